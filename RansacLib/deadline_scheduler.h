@@ -0,0 +1,457 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#ifndef RANSACLIB_RANSACLIB_DEADLINE_SCHEDULER_H_
+#define RANSACLIB_RANSACLIB_DEADLINE_SCHEDULER_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <RansacLib/ransac.h>
+#include <RansacLib/sampling.h>
+#include <RansacLib/utils.h>
+
+namespace ransac_lib {
+
+class DeadlineSchedulerOptions {
+ public:
+  DeadlineSchedulerOptions()
+      : slice_seconds_(0.002),
+        min_slice_iterations_(10u),
+        min_iterations_(25u),
+        initial_seconds_per_evaluation_(5e-8),
+        initial_inlier_ratio_(0.25),
+        smoothing_(0.2) {}
+  // The targeted duration of a time slice. The scheduler can only switch
+  // between jobs at the end of a slice.
+  double slice_seconds_;
+  uint32_t min_slice_iterations_;
+  // The number of iterations a job runs before it can be stopped early.
+  uint32_t min_iterations_;
+  // Initial values of the cost model, which are updated while the jobs run:
+  // The time needed to evaluate a model on a single data point, and the
+  // inlier ratio assumed for jobs that have not found a model yet as long as
+  // no job has finished.
+  double initial_seconds_per_evaluation_;
+  double initial_inlier_ratio_;
+  // The weight of a new observation in the exponential moving averages of
+  // the cost model.
+  double smoothing_;
+};
+
+// Describes how a job was scheduled. All times are in seconds relative to the
+// start of DeadlineScheduler::Run.
+struct ScheduledJobReport {
+  double release_seconds;
+  double deadline_seconds;
+  double finish_seconds;
+  // The time spent on the job itself.
+  double run_seconds;
+  // The predicted run time when the job was started.
+  double predicted_seconds;
+  int num_slices;
+  // True if the sampling was stopped before it reached the number of
+  // iterations required by the success probability of the job.
+  bool truncated;
+  bool missed_deadline;
+  int num_inliers;
+};
+
+// Runs LO-MSAC on a set of jobs that share a single thread and a common time
+// budget, e.g., the queries of a batch in an online service. Every job has a
+// release time, before which it cannot start, and a deadline. The jobs are
+// executed in time slices of a few iterations (see
+// LocallyOptimizedMSAC::RunIterations), and after every slice the released
+// job with the earliest deadline is continued (EDF scheduling). A newly
+// released job with an earlier deadline thus preempts the running job.
+//
+// The cost of a job is predicted from its number of data points and the
+// number of iterations it still needs. The latter is derived from the inlier
+// ratio of the best model found so far or, as long as the job has not found a
+// model, from the number of iterations the jobs finished before needed due to
+// their inlier ratios. The average is taken over the numbers of iterations
+// rather than the inlier ratios, as a few jobs with low inlier ratios
+// dominate the cost of a batch. Whenever
+// a job is started or resumed, it is granted the time it can use without
+// making any other job miss its predicted deadline. If the predicted costs
+// exceed the available time, each job is granted a share of its prediction
+// proportional to the overload instead. A job that used up its grant while
+// the system is overloaded, or that reaches its deadline, is stopped and
+// finalized with the best model found so far. As grants are computed from
+// the remaining time, time not used by easy jobs is given to harder ones.
+//
+// The solvers, models, and statistics passed to AddJob are not copied and
+// need to outlive Run. As the slices depend on the measured run times, the
+// results of a job can differ between runs with the same seeds.
+template <class Model, class ModelVector, class Solver,
+          class Sampler = UniformSampling<Solver> >
+class DeadlineScheduler {
+ public:
+  typedef LocallyOptimizedMSAC<Model, ModelVector, Solver, Sampler> Engine;
+
+  explicit DeadlineScheduler(const DeadlineSchedulerOptions& options)
+      : options_(options) {}
+
+  // Adds a job and returns its index. The release time and the deadline are
+  // given in seconds relative to the start of Run.
+  int AddJob(const LORansacOptions& options, const Solver* solver,
+             const double release_seconds, const double deadline_seconds,
+             Model* model, RansacStatistics* statistics) {
+    std::unique_ptr<Job> job(new Job);
+    job->options = options;
+    job->solver = solver;
+    job->model = model;
+    job->statistics = statistics;
+    job->started = false;
+    job->finished = false;
+    job->grant_end = 0.0;
+    job->report.release_seconds = release_seconds;
+    job->report.deadline_seconds = deadline_seconds;
+    job->report.finish_seconds = 0.0;
+    job->report.run_seconds = 0.0;
+    job->report.predicted_seconds = 0.0;
+    job->report.num_slices = 0;
+    job->report.truncated = false;
+    job->report.missed_deadline = false;
+    job->report.num_inliers = 0;
+    jobs_.push_back(std::move(job));
+    return static_cast<int>(jobs_.size()) - 1;
+  }
+
+  // Runs all jobs added so far and returns the number of missed deadlines.
+  int Run() {
+    seconds_per_evaluation_ = options_.initial_seconds_per_evaluation_;
+    iterations_prior_ = -1.0;
+    start_ = std::chrono::steady_clock::now();
+    const int kNumJobs = static_cast<int>(jobs_.size());
+    int num_unfinished = kNumJobs;
+    int previous_job = -1;
+
+    // The deadlines do not change, i.e., the jobs are sorted by their
+    // deadlines once and the scheduling decisions only update the demands.
+    deadline_order_.resize(kNumJobs);
+    for (int j = 0; j < kNumJobs; ++j) deadline_order_[j] = j;
+    std::stable_sort(deadline_order_.begin(), deadline_order_.end(),
+                     [this](const int a, const int b) {
+                       return jobs_[a]->report.deadline_seconds <
+                              jobs_[b]->report.deadline_seconds;
+                     });
+    demands_.assign(kNumJobs, 0.0);
+
+    while (num_unfinished > 0) {
+      double now = Elapsed();
+      const int kJob = NextJob(now);
+      if (kJob < 0) {
+        // Waits for the next job to be released.
+        double next_release = std::numeric_limits<double>::max();
+        for (const std::unique_ptr<Job>& job : jobs_) {
+          if (!job->finished) {
+            next_release =
+                std::min(next_release, job->report.release_seconds);
+          }
+        }
+        std::this_thread::sleep_for(
+            std::chrono::duration<double>(next_release - now));
+        continue;
+      }
+      Job& job = *jobs_[kJob];
+
+      if (!job.started) {
+        engine_.Initialize(job.options, *job.solver, &job.state,
+                           job.statistics);
+        job.started = true;
+        job.report.predicted_seconds = PredictRemainingSeconds(job);
+      }
+      // A job receives a new grant whenever it is started or resumed after
+      // another job ran.
+      if (kJob != previous_job) {
+        UpdateDemands();
+        job.grant_end = now + Grant(kJob, now, FeasibleFraction(now));
+      }
+      previous_job = kJob;
+
+      // A job whose deadline has passed is stopped as soon as it ran
+      // min_iterations_ iterations, without starting another slice.
+      const bool kDeadlinePassed =
+          now >= job.report.deadline_seconds &&
+          job.statistics->num_iterations >= options_.min_iterations_;
+      bool stop = kDeadlinePassed;
+      if (kDeadlinePassed) job.report.truncated = true;
+
+      if (!stop) {
+        // The grant is exceeded if the deadline has passed or if the job runs
+        // past its grant to reach min_iterations_. The slice then only has
+        // min_slice_iterations_ iterations.
+        const double kSecondsPerIteration = SecondsPerIteration(job);
+        const double kSliceSeconds = std::max(
+            0.0, std::min(options_.slice_seconds_, job.grant_end - now));
+        const uint32_t kSliceIterations = std::max(
+            options_.min_slice_iterations_,
+            static_cast<uint32_t>(std::min(
+                kSliceSeconds / kSecondsPerIteration,
+                static_cast<double>(std::numeric_limits<uint32_t>::max()))));
+
+        const uint32_t kIterationsBefore = job.statistics->num_iterations;
+        const int kLOBefore = job.statistics->number_lo_iterations;
+        const bool kSamplingDone =
+            engine_.RunIterations(job.options, *job.solver, kSliceIterations,
+                                  &job.state, job.model, job.statistics);
+        const double kSliceEnd = Elapsed();
+        job.report.run_seconds += kSliceEnd - now;
+        ++job.report.num_slices;
+        UpdateCostModel(job,
+                        job.statistics->num_iterations - kIterationsBefore,
+                        job.statistics->number_lo_iterations - kLOBefore,
+                        kSliceEnd - now);
+        now = kSliceEnd;
+        stop = kSamplingDone;
+      }
+
+      if (!stop && now >= job.grant_end &&
+          job.statistics->num_iterations >= options_.min_iterations_) {
+        // The job gets more time only if this does not put other jobs at
+        // risk and its deadline has not passed yet.
+        UpdateDemands();
+        const double kFeasibleFraction = FeasibleFraction(now);
+        const double kGrant = Grant(kJob, now, kFeasibleFraction);
+        if (kFeasibleFraction < 1.0 || kGrant <= 0.0) {
+          stop = true;
+          job.report.truncated = true;
+        } else {
+          job.grant_end = now + kGrant;
+        }
+      }
+      if (!stop) continue;
+
+      job.report.num_inliers = engine_.Finalize(
+          job.options, *job.solver, &job.state, job.model, job.statistics);
+      job.finished = true;
+      --num_unfinished;
+      // Frees the memory of the state.
+      job.state.ResetSampler();
+      std::vector<int>().swap(job.state.minimal_sample);
+      ModelVector().swap(job.state.estimated_models);
+      const double kFinish = Elapsed();
+      job.report.run_seconds += kFinish - now;
+      job.report.finish_seconds = kFinish;
+      job.report.missed_deadline = kFinish > job.report.deadline_seconds;
+      if (!job.report.truncated && job.state.valid) {
+        const double kIterations =
+            static_cast<double>(job.statistics->num_iterations);
+        iterations_prior_ =
+            iterations_prior_ < 0.0
+                ? kIterations
+                : iterations_prior_ +
+                      options_.smoothing_ * (kIterations - iterations_prior_);
+      }
+    }
+
+    int num_missed = 0;
+    reports_.clear();
+    for (const std::unique_ptr<Job>& job : jobs_) {
+      reports_.push_back(job->report);
+      if (job->report.missed_deadline) ++num_missed;
+    }
+    return num_missed;
+  }
+
+  // The reports of all jobs, in the order in which they were added. Only
+  // valid after Run.
+  inline const std::vector<ScheduledJobReport>& reports() const {
+    return reports_;
+  }
+
+  // The current estimates of the cost model.
+  inline double seconds_per_evaluation() const {
+    return seconds_per_evaluation_;
+  }
+  // The number of iterations expected for a job without a model, or -1 if no
+  // job has finished yet.
+  inline double iterations_prior() const { return iterations_prior_; }
+
+ protected:
+  struct Job {
+    LORansacOptions options;
+    const Solver* solver;
+    Model* model;
+    RansacStatistics* statistics;
+    typename Engine::EstimationState state;
+    bool started;
+    bool finished;
+    // The time until which the job may run without being stopped.
+    double grant_end;
+    ScheduledJobReport report;
+  };
+
+  inline double Elapsed() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start_)
+        .count();
+  }
+
+  // Returns the released, unfinished job with the earliest deadline, or -1 if
+  // there is none.
+  int NextJob(const double now) const {
+    int next = -1;
+    for (int j = 0; j < static_cast<int>(jobs_.size()); ++j) {
+      const Job& job = *jobs_[j];
+      if (job.finished || job.report.release_seconds > now) continue;
+      if (next < 0 || job.report.deadline_seconds <
+                          jobs_[next]->report.deadline_seconds) {
+        next = j;
+      }
+    }
+    return next;
+  }
+
+  // The cost of an iteration is dominated by evaluating the model(s) on all
+  // data points.
+  inline double SecondsPerIteration(const Job& job) const {
+    return seconds_per_evaluation_ *
+           static_cast<double>(std::max(1, job.solver->num_data()));
+  }
+
+  // The number of iterations a local optimization costs, as it scores about
+  // (num_lsq_iterations_ + 2) models in each of its steps.
+  inline double LOCostInIterations(const Job& job) const {
+    return static_cast<double>(job.options.num_lo_steps_ *
+                               (job.options.num_lsq_iterations_ + 2));
+  }
+
+  double PredictRemainingSeconds(const Job& job) const {
+    if (job.finished) return 0.0;
+    const RansacStatistics& stats = *job.statistics;
+    const uint32_t kMaxIterations = std::max(job.options.max_num_iterations_,
+                                             job.options.min_num_iterations_);
+    const double kPrior =
+        iterations_prior_ >= 0.0
+            ? iterations_prior_
+            : static_cast<double>(utils::NumRequiredIterations(
+                  options_.initial_inlier_ratio_,
+                  1.0 - job.options.success_probability_,
+                  job.solver->min_sample_size(),
+                  job.options.min_num_iterations_, kMaxIterations));
+    double remaining_iterations = 0.0;
+    if (!job.started) {
+      remaining_iterations = kPrior;
+    } else if (job.state.valid) {
+      // Without a model, the bound of the job is still the maximum number of
+      // iterations, which typically overestimates the cost by far.
+      double bound = static_cast<double>(job.state.max_num_iterations);
+      if (stats.best_num_inliers == 0) bound = std::min(bound, kPrior);
+      remaining_iterations = std::max(
+          0.0, bound - static_cast<double>(stats.num_iterations));
+    }
+    return (remaining_iterations + LOCostInIterations(job)) *
+           SecondsPerIteration(job);
+  }
+
+  // Predicts the remaining time of every job (see PredictRemainingSeconds).
+  // Called once per scheduling decision, before FeasibleFraction and Grant.
+  void UpdateDemands() {
+    for (int j = 0; j < static_cast<int>(jobs_.size()); ++j) {
+      demands_[j] = PredictRemainingSeconds(*jobs_[j]);
+    }
+  }
+
+  // Returns the largest factor s <= 1 such that all unfinished jobs meet
+  // their deadlines if each of them only needs s times its predicted time.
+  double FeasibleFraction(const double now) const {
+    double fraction = 1.0;
+    double cumulative = 0.0;
+    for (const int j : deadline_order_) {
+      if (jobs_[j]->finished) continue;
+      cumulative += demands_[j];
+      if (cumulative > 0.0) {
+        fraction = std::min(
+            fraction, (jobs_[j]->report.deadline_seconds - now) / cumulative);
+      }
+    }
+    return std::max(0.0, fraction);
+  }
+
+  // The time the job may run before it has to be reconsidered, given the
+  // result of FeasibleFraction(now).
+  double Grant(const int job_index, const double now,
+               const double feasible_fraction) const {
+    const Job& job = *jobs_[job_index];
+    // The slack of the job: the time it can use while all other jobs still
+    // finish before their deadlines according to their predictions.
+    double slack = job.report.deadline_seconds - now;
+    double cumulative = 0.0;
+    for (const int j : deadline_order_) {
+      if (j == job_index || jobs_[j]->finished) continue;
+      cumulative += demands_[j];
+      const double kDeadline = jobs_[j]->report.deadline_seconds;
+      if (kDeadline >= job.report.deadline_seconds) {
+        slack = std::min(slack, kDeadline - now - cumulative);
+      }
+    }
+    const double kShare = feasible_fraction * demands_[job_index];
+    return std::min(job.report.deadline_seconds - now,
+                    std::max(kShare, slack));
+  }
+
+  void UpdateCostModel(const Job& job, const uint32_t num_iterations,
+                       const int num_lo_iterations, const double seconds) {
+    const double kIterations =
+        static_cast<double>(num_iterations) +
+        static_cast<double>(num_lo_iterations) * LOCostInIterations(job);
+    if (kIterations <= 0.0 || seconds <= 0.0) return;
+    const double kNumData =
+        static_cast<double>(std::max(1, job.solver->num_data()));
+    const double kObserved = seconds / (kIterations * kNumData);
+    seconds_per_evaluation_ +=
+        options_.smoothing_ * (kObserved - seconds_per_evaluation_);
+  }
+
+  DeadlineSchedulerOptions options_;
+  Engine engine_;
+  std::vector<std::unique_ptr<Job>> jobs_;
+  // The indices of the jobs sorted by their deadlines, and the remaining time
+  // predicted for each job by the last call to UpdateDemands.
+  std::vector<int> deadline_order_;
+  std::vector<double> demands_;
+  std::vector<ScheduledJobReport> reports_;
+  std::chrono::steady_clock::time_point start_;
+  double seconds_per_evaluation_;
+  double iterations_prior_;
+};
+
+}  // namespace ransac_lib
+
+#endif  // RANSACLIB_RANSACLIB_DEADLINE_SCHEDULER_H_
@@ -0,0 +1,517 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#ifndef RANSACLIB_RANSACLIB_EXECUTOR_H_
+#define RANSACLIB_RANSACLIB_EXECUTOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <RansacLib/topology.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef RANSACLIB_WITH_TBB
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+#endif
+
+namespace ransac_lib {
+
+// The interface through which RansacLib executes work in parallel, e.g., the
+// parallel scoring in LocallyOptimizedMSAC (see LORansacOptions::executor_).
+// Applications that already manage their own threads can implement it (or use
+// one of the adapters below) such that RansacLib does not create additional
+// threads:
+//  - Submit schedules a task for asynchronous execution.
+//  - BulkFor calls function(i) for all i in [0, num_items) and returns once
+//    all calls have finished. The calling thread takes part in the work, such
+//    that BulkFor can also be called from within a task or a BulkFor.
+//  - Wait blocks until all tasks submitted so far have finished. It must not
+//    be called from within a task.
+// The functions passed to the executor must not throw exceptions.
+class Executor {
+ public:
+  virtual ~Executor() {}
+
+  virtual void Submit(std::function<void()> task) = 0;
+
+  virtual void BulkFor(const int num_items,
+                       const std::function<void(int)>& function) = 0;
+
+  virtual void Wait() = 0;
+
+  // The maximum number of threads executing work concurrently.
+  virtual int num_threads() const = 0;
+};
+
+// Executes all work immediately on the calling thread.
+class InlineExecutor : public Executor {
+ public:
+  void Submit(std::function<void()> task) override { task(); }
+
+  void BulkFor(const int num_items,
+               const std::function<void(int)>& function) override {
+    for (int i = 0; i < num_items; ++i) function(i);
+  }
+
+  void Wait() override {}
+
+  int num_threads() const override { return 1; }
+};
+
+class ThreadPoolOptions {
+ public:
+  ThreadPoolOptions()
+      : num_threads_(0),
+        pin_threads_(false),
+        use_smt_(true),
+        partition_by_node_(false),
+        workspace_bytes_(0u) {}
+  // The number of worker threads. If num_threads_ <= 0, one worker per CPU in
+  // the affinity mask of the process is created (only one per physical core
+  // if use_smt_ is false).
+  int num_threads_;
+  // Pins every worker to its own CPU (Linux only). The workers are spread
+  // evenly over the NUMA nodes (see topology::PlacementOrder).
+  bool pin_threads_;
+  // Whether the SMT siblings of a core are used for workers.
+  bool use_smt_;
+  // If true (and the workers are pinned), BulkFor splits the items into one
+  // contiguous block per NUMA node, with block sizes proportional to the
+  // node's number of workers, and processes every block only on the workers
+  // of its node. The blocks only depend on the number of items, such that a
+  // job whose data was allocated (first touched) in one BulkFor is processed
+  // on the same node by subsequent BulkFor calls with the same number of
+  // items. There is no work stealing between nodes.
+  bool partition_by_node_;
+  // The size of the workspace of every worker (see workspace()). It is
+  // allocated and first touched by the worker after pinning, i.e., on the
+  // worker's NUMA node under Linux's default memory policy.
+  size_t workspace_bytes_;
+};
+
+// The built-in thread pool. BulkFor distributes the items dynamically: The
+// calling thread and up to num_threads - 1 pool threads claim items from a
+// shared counter until all items are claimed. The calling thread then only
+// waits for the items claimed by other threads, which are being processed,
+// such that nested calls cannot deadlock.
+// If the items are partitioned by node (see ThreadPoolOptions), the calling
+// thread does not process items, unless it is a worker of the pool itself. In
+// that case, the call is not partitioned to avoid deadlocks.
+class ThreadPoolExecutor : public Executor {
+ public:
+  // Uses one thread per logical CPU the process may run on if
+  // num_threads <= 0 (see ThreadPoolOptions::num_threads_).
+  explicit ThreadPoolExecutor(const int num_threads = 0) {
+    ThreadPoolOptions options;
+    options.num_threads_ = num_threads;
+    Start(options, topology::DiscoverTopology());
+  }
+
+  explicit ThreadPoolExecutor(const ThreadPoolOptions& options) {
+    Start(options, topology::DiscoverTopology());
+  }
+
+  // Places the workers on the given CPUs instead of all CPUs of the machine,
+  // e.g., to restrict the pool to a subset of the NUMA nodes.
+  ThreadPoolExecutor(const ThreadPoolOptions& options,
+                     const topology::CpuTopology& cpu_topology) {
+    Start(options, cpu_topology);
+  }
+
+  ThreadPoolExecutor(const ThreadPoolExecutor&) = delete;
+  ThreadPoolExecutor& operator=(const ThreadPoolExecutor&) = delete;
+
+  ~ThreadPoolExecutor() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    task_cv_.notify_all();
+    for (std::thread& t : threads_) t.join();
+  }
+
+  void Submit(std::function<void()> task) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+      ++num_pending_;
+    }
+    task_cv_.notify_one();
+  }
+
+  void BulkFor(const int num_items,
+               const std::function<void(int)>& function) override {
+    if (num_items <= 0) return;
+    if (partition_by_node_ && num_nodes_ > 1 && current_worker() < 0) {
+      PartitionedBulkFor(num_items, function);
+      return;
+    }
+    if (num_items == 1 || num_threads_ == 1) {
+      for (int i = 0; i < num_items; ++i) function(i);
+      return;
+    }
+
+    // Helpers that start after all items have been claimed only touch the
+    // shared state, which they keep alive. The function is only called for
+    // claimed items, i.e., before BulkFor returns.
+    std::shared_ptr<Completion> completion(new Completion(num_items));
+    std::shared_ptr<BulkState> state(
+        new BulkState(0, num_items, &function, completion));
+    const int kNumHelpers = std::min(num_threads_ - 1, num_items - 1);
+    for (int h = 0; h < kNumHelpers; ++h) {
+      Submit([state]() { state->Work(); });
+    }
+    state->Work();
+    completion->Wait();
+  }
+
+  void Wait() override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this]() { return num_pending_ == 0; });
+  }
+
+  int num_threads() const override { return num_threads_; }
+
+  // The number of NUMA nodes the workers are placed on. Always 1 if the
+  // workers are not pinned.
+  int num_nodes() const { return num_nodes_; }
+
+  // Returns the index of the calling thread among the workers of this pool,
+  // or -1 if it is not a worker of this pool.
+  int current_worker() const {
+    const WorkerIdentity& identity = CurrentIdentity();
+    return identity.pool == this ? identity.index : -1;
+  }
+
+  // The CPU a worker is pinned to, or -1 if it is not pinned.
+  int worker_cpu(const int worker) const { return worker_cpus_[worker]; }
+
+  // The (dense) index of the NUMA node of a worker, see num_nodes().
+  int worker_node(const int worker) const { return worker_nodes_[worker]; }
+
+  // The workspace of a worker, which holds workspace_bytes() bytes. A worker
+  // may use its own workspace without synchronization.
+  char* workspace(const int worker) const {
+    return workspaces_[worker].get();
+  }
+
+  size_t workspace_bytes() const { return workspace_bytes_; }
+
+  const topology::CpuTopology& cpu_topology() const { return topology_; }
+
+ protected:
+  // Counts the processed items of a BulkFor call.
+  struct Completion {
+    explicit Completion(const int n) : num_items(n), num_done(0) {}
+
+    void Add(const int num_processed) {
+      if (num_done.fetch_add(num_processed) + num_processed == num_items) {
+        std::lock_guard<std::mutex> lock(mutex);
+        done_cv.notify_all();
+      }
+    }
+
+    void Wait() {
+      std::unique_lock<std::mutex> lock(mutex);
+      done_cv.wait(lock, [this]() { return num_done.load() == num_items; });
+    }
+
+    const int num_items;
+    std::atomic<int> num_done;
+    std::mutex mutex;
+    std::condition_variable done_cv;
+  };
+
+  // The items [begin, end) of a BulkFor call.
+  struct BulkState {
+    BulkState(const int b, const int e, const std::function<void(int)>* f,
+              const std::shared_ptr<Completion>& c)
+        : begin(b), end(e), function(f), next_item(b), completion(c) {}
+
+    void Work() {
+      int num_processed = 0;
+      for (int i = next_item++; i < end; i = next_item++) {
+        (*function)(i);
+        ++num_processed;
+      }
+      if (num_processed > 0) completion->Add(num_processed);
+    }
+
+    const int begin;
+    const int end;
+    const std::function<void(int)>* function;
+    std::atomic<int> next_item;
+    std::shared_ptr<Completion> completion;
+  };
+
+  struct WorkerIdentity {
+    const ThreadPoolExecutor* pool;
+    int index;
+  };
+
+  static WorkerIdentity& CurrentIdentity() {
+    thread_local WorkerIdentity identity = {nullptr, -1};
+    return identity;
+  }
+
+  void Start(const ThreadPoolOptions& options,
+             const topology::CpuTopology& cpu_topology) {
+    num_pending_ = 0;
+    num_started_ = 0;
+    stop_ = false;
+    partition_by_node_ = options.partition_by_node_;
+    workspace_bytes_ = options.workspace_bytes_;
+    topology_ = cpu_topology;
+    const std::vector<topology::LogicalCpu> kOrder =
+        topology::PlacementOrder(topology_, options.use_smt_);
+
+    num_threads_ = options.num_threads_;
+    if (num_threads_ <= 0) {
+      num_threads_ = std::max(1, static_cast<int>(kOrder.size()));
+    }
+    worker_cpus_.assign(num_threads_, -1);
+    worker_nodes_.assign(num_threads_, 0);
+    num_nodes_ = 1;
+    if (options.pin_threads_ && !kOrder.empty()) {
+      std::vector<int> node_index(std::max(1, topology_.num_nodes), -1);
+      num_nodes_ = 0;
+      for (int i = 0; i < num_threads_; ++i) {
+        const topology::LogicalCpu& cpu = kOrder[i % kOrder.size()];
+        worker_cpus_[i] = cpu.cpu;
+        if (node_index[cpu.node] < 0) node_index[cpu.node] = num_nodes_++;
+        worker_nodes_[i] = node_index[cpu.node];
+      }
+    }
+    workers_per_node_.assign(num_nodes_, 0);
+    for (const int kNode : worker_nodes_) ++workers_per_node_[kNode];
+    node_tasks_.resize(num_nodes_);
+    workspaces_.resize(num_threads_);
+
+    for (int i = 0; i < num_threads_; ++i) {
+      threads_.emplace_back(&ThreadPoolExecutor::WorkerLoop, this, i);
+    }
+    // Waits until all workers are pinned and allocated their workspaces.
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this]() { return num_started_ == num_threads_; });
+  }
+
+  void PartitionedBulkFor(const int num_items,
+                          const std::function<void(int)>& function) {
+    std::shared_ptr<Completion> completion(new Completion(num_items));
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      int workers_before = 0;
+      for (int n = 0; n < num_nodes_; ++n) {
+        const int kBegin = static_cast<int>(static_cast<int64_t>(num_items) *
+                                            workers_before / num_threads_);
+        workers_before += workers_per_node_[n];
+        const int kEnd = static_cast<int>(static_cast<int64_t>(num_items) *
+                                          workers_before / num_threads_);
+        if (kEnd == kBegin) continue;
+        std::shared_ptr<BulkState> state(
+            new BulkState(kBegin, kEnd, &function, completion));
+        const int kNumHelpers = std::min(workers_per_node_[n], kEnd - kBegin);
+        for (int h = 0; h < kNumHelpers; ++h) {
+          node_tasks_[n].push_back([state]() { state->Work(); });
+          ++num_pending_;
+        }
+      }
+    }
+    task_cv_.notify_all();
+    completion->Wait();
+  }
+
+  void WorkerLoop(const int index) {
+    CurrentIdentity().pool = this;
+    CurrentIdentity().index = index;
+    if (worker_cpus_[index] >= 0) {
+      topology::PinCurrentThread(worker_cpus_[index]);
+    }
+    if (workspace_bytes_ > 0u) {
+      workspaces_[index].reset(new char[workspace_bytes_]);
+      std::fill(workspaces_[index].get(),
+                workspaces_[index].get() + workspace_bytes_, 0);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++num_started_;
+    }
+    done_cv_.notify_all();
+
+    std::deque<std::function<void()>>& node_tasks =
+        node_tasks_[worker_nodes_[index]];
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        task_cv_.wait(lock, [this, &node_tasks]() {
+          return stop_ || !node_tasks.empty() || !tasks_.empty();
+        });
+        if (!node_tasks.empty()) {
+          task = std::move(node_tasks.front());
+          node_tasks.pop_front();
+        } else if (!tasks_.empty()) {
+          task = std::move(tasks_.front());
+          tasks_.pop_front();
+        } else {
+          return;
+        }
+      }
+      task();
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--num_pending_ == 0) done_cv_.notify_all();
+    }
+  }
+
+  int num_threads_;
+  int num_nodes_;
+  bool partition_by_node_;
+  size_t workspace_bytes_;
+  topology::CpuTopology topology_;
+  std::vector<int> worker_cpus_;
+  std::vector<int> worker_nodes_;
+  std::vector<int> workers_per_node_;
+  std::vector<std::unique_ptr<char[]>> workspaces_;
+  std::vector<std::thread> threads_;
+  // Tasks that can be executed by any worker, and tasks for the workers of a
+  // specific node.
+  std::deque<std::function<void()>> tasks_;
+  std::vector<std::deque<std::function<void()>>> node_tasks_;
+  int num_pending_;
+  int num_started_;
+  bool stop_;
+  std::mutex mutex_;
+  std::condition_variable task_cv_;
+  std::condition_variable done_cv_;
+};
+
+// Returns a thread pool with one thread per logical CPU the process may run
+// on (including SMT siblings) that is shared by the whole process. It is
+// created on first use.
+inline Executor* DefaultExecutor() {
+  static ThreadPoolExecutor pool;
+  return &pool;
+}
+
+#ifdef _OPENMP
+// Executes BulkFor as a dynamically scheduled OpenMP loop on the threads of
+// the OpenMP runtime. As OpenMP tasks are bound to parallel regions, submitted
+// tasks are executed immediately on the calling thread.
+class OpenMPExecutor : public Executor {
+ public:
+  // Uses omp_get_max_threads() threads if num_threads <= 0.
+  explicit OpenMPExecutor(const int num_threads = 0)
+      : num_threads_(num_threads > 0 ? num_threads : omp_get_max_threads()) {}
+
+  void Submit(std::function<void()> task) override { task(); }
+
+  void BulkFor(const int num_items,
+               const std::function<void(int)>& function) override {
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads_)
+    for (int i = 0; i < num_items; ++i) function(i);
+  }
+
+  void Wait() override {}
+
+  int num_threads() const override { return num_threads_; }
+
+ protected:
+  int num_threads_;
+};
+#endif
+
+#ifdef RANSACLIB_WITH_TBB
+// Executes all work in a TBB task arena, i.e., on TBB's worker threads, which
+// are shared with the rest of the application. Requires linking against TBB
+// and defining RANSACLIB_WITH_TBB.
+class TBBExecutor : public Executor {
+ public:
+  // Uses TBB's default concurrency if num_threads <= 0.
+  explicit TBBExecutor(const int num_threads = 0)
+      : arena_(num_threads > 0 ? num_threads
+                               : static_cast<int>(
+                                     tbb::task_arena::automatic)) {}
+
+  // tbb::task_group requires that all tasks finished before it is destroyed.
+  ~TBBExecutor() noexcept override { Wait(); }
+
+  void Submit(std::function<void()> task) override {
+    arena_.execute([this, &task]() { group_.run(std::move(task)); });
+  }
+
+  void BulkFor(const int num_items,
+               const std::function<void(int)>& function) override {
+    arena_.execute([num_items, &function]() {
+      tbb::parallel_for(0, num_items, [&function](int i) { function(i); });
+    });
+  }
+
+  void Wait() override {
+    arena_.execute([this]() { group_.wait(); });
+  }
+
+  int num_threads() const override { return arena_.max_concurrency(); }
+
+ protected:
+  // Mutable as max_concurrency() initializes the arena on first use.
+  mutable tbb::task_arena arena_;
+  tbb::task_group group_;
+};
+#endif
+
+// Calls function(i) for all i in [0, num_items), in parallel via the executor
+// if it is not nullptr.
+inline void ParallelFor(Executor* executor, const int num_items,
+                        const std::function<void(int)>& function) {
+  if (executor == nullptr) {
+    for (int i = 0; i < num_items; ++i) function(i);
+  } else {
+    executor->BulkFor(num_items, function);
+  }
+}
+
+}  // namespace ransac_lib
+
+#endif  // RANSACLIB_RANSACLIB_EXECUTOR_H_
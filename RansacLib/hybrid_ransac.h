@@ -40,6 +40,7 @@
 #include <vector>
 
 #include <RansacLib/hybrid_sampling.h>
+#include <RansacLib/policies.h>
 #include <RansacLib/utils.h>
 
 namespace ransac_lib {
@@ -123,8 +124,11 @@ class HybridRansacBase {
 // Pose Estimation, CVPR 2018] and [Lebeda, Matas, Chum, Fixing the Locally
 // Optimized RANSAC, BMVC 2012]. Iteratively re-weighted least-squares
 // optimization is optional.
+// Of the Statistics sink (see policies.h), only BeginIteration is used: the
+// inlier indices are always stored as local optimization relies on them.
 template <class Model, class ModelVector, class HybridSolver,
-          class Sampler = HybridUniformSampling<HybridSolver> >
+          class Sampler = HybridUniformSampling<HybridSolver>,
+          class Statistics = FullStatistics>
 class HybridLocallyOptimizedMSAC : public HybridRansacBase {
  public:
   // Estimates a model using a given solver. Notice that the solver contains
@@ -177,6 +181,7 @@ class HybridLocallyOptimizedMSAC : public HybridRansacBase {
 
     std::vector<std::vector<int>> minimal_sample(kNumDataTypes);
     ModelVector estimated_models;
+    std::vector<double> solver_probabilities(kNumSolvers);
 
     std::mt19937 rng;
     rng.seed(options.random_seed_);
@@ -185,6 +190,7 @@ class HybridLocallyOptimizedMSAC : public HybridRansacBase {
     for (stats.num_iterations_total = 0u;
          stats.num_iterations_total < max_num_iterations;
          ++stats.num_iterations_total) {
+      Statistics::BeginIteration(stats.num_iterations_total);
       // As proposed by Lebeda et al., Local Optimization is not executed in
       // the first lo_starting_iterations_ iterations. We thus run LO on the
       // best model found so far once we reach this iteration.
@@ -201,8 +207,9 @@ class HybridLocallyOptimizedMSAC : public HybridRansacBase {
       }
 
       const int kSolverType =
-          SelectMinimalSolver(solver, prior_probabilities, stats,
-                              options.min_num_iterations_, &rng);
+          SelectMinimalSolver(prior_probabilities, min_sample_sizes,
+                              kNumDataTypes, stats, options.min_num_iterations_,
+                              &rng, &solver_probabilities);
 
       if (kSolverType < -1) {
         // Since no solver could be selected, we stop Hybrid RANSAC here.
@@ -321,18 +328,19 @@ class HybridLocallyOptimizedMSAC : public HybridRansacBase {
 
  protected:
   // Randomly selects a minimal solver. See Eq. 1 in Camposeco et al.
-  int SelectMinimalSolver(const HybridSolver& solver,
-                          const std::vector<double> prior_probabilities,
+  // solver_probabilities is used as buffer for the selection probabilities,
+  // such that the selection does not allocate memory.
+  int SelectMinimalSolver(const std::vector<double>& prior_probabilities,
+                          const std::vector<std::vector<int>>& min_sample_sizes,
+                          const int num_data_types,
                           const HybridRansacStatistics& stats,
                           const uint32_t min_num_iterations,
-                          std::mt19937* rng) const {
+                          std::mt19937* rng,
+                          std::vector<double>* solver_probabilities) const {
     double sum_probabilities = 0.0;
     const int kNumSolvers = static_cast<int>(prior_probabilities.size());
-    std::vector<std::vector<int>> min_sample_sizes;
-    solver.min_sample_sizes(&min_sample_sizes);
-    std::vector<double> probabilities(kNumSolvers, 0);
-
-    const int kNumDataTypes = solver.num_data_types();
+    std::vector<double>& probabilities = *solver_probabilities;
+    probabilities.assign(kNumSolvers, 0.0);
 
     // There is a special case where all inlier ratios are 0. In this case, the
     // solvers should be sampled based on the priors.
@@ -353,7 +361,7 @@ class HybridLocallyOptimizedMSAC : public HybridRansacBase {
         }
 
         double all_inlier_prob = 1.0;
-        for (int j = 0; j < kNumDataTypes; ++j) {
+        for (int j = 0; j < num_data_types; ++j) {
           all_inlier_prob *=
               std::pow(stats.inlier_ratios[j],
                        static_cast<double>(min_sample_sizes[i][j]));
@@ -387,7 +395,7 @@ class HybridLocallyOptimizedMSAC : public HybridRansacBase {
       const HybridLORansacOptions& options, const HybridSolver& solver,
       const ModelVector& models, const int num_models,
       const std::vector<double>& squared_inlier_thresholds,
-      const int num_data_types, const std::vector<int> num_data,
+      const int num_data_types, const std::vector<int>& num_data,
       double* best_score, int* best_model_id) const {
     *best_score = std::numeric_limits<double>::max();
     *best_model_id = 0;
@@ -407,7 +415,7 @@ class HybridLocallyOptimizedMSAC : public HybridRansacBase {
   void ScoreModel(const HybridLORansacOptions& options,
                   const HybridSolver& solver, const Model& model,
                   const std::vector<double>& squared_inlier_thresholds,
-                  const int num_data_types, const std::vector<int> num_data,
+                  const int num_data_types, const std::vector<int>& num_data,
                   double* score) const {
     *score = 0.0;
 
@@ -0,0 +1,325 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of the copyright holder nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#ifndef RANSACLIB_RANSACLIB_MULTI_THRESHOLD_RANSAC_H_
+#define RANSACLIB_RANSACLIB_MULTI_THRESHOLD_RANSAC_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <RansacLib/ransac.h>
+#include <RansacLib/sampling.h>
+#include <RansacLib/scratch_arena.h>
+#include <RansacLib/utils.h>
+
+namespace ransac_lib {
+
+class MultiThresholdLORansacOptions : public LORansacOptions {
+ public:
+  MultiThresholdLORansacOptions() {}
+  // The squared inlier thresholds for which models are estimated. The
+  // squared_inlier_threshold_ inherited from RansacOptions is ignored.
+  std::vector<double> squared_inlier_thresholds_;
+};
+
+// Runs LO-MSAC for multiple inlier thresholds at (roughly) the cost of a
+// single run: All thresholds share the random samples, the calls to the
+// minimal solver, and the computation of the residuals. For each threshold,
+// a separate best model, score, and adaptive termination criterion are
+// maintained, i.e., sampling stops once the criteria of all thresholds are
+// met. Local optimization and the final least squares refinement depend on
+// the inliers and are thus performed per threshold.
+// Every threshold uses its own random number generator for local
+// optimization, seeded with random_seed_. As a result, the model and
+// statistics obtained for a threshold are identical to the ones obtained by
+// LocallyOptimizedMSAC with the same options and this threshold.
+template <class Model, class ModelVector, class Solver,
+          class Sampler = UniformSampling<Solver> >
+class MultiThresholdLocallyOptimizedMSAC
+    : public LocallyOptimizedMSAC<Model, ModelVector, Solver, Sampler> {
+ public:
+  typedef typename LocallyOptimizedMSAC<Model, ModelVector, Solver,
+                                        Sampler>::Scorer Scorer;
+
+  // Estimates one model per threshold. best_models and statistics are resized
+  // to the number of thresholds. Returns the number of thresholds for which
+  // a model with at least one inlier was found.
+  int EstimateModels(const MultiThresholdLORansacOptions& options,
+                     const Solver& solver, ModelVector* best_models,
+                     std::vector<RansacStatistics>* statistics) const {
+    const int kNumThresholds =
+        static_cast<int>(options.squared_inlier_thresholds_.size());
+    best_models->resize(kNumThresholds);
+    statistics->resize(kNumThresholds);
+    for (int t = 0; t < kNumThresholds; ++t) {
+      this->ResetStatistics(&((*statistics)[t]));
+    }
+    if (kNumThresholds == 0) return 0;
+
+    // Sanity check: No need to run RANSAC if there are not enough data
+    // points.
+    const int kMinSampleSize = solver.min_sample_size();
+    const int kNumData = solver.num_data();
+    if (kMinSampleSize > kNumData || kMinSampleSize <= 0) {
+      return 0;
+    }
+
+    // Initializes variables, etc.
+    Sampler sampler(options.random_seed_, solver);
+
+    const uint32_t kMaxNumIterations =
+        std::max(options.max_num_iterations_, options.min_num_iterations_);
+
+    // The per-threshold state. Each threshold uses a copy of the options with
+    // its own inlier threshold such that the functions of LocallyOptimizedMSAC
+    // can be used for local optimization.
+    std::vector<LORansacOptions> threshold_options(kNumThresholds, options);
+    std::vector<std::mt19937> rngs(kNumThresholds);
+    std::vector<uint32_t> max_num_iterations(kNumThresholds,
+                                             kMaxNumIterations);
+    std::vector<bool> active(kNumThresholds, true);
+    ModelVector best_minimal_models(kNumThresholds);
+    std::vector<double> best_min_model_scores(
+        kNumThresholds, std::numeric_limits<double>::max());
+    for (int t = 0; t < kNumThresholds; ++t) {
+      threshold_options[t].squared_inlier_threshold_ =
+          options.squared_inlier_thresholds_[t];
+      rngs[t].seed(options.random_seed_);
+    }
+
+    std::vector<int> minimal_sample(kMinSampleSize);
+    ModelVector estimated_models;
+    ScratchArena scratch_arena;
+    SolverContext context = {&scratch_arena};
+
+    // The indices and squared inlier thresholds of the thresholds whose
+    // termination criteria are not yet met.
+    std::vector<int> active_ids;
+    std::vector<double> active_thresholds;
+    std::vector<double> scores;
+    std::vector<double> best_local_scores;
+    std::vector<int> best_local_model_ids;
+
+    // Runs random sampling.
+    for (uint32_t iteration = 0u;; ++iteration) {
+      active_ids.clear();
+      active_thresholds.clear();
+      for (int t = 0; t < kNumThresholds; ++t) {
+        if (!active[t]) continue;
+        if (iteration >= max_num_iterations[t]) {
+          active[t] = false;
+          (*statistics)[t].num_iterations = iteration;
+          continue;
+        }
+        active_ids.push_back(t);
+        active_thresholds.push_back(options.squared_inlier_thresholds_[t]);
+      }
+      if (active_ids.empty()) break;
+      const int kNumActive = static_cast<int>(active_ids.size());
+      scratch_arena.Reset();
+
+      // As proposed by Lebeda et al., Local Optimization is not executed in
+      // the first lo_starting_iterations_ iterations. We thus run LO on the
+      // best model found so far once we reach this iteration.
+      if (iteration == options.lo_starting_iterations_) {
+        for (const int t : active_ids) {
+          if (best_min_model_scores[t] == std::numeric_limits<double>::max()) {
+            continue;
+          }
+          RansacStatistics& stats = (*statistics)[t];
+          ++stats.number_lo_iterations;
+          this->LocalOptimization(threshold_options[t], solver, &context,
+                                  &rngs[t], &((*best_models)[t]),
+                                  &(stats.best_model_score));
+          this->UpdateInlierStatistics(threshold_options[t], solver,
+                                       (*best_models)[t], &stats);
+          max_num_iterations[t] = utils::NumRequiredIterations(
+              stats.inlier_ratio, 1.0 - options.success_probability_,
+              kMinSampleSize, options.min_num_iterations_,
+              options.max_num_iterations_);
+        }
+      }
+
+      sampler.Sample(&minimal_sample);
+
+      // MinimalSolver returns the number of estimated models.
+      const int kNumEstimatedModels = utils::CallMinimalSolver(
+          solver, minimal_sample, &estimated_models, &context);
+      if (kNumEstimatedModels <= 0) continue;
+
+      // Finds the best model among all estimated models for each threshold.
+      // The residuals of each model are computed only once.
+      best_local_scores.assign(kNumActive,
+                               std::numeric_limits<double>::max());
+      best_local_model_ids.assign(kNumActive, 0);
+      for (int m = 0; m < kNumEstimatedModels; ++m) {
+        ScoreModelMultiThreshold(solver, estimated_models[m],
+                                 active_thresholds, &scores);
+        for (int a = 0; a < kNumActive; ++a) {
+          if (scores[a] < best_local_scores[a]) {
+            best_local_scores[a] = scores[a];
+            best_local_model_ids[a] = m;
+          }
+        }
+      }
+
+      // Updates the best model found so far for each threshold. This is the
+      // same update as in LocallyOptimizedMSAC::EstimateModel.
+      for (int a = 0; a < kNumActive; ++a) {
+        const int t = active_ids[a];
+        RansacStatistics& stats = (*statistics)[t];
+        const LORansacOptions& t_options = threshold_options[t];
+
+        if (best_local_scores[a] >= best_min_model_scores[t] &&
+            iteration != options.lo_starting_iterations_) {
+          continue;
+        }
+        const bool kBestMinModel =
+            best_local_scores[a] < best_min_model_scores[t];
+
+        if (kBestMinModel) {
+          best_min_model_scores[t] = best_local_scores[a];
+          best_minimal_models[t] = estimated_models[best_local_model_ids[a]];
+
+          this->UpdateBestModel(best_min_model_scores[t],
+                                best_minimal_models[t],
+                                &(stats.best_model_score),
+                                &((*best_models)[t]));
+        }
+
+        const bool kRunLO =
+            (iteration >= options.lo_starting_iterations_ &&
+             best_min_model_scores[t] < std::numeric_limits<double>::max());
+
+        if ((!kBestMinModel) && (!kRunLO)) continue;
+
+        if (kRunLO) {
+          ++stats.number_lo_iterations;
+          double score = best_min_model_scores[t];
+          this->LocalOptimization(t_options, solver, &context, &rngs[t],
+                                  &best_minimal_models[t], &score);
+
+          this->UpdateBestModel(score, best_minimal_models[t],
+                                &(stats.best_model_score),
+                                &((*best_models)[t]));
+        }
+
+        this->UpdateInlierStatistics(t_options, solver, (*best_models)[t],
+                                     &stats);
+        max_num_iterations[t] = utils::NumRequiredIterations(
+            stats.inlier_ratio, 1.0 - options.success_probability_,
+            kMinSampleSize, options.min_num_iterations_,
+            options.max_num_iterations_);
+      }
+    }
+
+    int num_successful = 0;
+    for (int t = 0; t < kNumThresholds; ++t) {
+      RansacStatistics& stats = (*statistics)[t];
+      const LORansacOptions& t_options = threshold_options[t];
+      Model& best_model = (*best_models)[t];
+
+      // As proposed by Lebeda et al., Local Optimization is not executed in
+      // the first lo_starting_iterations_ iterations. If LO-MSAC needs less
+      // than lo_starting_iterations_ iterations, we run LO now.
+      if (stats.num_iterations <= options.lo_starting_iterations_ &&
+          stats.best_model_score < std::numeric_limits<double>::max()) {
+        ++stats.number_lo_iterations;
+        this->LocalOptimization(t_options, solver, &context, &rngs[t],
+                                &best_model, &(stats.best_model_score));
+        this->UpdateInlierStatistics(t_options, solver, best_model, &stats);
+      }
+
+      if (options.final_least_squares_) {
+        Model refined_model = best_model;
+        scratch_arena.Reset();
+        utils::CallLeastSquares(solver, stats.inlier_indices, &refined_model,
+                                &context);
+
+        double score = std::numeric_limits<double>::max();
+        this->ScoreModel(solver, refined_model,
+                         t_options.squared_inlier_threshold_, &score);
+        if (score < stats.best_model_score) {
+          stats.best_model_score = score;
+          best_model = refined_model;
+          this->UpdateInlierStatistics(t_options, solver, best_model, &stats);
+        }
+      }
+
+      if (stats.best_num_inliers > 0) ++num_successful;
+    }
+
+    return num_successful;
+  }
+
+ protected:
+  // Computes the scores of a model for multiple squared inlier thresholds,
+  // evaluating the model only once per data point (on all data points at
+  // once if the solver supports it, see ComputeSquaredErrors). The squared
+  // errors are scored in the same blocks and accumulated in the same order as
+  // in ScoreModel (see AddScores), i.e., the scores are identical to the ones
+  // computed by ScoreModel.
+  void ScoreModelMultiThreshold(const Solver& solver, const Model& model,
+                                const std::vector<double>& thresholds,
+                                std::vector<double>* scores) const {
+    const int kNumData = solver.num_data();
+    const int kNumThresholds = static_cast<int>(thresholds.size());
+    scores->assign(kNumThresholds, 0.0);
+    double* s = scores->data();
+    const double* thresh = thresholds.data();
+    const double* kErrors = this->ComputeSquaredErrors(
+        solver, model, utils::HasEvaluateModelOnPoints<Solver, Model>());
+    double squared_errors[kScoreBlockSize];
+    for (int i = 0; i < kNumData; i += kScoreBlockSize) {
+      const int kNumErrors = std::min(kScoreBlockSize, kNumData - i);
+      const double* block = squared_errors;
+      if (kErrors != nullptr) {
+        block = kErrors + i;
+      } else {
+        for (int j = 0; j < kNumErrors; ++j) {
+          squared_errors[j] = solver.EvaluateModelOnPoint(model, i + j);
+        }
+      }
+      for (int t = 0; t < kNumThresholds; ++t) {
+        this->AddScores(block, kNumErrors, thresh[t],
+                        scoring::SumsSequentially<Scorer>(), &s[t]);
+      }
+    }
+  }
+};
+
+}  // namespace ransac_lib
+
+#endif  // RANSACLIB_RANSACLIB_MULTI_THRESHOLD_RANSAC_H_
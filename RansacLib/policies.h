@@ -0,0 +1,208 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#ifndef RANSACLIB_RANSACLIB_POLICIES_H_
+#define RANSACLIB_RANSACLIB_POLICIES_H_
+
+#include <algorithm>
+#include <cstdint>
+
+#include <RansacLib/scoring.h>
+#include <RansacLib/utils.h>
+
+namespace ransac_lib {
+
+// Compile-time policies that configure the stages of LocallyOptimizedMSAC
+// (see RansacPolicies below). All policies are stateless. Their functions
+// and flags are resolved at compile time, such that stages that are not used
+// by a configuration do not appear in the generated code. The sampler is
+// configured by the separate Sampler template parameter of the engine.
+
+// Scorers compute the score of a model from its squared errors. Lower scores
+// are better. InlierCountScorer (classic RANSAC), MSACScorer,
+// SequentialMSACScorer, MLESACScorer, HuberScorer, and MAGSACPlusPlusScorer
+// are defined in scoring.h, which also describes the interface of a scorer.
+
+// Verifiers decide whether a model estimated by the minimal solver is scored
+// at all, e.g., to reject degenerate models or models violating a chirality
+// constraint before evaluating them on all data points.
+
+// Scores all models.
+struct AcceptAllModels {
+  template <class Solver, class Model>
+  static inline bool Accept(const Solver& /*solver*/, const Model& /*model*/) {
+    return true;
+  }
+};
+
+// Local optimizers determine whether local optimization is run and whether
+// it uses the inlier-based least squares fits of Lebeda et al. or
+// iteratively reweighted least squares (IRLS).
+
+struct LebedaLocalOptimization {
+  static const bool kEnabled = true;
+  static const bool kIterativelyReweighted = false;
+};
+
+// Plain MSAC: The best model is the best model found by the minimal solver.
+// The random number generator used by local optimization is not seeded.
+struct NoLocalOptimization {
+  static const bool kEnabled = false;
+  static const bool kIterativelyReweighted = false;
+};
+
+// IRLS in the style of sigma-consensus++ of MAGSAC++: Starting from the best
+// model, runs up to num_lsq_iterations_ weighted least squares fits, where
+// every data point is weighted by Scorer::Weight of its squared error. Stops
+// as soon as a fit does not improve the score. num_lo_steps_ and the
+// threshold multiplier are not used and no random sampling is performed.
+// Requires a scorer that provides Weight (see scoring.h) and a solver that
+// provides
+//   void WeightedLeastSquares(const std::vector<int>& sample,
+//                             const std::vector<double>& weights,
+//                             Model* model) const;
+// which, like LeastSquares, refines the given model and leaves it unchanged
+// if the fit fails. It can take a SolverContext* as last parameter.
+struct IRLSLocalOptimization {
+  static const bool kEnabled = true;
+  static const bool kIterativelyReweighted = true;
+};
+
+// Terminators compute the maximum number of iterations.
+
+// The standard adaptive criterion: Stops once an all-inlier sample has been
+// drawn with probability success_probability_, given the inlier ratio of the
+// best model found so far. Requires counting the inliers of every new best
+// model.
+struct AdaptiveTermination {
+  static const bool kUsesInlierRatio = true;
+
+  template <class Options>
+  static inline uint32_t MaxNumIterations(const Options& options,
+                                          const double inlier_ratio,
+                                          const int min_sample_size) {
+    return utils::NumRequiredIterations(
+        inlier_ratio, 1.0 - options.success_probability_, min_sample_size,
+        options.min_num_iterations_, options.max_num_iterations_);
+  }
+};
+
+// Always runs max(min_num_iterations_, max_num_iterations_) iterations. The
+// inliers are only determined once, for the final model.
+struct FixedNumIterations {
+  static const bool kUsesInlierRatio = false;
+
+  template <class Options>
+  static inline uint32_t MaxNumIterations(const Options& options,
+                                          const double /*inlier_ratio*/,
+                                          const int /*min_sample_size*/) {
+    return std::max(options.max_num_iterations_, options.min_num_iterations_);
+  }
+};
+
+// Statistics sinks determine which statistics are reported. In addition,
+// BeginIteration(iteration) is called at the start of each iteration, before
+// the local optimization run once lo_starting_iterations_ is reached and before
+// sampling. Custom sinks can derive from the sinks below and hide it, e.g., to
+// attribute work to iterations (see allocation_counting.cc).
+
+// Reports all statistics, including the indices of the inliers of the best
+// model.
+struct FullStatistics {
+  static const bool kStoreInlierIndices = true;
+
+  static inline void BeginIteration(const uint32_t /*iteration*/) {}
+};
+
+// Only reports the number of inliers, not their indices, such that counting
+// the inliers of a new best model does not write to memory.
+// RansacStatistics::inlier_indices stays empty.
+struct CountOnlyStatistics {
+  static const bool kStoreInlierIndices = false;
+
+  static inline void BeginIteration(const uint32_t /*iteration*/) {}
+};
+
+// Bundles the policies used by LocallyOptimizedMSAC.
+template <class ScorerType = SequentialMSACScorer,
+          class LocalOptimizerType = LebedaLocalOptimization,
+          class TerminatorType = AdaptiveTermination,
+          class StatisticsType = FullStatistics,
+          class VerifierType = AcceptAllModels>
+struct RansacPolicies {
+  typedef ScorerType Scorer;
+  typedef LocalOptimizerType LocalOptimizer;
+  typedef TerminatorType Terminator;
+  typedef StatisticsType Statistics;
+  typedef VerifierType Verifier;
+};
+
+// LO-MSAC, the default configuration of LocallyOptimizedMSAC. Its scores are
+// summed sequentially and are bitwise reproducible across versions (see
+// SequentialMSACScorer).
+typedef RansacPolicies<> LOMSACPolicies;
+
+// LO-MSAC with vectorized block scoring. Faster than LOMSACPolicies, but the
+// model scores can differ from theirs in the last bits, which can change the
+// selected model in rare cases of (almost) ties.
+typedef RansacPolicies<MSACScorer> VectorizedLOMSACPolicies;
+
+// Plain MSAC with adaptive termination.
+typedef RansacPolicies<MSACScorer, NoLocalOptimization> MSACPolicies;
+
+// Plain MSAC that only reports the number of inliers. Besides sampling,
+// solving, and scoring, the inner loop only counts the inliers of new best
+// models for the termination criterion.
+typedef RansacPolicies<MSACScorer, NoLocalOptimization, AdaptiveTermination,
+                       CountOnlyStatistics>
+    CountOnlyMSACPolicies;
+
+// Classic RANSAC that only counts inliers, e.g., for cheap first-pass
+// filtering of matches. Scoring a model reduces to comparing its squared
+// errors against the threshold and counting the results.
+typedef RansacPolicies<InlierCountScorer, NoLocalOptimization,
+                       AdaptiveTermination, CountOnlyStatistics>
+    InlierCountRansacPolicies;
+
+// LO-MSAC variants that use the MLESAC and the truncated Huber score for
+// model selection and local optimization.
+typedef RansacPolicies<MLESACScorer> LOMLESACPolicies;
+typedef RansacPolicies<HuberScorer> LOHuberPolicies;
+
+// MAGSAC++: Models are selected by the marginalized MAGSAC++ score and
+// refined by IRLS. The inlier threshold is interpreted as the largest
+// residual considered by the marginalization (k * sigma_max, see
+// MAGSACPlusPlusScorer), not as a tuned inlier threshold.
+typedef RansacPolicies<MAGSACPlusPlusScorer<>, IRLSLocalOptimization>
+    MAGSACPlusPlusPolicies;
+
+}  // namespace ransac_lib
+
+#endif  // RANSACLIB_RANSACLIB_POLICIES_H_
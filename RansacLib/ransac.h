@@ -36,10 +36,15 @@
 #include <cstddef>
 #include <cstdint>
 #include <limits>
+#include <new>
 #include <random>
+#include <type_traits>
 #include <vector>
 
+#include <RansacLib/executor.h>
+#include <RansacLib/policies.h>
 #include <RansacLib/sampling.h>
+#include <RansacLib/scratch_arena.h>
 #include <RansacLib/utils.h>
 
 namespace ransac_lib {
@@ -70,7 +75,9 @@ class LORansacOptions : public RansacOptions {
         min_sample_multiplicator_(7),
         non_min_sample_multiplier_(3),
         lo_starting_iterations_(50u),
-        final_least_squares_(false) {}
+        final_least_squares_(false),
+        executor_(nullptr),
+        min_num_data_per_task_(4096) {}
   int num_lo_steps_;
   double threshold_multiplier_;
   int num_lsq_iterations_;
@@ -89,6 +96,17 @@ class LORansacOptions : public RansacOptions {
   // to reduce overhead.
   uint32_t lo_starting_iterations_;
   bool final_least_squares_;
+  // If not nullptr, LO-MSAC scores models in parallel via the executor: The
+  // models returned by a single call to the minimal solver are scored
+  // concurrently, and the data points are split into chunks of at least
+  // min_num_data_per_task_ points if there are at least twice as many. The
+  // scores of the chunks are summed in a fixed order, such that the results
+  // do not depend on the number of threads. They might however differ in the
+  // last bits from the results of the sequential implementation.
+  // Solvers providing EvaluateModelOnPoints (see utils.h) are already
+  // vectorized and always score a model with a single call.
+  Executor* executor_;
+  int min_num_data_per_task_;
 };
 
 struct RansacStatistics {
@@ -116,10 +134,59 @@ class RansacBase {
 // Implements LO-RANSAC with MSAC (top-hat) scoring, based on the description
 // provided in [Lebeda, Matas, Chum, Fixing the Locally Optimized RANSAC, BMVC
 // 2012]. Iteratively re-weighted least-squares optimization is optional.
+// The stages of the algorithm are configured at compile time via Policies
+// (see policies.h). E.g., LocallyOptimizedMSAC<..., MSACPolicies> is plain
+// MSAC without any of the code needed for local optimization.
 template <class Model, class ModelVector, class Solver,
-          class Sampler = UniformSampling<Solver> >
+          class Sampler = UniformSampling<Solver>,
+          class Policies = LOMSACPolicies>
 class LocallyOptimizedMSAC : public RansacBase {
  public:
+  typedef typename Policies::Scorer Scorer;
+  typedef typename Policies::LocalOptimizer LocalOptimizer;
+  typedef typename Policies::Terminator Terminator;
+  typedef typename Policies::Statistics Statistics;
+  typedef typename Policies::Verifier Verifier;
+
+  // The state of a single run of LO-MSAC between calls to RunIterations.
+  // Allows to interleave the runs on multiple problems on a single thread
+  // (see deadline_scheduler.h).
+  struct EstimationState {
+    EstimationState() : sampler(nullptr) {}
+    ~EstimationState() { ResetSampler(); }
+    EstimationState(const EstimationState&) = delete;
+    EstimationState& operator=(const EstimationState&) = delete;
+
+    // Constructs the sampler in sampler_storage, such that initializing a run
+    // does not allocate memory.
+    void EmplaceSampler(const unsigned int random_seed, const Solver& solver) {
+      ResetSampler();
+      sampler = new (&sampler_storage) Sampler(random_seed, solver);
+    }
+
+    void ResetSampler() {
+      if (sampler != nullptr) sampler->~Sampler();
+      sampler = nullptr;
+    }
+
+    // False if there are not enough data points to run LO-MSAC.
+    bool valid;
+    // Points to sampler_storage once the sampler is constructed, and is
+    // nullptr otherwise.
+    Sampler* sampler;
+    typename std::aligned_storage<sizeof(Sampler), alignof(Sampler)>::type
+        sampler_storage;
+    std::mt19937 rng;
+    uint32_t max_num_iterations;
+    Model best_minimal_model;
+    double best_min_model_score;
+    std::vector<int> minimal_sample;
+    ModelVector estimated_models;
+    // Scratch memory for solvers that accept a SolverContext (see
+    // scratch_arena.h).
+    ScratchArena scratch_arena;
+  };
+
   // Estimates a model using a given solver. Notice that the solver contains
   // all data and is responsible to implement a non-minimal solver and
   // least-squares refinement. The latter two are optional, i.e., a dummy
@@ -127,73 +194,102 @@ class LocallyOptimizedMSAC : public RansacBase {
   // Returns the number of inliers.
   int EstimateModel(const LORansacOptions& options, const Solver& solver,
                     Model* best_model, RansacStatistics* statistics) const {
+    EstimationState state;
+    Initialize(options, solver, &state, statistics);
+    RunIterations(options, solver, std::numeric_limits<uint32_t>::max(),
+                  &state, best_model, statistics);
+    return Finalize(options, solver, &state, best_model, statistics);
+  }
+
+  // Splits EstimateModel into three steps, such that the random sampling can
+  // be interrupted after any iteration: Initialize prepares the state,
+  // RunIterations runs at most num_iterations further iterations of the
+  // random sampling, and Finalize runs the final local optimization and
+  // least squares refinement. Finalize can be called before the sampling
+  // terminated, in which case it returns the best model found so far.
+  // Calling the three functions without interrupting the sampling produces
+  // the same result as EstimateModel.
+  void Initialize(const LORansacOptions& options, const Solver& solver,
+                  EstimationState* state, RansacStatistics* statistics) const {
     ResetStatistics(statistics);
-    RansacStatistics& stats = *statistics;
 
     // Sanity check: No need to run RANSAC if there are not enough data
     // points.
     const int kMinSampleSize = solver.min_sample_size();
     const int kNumData = solver.num_data();
-    if (kMinSampleSize > kNumData || kMinSampleSize <= 0) {
-      return 0;
-    }
+    state->valid = kMinSampleSize <= kNumData && kMinSampleSize > 0;
+    state->max_num_iterations = 0u;
+    if (!state->valid) return;
 
     // Initializes variables, etc.
-    Sampler sampler(options.random_seed_, solver);
-    std::mt19937 rng;
-    rng.seed(options.random_seed_);
+    state->EmplaceSampler(options.random_seed_, solver);
+    if (LocalOptimizer::kEnabled) state->rng.seed(options.random_seed_);
 
-    uint32_t max_num_iterations =
+    state->max_num_iterations =
         std::max(options.max_num_iterations_, options.min_num_iterations_);
 
-    const double kSqrInlierThresh = options.squared_inlier_threshold_;
+    state->best_min_model_score = std::numeric_limits<double>::max();
+    state->minimal_sample.resize(kMinSampleSize);
+    state->estimated_models.clear();
+  }
 
-    Model best_minimal_model;
-    double best_min_model_score = std::numeric_limits<double>::max();
+  // Returns true if the random sampling terminated, i.e., if the number of
+  // iterations required for the desired success probability was reached.
+  bool RunIterations(const LORansacOptions& options, const Solver& solver,
+                     const uint32_t num_iterations, EstimationState* state,
+                     Model* best_model, RansacStatistics* statistics) const {
+    RansacStatistics& stats = *statistics;
+    if (!state->valid) return true;
 
-    std::vector<int> minimal_sample(kMinSampleSize);
-    ModelVector estimated_models;
+    const double kSqrInlierThresh = options.squared_inlier_threshold_;
+    SolverContext context = {&state->scratch_arena};
+
+    uint32_t& max_num_iterations = state->max_num_iterations;
+    Model& best_minimal_model = state->best_minimal_model;
+    double& best_min_model_score = state->best_min_model_score;
+    std::vector<int>& minimal_sample = state->minimal_sample;
+    ModelVector& estimated_models = state->estimated_models;
 
     // Runs random sampling.
-    for (stats.num_iterations = 0u; stats.num_iterations < max_num_iterations;
-         ++stats.num_iterations) {
+    for (uint32_t i = 0u;
+         i < num_iterations && stats.num_iterations < max_num_iterations;
+         ++i, ++stats.num_iterations) {
+      Statistics::BeginIteration(stats.num_iterations);
+      state->scratch_arena.Reset();
+
       // As proposed by Lebeda et al., Local Optimization is not executed in
       // the first lo_starting_iterations_ iterations. We thus run LO on the
       // best model found so far once we reach this iteration.
-      if (stats.num_iterations == options.lo_starting_iterations_ &&
+      const bool kLOStart =
+          LocalOptimizer::kEnabled &&
+          stats.num_iterations == options.lo_starting_iterations_;
+      if (kLOStart &&
           best_min_model_score < std::numeric_limits<double>::max()) {
         ++stats.number_lo_iterations;
-        LocalOptimization(options, solver, &rng, best_model,
+        LocalOptimization(options, solver, &context, &state->rng, best_model,
                           &(stats.best_model_score));
 
         // Updates the number of RANSAC iterations.
-        stats.best_num_inliers = GetInliers(
-            solver, *best_model, kSqrInlierThresh, &(stats.inlier_indices));
-        stats.inlier_ratio = static_cast<double>(stats.best_num_inliers) /
-                             static_cast<double>(kNumData);
-        max_num_iterations = utils::NumRequiredIterations(
-            stats.inlier_ratio, 1.0 - options.success_probability_,
-            kMinSampleSize, options.min_num_iterations_,
-            options.max_num_iterations_);
+        UpdateTermination(options, solver, *best_model, &stats,
+                          &max_num_iterations);
       }
 
-      sampler.Sample(&minimal_sample);
+      state->sampler->Sample(&minimal_sample);
 
       // MinimalSolver returns the number of estimated models.
-      const int kNumEstimatedModels =
-          solver.MinimalSolver(minimal_sample, &estimated_models);
+      const int kNumEstimatedModels = utils::CallMinimalSolver(
+          solver, minimal_sample, &estimated_models, &context);
       if (kNumEstimatedModels <= 0) continue;
 
       // Finds the best model among all estimated models.
       double best_local_score = std::numeric_limits<double>::max();
       int best_local_model_id = 0;
-      GetBestEstimatedModelId(solver, estimated_models, kNumEstimatedModels,
-                              kSqrInlierThresh, &best_local_score,
-                              &best_local_model_id);
+      GetBestEstimatedModelId(options, solver, estimated_models,
+                              kNumEstimatedModels, kSqrInlierThresh,
+                              &best_local_score, &best_local_model_id);
 
       // Updates the best model found so far.
-      if (best_local_score < best_min_model_score ||
-          stats.num_iterations == options.lo_starting_iterations_) {
+      if (best_local_score < best_min_model_score || kLOStart) {
         const bool kBestMinModel = best_local_score < best_min_model_score;
 
         if (kBestMinModel) {
@@ -208,7 +304,8 @@ class LocallyOptimizedMSAC : public RansacBase {
         }
 
         const bool kRunLO =
-            (stats.num_iterations >= options.lo_starting_iterations_ &&
+            (LocalOptimizer::kEnabled &&
+             stats.num_iterations >= options.lo_starting_iterations_ &&
              best_min_model_score < std::numeric_limits<double>::max());
 
         if ((!kBestMinModel) && (!kRunLO)) continue;
@@ -220,7 +317,8 @@ class LocallyOptimizedMSAC : public RansacBase {
         if (kRunLO) {
           ++stats.number_lo_iterations;
           double score = best_min_model_score;
-          LocalOptimization(options, solver, &rng, &best_minimal_model, &score);
+          LocalOptimization(options, solver, &context, &state->rng,
+                            &best_minimal_model, &score);
 
           // Updates the best model.
           UpdateBestModel(score, best_minimal_model, &(stats.best_model_score),
@@ -228,46 +326,68 @@ class LocallyOptimizedMSAC : public RansacBase {
         }
 
         // Updates the number of RANSAC iterations.
-        stats.best_num_inliers = GetInliers(
-            solver, *best_model, kSqrInlierThresh, &(stats.inlier_indices));
-        stats.inlier_ratio = static_cast<double>(stats.best_num_inliers) /
-                             static_cast<double>(kNumData);
-        max_num_iterations = utils::NumRequiredIterations(
-            stats.inlier_ratio, 1.0 - options.success_probability_,
-            kMinSampleSize, options.min_num_iterations_,
-            options.max_num_iterations_);
+        UpdateTermination(options, solver, *best_model, &stats,
+                          &max_num_iterations);
       }
     }
 
+    return stats.num_iterations >= max_num_iterations;
+  }
+
+  // Returns the number of inliers.
+  int Finalize(const LORansacOptions& options, const Solver& solver,
+               EstimationState* state, Model* best_model,
+               RansacStatistics* statistics) const {
+    RansacStatistics& stats = *statistics;
+    if (!state->valid) return 0;
+
+    const double kSqrInlierThresh = options.squared_inlier_threshold_;
+    state->scratch_arena.Reset();
+    SolverContext context = {&state->scratch_arena};
+
+    // If the terminator does not use the inlier ratio, the inliers of the
+    // best model have not been determined yet.
+    bool inliers_up_to_date = Terminator::kUsesInlierRatio;
+
     // As proposed by Lebeda et al., Local Optimization is not executed in
     // the first lo_starting_iterations_ iterations. If LO-MSAC needs less than
     // lo_starting_iterations_ iterations, we run LO now.
-    if (stats.num_iterations <= options.lo_starting_iterations_ &&
+    if (LocalOptimizer::kEnabled &&
+        stats.num_iterations <= options.lo_starting_iterations_ &&
         stats.best_model_score < std::numeric_limits<double>::max()) {
       ++stats.number_lo_iterations;
-      LocalOptimization(options, solver, &rng, best_model,
+      LocalOptimization(options, solver, &context, &state->rng, best_model,
                         &(stats.best_model_score));
 
-      stats.best_num_inliers = GetInliers(solver, *best_model, kSqrInlierThresh,
-                                          &(stats.inlier_indices));
-      stats.inlier_ratio = static_cast<double>(stats.best_num_inliers) /
-                           static_cast<double>(kNumData);
+      UpdateInlierStatistics(options, solver, *best_model, &stats);
+      inliers_up_to_date = true;
+    }
+    if (!inliers_up_to_date &&
+        stats.best_model_score < std::numeric_limits<double>::max()) {
+      UpdateInlierStatistics(options, solver, *best_model, &stats);
     }
 
     if (options.final_least_squares_) {
+      // The least squares fit needs the inlier indices, which are not stored
+      // by all statistics policies.
+      std::vector<int> counted_inliers;
+      const std::vector<int>* inliers = &stats.inlier_indices;
+      if (!Statistics::kStoreInlierIndices) {
+        GetInliers(solver, *best_model, kSqrInlierThresh, &counted_inliers);
+        inliers = &counted_inliers;
+      }
+
       Model refined_model = *best_model;
-      solver.LeastSquares(stats.inlier_indices, &refined_model);
+      state->scratch_arena.Reset();
+      utils::CallLeastSquares(solver, *inliers, &refined_model, &context);
 
       double score = std::numeric_limits<double>::max();
-      ScoreModel(solver, refined_model, kSqrInlierThresh, &score);
+      ScoreModel(options, solver, refined_model, kSqrInlierThresh, &score);
       if (score < stats.best_model_score) {
         stats.best_model_score = score;
         *best_model = refined_model;
 
-        stats.best_num_inliers = GetInliers(
-            solver, *best_model, kSqrInlierThresh, &(stats.inlier_indices));
-        stats.inlier_ratio = static_cast<double>(stats.best_num_inliers) /
-                             static_cast<double>(kNumData);
+        UpdateInlierStatistics(options, solver, *best_model, &stats);
       }
     }
 
@@ -275,15 +395,59 @@ class LocallyOptimizedMSAC : public RansacBase {
   }
 
  protected:
-  void GetBestEstimatedModelId(const Solver& solver, const ModelVector& models,
+  // Determines the inliers of the best model and the inlier ratio. The
+  // indices of the inliers are only stored if required by the statistics
+  // policy.
+  void UpdateInlierStatistics(const LORansacOptions& options,
+                              const Solver& solver, const Model& model,
+                              RansacStatistics* stats) const {
+    stats->best_num_inliers =
+        GetInliers(solver, model, options.squared_inlier_threshold_,
+                   Statistics::kStoreInlierIndices ? &(stats->inlier_indices)
+                                                   : nullptr);
+    stats->inlier_ratio = static_cast<double>(stats->best_num_inliers) /
+                          static_cast<double>(solver.num_data());
+  }
+
+  // Updates the inlier statistics and the maximum number of iterations after
+  // the best model changed. Does nothing if the terminator does not depend on
+  // the inlier ratio, in which case the statistics are computed in Finalize.
+  void UpdateTermination(const LORansacOptions& options, const Solver& solver,
+                         const Model& best_model, RansacStatistics* stats,
+                         uint32_t* max_num_iterations) const {
+    if (!Terminator::kUsesInlierRatio) return;
+    UpdateInlierStatistics(options, solver, best_model, stats);
+    *max_num_iterations = Terminator::MaxNumIterations(
+        options, stats->inlier_ratio, solver.min_sample_size());
+  }
+
+  void GetBestEstimatedModelId(const LORansacOptions& options,
+                               const Solver& solver, const ModelVector& models,
                                const int num_models,
                                const double squared_inlier_threshold,
                                double* best_score, int* best_model_id) const {
     *best_score = std::numeric_limits<double>::max();
     *best_model_id = 0;
+    if (options.executor_ != nullptr && num_models > 1) {
+      std::vector<double> scores(num_models,
+                                 std::numeric_limits<double>::max());
+      options.executor_->BulkFor(num_models, [&](int m) {
+        if (!Verifier::Accept(solver, models[m])) return;
+        ScoreModel(options, solver, models[m], squared_inlier_threshold,
+                   &scores[m]);
+      });
+      for (int m = 0; m < num_models; ++m) {
+        if (scores[m] < *best_score) {
+          *best_score = scores[m];
+          *best_model_id = m;
+        }
+      }
+      return;
+    }
     for (int m = 0; m < num_models; ++m) {
+      if (!Verifier::Accept(solver, models[m])) continue;
       double score = std::numeric_limits<double>::max();
-      ScoreModel(solver, models[m], squared_inlier_threshold, &score);
+      ScoreModel(options, solver, models[m], squared_inlier_threshold, &score);
 
       if (score < *best_score) {
         *best_score = score;
@@ -292,26 +456,125 @@ class LocallyOptimizedMSAC : public RansacBase {
     }
   }
 
+  // Scores the model in parallel via options.executor_ if it is set and if
+  // there are enough data points (see LORansacOptions).
+  void ScoreModel(const LORansacOptions& options, const Solver& solver,
+                  const Model& model, const double squared_inlier_threshold,
+                  double* score) const {
+    const int kNumData = solver.num_data();
+    const int kMinNumDataPerTask = std::max(1, options.min_num_data_per_task_);
+    if (options.executor_ == nullptr ||
+        utils::HasEvaluateModelOnPoints<Solver, Model>::value ||
+        kNumData / 2 < kMinNumDataPerTask) {
+      ScoreModel(solver, model, squared_inlier_threshold, score);
+      return;
+    }
+
+    const int kNumChunks = kNumData / kMinNumDataPerTask;
+    std::vector<double> chunk_scores(kNumChunks, 0.0);
+    options.executor_->BulkFor(kNumChunks, [&](int c) {
+      const int kBegin = static_cast<int>(static_cast<int64_t>(kNumData) * c /
+                                          kNumChunks);
+      const int kEnd = static_cast<int>(static_cast<int64_t>(kNumData) *
+                                        (c + 1) / kNumChunks);
+      chunk_scores[c] = ScoreDataRange(solver, model, kBegin, kEnd,
+                                       squared_inlier_threshold);
+    });
+    *score = 0.0;
+    for (const double kChunkScore : chunk_scores) *score += kChunkScore;
+  }
+
+  // The squared errors are scored in blocks of kScoreBlockSize via
+  // Scorer::ScoreErrors (see scoring.h), independently of whether the solver
+  // evaluates the model on all data points at once or point by point. Both
+  // thus result in the same score.
   void ScoreModel(const Solver& solver, const Model& model,
                   const double squared_inlier_threshold, double* score) const {
     const int kNumData = solver.num_data();
-    *score = 0.0;
-    for (int i = 0; i < kNumData; ++i) {
-      double squared_error = solver.EvaluateModelOnPoint(model, i);
-      *score += ComputeScore(squared_error, squared_inlier_threshold);
+    const double* kErrors = ComputeSquaredErrors(
+        solver, model, utils::HasEvaluateModelOnPoints<Solver, Model>());
+    if (kErrors != nullptr) {
+      *score = 0.0;
+      for (int i = 0; i < kNumData; i += kScoreBlockSize) {
+        AddScores(kErrors + i, std::min(kScoreBlockSize, kNumData - i),
+                  squared_inlier_threshold,
+                  scoring::SumsSequentially<Scorer>(), score);
+      }
+      return;
+    }
+    *score = ScoreDataRange(solver, model, 0, kNumData,
+                            squared_inlier_threshold);
+  }
+
+  // Scores the data points in [begin, end), evaluating the model point by
+  // point. The squared errors are buffered on the stack.
+  double ScoreDataRange(const Solver& solver, const Model& model,
+                        const int begin, const int end,
+                        const double squared_inlier_threshold) const {
+    double squared_errors[kScoreBlockSize];
+    double score = 0.0;
+    for (int i = begin; i < end; i += kScoreBlockSize) {
+      const int kNumErrors = std::min(kScoreBlockSize, end - i);
+      for (int j = 0; j < kNumErrors; ++j) {
+        squared_errors[j] = solver.EvaluateModelOnPoint(model, i + j);
+      }
+      AddScores(squared_errors, kNumErrors, squared_inlier_threshold,
+                scoring::SumsSequentially<Scorer>(), &score);
+    }
+    return score;
+  }
+
+  // Adds the score of a block of squared errors to *score. Scorers that sum
+  // sequentially add the score of every data point to the running sum.
+  static void AddScores(const double* squared_errors, const int num_errors,
+                        const double squared_inlier_threshold, std::true_type,
+                        double* score) {
+    for (int i = 0; i < num_errors; ++i) {
+      *score += Scorer::Score(squared_errors[i], squared_inlier_threshold);
     }
   }
 
-  // MSAC (top-hat) scoring function.
-  inline double ComputeScore(const double squared_error,
-                             const double squared_error_threshold) const {
-    return std::min(squared_error, squared_error_threshold);
+  static void AddScores(const double* squared_errors, const int num_errors,
+                        const double squared_inlier_threshold,
+                        std::false_type, double* score) {
+    *score += Scorer::ScoreErrors(squared_errors, num_errors,
+                                  squared_inlier_threshold);
+  }
+
+  // Evaluates the model on all data points at once if the solver supports it
+  // (see utils::HasEvaluateModelOnPoints). Returns a pointer to a per-thread
+  // buffer holding the squared errors, or nullptr if the model needs to be
+  // evaluated point by point.
+  const double* ComputeSquaredErrors(const Solver& solver, const Model& model,
+                                     std::true_type) const {
+    double* errors = utils::SquaredErrorBuffer(solver.num_data());
+    solver.EvaluateModelOnPoints(model, errors);
+    return errors;
+  }
+
+  const double* ComputeSquaredErrors(const Solver& /*solver*/,
+                                     const Model& /*model*/,
+                                     std::false_type) const {
+    return nullptr;
   }
 
   int GetInliers(const Solver& solver, const Model& model,
                  const double squared_inlier_threshold,
                  std::vector<int>* inliers) const {
     const int kNumData = solver.num_data();
+    const double* kErrors = ComputeSquaredErrors(
+        solver, model, utils::HasEvaluateModelOnPoints<Solver, Model>());
+    if (kErrors != nullptr) {
+      if (inliers != nullptr) inliers->clear();
+      int num_inliers = 0;
+      for (int i = 0; i < kNumData; ++i) {
+        if (kErrors[i] < squared_inlier_threshold) {
+          ++num_inliers;
+          if (inliers != nullptr) inliers->push_back(i);
+        }
+      }
+      return num_inliers;
+    }
     if (inliers == nullptr) {
       int num_inliers = 0;
       for (int i = 0; i < kNumData; ++i) {
@@ -335,12 +598,27 @@ class LocallyOptimizedMSAC : public RansacBase {
     }
   }
 
-  // See algorithms 2 and 3 in Lebeda et al.
   // The input model is overwritten with the refined model if the latter is
-  // better, i.e., has a lower score.
+  // better, i.e., has a lower score. The scratch arena of the context is
+  // reset before every LO step. Dispatches to the local optimization of
+  // Lebeda et al. or to IRLS, depending on the local optimizer policy.
   void LocalOptimization(const LORansacOptions& options, const Solver& solver,
-                         std::mt19937* rng, Model* best_minimal_model,
+                         SolverContext* context, std::mt19937* rng,
+                         Model* best_minimal_model,
                          double* score_best_minimal_model) const {
+    LocalOptimization(
+        options, solver, context, rng, best_minimal_model,
+        score_best_minimal_model,
+        std::integral_constant<bool,
+                               LocalOptimizer::kIterativelyReweighted>());
+  }
+
+  // See algorithms 2 and 3 in Lebeda et al.
+  void LocalOptimization(const LORansacOptions& options, const Solver& solver,
+                         SolverContext* context, std::mt19937* rng,
+                         Model* best_minimal_model,
+                         double* score_best_minimal_model,
+                         std::false_type) const {
     const int kNumData = solver.num_data();
     // kMinNonMinSampleSize stores how many data points are required for a
     // non-minimal sample. For example, consider the case of pose estimation
@@ -358,10 +636,12 @@ class LocallyOptimizedMSAC : public RansacBase {
     // minimal solver so far and then determines the inliers to that model
     // under a (slightly) relaxed inlier threshold.
     Model m_init = *best_minimal_model;
-    LeastSquaresFit(options, kSqInThresh * kThreshMult, solver, rng, &m_init);
+    context->arena->Reset();
+    LeastSquaresFit(options, kSqInThresh * kThreshMult, solver, context, rng,
+                    &m_init);
 
     double score = std::numeric_limits<double>::max();
-    ScoreModel(solver, m_init, kSqInThresh, &score);
+    ScoreModel(options, solver, m_init, kSqInThresh, &score);
     UpdateBestModel(score, m_init, score_best_minimal_model,
                     best_minimal_model);
 
@@ -377,18 +657,21 @@ class LocallyOptimizedMSAC : public RansacBase {
     // Performs the actual local optimization (LO).
     std::vector<int> sample;
     for (int r = 0; r < options.num_lo_steps_; ++r) {
+      context->arena->Reset();
       sample = inliers_base;
       utils::RandomShuffleAndResize(kNonMinSampleSize, rng, &sample);
 
       Model m_non_min;
-      if (!solver.NonMinimalSolver(sample, &m_non_min)) continue;
+      if (!utils::CallNonMinimalSolver(solver, sample, &m_non_min, context)) {
+        continue;
+      }
 
-      ScoreModel(solver, m_non_min, kSqInThresh, &score);
+      ScoreModel(options, solver, m_non_min, kSqInThresh, &score);
       UpdateBestModel(score, m_non_min, score_best_minimal_model,
                       best_minimal_model);
 
       // Iterative least squares refinement.
-      LeastSquaresFit(options, kSqInThresh, solver, rng, &m_non_min);
+      LeastSquaresFit(options, kSqInThresh, solver, context, rng, &m_non_min);
 
       // The current threshold multiplier and its update.
       double thresh = kThreshMult * kSqInThresh;
@@ -396,9 +679,9 @@ class LocallyOptimizedMSAC : public RansacBase {
           (kThreshMult - 1.0) * kSqInThresh /
           static_cast<int>(options.num_lsq_iterations_ - 1);
       for (int i = 0; i < options.num_lsq_iterations_; ++i) {
-        LeastSquaresFit(options, thresh, solver, rng, &m_non_min);
+        LeastSquaresFit(options, thresh, solver, context, rng, &m_non_min);
 
-        ScoreModel(solver, m_non_min, kSqInThresh, &score);
+        ScoreModel(options, solver, m_non_min, kSqInThresh, &score);
         UpdateBestModel(score, m_non_min, score_best_minimal_model,
                         best_minimal_model);
         thresh -= thresh_mult_update;
@@ -406,9 +689,63 @@ class LocallyOptimizedMSAC : public RansacBase {
     }
   }
 
+  // Iteratively reweighted least squares, see IRLSLocalOptimization in
+  // policies.h.
+  void LocalOptimization(const LORansacOptions& options, const Solver& solver,
+                         SolverContext* context, std::mt19937* /*rng*/,
+                         Model* best_minimal_model,
+                         double* score_best_minimal_model,
+                         std::true_type) const {
+    const int kMinNonMinSampleSize = solver.non_minimal_sample_size();
+    if (kMinNonMinSampleSize > solver.num_data()) return;
+
+    const double kSqInThresh = options.squared_inlier_threshold_;
+    Model model = *best_minimal_model;
+    std::vector<int> sample;
+    std::vector<double> weights;
+    for (int i = 0; i < options.num_lsq_iterations_; ++i) {
+      context->arena->Reset();
+      GetWeights(solver, model, kSqInThresh, &sample, &weights);
+      if (static_cast<int>(sample.size()) < kMinNonMinSampleSize) return;
+
+      utils::CallWeightedLeastSquares(solver, sample, weights, &model,
+                                      context);
+
+      double score = std::numeric_limits<double>::max();
+      ScoreModel(options, solver, model, kSqInThresh, &score);
+      if (!(score < *score_best_minimal_model)) return;
+      *score_best_minimal_model = score;
+      *best_minimal_model = model;
+    }
+  }
+
+  // Stores the indices and Scorer::Weight of all data points with a positive
+  // weight.
+  void GetWeights(const Solver& solver, const Model& model,
+                  const double squared_inlier_threshold,
+                  std::vector<int>* sample,
+                  std::vector<double>* weights) const {
+    const int kNumData = solver.num_data();
+    sample->clear();
+    weights->clear();
+    const double* kErrors = ComputeSquaredErrors(
+        solver, model, utils::HasEvaluateModelOnPoints<Solver, Model>());
+    for (int i = 0; i < kNumData; ++i) {
+      const double kSquaredError = kErrors != nullptr
+                                       ? kErrors[i]
+                                       : solver.EvaluateModelOnPoint(model, i);
+      const double kWeight =
+          Scorer::Weight(kSquaredError, squared_inlier_threshold);
+      if (kWeight > 0.0) {
+        sample->push_back(i);
+        weights->push_back(kWeight);
+      }
+    }
+  }
+
   void LeastSquaresFit(const LORansacOptions& options, const double thresh,
-                       const Solver& solver, std::mt19937* rng,
-                       Model* model) const {
+                       const Solver& solver, SolverContext* context,
+                       std::mt19937* rng, Model* model) const {
     const int kLSqSampleSize =
         options.min_sample_multiplicator_ * solver.min_sample_size();
     std::vector<int> inliers;
@@ -416,7 +753,7 @@ class LocallyOptimizedMSAC : public RansacBase {
     if (num_inliers < solver.min_sample_size()) return;
     int lsq_data_size = std::min(kLSqSampleSize, num_inliers);
     utils::RandomShuffleAndResize(lsq_data_size, rng, &inliers);
-    solver.LeastSquares(inliers, model);
+    utils::CallLeastSquares(solver, inliers, model, context);
   }
 
   inline void UpdateBestModel(const double score_curr, const Model& m_curr,
@@ -0,0 +1,666 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#ifndef RANSACLIB_RANSACLIB_SCORING_H_
+#define RANSACLIB_RANSACLIB_SCORING_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace ransac_lib {
+
+// Scoring functions used by LocallyOptimizedMSAC (see the Scorer policy in
+// policies.h). Lower scores are better. A scorer provides
+//   static double Score(double squared_error, double squared_threshold);
+// which returns the contribution of a single data point, and
+//   static double ScoreErrors(const double* squared_errors, int num_errors,
+//                             double squared_threshold);
+// which returns the score of a block of squared errors. The engine only calls
+// ScoreErrors, on blocks of at most kScoreBlockSize errors. Score is used by
+// code that scores single points, e.g., the hybrid RANSAC variant.
+// Scorers that can be used with IRLSLocalOptimization (see policies.h) also
+// provide
+//   static double Weight(double squared_error, double squared_threshold);
+// which returns the weight of a data point in a weighted least squares fit.
+//
+// The block kernels are written such that they can be vectorized: Sums are
+// accumulated in kScoreLanes independent partial sums that are combined in a
+// fixed order at the end of the block. The scores computed by ScoreErrors
+// thus can differ from the sum over Score in the last bits.
+// A scorer that declares
+//   static const bool kSequentialSum = true;
+// is not scored in blocks. Instead, the engine adds Score of every data point
+// to the score one by one, in the order of the data (see SumsSequentially).
+
+// The maximum number of squared errors passed to ScoreErrors by the engine.
+// Also the number of errors that are buffered when a model is evaluated
+// point by point.
+static const int kScoreBlockSize = 256;
+
+namespace scoring {
+
+static const int kScoreLanes = 8;
+
+// Adds point_score(squared_errors[i]) for i in [begin, num_errors) to
+// lanes[(i - begin) % kScoreLanes].
+template <class PointScore>
+inline void AccumulateLanes(const double* squared_errors, const int begin,
+                            const int num_errors,
+                            const PointScore& point_score, double* lanes) {
+  int i = begin;
+  for (; i + kScoreLanes <= num_errors; i += kScoreLanes) {
+    for (int j = 0; j < kScoreLanes; ++j) {
+      lanes[j] += point_score(squared_errors[i + j]);
+    }
+  }
+  for (int j = 0; j < kScoreLanes && i + j < num_errors; ++j) {
+    lanes[j] += point_score(squared_errors[i + j]);
+  }
+}
+
+inline double CombineLanes(const double* lanes) {
+  return ((lanes[0] + lanes[4]) + (lanes[2] + lanes[6])) +
+         ((lanes[1] + lanes[5]) + (lanes[3] + lanes[7]));
+}
+
+// Sums point_score(squared_errors[i]) over a block, accumulating in
+// kScoreLanes partial sums.
+template <class PointScore>
+inline double SumOverLanes(const double* squared_errors, const int num_errors,
+                           const PointScore& point_score) {
+  double lanes[kScoreLanes] = {0.0};
+  AccumulateLanes(squared_errors, 0, num_errors, point_score, lanes);
+  return CombineLanes(lanes);
+}
+
+// Counts the squared errors below squared_threshold. NaNs are not counted.
+// On x86, the comparisons produce bit masks that are accumulated as integers:
+// With AVX-512, the population counts of the comparison masks are summed.
+// Otherwise, the all-ones lanes of the comparison results are subtracted from
+// 64-bit integer counters, which avoids population counts on CPUs without a
+// POPCNT instruction.
+inline int CountBelow(const double* squared_errors, const int num_errors,
+                      const double squared_threshold) {
+  int count = 0;
+  int i = 0;
+#if defined(__AVX512F__) && defined(__POPCNT__)
+  const __m512d kThresh = _mm512_set1_pd(squared_threshold);
+  for (; i + 8 <= num_errors; i += 8) {
+    const __mmask8 kMask = _mm512_cmp_pd_mask(
+        _mm512_loadu_pd(squared_errors + i), kThresh, _CMP_LT_OQ);
+    count += _mm_popcnt_u32(kMask);
+  }
+#elif defined(__AVX2__)
+  const __m256d kThresh = _mm256_set1_pd(squared_threshold);
+  __m256i counts = _mm256_setzero_si256();
+  for (; i + 4 <= num_errors; i += 4) {
+    const __m256d kMask = _mm256_cmp_pd(_mm256_loadu_pd(squared_errors + i),
+                                        kThresh, _CMP_LT_OQ);
+    counts = _mm256_sub_epi64(counts, _mm256_castpd_si256(kMask));
+  }
+  int64_t lanes[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), counts);
+  count += static_cast<int>((lanes[0] + lanes[1]) + (lanes[2] + lanes[3]));
+#elif defined(__SSE2__) || defined(_M_X64)
+  const __m128d kThresh = _mm_set1_pd(squared_threshold);
+  __m128i counts = _mm_setzero_si128();
+  for (; i + 2 <= num_errors; i += 2) {
+    const __m128d kMask =
+        _mm_cmplt_pd(_mm_loadu_pd(squared_errors + i), kThresh);
+    counts = _mm_sub_epi64(counts, _mm_castpd_si128(kMask));
+  }
+  int64_t lanes[2];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), counts);
+  count += static_cast<int>(lanes[0] + lanes[1]);
+#endif
+  for (; i < num_errors; ++i) {
+    count += squared_errors[i] < squared_threshold ? 1 : 0;
+  }
+  return count;
+}
+
+// Computes exp(x) for x <= 0 from a polynomial approximation, such that the
+// computation can be vectorized. The relative error is below 1e-15 for
+// x >= -708. Smaller values are clamped to -708.
+inline double ExpNonPositive(double x) {
+  // Also maps NaNs to -708.
+  x = x >= -708.0 ? x : -708.0;
+  // x = k * ln(2) + f with an integer k and |f| <= ln(2) / 2.
+#if defined(__FAST_MATH__)
+  // The rounding below would be optimized away. -ffast-math implies
+  // -fno-trapping-math, which allows vectorizing the conversion to int.
+  // Truncating x / ln(2) - 0.5 rounds to the nearest integer as x <= 0.
+  const double kK =
+      static_cast<double>(static_cast<int>(x * 1.4426950408889634 - 0.5));
+  const uint64_t kBits =
+      static_cast<uint64_t>(static_cast<int64_t>(kK) + 1023) << 52;
+#else
+  // Adding 1.5 * 2^52 rounds x / ln(2) to the nearest integer k, which is
+  // stored in the lower bits of the mantissa. In contrast to a conversion to
+  // int, this does not prevent vectorization under -ftrapping-math.
+  const double kRound = 6755399441055744.0;
+  const double kShifted = x * 1.4426950408889634 + kRound;
+  const double kK = kShifted - kRound;
+  uint64_t shifted_bits;
+  std::memcpy(&shifted_bits, &kShifted, sizeof(double));
+  const uint64_t kBits = (shifted_bits + (1023 - 0x4338000000000000ull))
+                         << 52;
+#endif
+  const double f = (x - kK * 6.93147180369123816490e-01) -
+                   kK * 1.90821492927058770002e-10;
+  // Taylor expansion of exp(f) up to degree 13.
+  double p = 1.0 / 6227020800.0;
+  p = p * f + 1.0 / 479001600.0;
+  p = p * f + 1.0 / 39916800.0;
+  p = p * f + 1.0 / 3628800.0;
+  p = p * f + 1.0 / 362880.0;
+  p = p * f + 1.0 / 40320.0;
+  p = p * f + 1.0 / 5040.0;
+  p = p * f + 1.0 / 720.0;
+  p = p * f + 1.0 / 120.0;
+  p = p * f + 1.0 / 24.0;
+  p = p * f + 1.0 / 6.0;
+  p = p * f + 0.5;
+  p = p * f + 1.0;
+  p = p * f + 1.0;
+  // 2^k, constructed from its exponent bits. k >= -1022.
+  double scale;
+  std::memcpy(&scale, &kBits, sizeof(double));
+  return p * scale;
+}
+
+// The incomplete gamma functions gamma(a, x) (lower) and Gamma(a, x) (upper),
+// without regularization, for a > 0 and x >= 0. Computed via the series
+// expansion of gamma(a, x) for x < a + 1 and via the continued fraction of
+// Gamma(a, x) otherwise (see Numerical Recipes, Sec. 6.2). Only used to
+// build lookup tables.
+inline double LowerIncompleteGammaSeries(const double a, const double x) {
+  double term = 1.0 / a;
+  double sum = term;
+  for (int n = 1; n < 1000; ++n) {
+    term *= x / (a + n);
+    sum += term;
+    if (std::abs(term) < std::abs(sum) * 1e-17) break;
+  }
+  return sum * std::exp(-x + a * std::log(x));
+}
+
+inline double UpperIncompleteGammaFraction(const double a, const double x) {
+  const double kTiny = 1e-300;
+  double b = x + 1.0 - a;
+  double c = 1.0 / kTiny;
+  double d = 1.0 / b;
+  double h = d;
+  for (int n = 1; n < 1000; ++n) {
+    const double kA = -n * (n - a);
+    b += 2.0;
+    d = kA * d + b;
+    if (std::abs(d) < kTiny) d = kTiny;
+    c = b + kA / c;
+    if (std::abs(c) < kTiny) c = kTiny;
+    d = 1.0 / d;
+    const double kDelta = d * c;
+    h *= kDelta;
+    if (std::abs(kDelta - 1.0) < 1e-17) break;
+  }
+  return std::exp(-x + a * std::log(x)) * h;
+}
+
+inline double LowerIncompleteGamma(const double a, const double x) {
+  if (x <= 0.0) return 0.0;
+  if (x < a + 1.0) return LowerIncompleteGammaSeries(a, x);
+  return std::tgamma(a) - UpperIncompleteGammaFraction(a, x);
+}
+
+inline double UpperIncompleteGamma(const double a, const double x) {
+  if (x <= 0.0) return std::tgamma(a);
+  if (x < a + 1.0) return std::tgamma(a) - LowerIncompleteGammaSeries(a, x);
+  return UpperIncompleteGammaFraction(a, x);
+}
+
+// Returns the quantile of the chi-square distribution with the given degrees
+// of freedom, i.e., the value q with P(dof / 2, q / 2) = probability, where P
+// is the regularized lower incomplete gamma function. Computed by bisection.
+inline double ChiSquareQuantile(const int degrees_of_freedom,
+                                const double probability) {
+  const double kA = 0.5 * degrees_of_freedom;
+  const double kTarget = probability * std::tgamma(kA);
+  double low = 0.0;
+  double high = 1.0;
+  while (LowerIncompleteGamma(kA, 0.5 * high) < kTarget) high *= 2.0;
+  for (int i = 0; i < 100; ++i) {
+    const double kMid = 0.5 * (low + high);
+    if (LowerIncompleteGamma(kA, 0.5 * kMid) < kTarget) {
+      low = kMid;
+    } else {
+      high = kMid;
+    }
+  }
+  return 0.5 * (low + high);
+}
+
+// The number of intervals of the lookup tables used by MAGSACPlusPlusScorer.
+static const int kMAGSACTableSize = 1024;
+
+// Lookup tables of the MAGSAC++ loss and weight functions (Barath et al.,
+// "MAGSAC++, a fast, reliable and accurate robust estimator", CVPR 2020) for
+// nu degrees of freedom, as functions of u = squared_error / squared_threshold
+// where the squared threshold is (k sigma_max)^2 and k^2 is the 0.99 quantile
+// of the chi-square distribution with nu degrees of freedom. With
+// x = u k^2 / 2, a = (nu + 1) / 2, and b = (nu - 1) / 2, the tables store
+//   loss(u) = (gamma(a, x) + x (Gamma(b, x) - Gamma(b, k^2 / 2)))
+//             / gamma(a, k^2 / 2),
+//   weight(u) = (Gamma(b, x) - Gamma(b, k^2 / 2))
+//               / (Gamma(b, 0) - Gamma(b, k^2 / 2)),
+// i.e., the loss of the paper up to a constant factor, normalized such that
+// it is 0 for u = 0 and 1 for u >= 1, and the weight of the paper normalized
+// to 1 for u = 0 and 0 for u >= 1. Both are sampled at u = i / kMAGSACTableSize
+// and stored as interleaved (value, slope) pairs, such that a lookup with
+// linear interpolation reads a single cache line.
+struct MAGSACTables {
+  explicit MAGSACTables(const int degrees_of_freedom) {
+    const double kA = 0.5 * (degrees_of_freedom + 1);
+    const double kB = 0.5 * (degrees_of_freedom - 1);
+    const double kXMax =
+        0.5 * ChiSquareQuantile(degrees_of_freedom, 0.99);
+    const double kUpperMax = UpperIncompleteGamma(kB, kXMax);
+    const double kLossNorm = LowerIncompleteGamma(kA, kXMax);
+    const double kWeightNorm = UpperIncompleteGamma(kB, 0.0) - kUpperMax;
+    for (int i = 0; i <= kMAGSACTableSize; ++i) {
+      const double kX = kXMax * i / kMAGSACTableSize;
+      const double kUpper =
+          i < kMAGSACTableSize ? UpperIncompleteGamma(kB, kX) : kUpperMax;
+      loss[2 * i] = i < kMAGSACTableSize
+                        ? (LowerIncompleteGamma(kA, kX) +
+                           kX * (kUpper - kUpperMax)) /
+                              kLossNorm
+                        : 1.0;
+      weight[2 * i] = (kUpper - kUpperMax) / kWeightNorm;
+    }
+    for (int i = 0; i < kMAGSACTableSize; ++i) {
+      loss[2 * i + 1] = loss[2 * i + 2] - loss[2 * i];
+      weight[2 * i + 1] = weight[2 * i + 2] - weight[2 * i];
+    }
+    loss[2 * kMAGSACTableSize + 1] = 0.0;
+    weight[2 * kMAGSACTableSize + 1] = 0.0;
+  }
+
+  alignas(64) double loss[2 * (kMAGSACTableSize + 1)];
+  alignas(64) double weight[2 * (kMAGSACTableSize + 1)];
+};
+
+// Evaluates a table of (value, slope) pairs (see MAGSACTables) at u by linear
+// interpolation. u is clamped to [0, 1], NaNs are mapped to 1. The lookup can
+// be vectorized with gather instructions.
+inline double InterpolateTable(const double* table, double u) {
+  u = u < 1.0 ? u : 1.0;
+  u = u > 0.0 ? u : 0.0;
+  const double x = u * kMAGSACTableSize;
+#if defined(__FAST_MATH__)
+  const int kIndex = static_cast<int>(x);
+  const double kOffset = x - kIndex;
+#else
+  // As in ExpNonPositive, the rounding is done by adding 1.5 * 2^52, which
+  // rounds x - 0.5 to the nearest integer, i.e., to floor(x) or, if x is an
+  // integer, possibly to x - 1. Both interpolate to the same value. The
+  // result is non-negative since ties are rounded to even.
+  const double kRound = 6755399441055744.0;
+  const double kShifted = (x - 0.5) + kRound;
+  const double kFloor = kShifted - kRound;
+  uint64_t shifted_bits;
+  std::memcpy(&shifted_bits, &kShifted, sizeof(double));
+  const uint64_t kIndex = shifted_bits - 0x4338000000000000ull;
+  const double kOffset = x - kFloor;
+#endif
+  return table[2 * kIndex] + kOffset * table[2 * kIndex + 1];
+}
+
+// Sums InterpolateTable(table, scale * squared_errors[i]) over a block. On
+// x86, pairs of errors are processed with SSE2, loading the (value, slope)
+// pair of each error with a single aligned load. The lanes are the same as
+// in AccumulateLanes.
+inline double SumInterpolated(const double* table,
+                              const double* squared_errors,
+                              const int num_errors, const double scale) {
+  double lanes[kScoreLanes] = {0.0};
+  int i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+  const __m128d kScale = _mm_set1_pd(scale);
+  const __m128d kOne = _mm_set1_pd(1.0);
+  const __m128d kZero = _mm_setzero_pd();
+  const __m128d kSize = _mm_set1_pd(static_cast<double>(kMAGSACTableSize));
+  __m128d sums[kScoreLanes / 2];
+  for (int k = 0; k < kScoreLanes / 2; ++k) sums[k] = _mm_setzero_pd();
+  for (; i + kScoreLanes <= num_errors; i += kScoreLanes) {
+    for (int k = 0; k < kScoreLanes / 2; ++k) {
+      // min returns its second operand for NaNs, i.e., maps them to 1.
+      const __m128d kU = _mm_max_pd(
+          _mm_min_pd(_mm_mul_pd(_mm_loadu_pd(squared_errors + i + 2 * k),
+                                kScale),
+                     kOne),
+          kZero);
+      const __m128d kX = _mm_mul_pd(kU, kSize);
+      // kX is in [0, kMAGSACTableSize], i.e., truncation rounds down.
+      const __m128i kIndex = _mm_cvttpd_epi32(kX);
+      const __m128d kOffset = _mm_sub_pd(kX, _mm_cvtepi32_pd(kIndex));
+      const __m128d kPair0 =
+          _mm_load_pd(table + 2 * _mm_cvtsi128_si32(kIndex));
+      const __m128d kPair1 = _mm_load_pd(
+          table + 2 * _mm_cvtsi128_si32(_mm_shuffle_epi32(kIndex, 1)));
+      sums[k] = _mm_add_pd(
+          sums[k], _mm_add_pd(_mm_unpacklo_pd(kPair0, kPair1),
+                              _mm_mul_pd(kOffset, _mm_unpackhi_pd(kPair0,
+                                                                  kPair1))));
+    }
+  }
+  for (int k = 0; k < kScoreLanes / 2; ++k) {
+    _mm_storeu_pd(lanes + 2 * k, sums[k]);
+  }
+#endif
+  AccumulateLanes(squared_errors, i, num_errors,
+                  [table, scale](const double e) {
+                    return InterpolateTable(table, e * scale);
+                  },
+                  lanes);
+  return CombineLanes(lanes);
+}
+
+namespace internal {
+template <class Scorer>
+auto TestSequentialSum(int)
+    -> std::integral_constant<bool, Scorer::kSequentialSum>;
+
+template <class Scorer>
+std::false_type TestSequentialSum(long);
+}  // namespace internal
+
+// True if Scorer declares kSequentialSum = true, false otherwise.
+template <class Scorer>
+struct SumsSequentially
+    : decltype(internal::TestSequentialSum<Scorer>(0)) {};
+
+}  // namespace scoring
+
+// Classic RANSAC: Counts the data points whose squared error is not below the
+// threshold, i.e., the score is the number of outliers. The errors are
+// compared and counted as integers, which makes this the cheapest scorer. It
+// does not distinguish between models with the same number of inliers.
+struct InlierCountScorer {
+  static inline double Score(const double squared_error,
+                             const double squared_threshold) {
+    return squared_error < squared_threshold ? 0.0 : 1.0;
+  }
+
+  static inline double ScoreErrors(const double* squared_errors,
+                                   const int num_errors,
+                                   const double squared_threshold) {
+    return static_cast<double>(
+        num_errors -
+        scoring::CountBelow(squared_errors, num_errors, squared_threshold));
+  }
+};
+
+// MSAC (top-hat) scoring: min(squared_error, squared_threshold).
+struct MSACScorer {
+  static inline double Score(const double squared_error,
+                             const double squared_threshold) {
+    return std::min(squared_error, squared_threshold);
+  }
+
+  static inline double ScoreErrors(const double* squared_errors,
+                                   const int num_errors,
+                                   const double squared_threshold) {
+    return scoring::SumOverLanes(
+        squared_errors, num_errors, [squared_threshold](const double e) {
+          return e < squared_threshold ? e : squared_threshold;
+        });
+  }
+};
+
+// MSAC scoring that adds the contributions of the data points one by one, in
+// the order of the data. The scores are bitwise identical to the ones
+// computed before scoring was split into blocks, e.g., to the scores stored
+// in replay files (see examples/ransac_replay.h). This is the scorer of the
+// default LOMSACPolicies. MSACScorer computes the same scores up to the last
+// bits and is faster, since its blocks can be vectorized.
+struct SequentialMSACScorer {
+  static const bool kSequentialSum = true;
+
+  static inline double Score(const double squared_error,
+                             const double squared_threshold) {
+    return std::min(squared_error, squared_threshold);
+  }
+
+  static inline double ScoreErrors(const double* squared_errors,
+                                   const int num_errors,
+                                   const double squared_threshold) {
+    double score = 0.0;
+    for (int i = 0; i < num_errors; ++i) {
+      score += Score(squared_errors[i], squared_threshold);
+    }
+    return score;
+  }
+};
+
+// MLESAC (Torr & Zisserman, CVIU 2000) with a fixed mixing parameter: The
+// negative log-likelihood of a mixture of Gaussian inlier noise and a uniform
+// outlier distribution. The inlier threshold is interpreted as three standard
+// deviations of the noise, and the outlier density is chosen such that it
+// equals the inlier density at the threshold. The score of a data point is
+//   -log((exp(-e / (2 sigma^2)) + c) / (1 + c)),  c = exp(-4.5),
+// where e is the squared error and sigma^2 = squared_threshold / 9, i.e., a
+// data point with zero error contributes 0 and the contribution of outliers
+// saturates at about 4.5.
+// Instead of estimating the mixing parameter via EM for every model as in the
+// original paper, which would require multiple passes over the data, both
+// components are weighted equally.
+struct MLESACScorer {
+  static inline double Score(const double squared_error,
+                             const double squared_threshold) {
+    const double kC = std::exp(-4.5);
+    return std::log1p(kC) -
+           std::log(std::exp(-4.5 * squared_error / squared_threshold) + kC);
+  }
+
+  // Each lane multiplies the likelihoods of kProductLength data points before
+  // taking the logarithm, which avoids one logarithm per data point. The
+  // likelihoods are at least c / (1 + c) > 0.01, i.e., the products do not
+  // underflow.
+  static inline double ScoreErrors(const double* squared_errors,
+                                   const int num_errors,
+                                   const double squared_threshold) {
+    static const int kProductLength = 32;
+    const double kC = std::exp(-4.5);
+    const double kNorm = 1.0 / (1.0 + kC);
+    const double kScale = -4.5 / squared_threshold;
+    double log_likelihoods[scoring::kScoreLanes] = {0.0};
+    for (int begin = 0; begin < num_errors;
+         begin += scoring::kScoreLanes * kProductLength) {
+      const int kEnd = std::min(
+          num_errors, begin + scoring::kScoreLanes * kProductLength);
+      double lanes[scoring::kScoreLanes] = {1.0, 1.0, 1.0, 1.0,
+                                            1.0, 1.0, 1.0, 1.0};
+      int i = begin;
+      for (; i + scoring::kScoreLanes <= kEnd; i += scoring::kScoreLanes) {
+        for (int j = 0; j < scoring::kScoreLanes; ++j) {
+          lanes[j] *=
+              (scoring::ExpNonPositive(kScale * squared_errors[i + j]) + kC) *
+              kNorm;
+        }
+      }
+      for (int j = 0; i < kEnd; ++i, ++j) {
+        lanes[j] *=
+            (scoring::ExpNonPositive(kScale * squared_errors[i]) + kC) * kNorm;
+      }
+      for (int j = 0; j < scoring::kScoreLanes; ++j) {
+        log_likelihoods[j] += std::log(lanes[j]);
+      }
+    }
+    return -(((log_likelihoods[0] + log_likelihoods[4]) +
+              (log_likelihoods[2] + log_likelihoods[6])) +
+             ((log_likelihoods[1] + log_likelihoods[5]) +
+              (log_likelihoods[3] + log_likelihoods[7])));
+  }
+};
+
+// Truncated Huber loss: Quadratic up to delta^2 = squared_threshold / 9, i.e.,
+// up to one standard deviation if the threshold corresponds to three, linear
+// in the error up to the threshold, and constant beyond it. In terms of the
+// residual r = sqrt(squared_error):
+//   r^2                                 if r <= delta,
+//   2 delta r - delta^2                 if delta < r < threshold,
+//   2 delta threshold - delta^2         otherwise.
+// Compared to MSAC, inliers with large errors are penalized less.
+struct HuberScorer {
+  static inline double Score(const double squared_error,
+                             const double squared_threshold) {
+    const double kSqDelta = squared_threshold / 9.0;
+    if (squared_error <= kSqDelta) return squared_error;
+    const double kDelta = std::sqrt(kSqDelta);
+    return 2.0 * kDelta *
+               std::sqrt(std::min(squared_error, squared_threshold)) -
+           kSqDelta;
+  }
+
+  static inline double ScoreErrors(const double* squared_errors,
+                                   const int num_errors,
+                                   const double squared_threshold) {
+    const double kSqDelta = squared_threshold / 9.0;
+    const double kTwoDelta = 2.0 * std::sqrt(kSqDelta);
+    auto point_score = [squared_threshold, kSqDelta,
+                        kTwoDelta](const double e) {
+      const double kLinear =
+          kTwoDelta * std::sqrt(e < squared_threshold ? e : squared_threshold) -
+          kSqDelta;
+      return e <= kSqDelta ? e : kLinear;
+    };
+    double lanes[scoring::kScoreLanes] = {0.0};
+    int i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+    // Unless compiling with -fno-math-errno, the compiler neither vectorizes
+    // std::sqrt nor removes the branches around it. The lanes are the same as
+    // in scoring::AccumulateLanes.
+    const __m128d kThresh = _mm_set1_pd(squared_threshold);
+    const __m128d kSqDeltaV = _mm_set1_pd(kSqDelta);
+    const __m128d kTwoDeltaV = _mm_set1_pd(kTwoDelta);
+    __m128d sums[scoring::kScoreLanes / 2];
+    for (int k = 0; k < scoring::kScoreLanes / 2; ++k) {
+      sums[k] = _mm_setzero_pd();
+    }
+    for (; i + scoring::kScoreLanes <= num_errors; i += scoring::kScoreLanes) {
+      for (int k = 0; k < scoring::kScoreLanes / 2; ++k) {
+        const __m128d kErrors = _mm_loadu_pd(squared_errors + i + 2 * k);
+        const __m128d kLinear = _mm_sub_pd(
+            _mm_mul_pd(kTwoDeltaV, _mm_sqrt_pd(_mm_min_pd(kErrors, kThresh))),
+            kSqDeltaV);
+        const __m128d kQuadratic = _mm_cmple_pd(kErrors, kSqDeltaV);
+        sums[k] = _mm_add_pd(
+            sums[k], _mm_or_pd(_mm_and_pd(kQuadratic, kErrors),
+                               _mm_andnot_pd(kQuadratic, kLinear)));
+      }
+    }
+    for (int k = 0; k < scoring::kScoreLanes / 2; ++k) {
+      _mm_storeu_pd(lanes + 2 * k, sums[k]);
+    }
+#endif
+    scoring::AccumulateLanes(squared_errors, i, num_errors, point_score,
+                             lanes);
+    return scoring::CombineLanes(lanes);
+  }
+
+  // The IRLS weight of the Huber loss: 1 up to delta, delta / r up to the
+  // threshold, and 0 beyond.
+  static inline double Weight(const double squared_error,
+                              const double squared_threshold) {
+    if (!(squared_error < squared_threshold)) return 0.0;
+    const double kSqDelta = squared_threshold / 9.0;
+    if (squared_error <= kSqDelta) return 1.0;
+    return std::sqrt(kSqDelta / squared_error);
+  }
+};
+
+// MAGSAC++ scoring (Barath et al., CVPR 2020): The loss obtained by
+// marginalizing the (Gaussian) noise level over [0, sigma_max], where the
+// squared inlier threshold is (k sigma_max)^2 (see scoring::MAGSACTables).
+// Compared to MSAC, the score depends less on the choice of the threshold,
+// which thus only needs to be an upper bound on the noise.
+// kDegreesOfFreedom is the dimension of the residual, e.g., 2 for
+// reprojection errors. The incomplete gamma functions in the loss are
+// precomputed in lookup tables, which are built once per kDegreesOfFreedom
+// on first use. Scoring a data point thus costs a table lookup with linear
+// interpolation. The loss is scaled by the squared threshold, i.e., as for
+// MSAC, an outlier contributes squared_threshold to the score.
+// Provides the IRLS weights of MAGSAC++ via Weight, see
+// IRLSLocalOptimization in policies.h.
+template <int kDegreesOfFreedom = 2>
+struct MAGSACPlusPlusScorer {
+  static_assert(kDegreesOfFreedom >= 2,
+                "The MAGSAC++ weights are unbounded for 1 degree of freedom");
+
+  static inline double Score(const double squared_error,
+                             const double squared_threshold) {
+    return squared_threshold *
+           scoring::InterpolateTable(Tables().loss,
+                                     squared_error * (1.0 / squared_threshold));
+  }
+
+  static inline double ScoreErrors(const double* squared_errors,
+                                   const int num_errors,
+                                   const double squared_threshold) {
+    return squared_threshold *
+           scoring::SumInterpolated(Tables().loss, squared_errors, num_errors,
+                                    1.0 / squared_threshold);
+  }
+
+  // The weight of a data point in the weighted least squares fits of
+  // sigma-consensus++, in [0, 1]. Data points whose squared error is not
+  // below the threshold have weight 0.
+  static inline double Weight(const double squared_error,
+                              const double squared_threshold) {
+    return scoring::InterpolateTable(Tables().weight,
+                                     squared_error * (1.0 / squared_threshold));
+  }
+
+  static const scoring::MAGSACTables& Tables() {
+    static const scoring::MAGSACTables kTables(kDegreesOfFreedom);
+    return kTables;
+  }
+};
+
+}  // namespace ransac_lib
+
+#endif  // RANSACLIB_RANSACLIB_SCORING_H_
@@ -0,0 +1,192 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#ifndef RANSACLIB_RANSACLIB_SCRATCH_ARENA_H_
+#define RANSACLIB_RANSACLIB_SCRATCH_ARENA_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ransac_lib {
+
+// A bump allocator for temporary memory. Allocations are served from large
+// blocks by advancing an offset and are never freed individually. Reset()
+// releases all allocations at once but keeps the blocks, such that a solver
+// that needs the same amount of scratch memory in every call does not
+// allocate from the heap once the arena has grown to that size.
+// A ScratchArena is not thread-safe. No constructors or destructors are run
+// for the allocated memory.
+class ScratchArena {
+ public:
+  explicit ScratchArena(const size_t block_bytes = 64u * 1024u)
+      : block_bytes_(std::max(block_bytes, static_cast<size_t>(1u))),
+        current_block_(0u),
+        offset_(0u),
+        num_bytes_used_(0u) {}
+
+  ScratchArena(const ScratchArena&) = delete;
+  ScratchArena& operator=(const ScratchArena&) = delete;
+  ScratchArena(ScratchArena&&) = default;
+  ScratchArena& operator=(ScratchArena&&) = default;
+
+  // Returns num_bytes of memory with the given alignment, which needs to be a
+  // power of two. The memory stays valid until the next call to Reset().
+  void* Allocate(const size_t num_bytes,
+                 const size_t alignment = alignof(std::max_align_t)) {
+    while (current_block_ < blocks_.size()) {
+      void* memory = AllocateFromBlock(num_bytes, alignment);
+      if (memory != nullptr) return memory;
+      ++current_block_;
+      offset_ = 0u;
+    }
+    blocks_.emplace_back(std::max(block_bytes_, num_bytes + alignment));
+    return AllocateFromBlock(num_bytes, alignment);
+  }
+
+  // Returns an uninitialized array of num_elements elements of type T.
+  template <class T>
+  T* Allocate(const size_t num_elements) {
+    return static_cast<T*>(Allocate(num_elements * sizeof(T), alignof(T)));
+  }
+
+  // Releases all allocations. If the allocations since the last reset did
+  // not fit into the first block, all blocks are replaced by a single block
+  // that is large enough to hold them, such that the arena eventually serves
+  // all allocations from a single block.
+  void Reset() {
+    if (blocks_.size() > 1u && current_block_ > 0u) {
+      size_t total_bytes = 0u;
+      for (const Block& block : blocks_) total_bytes += block.size;
+      blocks_.clear();
+      blocks_.emplace_back(total_bytes);
+    }
+    current_block_ = 0u;
+    offset_ = 0u;
+    num_bytes_used_ = 0u;
+  }
+
+  // The number of bytes handed out since the last reset, including padding.
+  size_t num_bytes_used() const { return num_bytes_used_; }
+
+  // The total size of all blocks.
+  size_t capacity() const {
+    size_t total_bytes = 0u;
+    for (const Block& block : blocks_) total_bytes += block.size;
+    return total_bytes;
+  }
+
+ protected:
+  struct Block {
+    explicit Block(const size_t num_bytes)
+        : data(new char[num_bytes]), size(num_bytes) {}
+    std::unique_ptr<char[]> data;
+    size_t size;
+  };
+
+  // Returns nullptr if the allocation does not fit into the current block.
+  void* AllocateFromBlock(const size_t num_bytes, const size_t alignment) {
+    Block& block = blocks_[current_block_];
+    const uintptr_t kBase = reinterpret_cast<uintptr_t>(block.data.get());
+    const uintptr_t kAligned =
+        (kBase + offset_ + alignment - 1u) & ~(uintptr_t(alignment) - 1u);
+    const size_t kEnd = static_cast<size_t>(kAligned - kBase) + num_bytes;
+    if (kEnd > block.size) return nullptr;
+    num_bytes_used_ += kEnd - offset_;
+    offset_ = kEnd;
+    return reinterpret_cast<void*>(kAligned);
+  }
+
+  size_t block_bytes_;
+  std::vector<Block> blocks_;
+  size_t current_block_;
+  size_t offset_;
+  size_t num_bytes_used_;
+};
+
+// A standard allocator that allocates from a ScratchArena, e.g., for
+// temporary std::vectors inside a solver. Deallocation is a no-op; the memory
+// is released by ScratchArena::Reset(). Containers using it must not outlive
+// the next reset of the arena.
+template <class T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+
+  explicit ArenaAllocator(ScratchArena* arena) : arena_(arena) {}
+
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+  T* allocate(const size_t n) { return arena_->Allocate<T>(n); }
+
+  void deallocate(T*, size_t) {}
+
+  ScratchArena* arena() const { return arena_; }
+
+ private:
+  ScratchArena* arena_;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
+// Per-thread state that RANSAC passes to solvers that accept it. A solver
+// opts in by providing
+//   int MinimalSolver(const std::vector<int>& sample, ModelVector* models,
+//                     SolverContext* context) const;
+//   int NonMinimalSolver(const std::vector<int>& sample, Model* model,
+//                        SolverContext* context) const;
+//   void LeastSquares(const std::vector<int>& sample, Model* model,
+//                     SolverContext* context) const;
+// in addition to or instead of the functions without the context (see
+// utils::CallMinimalSolver etc.). Each function can opt in individually.
+// The context is owned by the RANSAC run and is only used by the thread
+// executing it, such that solvers can use it without synchronization while
+// their functions remain const.
+struct SolverContext {
+  // Scratch memory for temporaries. RANSAC resets the arena at the start of
+  // every iteration and of every local optimization step, i.e., memory
+  // allocated by a solver call must not be used after the call returns.
+  ScratchArena* arena;
+};
+
+}  // namespace ransac_lib
+
+#endif  // RANSACLIB_RANSACLIB_SCRATCH_ARENA_H_
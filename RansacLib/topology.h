@@ -0,0 +1,267 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#ifndef RANSACLIB_RANSACLIB_TOPOLOGY_H_
+#define RANSACLIB_RANSACLIB_TOPOLOGY_H_
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace ransac_lib {
+
+namespace topology {
+
+struct LogicalCpu {
+  // The index of the CPU used by the operating system.
+  int cpu;
+  // Dense index of the physical core the CPU belongs to.
+  int core;
+  // The index of the CPU among the hardware threads (SMT siblings) of its
+  // core, i.e., 0 for the first hardware thread.
+  int smt_index;
+  int package;
+  // The NUMA node of the CPU.
+  int node;
+};
+
+struct CpuTopology {
+  // Sorted by the CPU index.
+  std::vector<LogicalCpu> cpus;
+  int num_cores;
+  int num_packages;
+  int num_nodes;
+};
+
+// Parses a CPU list in the sysfs format, e.g., "0-3,8,10-11".
+inline bool ParseCpuList(const std::string& list, std::vector<int>* cpus) {
+  cpus->clear();
+  std::stringstream s_stream(list);
+  std::string range;
+  while (std::getline(s_stream, range, ',')) {
+    range.erase(std::remove_if(range.begin(), range.end(),
+                               [](char c) { return c == ' ' || c == '\n'; }),
+                range.end());
+    if (range.empty()) continue;
+    const size_t kDash = range.find('-');
+    char* end = nullptr;
+    const long kFirst = std::strtol(range.c_str(), &end, 10);
+    if (end == range.c_str()) return false;
+    long last = kFirst;
+    if (kDash != std::string::npos) {
+      const char* kLastStr = range.c_str() + kDash + 1;
+      last = std::strtol(kLastStr, &end, 10);
+      if (end == kLastStr || last < kFirst) return false;
+    }
+    for (long c = kFirst; c <= last; ++c) cpus->push_back(static_cast<int>(c));
+  }
+  return !cpus->empty();
+}
+
+inline bool ReadSysfsLine(const std::string& path, std::string* line) {
+  std::ifstream ifs(path.c_str(), std::ios::in);
+  if (!ifs.is_open()) return false;
+  return static_cast<bool>(std::getline(ifs, *line));
+}
+
+inline bool ReadSysfsInt(const std::string& path, int* value) {
+  std::string line;
+  if (!ReadSysfsLine(path, &line)) return false;
+  char* end = nullptr;
+  const long kValue = std::strtol(line.c_str(), &end, 10);
+  if (end == line.c_str()) return false;
+  *value = static_cast<int>(kValue);
+  return true;
+}
+
+// Removes the CPUs the calling thread is not allowed to run on (Linux), e.g.,
+// because of taskset, cgroup cpusets, or container CPU limits. Leaves cpus
+// unchanged if the affinity mask cannot be read or if none of the CPUs is in
+// it, e.g., when a test passes CPUs of a different machine.
+inline void RestrictToAffinityMask(std::vector<int>* cpus) {
+#if defined(__linux__)
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+  std::vector<int> allowed_cpus;
+  for (const int kCpu : *cpus) {
+    if (kCpu >= 0 && kCpu < CPU_SETSIZE && CPU_ISSET(kCpu, &allowed)) {
+      allowed_cpus.push_back(kCpu);
+    }
+  }
+  if (!allowed_cpus.empty()) cpus->swap(allowed_cpus);
+#else
+  (void)cpus;
+#endif
+}
+
+// Discovers the online CPUs the process may run on (see
+// RestrictToAffinityMask), their physical cores, packages and NUMA nodes
+// from sysfs (Linux). Missing information is replaced by defaults, i.e., if
+// sysfs is not available, every CPU reported by the standard library is
+// assumed to be its own core on a single package and node. sysfs_root can
+// be changed for testing.
+inline CpuTopology DiscoverTopology(
+    const std::string& sysfs_root = "/sys/devices/system") {
+  CpuTopology topology;
+  std::vector<int> cpu_ids;
+  std::string line;
+  if (!ReadSysfsLine(sysfs_root + "/cpu/online", &line) ||
+      !ParseCpuList(line, &cpu_ids)) {
+    const int kNumCpus =
+        std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    cpu_ids.clear();
+    for (int c = 0; c < kNumCpus; ++c) cpu_ids.push_back(c);
+  }
+  RestrictToAffinityMask(&cpu_ids);
+
+  std::map<int, int> node_of_cpu;
+  std::vector<int> node_ids;
+  if (ReadSysfsLine(sysfs_root + "/node/possible", &line) &&
+      ParseCpuList(line, &node_ids)) {
+    for (const int kNode : node_ids) {
+      std::vector<int> node_cpus;
+      const std::string kPath =
+          sysfs_root + "/node/node" + std::to_string(kNode) + "/cpulist";
+      if (!ReadSysfsLine(kPath, &line) || !ParseCpuList(line, &node_cpus)) {
+        continue;
+      }
+      for (const int kCpu : node_cpus) node_of_cpu[kCpu] = kNode;
+    }
+  }
+
+  // Physical cores are identified by their package and core ID.
+  std::map<std::pair<int, int>, int> core_index;
+  std::map<int, int> package_index;
+  std::map<int, int> node_index;
+  std::map<int, int> num_threads_of_core;
+  for (const int kCpu : cpu_ids) {
+    const std::string kTopology =
+        sysfs_root + "/cpu/cpu" + std::to_string(kCpu) + "/topology/";
+    int package = 0;
+    int core_id = kCpu;
+    ReadSysfsInt(kTopology + "physical_package_id", &package);
+    ReadSysfsInt(kTopology + "core_id", &core_id);
+    const std::pair<int, int> kCoreKey(package, core_id);
+    if (core_index.find(kCoreKey) == core_index.end()) {
+      const int kIndex = static_cast<int>(core_index.size());
+      core_index[kCoreKey] = kIndex;
+    }
+    if (package_index.find(package) == package_index.end()) {
+      const int kIndex = static_cast<int>(package_index.size());
+      package_index[package] = kIndex;
+    }
+    int node = node_ids.empty() ? 0 : node_ids[0];
+    std::map<int, int>::const_iterator it = node_of_cpu.find(kCpu);
+    if (it != node_of_cpu.end()) node = it->second;
+    if (node_index.find(node) == node_index.end()) {
+      const int kIndex = static_cast<int>(node_index.size());
+      node_index[node] = kIndex;
+    }
+
+    LogicalCpu cpu;
+    cpu.cpu = kCpu;
+    cpu.core = core_index[kCoreKey];
+    // The CPUs are processed in increasing order, such that the first
+    // hardware thread of a core has the smallest CPU index.
+    cpu.smt_index = num_threads_of_core[cpu.core]++;
+    cpu.package = package_index[package];
+    cpu.node = node_index[node];
+    topology.cpus.push_back(cpu);
+  }
+  topology.num_cores = static_cast<int>(core_index.size());
+  topology.num_packages = static_cast<int>(package_index.size());
+  topology.num_nodes = static_cast<int>(node_index.size());
+  return topology;
+}
+
+// Returns the CPUs in the order in which workers should be placed on them:
+// Consecutive workers are distributed round-robin over the NUMA nodes, and
+// within a node, the first hardware thread of every core is used before any
+// SMT sibling. If use_smt is false, SMT siblings are not used at all.
+inline std::vector<LogicalCpu> PlacementOrder(const CpuTopology& topology,
+                                              const bool use_smt) {
+  std::vector<std::vector<LogicalCpu>> per_node(
+      std::max(1, topology.num_nodes));
+  for (const LogicalCpu& cpu : topology.cpus) {
+    if (!use_smt && cpu.smt_index > 0) continue;
+    per_node[cpu.node].push_back(cpu);
+  }
+  for (std::vector<LogicalCpu>& cpus : per_node) {
+    std::stable_sort(cpus.begin(), cpus.end(),
+                     [](const LogicalCpu& a, const LogicalCpu& b) {
+                       return a.smt_index < b.smt_index;
+                     });
+  }
+  std::vector<LogicalCpu> order;
+  for (size_t i = 0; order.size() < topology.cpus.size(); ++i) {
+    bool added = false;
+    for (const std::vector<LogicalCpu>& cpus : per_node) {
+      if (i < cpus.size()) {
+        order.push_back(cpus[i]);
+        added = true;
+      }
+    }
+    if (!added) break;
+  }
+  return order;
+}
+
+// Restricts the calling thread to the given CPU. Returns false if this is not
+// supported on the platform or failed.
+inline bool PinCurrentThread(const int cpu) {
+#if defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t),
+                                 &cpu_set) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+}  // namespace topology
+
+}  // namespace ransac_lib
+
+#endif  // RANSACLIB_RANSACLIB_TOPOLOGY_H_
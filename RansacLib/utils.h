@@ -37,6 +37,8 @@
 #include <cstdint>
 #include <limits>
 #include <random>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace ransac_lib {
@@ -161,6 +163,139 @@ inline uint32_t NumRequiredIterations(const std::vector<double> inlier_ratios,
   return num_req_iterations;
 }
 
+namespace internal {
+template <class Solver, class Model>
+auto TestEvaluateModelOnPoints(int)
+    -> decltype(std::declval<const Solver&>().EvaluateModelOnPoints(
+                    std::declval<const Model&>(), std::declval<double*>()),
+                std::true_type());
+
+template <class Solver, class Model>
+std::false_type TestEvaluateModelOnPoints(...);
+}  // namespace internal
+
+// Detects whether a solver provides a batched evaluation function
+//   void EvaluateModelOnPoints(const Model& model, double* squared_errors)
+//   const;
+// that stores the squared errors of the model on all num_data() data points.
+// Solvers without it are evaluated point by point via EvaluateModelOnPoint.
+template <class Solver, class Model>
+struct HasEvaluateModelOnPoints
+    : decltype(internal::TestEvaluateModelOnPoints<Solver, Model>(0)) {};
+
+namespace internal {
+// Overloads taking an int are preferred by overload resolution and are only
+// viable if the solver function accepts the context as its last parameter.
+template <class Solver, class ModelVector, class Context>
+auto MinimalSolverWithContext(const Solver& solver,
+                              const std::vector<int>& sample,
+                              ModelVector* models, Context* context, int)
+    -> decltype(solver.MinimalSolver(sample, models, context)) {
+  return solver.MinimalSolver(sample, models, context);
+}
+
+template <class Solver, class ModelVector, class Context>
+int MinimalSolverWithContext(const Solver& solver,
+                             const std::vector<int>& sample,
+                             ModelVector* models, Context*, long) {
+  return solver.MinimalSolver(sample, models);
+}
+
+template <class Solver, class Model, class Context>
+auto NonMinimalSolverWithContext(const Solver& solver,
+                                 const std::vector<int>& sample, Model* model,
+                                 Context* context, int)
+    -> decltype(solver.NonMinimalSolver(sample, model, context)) {
+  return solver.NonMinimalSolver(sample, model, context);
+}
+
+template <class Solver, class Model, class Context>
+int NonMinimalSolverWithContext(const Solver& solver,
+                                const std::vector<int>& sample, Model* model,
+                                Context*, long) {
+  return solver.NonMinimalSolver(sample, model);
+}
+
+template <class Solver, class Model, class Context>
+auto LeastSquaresWithContext(const Solver& solver,
+                             const std::vector<int>& sample, Model* model,
+                             Context* context, int)
+    -> decltype(solver.LeastSquares(sample, model, context), void()) {
+  solver.LeastSquares(sample, model, context);
+}
+
+template <class Solver, class Model, class Context>
+void LeastSquaresWithContext(const Solver& solver,
+                             const std::vector<int>& sample, Model* model,
+                             Context*, long) {
+  solver.LeastSquares(sample, model);
+}
+
+template <class Solver, class Model, class Context>
+auto WeightedLeastSquaresWithContext(const Solver& solver,
+                                     const std::vector<int>& sample,
+                                     const std::vector<double>& weights,
+                                     Model* model, Context* context, int)
+    -> decltype(solver.WeightedLeastSquares(sample, weights, model, context),
+                void()) {
+  solver.WeightedLeastSquares(sample, weights, model, context);
+}
+
+template <class Solver, class Model, class Context>
+void WeightedLeastSquaresWithContext(const Solver& solver,
+                                     const std::vector<int>& sample,
+                                     const std::vector<double>& weights,
+                                     Model* model, Context*, long) {
+  solver.WeightedLeastSquares(sample, weights, model);
+}
+}  // namespace internal
+
+// Call solver.MinimalSolver, solver.NonMinimalSolver, solver.LeastSquares,
+// and solver.WeightedLeastSquares with the solver context (see
+// scratch_arena.h) as last argument if the solver accepts it, and without it
+// otherwise.
+template <class Solver, class ModelVector, class Context>
+inline int CallMinimalSolver(const Solver& solver,
+                             const std::vector<int>& sample,
+                             ModelVector* models, Context* context) {
+  return internal::MinimalSolverWithContext(solver, sample, models, context,
+                                            0);
+}
+
+template <class Solver, class Model, class Context>
+inline int CallNonMinimalSolver(const Solver& solver,
+                                const std::vector<int>& sample, Model* model,
+                                Context* context) {
+  return internal::NonMinimalSolverWithContext(solver, sample, model, context,
+                                               0);
+}
+
+template <class Solver, class Model, class Context>
+inline void CallLeastSquares(const Solver& solver,
+                             const std::vector<int>& sample, Model* model,
+                             Context* context) {
+  internal::LeastSquaresWithContext(solver, sample, model, context, 0);
+}
+
+template <class Solver, class Model, class Context>
+inline void CallWeightedLeastSquares(const Solver& solver,
+                                     const std::vector<int>& sample,
+                                     const std::vector<double>& weights,
+                                     Model* model, Context* context) {
+  internal::WeightedLeastSquaresWithContext(solver, sample, weights, model,
+                                            context, 0);
+}
+
+// Returns a per-thread buffer that can hold at least num_elements squared
+// errors. The buffer is reused by subsequent calls from the same thread.
+inline double* SquaredErrorBuffer(const int num_elements) {
+  thread_local std::vector<double> buffer;
+  if (static_cast<int>(buffer.size()) < num_elements) {
+    buffer.resize(num_elements);
+  }
+  return buffer.data();
+}
+
 }  // namespace utils
 }  // namespace ransac_lib
 
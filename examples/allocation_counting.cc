@@ -0,0 +1,697 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of the copyright holder nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// Counts the heap allocations performed by LocallyOptimizedMSAC and
+// HybridLocallyOptimizedMSAC on the line and pose examples. The global
+// operator new / delete (and, on glibc, malloc and friends) are replaced by
+// counting hooks. Allocations are attributed to iterations and local
+// optimization (LO) stages by observing the iterations of the engine (via its
+// Statistics policy) and the calls it makes into the solver.
+//
+// usage: allocation_counting [max_allocations_per_iteration]
+// If a maximum is given, the program returns 1 if any of the problems exceeds
+// it. This allows using the program to guard against regressions.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <numeric>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+#include <RansacLib/hybrid_ransac.h>
+#include <RansacLib/ransac.h>
+#include "calibrated_absolute_pose_estimator.h"
+#include "hybrid_line_estimator.h"
+#include "line_estimator.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Allocation hooks.
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+std::atomic<uint64_t> g_num_allocations(0u);
+std::atomic<uint64_t> g_num_allocated_bytes(0u);
+
+inline void CountAllocation(const std::size_t size) {
+  g_num_allocations.fetch_add(1u, std::memory_order_relaxed);
+  g_num_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+#ifdef __GLIBC__
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t num, std::size_t size);
+void* __libc_realloc(void* ptr, std::size_t size);
+void* __libc_memalign(std::size_t alignment, std::size_t size);
+void __libc_free(void* ptr);
+}
+
+namespace {
+inline void* RawMalloc(std::size_t size) { return __libc_malloc(size); }
+inline void* RawAlignedMalloc(std::size_t alignment, std::size_t size) {
+  return __libc_memalign(alignment, size);
+}
+inline void RawFree(void* ptr) { __libc_free(ptr); }
+}  // namespace
+
+// Eigen (and most C code) allocates through malloc rather than operator new.
+// On glibc, we can intercept these calls by defining the functions ourselves
+// and forwarding to the internal implementations.
+extern "C" {
+void* malloc(std::size_t size) {
+  CountAllocation(size);
+  return __libc_malloc(size);
+}
+
+void* calloc(std::size_t num, std::size_t size) {
+  CountAllocation(num * size);
+  return __libc_calloc(num, size);
+}
+
+void* realloc(void* ptr, std::size_t size) {
+  CountAllocation(size);
+  return __libc_realloc(ptr, size);
+}
+
+void* memalign(std::size_t alignment, std::size_t size) {
+  CountAllocation(size);
+  return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(std::size_t alignment, std::size_t size) {
+  CountAllocation(size);
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, std::size_t alignment, std::size_t size) {
+  CountAllocation(size);
+  *ptr = __libc_memalign(alignment, size);
+  return *ptr == nullptr ? ENOMEM : 0;
+}
+
+void free(void* ptr) { __libc_free(ptr); }
+}
+#else
+namespace {
+inline void* RawMalloc(std::size_t size) { return std::malloc(size); }
+inline void* RawAlignedMalloc(std::size_t alignment, std::size_t size) {
+  // std::aligned_alloc requires the size to be a multiple of the alignment.
+  return std::aligned_alloc(alignment,
+                            (size + alignment - 1) / alignment * alignment);
+}
+inline void RawFree(void* ptr) { std::free(ptr); }
+}  // namespace
+#endif
+
+void* operator new(std::size_t size) {
+  CountAllocation(size);
+  void* ptr = RawMalloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new[](std::size_t size) {
+  CountAllocation(size);
+  void* ptr = RawMalloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  CountAllocation(size);
+  return RawMalloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  CountAllocation(size);
+  return RawMalloc(size == 0 ? 1 : size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  CountAllocation(size);
+  void* ptr =
+      RawAlignedMalloc(static_cast<std::size_t>(alignment), size == 0 ? 1 : size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  CountAllocation(size);
+  void* ptr =
+      RawAlignedMalloc(static_cast<std::size_t>(alignment), size == 0 ? 1 : size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { RawFree(ptr); }
+void operator delete[](void* ptr) noexcept { RawFree(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { RawFree(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { RawFree(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { RawFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { RawFree(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+  RawFree(ptr);
+}
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+  RawFree(ptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Attribution of allocations to RANSAC iterations and LO stages.
+////////////////////////////////////////////////////////////////////////////////
+
+namespace ransac_lib {
+
+// Splits the run of RANSAC into intervals. The start of each iteration of the
+// engine starts a new interval, i.e., an interval covers one RANSAC iteration,
+// including the LO run at its start once lo_starting_iterations_ is reached.
+// Calls to the least squares and non-minimal solvers only happen inside local
+// optimization (or in the final least squares step). An interval containing
+// such calls is thus an iteration in which LO was executed.
+class AllocationTracker {
+ public:
+  // max_num_intervals should be set to the maximum number of RANSAC
+  // iterations to avoid that the bookkeeping allocates memory while counting.
+  void Start(const uint32_t max_num_intervals) {
+    plain_intervals_.clear();
+    lo_intervals_.clear();
+    plain_intervals_.reserve(max_num_intervals + 1u);
+    lo_intervals_.reserve(max_num_intervals + 1u);
+    interval_start_ = g_num_allocations.load();
+    call_start_ = interval_start_;
+    in_interval_ = false;
+    interval_has_lo_ = false;
+    allocations_setup_ = 0u;
+  }
+
+  // Called by TrackingStatistics at the beginning of each iteration.
+  void BeginIteration() {
+    const uint64_t kNow = g_num_allocations.load();
+    if (in_interval_) {
+      CloseInterval(kNow);
+    } else {
+      allocations_setup_ = kNow - call_start_;
+    }
+    in_interval_ = true;
+    interval_has_lo_ = false;
+    interval_start_ = kNow;
+  }
+
+  // Called by the solver whenever a method only used by LO is invoked.
+  void MarkLocalOptimization() { interval_has_lo_ = true; }
+
+  void Stop() {
+    const uint64_t kNow = g_num_allocations.load();
+    if (in_interval_) CloseInterval(kNow);
+    in_interval_ = false;
+    allocations_total_ = kNow - call_start_;
+  }
+
+  uint64_t allocations_total() const { return allocations_total_; }
+  uint64_t allocations_setup() const { return allocations_setup_; }
+  const std::vector<uint64_t>& plain_intervals() const {
+    return plain_intervals_;
+  }
+  const std::vector<uint64_t>& lo_intervals() const { return lo_intervals_; }
+
+ private:
+  void CloseInterval(const uint64_t now) {
+    if (interval_has_lo_) {
+      lo_intervals_.push_back(now - interval_start_);
+    } else {
+      plain_intervals_.push_back(now - interval_start_);
+    }
+  }
+
+  uint64_t call_start_;
+  uint64_t interval_start_;
+  uint64_t allocations_setup_;
+  uint64_t allocations_total_;
+  bool in_interval_;
+  bool interval_has_lo_;
+  std::vector<uint64_t> plain_intervals_;
+  std::vector<uint64_t> lo_intervals_;
+};
+
+AllocationTracker* g_tracker = nullptr;
+
+// Wraps a solver and reports calls to the LO-only methods to the tracker.
+// The overloads taking a solver context and EvaluateModelOnPoints are forwarded
+// as well, such that the engine takes the same paths as for the wrapped solver.
+template <class Solver, class Model>
+class TrackedSolver {
+ public:
+  explicit TrackedSolver(const Solver& solver) : solver_(solver) {}
+
+  inline int min_sample_size() const { return solver_.min_sample_size(); }
+
+  inline int non_minimal_sample_size() const {
+    return solver_.non_minimal_sample_size();
+  }
+
+  inline int num_data() const { return solver_.num_data(); }
+
+  template <class ModelVector>
+  int MinimalSolver(const std::vector<int>& sample,
+                    ModelVector* models) const {
+    return solver_.MinimalSolver(sample, models);
+  }
+
+  template <class ModelVector>
+  int MinimalSolver(const std::vector<int>& sample, ModelVector* models,
+                    SolverContext* context) const {
+    return utils::CallMinimalSolver(solver_, sample, models, context);
+  }
+
+  int NonMinimalSolver(const std::vector<int>& sample, Model* model) const {
+    g_tracker->MarkLocalOptimization();
+    return solver_.NonMinimalSolver(sample, model);
+  }
+
+  int NonMinimalSolver(const std::vector<int>& sample, Model* model,
+                       SolverContext* context) const {
+    g_tracker->MarkLocalOptimization();
+    return utils::CallNonMinimalSolver(solver_, sample, model, context);
+  }
+
+  double EvaluateModelOnPoint(const Model& model, int i) const {
+    return solver_.EvaluateModelOnPoint(model, i);
+  }
+
+  // Only available if the wrapped solver provides it (see
+  // utils::HasEvaluateModelOnPoints).
+  template <class S = Solver>
+  auto EvaluateModelOnPoints(const Model& model, double* squared_errors) const
+      -> decltype(std::declval<const S&>().EvaluateModelOnPoints(
+                      model, squared_errors),
+                  void()) {
+    solver_.EvaluateModelOnPoints(model, squared_errors);
+  }
+
+  void LeastSquares(const std::vector<int>& sample, Model* model) const {
+    g_tracker->MarkLocalOptimization();
+    solver_.LeastSquares(sample, model);
+  }
+
+  void LeastSquares(const std::vector<int>& sample, Model* model,
+                    SolverContext* context) const {
+    g_tracker->MarkLocalOptimization();
+    utils::CallLeastSquares(solver_, sample, model, context);
+  }
+
+  void WeightedLeastSquares(const std::vector<int>& sample,
+                            const std::vector<double>& weights, Model* model,
+                            SolverContext* context) const {
+    g_tracker->MarkLocalOptimization();
+    utils::CallWeightedLeastSquares(solver_, sample, weights, model, context);
+  }
+
+ private:
+  const Solver& solver_;
+};
+
+template <class HybridSolver, class Model>
+class TrackedHybridSolver {
+ public:
+  explicit TrackedHybridSolver(const HybridSolver& solver) : solver_(solver) {}
+
+  inline int num_minimal_solvers() const {
+    return solver_.num_minimal_solvers();
+  }
+
+  inline void min_sample_sizes(
+      std::vector<std::vector<int>>* min_sample_sizes) const {
+    solver_.min_sample_sizes(min_sample_sizes);
+  }
+
+  inline int num_data_types() const { return solver_.num_data_types(); }
+
+  inline void num_data(std::vector<int>* num_data) const {
+    solver_.num_data(num_data);
+  }
+
+  inline void solver_probabilities(
+      std::vector<double>* solver_probabilites) const {
+    solver_.solver_probabilities(solver_probabilites);
+  }
+
+  template <class ModelVector>
+  int MinimalSolver(const std::vector<std::vector<int>>& sample,
+                    const int solver_idx, ModelVector* models) const {
+    return solver_.MinimalSolver(sample, solver_idx, models);
+  }
+
+  // The overloads taking a solver context are only available if the wrapped
+  // solver provides them. HybridLocallyOptimizedMSAC does not evaluate models
+  // in batches, i.e., there is no EvaluateModelOnPoints to forward.
+  template <class ModelVector, class S = HybridSolver>
+  auto MinimalSolver(const std::vector<std::vector<int>>& sample,
+                     const int solver_idx, ModelVector* models,
+                     SolverContext* context) const
+      -> decltype(std::declval<const S&>().MinimalSolver(sample, solver_idx,
+                                                         models, context)) {
+    return solver_.MinimalSolver(sample, solver_idx, models, context);
+  }
+
+  double EvaluateModelOnPoint(const Model& model, int t, int i) const {
+    return solver_.EvaluateModelOnPoint(model, t, i);
+  }
+
+  void LeastSquares(const std::vector<std::vector<int>>& sample,
+                    Model* model) const {
+    g_tracker->MarkLocalOptimization();
+    solver_.LeastSquares(sample, model);
+  }
+
+  template <class S = HybridSolver>
+  auto LeastSquares(const std::vector<std::vector<int>>& sample, Model* model,
+                    SolverContext* context) const
+      -> decltype(std::declval<const S&>().LeastSquares(sample, model,
+                                                        context),
+                  void()) {
+    g_tracker->MarkLocalOptimization();
+    solver_.LeastSquares(sample, model, context);
+  }
+
+ private:
+  const HybridSolver& solver_;
+};
+
+// Statistics sink that marks the beginning of each iteration.
+struct TrackingStatistics : public FullStatistics {
+  static inline void BeginIteration(const uint32_t /*iteration*/) {
+    g_tracker->BeginIteration();
+  }
+};
+
+}  // namespace ransac_lib
+
+////////////////////////////////////////////////////////////////////////////////
+// Problem instances.
+////////////////////////////////////////////////////////////////////////////////
+
+// Generates points on a random line with outliers in [0, 1] x [-0.5, 0.5].
+// If normals is not nullptr, a normal is generated for each point as well.
+void GenerateLineInstance(const int num_inliers, const int num_outliers,
+                          const double inlier_threshold, std::mt19937* rng,
+                          Eigen::Matrix2Xd* points, Eigen::Matrix4Xd* normals) {
+  const int kNumPoints = num_inliers + num_outliers;
+  points->resize(2, kNumPoints);
+  if (normals != nullptr) normals->resize(4, kNumPoints);
+
+  std::uniform_real_distribution<double> distr(-inlier_threshold,
+                                               inlier_threshold);
+  std::uniform_real_distribution<double> distr_x(0.0, 1.0);
+  std::uniform_real_distribution<double> distr_y(-0.5, 0.5);
+
+  for (int i = 0; i < kNumPoints; ++i) {
+    Eigen::Vector2d n(0.0, 1.0);
+    if (i < num_inliers) {
+      points->col(i) = Eigen::Vector2d(distr_x(*rng), distr(*rng));
+    } else {
+      double y = distr_y(*rng);
+      while (std::fabs(y) < 5.0 * inlier_threshold) y = distr_y(*rng);
+      points->col(i) = Eigen::Vector2d(distr_x(*rng), y);
+      n = Eigen::Vector2d(distr_y(*rng), distr_y(*rng)).normalized();
+    }
+    if (normals != nullptr) {
+      normals->col(i) << points->col(i), n;
+    }
+  }
+}
+
+void GeneratePoseInstance(
+    const int num_inliers, const int num_outliers, std::mt19937* rng,
+    const double focal_length,
+    ransac_lib::calibrated_absolute_pose::Points2D* points2D,
+    ransac_lib::calibrated_absolute_pose::ViewingRays* rays,
+    ransac_lib::calibrated_absolute_pose::Points3D* points3D) {
+  const int kNumPoints = num_inliers + num_outliers;
+  points2D->resize(kNumPoints);
+  points3D->resize(kNumPoints);
+
+  std::uniform_real_distribution<double> distr_x(-320.0, 320.0);
+  std::uniform_real_distribution<double> distr_y(-160.0, 160.0);
+  std::uniform_real_distribution<double> distr_d(2.0, 10.0);
+  std::uniform_real_distribution<double> distr(-1.0, 1.0);
+
+  for (int i = 0; i < kNumPoints; ++i) {
+    Eigen::Vector2d p(distr_x(*rng), distr_y(*rng));
+    Eigen::Vector3d dir = p.homogeneous();
+    dir.head<2>() /= focal_length;
+    (*points3D)[i] = dir.normalized() * distr_d(*rng);
+    if (i < num_inliers) {
+      (*points2D)[i] = p + Eigen::Vector2d(distr(*rng), distr(*rng));
+    } else {
+      (*points2D)[i] = Eigen::Vector2d(distr_x(*rng), distr_y(*rng));
+    }
+  }
+
+  ransac_lib::calibrated_absolute_pose::CalibratedAbsolutePoseEstimator::
+      PixelsToViewingRays(focal_length, focal_length, *points2D, rays);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reporting.
+////////////////////////////////////////////////////////////////////////////////
+
+struct AllocationReport {
+  std::string name;
+  int num_data;
+  uint32_t num_iterations;
+  int num_lo;
+  uint64_t per_call;
+  uint64_t setup_and_final;
+  double per_iteration;
+  double per_lo;
+};
+
+AllocationReport Summarize(const std::string& name, const int num_data,
+                           const uint32_t num_iterations, const int num_lo,
+                           const ransac_lib::AllocationTracker& tracker) {
+  AllocationReport r;
+  r.name = name;
+  r.num_data = num_data;
+  r.num_iterations = num_iterations;
+  r.num_lo = num_lo;
+  r.per_call = tracker.allocations_total();
+
+  const std::vector<uint64_t>& plain = tracker.plain_intervals();
+  const std::vector<uint64_t>& lo = tracker.lo_intervals();
+  const uint64_t kSumPlain = std::accumulate(plain.begin(), plain.end(),
+                                             static_cast<uint64_t>(0u));
+  const uint64_t kSumLO =
+      std::accumulate(lo.begin(), lo.end(), static_cast<uint64_t>(0u));
+
+  r.per_iteration =
+      plain.empty() ? 0.0
+                    : static_cast<double>(kSumPlain) /
+                          static_cast<double>(plain.size());
+  // An iteration containing LO also contains the work of a regular iteration.
+  const double kLOWork =
+      static_cast<double>(kSumLO) -
+      r.per_iteration * static_cast<double>(lo.size());
+  r.per_lo = num_lo > 0 ? std::max(0.0, kLOWork) / static_cast<double>(num_lo)
+                        : 0.0;
+  r.setup_and_final = r.per_call - kSumPlain - kSumLO;
+  return r;
+}
+
+void PrintReport(const AllocationReport& r) {
+  std::cout << std::left << std::setw(24) << r.name << std::right
+            << std::setw(8) << r.num_data << std::setw(8) << r.num_iterations
+            << std::setw(6) << r.num_lo << std::setw(12) << r.per_call
+            << std::setw(12) << std::fixed << std::setprecision(2)
+            << r.per_iteration << std::setw(12) << r.per_lo << std::setw(12)
+            << r.setup_and_final << std::endl;
+}
+
+int main(int argc, char** argv) {
+  using ransac_lib::AllocationTracker;
+  using ransac_lib::TrackedHybridSolver;
+  using ransac_lib::TrackedSolver;
+  using ransac_lib::TrackingStatistics;
+  namespace pose = ransac_lib::calibrated_absolute_pose;
+
+  double max_allocations_per_iteration = -1.0;
+  if (argc >= 2) max_allocations_per_iteration = atof(argv[1]);
+
+  // LO-MSAC with the default policies, tracking the iterations.
+  typedef ransac_lib::RansacPolicies<
+      ransac_lib::SequentialMSACScorer, ransac_lib::LebedaLocalOptimization,
+      ransac_lib::AdaptiveTermination, TrackingStatistics>
+      Policies;
+
+  AllocationTracker tracker;
+  ransac_lib::g_tracker = &tracker;
+
+  std::vector<AllocationReport> reports;
+  const std::vector<int> kNumData = {100, 1000, 10000};
+  const double kOutlierRatio = 0.5;
+
+  for (const int kN : kNumData) {
+    const int kNumOutliers = static_cast<int>(kN * kOutlierRatio);
+    const int kNumInliers = kN - kNumOutliers;
+    std::mt19937 rng(kN);
+
+    // LO-MSAC on the line example.
+    {
+      Eigen::Matrix2Xd points;
+      GenerateLineInstance(kNumInliers, kNumOutliers, 0.005, &rng, &points,
+                           nullptr);
+      ransac_lib::LineEstimator estimator(points);
+      typedef TrackedSolver<ransac_lib::LineEstimator, Eigen::Vector3d>
+          Solver;
+      Solver solver(estimator);
+
+      ransac_lib::LORansacOptions options;
+      options.squared_inlier_threshold_ = 0.01 * 0.01;
+      options.random_seed_ = 0u;
+
+      ransac_lib::LocallyOptimizedMSAC<
+          Eigen::Vector3d, std::vector<Eigen::Vector3d>, Solver,
+          ransac_lib::UniformSampling<Solver>, Policies>
+          lomsac;
+      ransac_lib::RansacStatistics stats;
+      Eigen::Vector3d best_model;
+      tracker.Start(options.max_num_iterations_);
+      lomsac.EstimateModel(options, solver, &best_model, &stats);
+      tracker.Stop();
+      reports.push_back(Summarize("line/LO-MSAC", kN, stats.num_iterations,
+                                  stats.number_lo_iterations, tracker));
+    }
+
+    // HybridLO-MSAC on the hybrid line example.
+    {
+      Eigen::Matrix2Xd points;
+      Eigen::Matrix4Xd points_with_normals;
+      GenerateLineInstance(kNumInliers, kNumOutliers, 0.005, &rng, &points,
+                           &points_with_normals);
+      ransac_lib::HybridLineEstimator estimator(points, points_with_normals,
+                                                {0.2, 0.8});
+      typedef TrackedHybridSolver<ransac_lib::HybridLineEstimator,
+                                  Eigen::Vector3d>
+          Solver;
+      Solver solver(estimator);
+
+      ransac_lib::HybridLORansacOptions options;
+      options.max_num_iterations_per_solver_ = 1000u;
+      options.squared_inlier_thresholds_ = {0.01 * 0.01, 0.01 * 0.01};
+      options.data_type_weights_ = {2.0, 0.5};
+      options.random_seed_ = 0u;
+
+      ransac_lib::HybridLocallyOptimizedMSAC<
+          Eigen::Vector3d, std::vector<Eigen::Vector3d>, Solver,
+          ransac_lib::HybridUniformSampling<Solver>, TrackingStatistics>
+          lomsac;
+      ransac_lib::HybridRansacStatistics stats;
+      Eigen::Vector3d best_model;
+      tracker.Start(options.max_num_iterations_);
+      lomsac.EstimateModel(options, solver, &best_model, &stats);
+      tracker.Stop();
+      reports.push_back(Summarize("hybrid_line/LO-MSAC", 2 * kN,
+                                  stats.num_iterations_total,
+                                  stats.number_lo_iterations, tracker));
+    }
+
+    // LO-MSAC on the calibrated absolute pose example.
+    {
+      const double kFocalLength = 320.0 / std::tan(60.0 * M_PI / 180.0);
+      pose::Points2D points2D;
+      pose::ViewingRays rays;
+      pose::Points3D points3D;
+      GeneratePoseInstance(kNumInliers, kNumOutliers, &rng, kFocalLength,
+                           &points2D, &rays, &points3D);
+      const double kSqrThreshold = 12.0 * 12.0;
+      pose::CalibratedAbsolutePoseEstimator estimator(
+          kFocalLength, kFocalLength, kSqrThreshold, points2D, rays, points3D);
+      typedef TrackedSolver<pose::CalibratedAbsolutePoseEstimator,
+                            pose::CameraPose>
+          Solver;
+      Solver solver(estimator);
+
+      ransac_lib::LORansacOptions options;
+      options.squared_inlier_threshold_ = kSqrThreshold;
+      options.random_seed_ = 0u;
+
+      ransac_lib::LocallyOptimizedMSAC<pose::CameraPose, pose::CameraPoses,
+                                       Solver,
+                                       ransac_lib::UniformSampling<Solver>,
+                                       Policies>
+          lomsac;
+      ransac_lib::RansacStatistics stats;
+      pose::CameraPose best_model;
+      tracker.Start(options.max_num_iterations_);
+      lomsac.EstimateModel(options, solver, &best_model, &stats);
+      tracker.Stop();
+      reports.push_back(Summarize("pose/LO-MSAC", kN, stats.num_iterations,
+                                  stats.number_lo_iterations, tracker));
+    }
+  }
+
+  std::cout << std::left << std::setw(24) << " problem" << std::right
+            << std::setw(8) << "N" << std::setw(8) << "iters" << std::setw(6)
+            << "LO" << std::setw(12) << "per call" << std::setw(12)
+            << "per iter" << std::setw(12) << "per LO" << std::setw(12)
+            << "setup+final" << std::endl;
+  bool within_budget = true;
+  for (const AllocationReport& r : reports) {
+    PrintReport(r);
+    if (max_allocations_per_iteration >= 0.0 &&
+        r.per_iteration > max_allocations_per_iteration) {
+      within_budget = false;
+    }
+  }
+
+  if (!within_budget) {
+    std::cerr << " ERROR: More than " << max_allocations_per_iteration
+              << " allocations per iteration" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,335 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include <RansacLib/executor.h>
+#include "batch_localization.h"
+
+namespace ransac_lib {
+
+namespace batch_localization {
+
+using calibrated_absolute_pose::CalibratedAbsolutePoseEstimator;
+
+LORansacOptions LocalizationOptions(const LocalizationSettings& settings) {
+  LORansacOptions options;
+  options.min_num_iterations_ = 100u;
+  options.max_num_iterations_ = 10000u;
+  options.min_sample_multiplicator_ = 7;
+  options.num_lsq_iterations_ = 4;
+  options.num_lo_steps_ = settings.num_lo_steps;
+  options.lo_starting_iterations_ = 60;
+  options.final_least_squares_ = true;
+  options.squared_inlier_threshold_ =
+      settings.inlier_threshold * settings.inlier_threshold;
+  return options;
+}
+
+unsigned int QuerySeed(const unsigned int random_seed, const int query_index) {
+  const uint32_t kValues[2] = {static_cast<uint32_t>(random_seed),
+                               static_cast<uint32_t>(query_index)};
+  uint32_t hash = 2166136261u;
+  for (const uint32_t value : kValues) {
+    for (int i = 0; i < 4; ++i) {
+      hash ^= (value >> (8 * i)) & 0xFFu;
+      hash *= 16777619u;
+    }
+  }
+  return hash;
+}
+
+bool LoadQueryMatches(const localization_io::QueryData& query,
+                      const LocalizationSettings& settings,
+                      QueryMatches* matches) {
+  std::string matchfile(query.name);
+  matchfile.append(settings.matchfile_postfix);
+  if (!ReadMatches(matchfile, settings, matches)) return false;
+  PrepareQueryMatches(query, settings, matches);
+  return true;
+}
+
+bool ReadMatches(const std::string& filename,
+                 const LocalizationSettings& settings, QueryMatches* matches) {
+  if (settings.map == nullptr) {
+    matches->point_ids.clear();
+    return localization_io::LoadMatches(filename, settings.invert_Y_Z,
+                                        &matches->points2D,
+                                        &matches->points3D);
+  }
+  return localization_io::LoadIdMatches(filename, &matches->points2D,
+                                        &matches->point_ids) &&
+         settings.map->Gather(matches->point_ids, settings.invert_Y_Z,
+                              filename, &matches->points3D);
+}
+
+void PrepareQueryMatches(const localization_io::QueryData& query,
+                         const LocalizationSettings& settings,
+                         QueryMatches* matches) {
+  if (!settings.points_centered) {
+    for (Eigen::Vector2d& p : matches->points2D) {
+      p[0] -= query.c_x;
+      p[1] -= query.c_y;
+    }
+  }
+  CalibratedAbsolutePoseEstimator::PixelsToViewingRays(
+      query.focal_x, query.focal_y, matches->points2D, &matches->rays);
+  matches->arrays.Assign(matches->points2D, matches->points3D);
+}
+
+void LocalizationWorker::Localize(const localization_io::QueryData& query,
+                                  const int query_index,
+                                  const LocalizationSettings& settings,
+                                  std::ostream* log, QueryResult* result) {
+  if (!LoadQueryMatches(query, settings, &matches_)) {
+    *log << "  ERROR: Could not load matches from " << query.name
+         << settings.matchfile_postfix << std::endl;
+    result->ransac_run = false;
+    result->num_matches = 0;
+    return;
+  }
+  Solve(query, matches_, query_index, settings, log, result);
+}
+
+void LocalizationWorker::Solve(const localization_io::QueryData& query,
+                               const QueryMatches& matches,
+                               const int query_index,
+                               const LocalizationSettings& settings,
+                               std::ostream* log, QueryResult* result) const {
+  const int kNumMatches = static_cast<int>(matches.points2D.size());
+  result->num_matches = kNumMatches;
+  result->ransac_run = false;
+
+  *log << " image " << query.name << " has # " << kNumMatches
+       << " matches as input to RANSAC" << std::endl;
+  if (kNumMatches < settings.min_num_matches) {
+    *log << " Found only " << kNumMatches << " matches for query image "
+         << query.name << " -> skipping image" << std::endl;
+    return;
+  }
+  *log << "  " << query_index << " " << query.name << " " << query.focal_x
+       << " " << query.focal_y << std::endl;
+
+  result->options = LocalizationOptions(settings);
+  result->options.random_seed_ = QuerySeed(settings.random_seed, query_index);
+
+  CalibratedAbsolutePoseEstimator solver(
+      query.focal_x, query.focal_y, result->options.squared_inlier_threshold_,
+      matches.points2D, matches.rays, matches.points3D, matches.arrays);
+
+  *log << "   " << query.name << " : running LO-MSAC on " << kNumMatches
+       << " matches " << std::endl;
+  // LO-MSAC does not set the pose if it does not find any model. Using a
+  // fixed pose in this case keeps the output deterministic.
+  result->pose.setIdentity();
+  auto ransac_start = std::chrono::steady_clock::now();
+  result->num_inliers = lomsac_.EstimateModel(result->options, solver,
+                                              &result->pose,
+                                              &result->statistics);
+  auto ransac_end = std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed_seconds = ransac_end - ransac_start;
+  result->seconds = elapsed_seconds.count();
+  result->ransac_run = true;
+
+  *log << "   ... LOMSAC found " << result->num_inliers << " inliers in "
+       << result->statistics.num_iterations
+       << " iterations with an inlier ratio of "
+       << result->statistics.inlier_ratio << std::endl;
+  *log << "   ... LOMSAC took " << result->seconds << " s" << std::endl;
+  *log << "   ... LOMSAC executed " << result->statistics.number_lo_iterations
+       << " local optimization stages" << std::endl;
+  *log << "  Image " << query.name << " : we found # " << result->num_inliers
+       << " inliers" << std::endl;
+}
+
+std::string FormatPose(const std::string& name,
+                       const calibrated_absolute_pose::CameraPose& pose) {
+  Eigen::Matrix3d R = pose.topLeftCorner<3, 3>();
+  Eigen::Vector3d t = -R * pose.col(3);
+  Eigen::Quaterniond q(R);
+  q.normalize();
+
+  std::ostringstream s_stream;
+  s_stream << name << " " << q.w() << " " << q.x() << " " << q.y() << " "
+           << q.z() << " " << t[0] << " " << t[1] << " " << t[2] << "\n";
+  return s_stream.str();
+}
+
+void RunPipeline(const localization_io::Queries& queries,
+                 const int first_query, const LocalizationSettings& settings,
+                 const PipelineOptions& options, const QueryConsumer& consume) {
+  const int kNumQueries = static_cast<int>(queries.size());
+  const int kNumLoaders = std::max(1, options.num_loaders);
+  const int kNumWorkers = std::max(1, options.num_workers);
+  const int kLoadQueueDepth = std::max(1, options.load_queue_depth);
+  const int kResultQueueDepth = std::max(1, options.result_queue_depth);
+
+  // Every query in flight occupies a slot. Loaders take the index of the next
+  // query only after obtaining a free slot. The first query that has not been
+  // consumed yet thus always has a slot, which guarantees progress even
+  // though results are consumed in order.
+  const int kNumSlots = kLoadQueueDepth + kNumWorkers + kResultQueueDepth;
+  std::vector<std::unique_ptr<ProcessedQuery>> slots(kNumSlots);
+  BoundedQueue<ProcessedQuery*> free_slots(kNumSlots);
+  for (std::unique_ptr<ProcessedQuery>& slot : slots) {
+    slot.reset(new ProcessedQuery);
+    free_slots.Push(slot.get());
+  }
+  BoundedQueue<ProcessedQuery*> loaded_queries(kLoadQueueDepth);
+  BoundedQueue<ProcessedQuery*> solved_queries(kResultQueueDepth);
+
+  std::atomic<int> next_index(first_query);
+  std::atomic<int> num_running_loaders(kNumLoaders);
+  std::atomic<int> num_running_workers(kNumWorkers);
+
+  auto loader = [&]() {
+    ProcessedQuery* slot = nullptr;
+    while (free_slots.Pop(&slot)) {
+      const int kIndex = next_index.fetch_add(1);
+      if (kIndex >= kNumQueries) {
+        free_slots.Push(slot);
+        break;
+      }
+      slot->index = kIndex;
+      slot->loaded =
+          LoadQueryMatches(queries[kIndex], settings, &slot->matches);
+      loaded_queries.Push(slot);
+    }
+    if (num_running_loaders.fetch_sub(1) == 1) loaded_queries.Close();
+  };
+
+  auto worker = [&]() {
+    LocalizationWorker localizer;
+    std::ostringstream log;
+    ProcessedQuery* slot = nullptr;
+    while (loaded_queries.Pop(&slot)) {
+      const localization_io::QueryData& query = queries[slot->index];
+      log.str("");
+      if (slot->loaded) {
+        localizer.Solve(query, slot->matches, slot->index, settings, &log,
+                        &slot->result);
+      } else {
+        log << "  ERROR: Could not load matches from " << query.name
+            << settings.matchfile_postfix << std::endl;
+        slot->result.ransac_run = false;
+        slot->result.num_matches = 0;
+      }
+      slot->log = log.str();
+      solved_queries.Push(slot);
+    }
+    if (num_running_workers.fetch_sub(1) == 1) solved_queries.Close();
+  };
+
+  // The RANSAC workers block on the queue of loaded queries until it is
+  // closed. They thus run on a pool of their own instead of occupying the
+  // threads of DefaultExecutor(). The loaders block on file I/O and get their
+  // own threads.
+  ThreadPoolExecutor executor(kNumWorkers);
+  std::vector<std::thread> loaders;
+  for (int t = 0; t < kNumLoaders; ++t) loaders.emplace_back(loader);
+  for (int t = 0; t < kNumWorkers; ++t) executor.Submit(worker);
+
+  // Results arriving out of order wait until all previous queries have been
+  // consumed.
+  std::map<int, ProcessedQuery*> pending;
+  int next_to_consume = first_query;
+  ProcessedQuery* slot = nullptr;
+  while (solved_queries.Pop(&slot)) {
+    pending.emplace(slot->index, slot);
+    auto it = pending.begin();
+    while (it != pending.end() && it->first == next_to_consume) {
+      consume(queries[it->first], *it->second);
+      free_slots.Push(it->second);
+      ++next_to_consume;
+      it = pending.erase(it);
+    }
+  }
+  free_slots.Close();
+
+  for (std::thread& t : loaders) t.join();
+  executor.Wait();
+}
+
+const char kPipelineArgumentsUsage[] =
+    "[num_threads] [random_seed] [num_loaders] [load_queue_depth] "
+    "[result_queue_depth]";
+
+void ParsePipelineArguments(const int argc, char** argv,
+                            const int first_argument,
+                            LocalizationSettings* settings,
+                            PipelineOptions* options) {
+  auto has_argument = [&](const int i) { return argc > first_argument + i; };
+  auto argument = [&](const int i) { return argv[first_argument + i]; };
+
+  options->num_workers = has_argument(0) ? std::max(1, atoi(argument(0))) : 1;
+  if (has_argument(1)) {
+    settings->random_seed =
+        static_cast<unsigned int>(std::strtoul(argument(1), nullptr, 10));
+  } else {
+    std::random_device rand_dev;
+    settings->random_seed = rand_dev();
+  }
+  options->num_loaders = has_argument(2) ? std::max(1, atoi(argument(2))) : 1;
+  options->load_queue_depth = has_argument(3)
+                                  ? std::max(1, atoi(argument(3)))
+                                  : 2 * options->num_workers;
+  options->result_queue_depth = has_argument(4)
+                                    ? std::max(1, atoi(argument(4)))
+                                    : 2 * options->num_workers;
+}
+
+bool UseMapFromEnvironment(map_store::MapStore* store,
+                           LocalizationSettings* settings) {
+  settings->map = nullptr;
+  const char* map_file = std::getenv("RANSACLIB_MAP");
+  if (map_file == nullptr || map_file[0] == '\0') return true;
+  if (!store->Open(map_file)) return false;
+  settings->map = store;
+  return true;
+}
+
+}  // namespace batch_localization
+
+}  // namespace ransac_lib
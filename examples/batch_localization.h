@@ -0,0 +1,277 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#ifndef RANSACLIB_EXAMPLE_BATCH_LOCALIZATION_H_
+#define RANSACLIB_EXAMPLE_BATCH_LOCALIZATION_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <RansacLib/ransac.h>
+#include "calibrated_absolute_pose_estimator.h"
+#include "localization_io.h"
+#include "map_store.h"
+
+namespace ransac_lib {
+
+namespace batch_localization {
+
+// Settings shared by all queries of a batch.
+struct LocalizationSettings {
+  // The inlier threshold in pixels.
+  double inlier_threshold;
+  int num_lo_steps;
+  bool invert_Y_Z;
+  // Whether the 2D positions in the match files are already centered around
+  // the principal point.
+  bool points_centered;
+  std::string matchfile_postfix;
+  // Queries with fewer matches are skipped.
+  int min_num_matches;
+  // The seed of each query is derived from this seed and the index of the
+  // query (see QuerySeed), such that the result of a query does not depend on
+  // the thread processing it or on the order in which queries are processed.
+  unsigned int random_seed;
+  // If not nullptr, the match files reference the 3D points of this map by
+  // their IDs (see localization_io::LoadIdMatches) instead of storing their
+  // coordinates. The map is shared by all queries and threads.
+  const map_store::MapStore* map;
+};
+
+// The LO-MSAC options used for all queries, without the random seed.
+LORansacOptions LocalizationOptions(const LocalizationSettings& settings);
+
+// Derives the random seed for the query with the given index via FNV-1a.
+unsigned int QuerySeed(const unsigned int random_seed, const int query_index);
+
+// The matches of a query. The 2D positions are centered around the principal
+// point.
+struct QueryMatches {
+  calibrated_absolute_pose::Points2D points2D;
+  calibrated_absolute_pose::Points3D points3D;
+  calibrated_absolute_pose::ViewingRays rays;
+  // Structure-of-arrays layout of the matches, shared by all estimators
+  // created for the query.
+  calibrated_absolute_pose::MatchArrays arrays;
+  // The IDs of the 3D points if the matches reference a map. Empty otherwise.
+  std::vector<uint32_t> point_ids;
+};
+
+// Reads the 2D positions and the 3D points of the matches stored in a match
+// file. If settings.map is set, the 3D points are gathered from the map.
+bool ReadMatches(const std::string& filename,
+                 const LocalizationSettings& settings, QueryMatches* matches);
+
+// Loads the matches of a query and computes their viewing rays. Returns false
+// if the match file cannot be read.
+bool LoadQueryMatches(const localization_io::QueryData& query,
+                      const LocalizationSettings& settings,
+                      QueryMatches* matches);
+
+// Centers the 2D positions of matches that were loaded by other means (unless
+// they are already centered) and computes their viewing rays and their
+// structure-of-arrays layout.
+void PrepareQueryMatches(const localization_io::QueryData& query,
+                         const LocalizationSettings& settings,
+                         QueryMatches* matches);
+
+struct QueryResult {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  // False if the matches could not be loaded or if there were too few matches
+  // to run RANSAC. All other fields are only valid if RANSAC was run.
+  bool ransac_run;
+  int num_matches;
+  LORansacOptions options;
+  calibrated_absolute_pose::CameraPose pose;
+  int num_inliers;
+  RansacStatistics statistics;
+  double seconds;
+};
+
+// Localizes queries one at a time. A worker keeps the buffers for the matches
+// allocated between queries, i.e., every thread should use its own worker and
+// reuse it for all queries it processes. Progress messages are written to
+// log, which allows callers to keep the messages of different queries apart.
+class LocalizationWorker {
+ public:
+  // Loads the matches of the query and runs LO-MSAC on them.
+  void Localize(const localization_io::QueryData& query,
+                const int query_index, const LocalizationSettings& settings,
+                std::ostream* log, QueryResult* result);
+
+  // Runs LO-MSAC on matches that have already been loaded.
+  void Solve(const localization_io::QueryData& query,
+             const QueryMatches& matches, const int query_index,
+             const LocalizationSettings& settings, std::ostream* log,
+             QueryResult* result) const;
+
+  // The matches of the last query passed to Localize.
+  inline const QueryMatches& matches() const { return matches_; }
+
+ protected:
+  QueryMatches matches_;
+  LocallyOptimizedMSAC<calibrated_absolute_pose::CameraPose,
+                       calibrated_absolute_pose::CameraPoses,
+                       calibrated_absolute_pose::CalibratedAbsolutePoseEstimator>
+      lomsac_;
+};
+
+// Returns the line written into the pose file for a query, i.e., its name
+// followed by the rotation as quaternion (w, x, y, z) and the translation.
+std::string FormatPose(const std::string& name,
+                       const calibrated_absolute_pose::CameraPose& pose);
+
+// A first-in first-out queue with a fixed capacity that can be used by
+// multiple producer and consumer threads. Push blocks while the queue is full
+// and Pop blocks while it is empty. After Close, Push fails and Pop fails
+// once the remaining elements have been taken.
+template <typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(const int capacity)
+      : capacity_(static_cast<size_t>(std::max(1, capacity))),
+        closed_(false) {}
+
+  bool Push(T value) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock,
+                   [this]() { return closed_ || queue_.size() < capacity_; });
+    if (closed_) return false;
+    queue_.push_back(std::move(value));
+    not_empty_.notify_one();
+    return true;
+  }
+
+  bool Pop(T* value) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this]() { return closed_ || !queue_.empty(); });
+    if (queue_.empty()) return false;
+    *value = std::move(queue_.front());
+    queue_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    not_empty_.notify_all();
+    not_full_.notify_all();
+  }
+
+ protected:
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::deque<T> queue_;
+  size_t capacity_;
+  bool closed_;
+};
+
+// The sizes of the stages of the pipeline run by RunPipeline.
+struct PipelineOptions {
+  // The number of threads loading match files.
+  int num_loaders;
+  // The number of RANSAC workers. They run on a thread pool of their own.
+  int num_workers;
+  // The maximum number of loaded queries waiting for a RANSAC worker.
+  int load_queue_depth;
+  // The maximum number of localized queries waiting to be written.
+  int result_queue_depth;
+};
+
+// A query after it passed through the pipeline.
+struct ProcessedQuery {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  int index;
+  // False if the match file could not be read.
+  bool loaded;
+  QueryMatches matches;
+  QueryResult result;
+  // The progress messages of LocalizationWorker::Solve.
+  std::string log;
+};
+
+// Called once per query, in the order of the queries.
+typedef std::function<void(const localization_io::QueryData& query,
+                           const ProcessedQuery& processed)>
+    QueryConsumer;
+
+// Localizes all queries in a pipeline of three stages connected by bounded
+// queues: Loader threads read the match files, worker tasks on the default
+// executor (each with its own LocalizationWorker) run LO-MSAC, and the
+// calling thread passes the results to consume in the order of the queries.
+// Loading thus overlaps with RANSAC, and writing the results overlaps with
+// both.
+// The number of queries in flight is limited to the sum of the queue depths
+// and the number of workers. Their buffers are recycled, i.e., the memory
+// usage does not grow with the number of queries. As the seed of a query only
+// depends on its index, the results do not depend on the stage sizes.
+// Queries before first_query are not processed, e.g., because their results
+// are already known from an earlier, interrupted run.
+void RunPipeline(const localization_io::Queries& queries,
+                 const int first_query, const LocalizationSettings& settings,
+                 const PipelineOptions& options, const QueryConsumer& consume);
+
+// Parses the optional command line arguments
+//   [num_threads] [random_seed] [num_loaders] [load_queue_depth]
+//   [result_queue_depth]
+// starting at argv[first_argument]. num_threads is the number of RANSAC
+// workers. Without a random seed, a random one is drawn. The queue depths
+// default to twice the number of workers.
+void ParsePipelineArguments(const int argc, char** argv,
+                            const int first_argument,
+                            LocalizationSettings* settings,
+                            PipelineOptions* options);
+
+// The usage string of the arguments parsed by ParsePipelineArguments.
+extern const char kPipelineArgumentsUsage[];
+
+// If the environment variable RANSACLIB_MAP names a map file, opens it as
+// store and sets settings->map to it. Otherwise, settings->map is set to
+// nullptr. Returns false if the map file cannot be opened.
+bool UseMapFromEnvironment(map_store::MapStore* store,
+                           LocalizationSettings* settings);
+
+}  // namespace batch_localization
+
+}  // namespace ransac_lib
+
+#endif  // RANSACLIB_EXAMPLE_BATCH_LOCALIZATION_H_
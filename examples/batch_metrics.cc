@@ -0,0 +1,382 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of the copyright holder nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "batch_metrics.h"
+
+namespace ransac_lib {
+
+namespace metrics {
+
+namespace {
+
+// The percentiles reported for all histograms.
+const std::vector<double> kPercentiles = {50.0, 90.0, 99.0, 99.9};
+
+inline int MostSignificantBit(const int64_t value) {
+  return 63 - __builtin_clzll(static_cast<uint64_t>(value));
+}
+
+// Escapes backslashes, double quotes, and newlines in a label value of the
+// Prometheus text format. JSON strings use the same escape sequences.
+std::string EscapeLabelValue(const std::string& value) {
+  std::string escaped;
+  for (const char c : value) {
+    if (c == '\\' || c == '"') {
+      escaped += '\\';
+      escaped += c;
+    } else if (c == '\n') {
+      escaped += "\\n";
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+std::string PercentileName(const double percentile) {
+  std::ostringstream s;
+  s << "p" << percentile;
+  return s.str();
+}
+
+// Writes a Prometheus summary with the standard percentiles. All values are
+// multiplied by scale before being written.
+void WritePrometheusSummary(const std::string& name, const std::string& help,
+                            const std::string& job, const double scale,
+                            const HdrHistogram& histogram, std::ostream* out) {
+  std::ostream& ofs = *out;
+  ofs << "# HELP " << name << " " << help << "\n";
+  ofs << "# TYPE " << name << " summary\n";
+  for (const double p : kPercentiles) {
+    ofs << name << "{job=\"" << job << "\",quantile=\"" << p / 100.0 << "\"} "
+        << static_cast<double>(histogram.ValueAtPercentile(p)) * scale << "\n";
+  }
+  ofs << name << "_sum{job=\"" << job << "\"} " << histogram.sum() * scale
+      << "\n";
+  ofs << name << "_count{job=\"" << job << "\"} " << histogram.count() << "\n";
+}
+
+// Writes a Prometheus histogram with bucket boundaries at the powers of two,
+// rounded up to the upper edges of the entries of the HdrHistogram, such that
+// the cumulative counts are exact. Boundaries above 2^sub_bucket_bits_ thus
+// are slightly larger than the powers of two, e.g., 2049 instead of 2048 for
+// 3 significant digits.
+void WritePrometheusHistogram(const std::string& name, const std::string& help,
+                              const std::string& job,
+                              const HdrHistogram& histogram,
+                              std::ostream* out) {
+  std::ostream& ofs = *out;
+  ofs << "# HELP " << name << " " << help << "\n";
+  ofs << "# TYPE " << name << " histogram\n";
+  for (int64_t p = 1; p < 2 * std::max<int64_t>(histogram.max(), 1);
+       p *= 2) {
+    const int64_t kLe = histogram.HighestEquivalentValue(p);
+    ofs << name << "_bucket{job=\"" << job << "\",le=\"" << kLe << "\"} "
+        << histogram.CountAtOrBelow(kLe) << "\n";
+  }
+  ofs << name << "_bucket{job=\"" << job << "\",le=\"+Inf\"} "
+      << histogram.count() << "\n";
+  ofs << name << "_sum{job=\"" << job << "\"} " << histogram.sum() << "\n";
+  ofs << name << "_count{job=\"" << job << "\"} " << histogram.count() << "\n";
+}
+
+void WritePrometheusGauge(const std::string& name, const std::string& help,
+                          const std::string& type, const std::string& job,
+                          const double value, std::ostream* out) {
+  std::ostream& ofs = *out;
+  ofs << "# HELP " << name << " " << help << "\n";
+  ofs << "# TYPE " << name << " " << type << "\n";
+  ofs << name << "{job=\"" << job << "\"} " << value << "\n";
+}
+
+// Writes a histogram as a JSON object. If with_buckets is true, the counts for
+// the buckets of WritePrometheusHistogram are written as well.
+void WriteJSONHistogram(const HdrHistogram& histogram, const double scale,
+                        const bool with_buckets, std::ostream* out) {
+  std::ostream& ofs = *out;
+  ofs << "{\"count\": " << histogram.count()
+      << ", \"min\": " << static_cast<double>(histogram.min()) * scale
+      << ", \"mean\": " << histogram.mean() * scale
+      << ", \"max\": " << static_cast<double>(histogram.max()) * scale;
+  for (const double p : kPercentiles) {
+    ofs << ", \"" << PercentileName(p) << "\": "
+        << static_cast<double>(histogram.ValueAtPercentile(p)) * scale;
+  }
+  if (with_buckets) {
+    ofs << ", \"buckets\": [";
+    int64_t previous = 0;
+    bool first = true;
+    for (int64_t p = 1; p < 2 * std::max<int64_t>(histogram.max(), 1);
+         p *= 2) {
+      const int64_t kLe = histogram.HighestEquivalentValue(p);
+      const int64_t kCount = histogram.CountAtOrBelow(kLe);
+      if (!first) ofs << ", ";
+      ofs << "{\"le\": " << kLe << ", \"count\": " << kCount - previous
+          << "}";
+      previous = kCount;
+      first = false;
+    }
+    ofs << "]";
+  }
+  ofs << "}";
+}
+
+}  // namespace
+
+HdrHistogram::HdrHistogram(const int64_t highest_trackable_value,
+                           const int significant_digits)
+    : highest_trackable_value_(std::max<int64_t>(highest_trackable_value, 2)) {
+  // Two values that differ by less than 1 in the significant_digits-th digit
+  // need to be stored in different entries.
+  const double kLargestSingleUnitValue =
+      2.0 * std::pow(10.0, static_cast<double>(significant_digits));
+  sub_bucket_bits_ =
+      std::max(1, static_cast<int>(std::ceil(std::log2(kLargestSingleUnitValue))));
+  sub_bucket_count_ = static_cast<int64_t>(1) << sub_bucket_bits_;
+  half_sub_bucket_count_ = sub_bucket_count_ / 2;
+  counts_.resize(BucketIndex(highest_trackable_value_) + 1);
+  Reset();
+}
+
+void HdrHistogram::Record(const int64_t value) {
+  const int64_t kValue =
+      std::min(std::max<int64_t>(value, 0), highest_trackable_value_);
+  ++counts_[BucketIndex(kValue)];
+  if (count_ == 0 || kValue < min_) min_ = kValue;
+  max_ = std::max(max_, kValue);
+  sum_ += static_cast<double>(kValue);
+  ++count_;
+}
+
+void HdrHistogram::Reset() {
+  std::fill(counts_.begin(), counts_.end(), 0);
+  count_ = 0;
+  min_ = 0;
+  max_ = 0;
+  sum_ = 0.0;
+}
+
+int64_t HdrHistogram::ValueAtPercentile(const double percentile) const {
+  if (count_ == 0) return 0;
+  const double kFraction = std::min(std::max(percentile, 0.0), 100.0) / 100.0;
+  const int64_t kTarget = std::max<int64_t>(
+      1, static_cast<int64_t>(
+             std::ceil(kFraction * static_cast<double>(count_))));
+  int64_t cumulative = 0;
+  const int kNumBuckets = static_cast<int>(counts_.size());
+  for (int i = 0; i < kNumBuckets; ++i) {
+    cumulative += counts_[i];
+    if (cumulative >= kTarget) {
+      return std::min(HighestValueOfBucket(i), max_);
+    }
+  }
+  return max_;
+}
+
+int64_t HdrHistogram::CountAtOrBelow(const int64_t value) const {
+  if (value < 0) return 0;
+  const int kLastIndex =
+      BucketIndex(std::min(value, highest_trackable_value_));
+  int64_t cumulative = 0;
+  for (int i = 0; i <= kLastIndex; ++i) cumulative += counts_[i];
+  return cumulative;
+}
+
+int HdrHistogram::BucketIndex(const int64_t value) const {
+  if (value < sub_bucket_count_) return static_cast<int>(value);
+  const int kShift = MostSignificantBit(value) - (sub_bucket_bits_ - 1);
+  const int64_t kSubIndex = (value >> kShift) - half_sub_bucket_count_;
+  return static_cast<int>(sub_bucket_count_ +
+                          (kShift - 1) * half_sub_bucket_count_ + kSubIndex);
+}
+
+int64_t HdrHistogram::HighestEquivalentValue(const int64_t value) const {
+  const int64_t kValue =
+      std::min(std::max<int64_t>(value, 0), highest_trackable_value_);
+  return HighestValueOfBucket(BucketIndex(kValue));
+}
+
+int64_t HdrHistogram::HighestValueOfBucket(const int index) const {
+  if (index < sub_bucket_count_) return index;
+  const int64_t kOffset = index - sub_bucket_count_;
+  const int kShift = static_cast<int>(kOffset / half_sub_bucket_count_) + 1;
+  const int64_t kSubIndex =
+      kOffset % half_sub_bucket_count_ + half_sub_bucket_count_;
+  return (kSubIndex << kShift) + (static_cast<int64_t>(1) << kShift) - 1;
+}
+
+BatchMetrics::BatchMetrics()
+    : latency_us_(3600ll * 1000ll * 1000ll, 3),
+      iterations_(100000000ll, 3),
+      lo_iterations_(1000000ll, 3),
+      inliers_(100000000ll, 3),
+      num_skipped_queries_(0),
+      running_(false) {
+  start_ = std::chrono::steady_clock::now();
+  stop_ = start_;
+}
+
+void BatchMetrics::Start() {
+  start_ = std::chrono::steady_clock::now();
+  running_ = true;
+}
+
+void BatchMetrics::Stop() {
+  stop_ = std::chrono::steady_clock::now();
+  running_ = false;
+}
+
+void BatchMetrics::AddQuery(const double ransac_seconds,
+                            const uint32_t num_iterations,
+                            const int num_lo_iterations,
+                            const int num_inliers) {
+  latency_us_.Record(static_cast<int64_t>(std::llround(ransac_seconds * 1e6)));
+  iterations_.Record(static_cast<int64_t>(num_iterations));
+  lo_iterations_.Record(static_cast<int64_t>(num_lo_iterations));
+  inliers_.Record(static_cast<int64_t>(num_inliers));
+}
+
+void BatchMetrics::AddSkippedQuery() { ++num_skipped_queries_; }
+
+double BatchMetrics::wall_time_seconds() const {
+  const std::chrono::steady_clock::time_point kEnd =
+      running_ ? std::chrono::steady_clock::now() : stop_;
+  std::chrono::duration<double> elapsed = kEnd - start_;
+  return elapsed.count();
+}
+
+double BatchMetrics::queries_per_second() const {
+  const double kWallTime = wall_time_seconds();
+  if (kWallTime <= 0.0) return 0.0;
+  return static_cast<double>(num_queries() + num_skipped_queries_) / kWallTime;
+}
+
+int64_t BatchMetrics::PeakRSSBytes() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+  // Mac OS X reports the maximum resident set size in bytes.
+  return static_cast<int64_t>(usage.ru_maxrss);
+#else
+  // Linux reports the maximum resident set size in kilobytes.
+  return static_cast<int64_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+bool BatchMetrics::WritePrometheus(const std::string& filename,
+                                   const std::string& job) const {
+  std::ofstream ofs(filename.c_str(), std::ios::out);
+  if (!ofs.is_open()) {
+    std::cerr << " ERROR: Cannot write the metrics to " << filename
+              << std::endl;
+    return false;
+  }
+  ofs << std::setprecision(9);
+  const std::string kJob = EscapeLabelValue(job);
+
+  WritePrometheusSummary("ransaclib_ransac_latency_seconds",
+                         "Run-time of RANSAC per query.", kJob, 1e-6,
+                         latency_us_, &ofs);
+  WritePrometheusHistogram("ransaclib_ransac_iterations",
+                           "Number of RANSAC iterations per query.", kJob,
+                           iterations_, &ofs);
+  WritePrometheusHistogram("ransaclib_ransac_lo_iterations",
+                           "Number of local optimization stages per query.",
+                           kJob, lo_iterations_, &ofs);
+  WritePrometheusHistogram("ransaclib_ransac_inliers",
+                           "Number of inliers found per query.", kJob,
+                           inliers_, &ofs);
+  WritePrometheusGauge("ransaclib_queries_total",
+                       "Number of queries processed by RANSAC.", "counter",
+                       kJob, static_cast<double>(num_queries()), &ofs);
+  WritePrometheusGauge("ransaclib_skipped_queries_total",
+                       "Number of queries for which RANSAC was not run.",
+                       "counter", kJob,
+                       static_cast<double>(num_skipped_queries_), &ofs);
+  WritePrometheusGauge("ransaclib_batch_wall_time_seconds",
+                       "Wall-clock time of the batch.", "gauge", kJob,
+                       wall_time_seconds(), &ofs);
+  WritePrometheusGauge("ransaclib_queries_per_second",
+                       "Number of queries processed per second.", "gauge", kJob,
+                       queries_per_second(), &ofs);
+  WritePrometheusGauge("ransaclib_peak_rss_bytes",
+                       "Peak resident set size of the process.", "gauge", kJob,
+                       static_cast<double>(PeakRSSBytes()), &ofs);
+
+  ofs.close();
+  return true;
+}
+
+bool BatchMetrics::WriteJSON(const std::string& filename,
+                             const std::string& job) const {
+  std::ofstream ofs(filename.c_str(), std::ios::out);
+  if (!ofs.is_open()) {
+    std::cerr << " ERROR: Cannot write the metrics to " << filename
+              << std::endl;
+    return false;
+  }
+  ofs << std::setprecision(9);
+
+  ofs << "{\n";
+  ofs << "  \"job\": \"" << EscapeLabelValue(job) << "\",\n";
+  ofs << "  \"num_queries\": " << num_queries() << ",\n";
+  ofs << "  \"num_skipped_queries\": " << num_skipped_queries_ << ",\n";
+  ofs << "  \"wall_time_seconds\": " << wall_time_seconds() << ",\n";
+  ofs << "  \"queries_per_second\": " << queries_per_second() << ",\n";
+  ofs << "  \"peak_rss_bytes\": " << PeakRSSBytes() << ",\n";
+  ofs << "  \"latency_seconds\": ";
+  WriteJSONHistogram(latency_us_, 1e-6, false, &ofs);
+  ofs << ",\n  \"iterations\": ";
+  WriteJSONHistogram(iterations_, 1.0, true, &ofs);
+  ofs << ",\n  \"lo_iterations\": ";
+  WriteJSONHistogram(lo_iterations_, 1.0, true, &ofs);
+  ofs << ",\n  \"inliers\": ";
+  WriteJSONHistogram(inliers_, 1.0, false, &ofs);
+  ofs << "\n}\n";
+
+  ofs.close();
+  return true;
+}
+
+}  // namespace metrics
+
+}  // namespace ransac_lib
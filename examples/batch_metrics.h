@@ -0,0 +1,162 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of the copyright holder nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#ifndef RANSACLIB_EXAMPLE_BATCH_METRICS_H_
+#define RANSACLIB_EXAMPLE_BATCH_METRICS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ransac_lib {
+
+namespace metrics {
+
+// A histogram in the style of HdrHistogram: Values are stored in buckets
+// whose width grows exponentially with the magnitude of the value, such that
+// every recorded value can be reproduced with a fixed number of significant
+// decimal digits. Memory usage and the cost of recording a value are
+// independent of the number of recorded values.
+// Only non-negative integer values are supported. Values larger than
+// highest_trackable_value are clamped.
+class HdrHistogram {
+ public:
+  HdrHistogram(const int64_t highest_trackable_value,
+               const int significant_digits);
+
+  void Record(const int64_t value);
+
+  void Reset();
+
+  // Returns the smallest recorded value v such that percentile% of all
+  // recorded values are less than or equal to v. Returns 0 if no values have
+  // been recorded.
+  int64_t ValueAtPercentile(const double percentile) const;
+
+  // Returns the number of recorded values less than or equal to value. The
+  // count is exact only if value is the upper edge of an entry, see
+  // HighestEquivalentValue. Otherwise, it includes the recorded values up to
+  // HighestEquivalentValue(value).
+  int64_t CountAtOrBelow(const int64_t value) const;
+
+  // Returns the largest value that is stored in the same entry as value.
+  // This is value itself for small values, e.g., below 2048 for 3 significant
+  // digits, and differs from value in less significant digits otherwise.
+  int64_t HighestEquivalentValue(const int64_t value) const;
+
+  inline int64_t count() const { return count_; }
+  inline int64_t min() const { return count_ > 0 ? min_ : 0; }
+  inline int64_t max() const { return max_; }
+  inline double sum() const { return sum_; }
+  inline double mean() const {
+    return count_ > 0 ? sum_ / static_cast<double>(count_) : 0.0;
+  }
+
+ protected:
+  int BucketIndex(const int64_t value) const;
+  // The largest value that is mapped to the bucket with the given index.
+  int64_t HighestValueOfBucket(const int index) const;
+
+  int64_t highest_trackable_value_;
+  // Values smaller than sub_bucket_count_ are stored exactly. Larger values
+  // are stored in buckets of half_sub_bucket_count_ entries each, where the
+  // width of the entries doubles from bucket to bucket.
+  int sub_bucket_bits_;
+  int64_t sub_bucket_count_;
+  int64_t half_sub_bucket_count_;
+  std::vector<int64_t> counts_;
+  int64_t count_;
+  int64_t min_;
+  int64_t max_;
+  double sum_;
+};
+
+// Collects statistics over a batch of queries processed by RANSAC and exports
+// them as a Prometheus text-format file or as a JSON file. The following
+// metrics are collected:
+//  - A histogram of the RANSAC run-times (with microsecond resolution).
+//  - The number of queries processed per second (over the wall-clock time of
+//    the batch, i.e., including I/O).
+//  - Histograms of the number of RANSAC iterations and of the number of
+//    local optimization stages.
+//  - The peak resident set size of the process.
+class BatchMetrics {
+ public:
+  BatchMetrics();
+
+  // Marks the start and the end of the batch. Used to compute the throughput.
+  void Start();
+  void Stop();
+
+  // Adds the statistics of a single RANSAC run.
+  void AddQuery(const double ransac_seconds, const uint32_t num_iterations,
+                const int num_lo_iterations, const int num_inliers);
+
+  // Counts a query for which RANSAC was not run, e.g., because there were not
+  // enough matches.
+  void AddSkippedQuery();
+
+  // Writes all metrics in the Prometheus text exposition format. All metric
+  // names are prefixed by "ransaclib_" and labeled with the given job name.
+  bool WritePrometheus(const std::string& filename,
+                       const std::string& job) const;
+
+  // Writes all metrics as a single JSON object.
+  bool WriteJSON(const std::string& filename, const std::string& job) const;
+
+  // Returns the peak resident set size of the current process in bytes.
+  static int64_t PeakRSSBytes();
+
+  inline int64_t num_queries() const { return latency_us_.count(); }
+  inline int64_t num_skipped_queries() const { return num_skipped_queries_; }
+  double wall_time_seconds() const;
+  double queries_per_second() const;
+  inline const HdrHistogram& latency_us() const { return latency_us_; }
+  inline const HdrHistogram& iterations() const { return iterations_; }
+  inline const HdrHistogram& lo_iterations() const { return lo_iterations_; }
+  inline const HdrHistogram& inliers() const { return inliers_; }
+
+ protected:
+  HdrHistogram latency_us_;
+  HdrHistogram iterations_;
+  HdrHistogram lo_iterations_;
+  HdrHistogram inliers_;
+  int64_t num_skipped_queries_;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point stop_;
+  bool running_;
+};
+
+}  // namespace metrics
+
+}  // namespace ransac_lib
+
+#endif  // RANSACLIB_EXAMPLE_BATCH_METRICS_H_
@@ -0,0 +1,199 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// Creates a map file (see map_store.h) that stores the 3D points of a scene
+// once, such that the match files of the queries only need to reference the
+// points by their IDs. The map is either created from a text file containing
+// one point "X Y Z" per line, where the ID of a point is the index of its
+// line among all non-empty lines, or from existing match files. In the latter
+// case, all 3D points with identical coordinates are merged into a single map
+// point and every match file is rewritten in the format
+//   x y point_id
+// read by localization_io::LoadIdMatches.
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "calibrated_absolute_pose_estimator.h"
+#include "localization_io.h"
+#include "map_store.h"
+
+namespace {
+
+using ransac_lib::calibrated_absolute_pose::Points2D;
+using ransac_lib::calibrated_absolute_pose::Points3D;
+
+// Identifies a 3D point by the bit patterns of its coordinates, i.e., only
+// points with exactly the same coordinates are merged.
+struct PointKey {
+  uint64_t bits[3];
+
+  explicit PointKey(const Eigen::Vector3d& p) {
+    for (int d = 0; d < 3; ++d) std::memcpy(&bits[d], &p[d], sizeof(double));
+  }
+
+  bool operator==(const PointKey& other) const {
+    return bits[0] == other.bits[0] && bits[1] == other.bits[1] &&
+           bits[2] == other.bits[2];
+  }
+};
+
+struct PointKeyHash {
+  size_t operator()(const PointKey& key) const {
+    uint64_t hash = 14695981039346656037ull;
+    for (int d = 0; d < 3; ++d) {
+      hash ^= key.bits[d];
+      hash *= 1099511628211ull;
+      hash ^= hash >> 29;
+    }
+    return static_cast<size_t>(hash);
+  }
+};
+
+bool LoadPoints(const std::string& filename, Points3D* points3D) {
+  std::ifstream ifs(filename.c_str(), std::ios::in);
+  if (!ifs.is_open()) {
+    std::cerr << " ERROR: Cannot read the points from " << filename
+              << std::endl;
+    return false;
+  }
+  points3D->clear();
+  std::string line;
+  int line_number = 0;
+  while (std::getline(ifs, line)) {
+    ++line_number;
+    if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+    std::stringstream s_stream(line);
+    Eigen::Vector3d p;
+    if (!(s_stream >> p[0] >> p[1] >> p[2])) {
+      std::cerr << " ERROR: Cannot parse line " << line_number << " of "
+                << filename << std::endl;
+      return false;
+    }
+    points3D->push_back(p);
+  }
+  return true;
+}
+
+// Replaces the 3D points of the matches by the IDs of the corresponding map
+// points, which are added to the map if they are not part of it yet.
+bool ConvertMatches(const std::string& input, const std::string& output,
+                    std::unordered_map<PointKey, uint32_t, PointKeyHash>* ids,
+                    Points3D* map_points, uint64_t* num_matches) {
+  Points2D points2D;
+  Points3D points3D;
+  if (!ransac_lib::localization_io::LoadMatches(input, false, &points2D,
+                                                &points3D)) {
+    return false;
+  }
+
+  std::ofstream ofs(output.c_str(), std::ios::out);
+  if (!ofs.is_open()) {
+    std::cerr << " ERROR: Cannot write to " << output << std::endl;
+    return false;
+  }
+  // Writes the 2D positions such that they are read back exactly.
+  ofs << std::setprecision(std::numeric_limits<double>::max_digits10);
+  const int kNumMatches = static_cast<int>(points2D.size());
+  *num_matches += static_cast<uint64_t>(kNumMatches);
+  for (int i = 0; i < kNumMatches; ++i) {
+    const uint32_t kNextId = static_cast<uint32_t>(map_points->size());
+    const auto kInserted = ids->emplace(PointKey(points3D[i]), kNextId);
+    if (kInserted.second) map_points->push_back(points3D[i]);
+    ofs << points2D[i][0] << " " << points2D[i][1] << " "
+        << kInserted.first->second << "\n";
+  }
+  ofs.close();
+  if (!ofs) {
+    std::cerr << " ERROR: Failed to write " << output << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::cout << " usage: " << argv[0] << " points.txt map.bin" << std::endl;
+  std::cout << "    or: " << argv[0] << " --from-matches list input_postfix "
+            << "output_postfix map.bin" << std::endl;
+  std::cout << "  where list contains one file name prefix (e.g., the query "
+            << "name) per line as first entry" << std::endl;
+  if (argc < 3) return -1;
+
+  Points3D map_points;
+  std::string map_file;
+  if (std::string(argv[1]) == "--from-matches") {
+    if (argc < 6) return -1;
+    map_file = argv[5];
+    std::ifstream ifs(argv[2], std::ios::in);
+    if (!ifs.is_open()) {
+      std::cerr << " ERROR: Cannot read the list " << argv[2] << std::endl;
+      return -1;
+    }
+    std::unordered_map<PointKey, uint32_t, PointKeyHash> ids;
+    int num_converted = 0, num_failed = 0;
+    uint64_t num_matches = 0u;
+    std::string line;
+    while (std::getline(ifs, line)) {
+      std::stringstream s_stream(line);
+      std::string prefix;
+      if (!(s_stream >> prefix)) continue;
+      if (ConvertMatches(prefix + argv[3], prefix + argv[4], &ids,
+                         &map_points, &num_matches)) {
+        ++num_converted;
+      } else {
+        ++num_failed;
+      }
+    }
+    std::cout << " Converted " << num_converted << " files with "
+              << num_matches << " matches, " << num_failed << " failed"
+              << std::endl;
+    if (num_failed > 0) return -1;
+  } else {
+    map_file = argv[2];
+    if (!LoadPoints(argv[1], &map_points)) return -1;
+  }
+
+  if (!ransac_lib::map_store::WriteMapFile(map_file, map_points)) return -1;
+  std::cout << " Wrote " << map_points.size() << " points to " << map_file
+            << std::endl;
+  return 0;
+}
@@ -28,6 +28,7 @@
 //
 // author: Torsten Sattler, torsten.sattler.de@googlemail.com
 
+#include <cmath>
 #include <iostream>
 
 #include <ceres/ceres.h>
@@ -35,6 +36,7 @@
 #include <Eigen/StdVector>
 
 #include "calibrated_absolute_pose_estimator.h"
+#include "reprojection_kernels.h"
 
 namespace ransac_lib {
 
@@ -96,6 +98,86 @@ struct NormalizedReprojectionError {
   double f_y;
 };
 
+// The reprojection errors of all points of a sample as a single cost
+// function. The residuals and Jacobians are computed by automatic
+// differentiation of NormalizedReprojectionError, i.e., they are the same as
+// for one AutoDiffCostFunction per point, but neither a cost function nor a
+// residual block needs to be created per point. The sample data, stored as
+// (x, y, X, Y, Z) per point, is not owned. If sqrt_weights is not null, the
+// residuals and Jacobians of the i-th point are scaled by sqrt_weights[i].
+class SampleReprojectionError : public ceres::CostFunction {
+ public:
+  SampleReprojectionError(const double* points, const int num_points,
+                          const double fx, const double fy,
+                          const double* sqrt_weights = nullptr)
+      : points_(points),
+        num_points_(num_points),
+        f_x_(fx),
+        f_y_(fy),
+        sqrt_weights_(sqrt_weights) {
+    set_num_residuals(2 * num_points);
+    mutable_parameter_block_sizes()->push_back(6);
+  }
+
+  bool Evaluate(double const* const* parameters, double* residuals,
+                double** jacobians) const override {
+    typedef ceres::Jet<double, 6> Jet;
+    const double* kCamera = parameters[0];
+    const bool kComputeJacobian =
+        jacobians != nullptr && jacobians[0] != nullptr;
+    Jet camera[6];
+    for (int k = 0; k < 6; ++k) camera[k] = Jet(kCamera[k], k);
+
+    for (int i = 0; i < num_points_; ++i) {
+      const double* p = points_ + 5 * i;
+      const NormalizedReprojectionError kError(p[0], p[1], p[2], p[3], p[4],
+                                               f_x_, f_y_);
+      if (!kComputeJacobian) {
+        if (!kError(kCamera, residuals + 2 * i)) return false;
+        if (sqrt_weights_ != nullptr) {
+          residuals[2 * i] *= sqrt_weights_[i];
+          residuals[2 * i + 1] *= sqrt_weights_[i];
+        }
+        continue;
+      }
+      Jet jet_residuals[2];
+      if (!kError(camera, jet_residuals)) return false;
+      const double kScale = sqrt_weights_ != nullptr ? sqrt_weights_[i] : 1.0;
+      for (int r = 0; r < 2; ++r) {
+        residuals[2 * i + r] = kScale * jet_residuals[r].a;
+        double* jacobian_row = jacobians[0] + (2 * i + r) * 6;
+        for (int k = 0; k < 6; ++k) {
+          jacobian_row[k] = kScale * jet_residuals[r].v[k];
+        }
+      }
+    }
+    return true;
+  }
+
+ private:
+  const double* points_;
+  int num_points_;
+  double f_x_;
+  double f_y_;
+  const double* sqrt_weights_;
+};
+
+void MatchArrays::Assign(const Points2D& points2D, const Points3D& points3D) {
+  const size_t kNumData = points2D.size();
+  X.resize(kNumData);
+  Y.resize(kNumData);
+  Z.resize(kNumData);
+  x.resize(kNumData);
+  y.resize(kNumData);
+  for (size_t i = 0; i < kNumData; ++i) {
+    X[i] = points3D[i][0];
+    Y[i] = points3D[i][1];
+    Z[i] = points3D[i][2];
+    x[i] = points2D[i][0];
+    y[i] = points2D[i][1];
+  }
+}
+
 CalibratedAbsolutePoseEstimator::CalibratedAbsolutePoseEstimator(
     const double f_x, const double f_y, const double squared_inlier_threshold,
     const Points2D& points2D, const ViewingRays& rays, const Points3D& points3D)
@@ -104,6 +186,22 @@ CalibratedAbsolutePoseEstimator::CalibratedAbsolutePoseEstimator(
       squared_inlier_threshold_(squared_inlier_threshold),
       points2D_(points2D),
       points3D_(points3D),
+      arrays_(&owned_arrays_),
+      adapter_(rays, points3D) {
+  num_data_ = static_cast<int>(points2D_.size());
+  owned_arrays_.Assign(points2D_, points3D_);
+}
+
+CalibratedAbsolutePoseEstimator::CalibratedAbsolutePoseEstimator(
+    const double f_x, const double f_y, const double squared_inlier_threshold,
+    const Points2D& points2D, const ViewingRays& rays, const Points3D& points3D,
+    const MatchArrays& arrays)
+    : focal_x_(f_x),
+      focal_y_(f_y),
+      squared_inlier_threshold_(squared_inlier_threshold),
+      points2D_(points2D),
+      points3D_(points3D),
+      arrays_(&arrays),
       adapter_(rays, points3D) {
   num_data_ = static_cast<int>(points2D_.size());
 }
@@ -155,25 +253,97 @@ int CalibratedAbsolutePoseEstimator::NonMinimalSolver(
 //   return 1;
 }
 
+int CalibratedAbsolutePoseEstimator::NonMinimalSolver(
+    const std::vector<int>& sample, CameraPose* pose,
+    SolverContext* context) const {
+  CameraPoses poses;
+  if (MinimalSolver(sample, &poses) == 1) {
+    *pose = poses[0];
+    LeastSquares(sample, pose, context);
+    return 1;
+  } else {
+    return 0;
+  }
+}
+
 // Evaluates the pose on the i-th data point.
+// The operations are written out explicitly and in the same order as in the
+// vectorized kernel used by EvaluateModelOnPoints, such that both produce
+// identical results.
 double CalibratedAbsolutePoseEstimator::EvaluateModelOnPoint(
     const CameraPose& pose, int i) const {
-  Eigen::Vector3d p_c =
-      pose.topLeftCorner<3, 3>() * (points3D_[i] - pose.col(3));
+  const double kDX = points3D_[i][0] - pose(0, 3);
+  const double kDY = points3D_[i][1] - pose(1, 3);
+  const double kDZ = points3D_[i][2] - pose(2, 3);
+  const double kPX = pose(0, 0) * kDX + pose(0, 1) * kDY + pose(0, 2) * kDZ;
+  const double kPY = pose(1, 0) * kDX + pose(1, 1) * kDY + pose(1, 2) * kDZ;
+  const double kPZ = pose(2, 0) * kDX + pose(2, 1) * kDY + pose(2, 2) * kDZ;
 
   // Check whether point projects behind the camera.
-  if (p_c[2] < 0.0) return std::numeric_limits<double>::max();
+  if (kPZ < 0.0) return std::numeric_limits<double>::max();
 
-  Eigen::Vector2d p_2d = p_c.head<2>() / p_c[2];
-  p_2d[0] *= focal_x_;
-  p_2d[1] *= focal_y_;
+  const double kEX = kPX / kPZ * focal_x_ - points2D_[i][0];
+  const double kEY = kPY / kPZ * focal_y_ - points2D_[i][1];
+  return kEX * kEX + kEY * kEY;
+}
 
-  return (p_2d - points2D_[i]).squaredNorm();
+void CalibratedAbsolutePoseEstimator::EvaluateModelOnPoints(
+    const CameraPose& pose, double* squared_errors) const {
+  double R[9];
+  for (int row = 0; row < 3; ++row) {
+    for (int col = 0; col < 3; ++col) R[row * 3 + col] = pose(row, col);
+  }
+  const double c[3] = {pose(0, 3), pose(1, 3), pose(2, 3)};
+  kernels::ReprojectionData data;
+  data.X = arrays_->X.data();
+  data.Y = arrays_->Y.data();
+  data.Z = arrays_->Z.data();
+  data.x = arrays_->x.data();
+  data.y = arrays_->y.data();
+  data.num_points = num_data_;
+  kernels::SquaredReprojectionErrors(R, c, focal_x_, focal_y_, data,
+                                     squared_errors);
 }
 
 // Reference implementation using Ceres for refinement.
 void CalibratedAbsolutePoseEstimator::LeastSquares(
     const std::vector<int>& sample, CameraPose* pose) const {
+  ScratchArena arena(5u * sizeof(double) * sample.size() + 64u);
+  SolverContext context = {&arena};
+  LeastSquares(sample, pose, &context);
+}
+
+void CalibratedAbsolutePoseEstimator::LeastSquares(
+    const std::vector<int>& sample, CameraPose* pose,
+    SolverContext* context) const {
+  RefinePose(sample, nullptr, pose, context);
+}
+
+void CalibratedAbsolutePoseEstimator::WeightedLeastSquares(
+    const std::vector<int>& sample, const std::vector<double>& weights,
+    CameraPose* pose) const {
+  ScratchArena arena(6u * sizeof(double) * sample.size() + 128u);
+  SolverContext context = {&arena};
+  WeightedLeastSquares(sample, weights, pose, &context);
+}
+
+void CalibratedAbsolutePoseEstimator::WeightedLeastSquares(
+    const std::vector<int>& sample, const std::vector<double>& weights,
+    CameraPose* pose, SolverContext* context) const {
+  const int kSampleSize = static_cast<int>(sample.size());
+  double* sqrt_weights = context->arena->Allocate<double>(kSampleSize);
+  for (int i = 0; i < kSampleSize; ++i) {
+    sqrt_weights[i] = std::sqrt(weights[i]);
+  }
+  RefinePose(sample, sqrt_weights, pose, context);
+}
+
+void CalibratedAbsolutePoseEstimator::RefinePose(
+    const std::vector<int>& sample, const double* sqrt_weights,
+    CameraPose* pose, SolverContext* context) const {
+  const int kSampleSize = static_cast<int>(sample.size());
+  if (kSampleSize == 0) return;
+
   Eigen::AngleAxisd aax(pose->topLeftCorner<3, 3>());
   Eigen::Vector3d aax_vec = aax.axis() * aax.angle();
   double camera[6];
@@ -184,24 +354,22 @@ void CalibratedAbsolutePoseEstimator::LeastSquares(
   camera[4] = pose->col(3)[1];
   camera[5] = pose->col(3)[2];
 
-  ceres::Problem refinement_problem;
-  const int kSampleSize = static_cast<int>(sample.size());
+  double* points = context->arena->Allocate<double>(5 * kSampleSize);
   for (int i = 0; i < kSampleSize; ++i) {
     const int kIdx = sample[i];
-    const Eigen::Vector2d& p_img = points2D_[kIdx];
-    const Eigen::Vector3d& p_3D = points3D_[kIdx];
-    ceres::CostFunction* cost_function =
-        NormalizedReprojectionError::CreateCost(
-            p_img[0], p_img[1], p_3D[0], p_3D[1], p_3D[2], focal_x_, focal_y_);
-//     double error_i = std::sqrt(EvaluateModelOnPoint(*pose, sample[i]));
-//     error_i = std::max(0.00001, error_i);
-    refinement_problem.AddResidualBlock(cost_function, nullptr, camera);
-//     refinement_problem.AddResidualBlock(cost_function,
-//                                         new ceres::ScaledLoss(nullptr,
-//                                                               1.0 / error_i,
-//                                                               ceres::DO_NOT_TAKE_OWNERSHIP),
-//                                         camera);
+    points[5 * i] = arrays_->x[kIdx];
+    points[5 * i + 1] = arrays_->y[kIdx];
+    points[5 * i + 2] = arrays_->X[kIdx];
+    points[5 * i + 3] = arrays_->Y[kIdx];
+    points[5 * i + 4] = arrays_->Z[kIdx];
   }
+  SampleReprojectionError cost_function(points, kSampleSize, focal_x_,
+                                        focal_y_, sqrt_weights);
+
+  ceres::Problem::Options problem_options;
+  problem_options.cost_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  ceres::Problem refinement_problem(problem_options);
+  refinement_problem.AddResidualBlock(&cost_function, nullptr, camera);
 
   ceres::Solver::Options options;
   options.linear_solver_type = ceres::DENSE_QR;
@@ -47,6 +47,8 @@
 #include <opengv/absolute_pose/methods.hpp>
 #include <opengv/types.hpp>
 
+#include <RansacLib/scratch_arena.h>
+
 namespace ransac_lib {
 
 namespace calibrated_absolute_pose {
@@ -61,6 +63,19 @@ typedef std::vector<Eigen::Vector2d> Points2D;
 typedef std::vector<Vector3d, Eigen::aligned_allocator<Vector3d>> Points3D;
 typedef std::vector<Vector3d, Eigen::aligned_allocator<Vector3d>> ViewingRays;
 
+// Structure-of-arrays layout of the matches, used by EvaluateModelOnPoints to
+// evaluate a pose on all matches at once. Building it once per query and
+// passing it to the estimator avoids a copy of the matches per estimator.
+struct MatchArrays {
+  void Assign(const Points2D& points2D, const Points3D& points3D);
+
+  std::vector<double> X;
+  std::vector<double> Y;
+  std::vector<double> Z;
+  std::vector<double> x;
+  std::vector<double> y;
+};
+
 // Implements a camera pose solver for calibrated cameras. Uses the OpenGV
 // implementations of the P3P and EPnP solvers, as well as for non-linear
 // optimization.
@@ -81,11 +96,25 @@ class CalibratedAbsolutePoseEstimator {
   // In addition, the squared inlier threshold used by *SAC is required as
   // input. It is used to pick at most one of the up to 4 solutions created by
   // the P3P solver.
+  // The estimator does not copy the matches, i.e., the 2D points, rays, and
+  // 3D points need to outlive it.
   CalibratedAbsolutePoseEstimator(const double f_x, const double f_y,
                                   const double squared_inlier_threshold,
                                   const Points2D& points2D,
                                   const ViewingRays& rays,
                                   const Points3D& points3D);
+  // Same as above, but uses the given structure-of-arrays layout of points2D
+  // and points3D instead of building its own. arrays needs to outlive the
+  // estimator.
+  CalibratedAbsolutePoseEstimator(const double f_x, const double f_y,
+                                  const double squared_inlier_threshold,
+                                  const Points2D& points2D,
+                                  const ViewingRays& rays,
+                                  const Points3D& points3D,
+                                  const MatchArrays& arrays);
+  // arrays_ might point to owned_arrays_.
+  CalibratedAbsolutePoseEstimator(const CalibratedAbsolutePoseEstimator&) =
+      delete;
 
   inline int min_sample_size() const { return 4; }
 
@@ -100,25 +129,58 @@ class CalibratedAbsolutePoseEstimator {
   // Returns 0 if no model could be estimated and 1 otherwise.
   // Implemented by a simple linear least squares solver.
   int NonMinimalSolver(const std::vector<int>& sample, CameraPose* pose) const;
+  int NonMinimalSolver(const std::vector<int>& sample, CameraPose* pose,
+                       SolverContext* context) const;
 
   // Evaluates the pose on the i-th data point.
   double EvaluateModelOnPoint(const CameraPose& pose, int i) const;
 
-  // Linear least squares solver. Calls NonMinimalSolver.
+  // Evaluates the pose on all data points, using the vectorized kernel for the
+  // instruction set selected at run-time (see reprojection_kernels.h). The
+  // results are identical to those of EvaluateModelOnPoint.
+  void EvaluateModelOnPoints(const CameraPose& pose,
+                             double* squared_errors) const;
+
+  // Non-linear least squares refinement of the pose with Ceres, minimizing
+  // the reprojection errors of the sample. The variant with the solver
+  // context stores the sample data in its scratch arena and adds all
+  // residuals as a single cost function, such that only Ceres itself
+  // allocates memory.
   void LeastSquares(const std::vector<int>& sample, CameraPose* pose) const;
+  void LeastSquares(const std::vector<int>& sample, CameraPose* pose,
+                    SolverContext* context) const;
+
+  // Same as LeastSquares, but the squared reprojection error of sample[i] is
+  // weighted by weights[i]. Used by IRLSLocalOptimization (see policies.h).
+  void WeightedLeastSquares(const std::vector<int>& sample,
+                            const std::vector<double>& weights,
+                            CameraPose* pose) const;
+  void WeightedLeastSquares(const std::vector<int>& sample,
+                            const std::vector<double>& weights,
+                            CameraPose* pose, SolverContext* context) const;
 
   static void PixelsToViewingRays(const double focal_x, const double focal_y,
                                   const Points2D& points2D, ViewingRays* rays);
 
  protected:
+  // Shared implementation of LeastSquares and WeightedLeastSquares.
+  // sqrt_weights is either null or holds one entry per sample.
+  void RefinePose(const std::vector<int>& sample, const double* sqrt_weights,
+                  CameraPose* pose, SolverContext* context) const;
+
   // Focal lengths in x- and y-directions.
   double focal_x_;
   double focal_y_;
   double squared_inlier_threshold_;
-  // Matrix holding the 2D point positions.
-  Points2D points2D_;
-  // Matrix holding the corresponding 3D point positions.
-  Points3D points3D_;
+  // The 2D point positions.
+  const Points2D& points2D_;
+  // The corresponding 3D point positions, e.g., gathered from a map store
+  // shared by all queries (see map_store.h).
+  const Points3D& points3D_;
+  // Structure-of-arrays layout of the matches used by EvaluateModelOnPoints.
+  // Points to owned_arrays_ unless it was passed to the constructor.
+  const MatchArrays* arrays_;
+  MatchArrays owned_arrays_;
   // The adapter used by OpenGV's solvers.
   opengv::absolute_pose::CentralAbsoluteAdapter adapter_;
   int num_data_;
@@ -36,6 +36,7 @@
 #include <iostream>
 #include <limits>
 #include <random>
+#include <string>
 #include <vector>
 
 #include <Eigen/Core>
@@ -48,97 +49,19 @@
 
 #include <RansacLib/ransac.h>
 #include "calibrated_absolute_pose_estimator.h"
-
-namespace ransac_lib {
-namespace calibrated_absolute_pose {
-
-void GenerateRandomInstance(const double width, const double height,
-                            const double focal_length, const int num_inliers,
-                            const int num_outliers, double inlier_threshold,
-                            const double min_depth, const double max_depth,
-                            Points2D* points2D, opengv::bearingVectors_t* rays,
-                            opengv::points_t* points3D) {
-  const int kNumPoints = num_inliers + num_outliers;
-  points2D->resize(kNumPoints);
-  points3D->resize(kNumPoints);
-
-  std::vector<int> indices(kNumPoints);
-  std::iota(indices.begin(), indices.end(), 0);
-
-  std::random_device rand_dev;
-  std::mt19937 rng(rand_dev());
-
-  std::shuffle(indices.begin(), indices.end(), rng);
-
-  const double kWidthHalf = width * 0.5;
-  const double kHeightHalf = height * 0.5;
-  std::uniform_real_distribution<double> distr_x(-kWidthHalf, kWidthHalf);
-  std::uniform_real_distribution<double> distr_y(-kHeightHalf, kHeightHalf);
-  std::uniform_real_distribution<double> distr_d(min_depth, max_depth);
-  std::uniform_real_distribution<double> distr(-1.0, 1.0);
-
-  // Generates the inliers.
-  for (int i = 0; i < num_inliers; ++i) {
-    const int kIndex = indices[i];
-    (*points2D)[kIndex] = Eigen::Vector2d(distr_x(rng), distr_y(rng));
-
-    opengv::point_t dir = (*points2D)[kIndex].homogeneous();
-    dir.head<2>() /= focal_length;
-    dir.normalize();
-
-    // Obtains the 3D point.
-    (*points3D)[kIndex] = dir * distr_d(rng);
-
-    // Adds some noise to the 2D position to make the case more realistic.
-    (*points2D)[kIndex] +=
-        Eigen::Vector2d(distr(rng), distr(rng)) * inlier_threshold;
-  }
-
-  // Generates the outlier.
-  for (int i = num_inliers; i < kNumPoints; ++i) {
-    const int kIndex = indices[i];
-    Eigen::Vector2d p(distr_x(rng), distr_y(rng));
-
-    opengv::point_t dir = p.homogeneous();
-    dir.head<2>() /= focal_length;
-    dir.normalize();
-
-    // Obtains the 3D point.
-    (*points3D)[kIndex] = dir * distr_d(rng);
-
-    // Estimates a new pixel position that is far enough from the original one.
-    (*points2D)[kIndex] = Eigen::Vector2d(distr_x(rng), distr_y(rng));
-    while (((*points2D)[kIndex] - p).norm() < 10.0 * (inlier_threshold + 1.0)) {
-      (*points2D)[kIndex] = Eigen::Vector2d(distr_x(rng), distr_y(rng));
-    }
-  }
-
-  // Randomly rotates and translates the 3D points.
-  Eigen::Quaterniond q = Eigen::Quaterniond::UnitRandom();
-  Eigen::Matrix3d R(q);
-  std::uniform_real_distribution<double> distr_scale(1.0, 2.0);
-  Eigen::Vector3d t(distr(rng), distr(rng), distr(rng));
-  t *= distr_scale(rng);
-
-  for (int i = 0; i < kNumPoints; ++i) {
-    Eigen::Vector3d p = R * (*points3D)[i] + t;
-    (*points3D)[i] = p;
-  }
-
-  CalibratedAbsolutePoseEstimator::PixelsToViewingRays(
-      focal_length, focal_length, *points2D, rays);
-}
-
-}  // namespace calibrated_absolute_pose
-}  // namespace ransac_lib
+#include "synthetic_datasets.h"
 
 int main(int argc, char** argv) {
   ransac_lib::LORansacOptions options;
   options.min_num_iterations_ = 100u;
   options.max_num_iterations_ = 100000u;
 
-  std::random_device rand_dev;
-  options.random_seed_ = rand_dev();
+  // The seed can be passed as the first argument. The same seed is used to
+  // generate the instances and for RANSAC.
+  const unsigned int kSeed =
+      argc > 1 ? static_cast<unsigned int>(std::stoul(argv[1])) : 0u;
+  options.random_seed_ = kSeed;
+  std::mt19937 rng(kSeed);
 
   // Generates random instances for outlier ratios 10%, 20%, 30%, ..., 90%,
   // and then applies RANSAC on it.
@@ -162,11 +85,13 @@ int main(int argc, char** argv) {
     int num_inliers = kNumDataPoints - num_outliers;
 
     ransac_lib::calibrated_absolute_pose::Points2D points2D;
-    opengv::bearingVectors_t rays;
-    opengv::points_t points3D;
-    ransac_lib::calibrated_absolute_pose::GenerateRandomInstance(
+    ransac_lib::calibrated_absolute_pose::ViewingRays rays;
+    ransac_lib::calibrated_absolute_pose::Points3D points3D;
+    ransac_lib::calibrated_absolute_pose::CameraPose gt_pose;
+    std::vector<int> gt_inliers;
+    ransac_lib::synthetic::GeneratePoseInstance(
         kWidth, kHeight, kFocalLength, num_inliers, num_outliers, 2.0, 2.0,
-        10.0, &points2D, &rays, &points3D);
+        10.0, &rng, &points2D, &rays, &points3D, &gt_pose, &gt_inliers);
     std::cout << "   ... instance generated" << std::endl;
 
     ransac_lib::calibrated_absolute_pose::CalibratedAbsolutePoseEstimator
@@ -0,0 +1,599 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of the copyright holder nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// Microbenchmarks for the individual components of RansacLib: the samplers,
+// the utility functions, the scoring functions and scorers, the engine
+// configurations defined in policies.h, and the solvers provided with the
+// examples. Uses Google Benchmark. All benchmarks use a
+// fixed random seed.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+#include <RansacLib/hybrid_sampling.h>
+#include <RansacLib/policies.h>
+#include <RansacLib/ransac.h>
+#include <RansacLib/sampling.h>
+#include <RansacLib/utils.h>
+#include "calibrated_absolute_pose_estimator.h"
+#include "line_estimator.h"
+
+namespace ransac_lib {
+
+namespace {
+
+const unsigned int kSeed = 42u;
+
+// A solver that only provides the information required by the samplers.
+class SamplingProblem {
+ public:
+  SamplingProblem(const int num_data, const int sample_size)
+      : num_data_(num_data), sample_size_(sample_size) {}
+
+  inline int min_sample_size() const { return sample_size_; }
+  inline int num_data() const { return num_data_; }
+
+ private:
+  int num_data_;
+  int sample_size_;
+};
+
+// Provides the information required by the hybrid samplers for two data types
+// with the same number of data points each.
+class HybridSamplingProblem {
+ public:
+  explicit HybridSamplingProblem(const int num_data) : num_data_(num_data) {}
+
+  inline void num_data(std::vector<int>* num_data) const {
+    num_data->assign(2, num_data_);
+  }
+
+  // Random positive weights, used by HybridBiasedSampling.
+  void get_weights(std::vector<std::vector<double>>& weights) const {
+    std::mt19937 rng(kSeed);
+    std::uniform_real_distribution<double> distr(0.1, 1.0);
+    weights.assign(2, std::vector<double>(num_data_));
+    for (std::vector<double>& w : weights) {
+      for (double& v : w) v = distr(rng);
+    }
+  }
+
+ private:
+  int num_data_;
+};
+
+// Exposes the two sampling strategies of UniformSampling.
+template <class Solver>
+class BenchmarkUniformSampling : public UniformSampling<Solver> {
+ public:
+  BenchmarkUniformSampling(const unsigned int random_seed,
+                           const Solver& solver)
+      : UniformSampling<Solver>(random_seed, solver) {}
+  using UniformSampling<Solver>::DrawSample;
+  using UniformSampling<Solver>::ShuffleSample;
+};
+
+// Exposes the scoring functions of LO-MSAC.
+template <class Model, class ModelVector, class Solver,
+          class Policies = LOMSACPolicies>
+class BenchmarkLOMSAC
+    : public LocallyOptimizedMSAC<Model, ModelVector, Solver,
+                                  UniformSampling<Solver>, Policies> {
+ public:
+  typedef LocallyOptimizedMSAC<Model, ModelVector, Solver,
+                               UniformSampling<Solver>, Policies>
+      Base;
+  using Base::ScoreModel;
+  using Base::GetInliers;
+};
+
+// Generates a line instance with 50% outliers. The inliers are
+// (approximately) on the x-axis.
+Eigen::Matrix2Xd GenerateLineData(const int num_data) {
+  std::mt19937 rng(kSeed);
+  std::uniform_real_distribution<double> distr_x(0.0, 1.0);
+  std::uniform_real_distribution<double> distr_y(-0.5, 0.5);
+  std::uniform_real_distribution<double> distr_noise(-0.005, 0.005);
+  Eigen::Matrix2Xd data(2, num_data);
+  for (int i = 0; i < num_data; ++i) {
+    data(0, i) = distr_x(rng);
+    data(1, i) = (i % 2 == 0) ? distr_noise(rng) : distr_y(rng);
+  }
+  return data;
+}
+
+// Generates 2D-3D matches for a camera with identity pose. 50% of the matches
+// are outliers.
+void GeneratePoseData(const int num_data, const double focal_length,
+                      calibrated_absolute_pose::Points2D* points2D,
+                      calibrated_absolute_pose::ViewingRays* rays,
+                      calibrated_absolute_pose::Points3D* points3D) {
+  std::mt19937 rng(kSeed);
+  std::uniform_real_distribution<double> distr_x(-320.0, 320.0);
+  std::uniform_real_distribution<double> distr_y(-160.0, 160.0);
+  std::uniform_real_distribution<double> distr_d(2.0, 10.0);
+  std::uniform_real_distribution<double> distr(-1.0, 1.0);
+  points2D->resize(num_data);
+  points3D->resize(num_data);
+  for (int i = 0; i < num_data; ++i) {
+    Eigen::Vector2d p(distr_x(rng), distr_y(rng));
+    Eigen::Vector3d dir = p.homogeneous();
+    dir.head<2>() /= focal_length;
+    (*points3D)[i] = dir.normalized() * distr_d(rng);
+    if (i % 2 == 0) {
+      (*points2D)[i] = p + Eigen::Vector2d(distr(rng), distr(rng));
+    } else {
+      (*points2D)[i] = Eigen::Vector2d(distr_x(rng), distr_y(rng));
+    }
+  }
+  calibrated_absolute_pose::CalibratedAbsolutePoseEstimator::
+      PixelsToViewingRays(focal_length, focal_length, *points2D, rays);
+}
+
+// Arguments are (N, sample size).
+void SamplingArguments(benchmark::internal::Benchmark* b) {
+  for (const int kN : {10, 100, 1000, 10000, 100000}) {
+    for (const int kSampleSize : {2, 4, 8, 16}) {
+      if (kSampleSize < kN) b->Args({kN, kSampleSize});
+    }
+  }
+}
+
+// Arguments are (N).
+void DataArguments(benchmark::internal::Benchmark* b) {
+  for (const int kN : {100, 1000, 10000, 100000}) b->Args({kN});
+}
+
+// Arguments are (N, sample size) for least squares fits.
+void LeastSquaresArguments(benchmark::internal::Benchmark* b) {
+  for (const int kSampleSize : {6, 14, 28, 100, 1000}) {
+    b->Args({10000, kSampleSize});
+  }
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// Samplers.
+////////////////////////////////////////////////////////////////////////////////
+
+static void BM_UniformSampling_Draw(benchmark::State& state) {
+  SamplingProblem problem(static_cast<int>(state.range(0)),
+                          static_cast<int>(state.range(1)));
+  BenchmarkUniformSampling<SamplingProblem> sampler(kSeed, problem);
+  std::vector<int> sample;
+  for (auto _ : state) {
+    sampler.DrawSample(&sample);
+    benchmark::DoNotOptimize(sample.data());
+  }
+}
+BENCHMARK(BM_UniformSampling_Draw)->Apply(SamplingArguments);
+
+static void BM_UniformSampling_Shuffle(benchmark::State& state) {
+  SamplingProblem problem(static_cast<int>(state.range(0)),
+                          static_cast<int>(state.range(1)));
+  BenchmarkUniformSampling<SamplingProblem> sampler(kSeed, problem);
+  std::vector<int> sample;
+  for (auto _ : state) {
+    sampler.ShuffleSample(&sample);
+    benchmark::DoNotOptimize(sample.data());
+  }
+}
+BENCHMARK(BM_UniformSampling_Shuffle)->Apply(SamplingArguments);
+
+// Uses the strategy selected by UniformSampling itself.
+static void BM_UniformSampling_Sample(benchmark::State& state) {
+  SamplingProblem problem(static_cast<int>(state.range(0)),
+                          static_cast<int>(state.range(1)));
+  UniformSampling<SamplingProblem> sampler(kSeed, problem);
+  std::vector<int> sample;
+  for (auto _ : state) {
+    sampler.Sample(&sample);
+    benchmark::DoNotOptimize(sample.data());
+  }
+}
+BENCHMARK(BM_UniformSampling_Sample)->Apply(SamplingArguments);
+
+// The sample size is split evenly among both data types.
+static void BM_HybridUniformSampling(benchmark::State& state) {
+  HybridSamplingProblem problem(static_cast<int>(state.range(0)));
+  HybridUniformSampling<HybridSamplingProblem> sampler(kSeed, problem);
+  const int kSampleSize = static_cast<int>(state.range(1));
+  std::vector<int> sample_sizes = {kSampleSize / 2,
+                                   kSampleSize - kSampleSize / 2};
+  std::vector<std::vector<int>> sample;
+  for (auto _ : state) {
+    sampler.Sample(sample_sizes, &sample);
+    benchmark::DoNotOptimize(sample.data());
+  }
+}
+BENCHMARK(BM_HybridUniformSampling)->Apply(SamplingArguments);
+
+static void BM_HybridBiasedSampling(benchmark::State& state) {
+  HybridSamplingProblem problem(static_cast<int>(state.range(0)));
+  HybridBiasedSampling<HybridSamplingProblem> sampler(kSeed, problem);
+  const int kSampleSize = static_cast<int>(state.range(1));
+  std::vector<int> sample_sizes = {kSampleSize / 2,
+                                   kSampleSize - kSampleSize / 2};
+  std::vector<std::vector<int>> sample;
+  for (auto _ : state) {
+    sampler.Sample(sample_sizes, &sample);
+    benchmark::DoNotOptimize(sample.data());
+  }
+}
+BENCHMARK(BM_HybridBiasedSampling)->Apply(SamplingArguments);
+
+////////////////////////////////////////////////////////////////////////////////
+// Utility functions.
+////////////////////////////////////////////////////////////////////////////////
+
+// Note that the time includes copying the N indices, which is required as
+// RandomShuffleAndResize shrinks its input.
+static void BM_RandomShuffleAndResize(benchmark::State& state) {
+  const int kN = static_cast<int>(state.range(0));
+  const int kSampleSize = static_cast<int>(state.range(1));
+  std::vector<int> indices(kN);
+  std::iota(indices.begin(), indices.end(), 0);
+  std::mt19937 rng(kSeed);
+  std::vector<int> sample;
+  sample.reserve(kN);
+  for (auto _ : state) {
+    sample = indices;
+    utils::RandomShuffleAndResize(kSampleSize, &rng, &sample);
+    benchmark::DoNotOptimize(sample.data());
+  }
+}
+BENCHMARK(BM_RandomShuffleAndResize)->Apply(SamplingArguments);
+
+// Arguments are the inlier ratio in percent and the sample size.
+static void BM_NumRequiredIterations(benchmark::State& state) {
+  const double kInlierRatio = static_cast<double>(state.range(0)) / 100.0;
+  const int kSampleSize = static_cast<int>(state.range(1));
+  for (auto _ : state) {
+    uint32_t num_iterations = utils::NumRequiredIterations(
+        kInlierRatio, 1.0 - 0.9999, kSampleSize, 100u, 100000u);
+    benchmark::DoNotOptimize(num_iterations);
+  }
+}
+BENCHMARK(BM_NumRequiredIterations)
+    ->ArgsProduct({{1, 10, 50, 90}, {2, 4, 8, 16}});
+
+////////////////////////////////////////////////////////////////////////////////
+// Scoring.
+////////////////////////////////////////////////////////////////////////////////
+
+static void BM_ScoreModel_Line(benchmark::State& state) {
+  const int kN = static_cast<int>(state.range(0));
+  LineEstimator solver(GenerateLineData(kN));
+  BenchmarkLOMSAC<Eigen::Vector3d, std::vector<Eigen::Vector3d>, LineEstimator>
+      lomsac;
+  const Eigen::Vector3d kLine(0.0, 1.0, 0.0);
+  for (auto _ : state) {
+    double score = 0.0;
+    lomsac.ScoreModel(solver, kLine, 0.01 * 0.01, &score);
+    benchmark::DoNotOptimize(score);
+  }
+  state.SetItemsProcessed(state.iterations() * kN);
+}
+BENCHMARK(BM_ScoreModel_Line)->Apply(DataArguments);
+
+static void BM_GetInliers_Line(benchmark::State& state) {
+  const int kN = static_cast<int>(state.range(0));
+  LineEstimator solver(GenerateLineData(kN));
+  BenchmarkLOMSAC<Eigen::Vector3d, std::vector<Eigen::Vector3d>, LineEstimator>
+      lomsac;
+  const Eigen::Vector3d kLine(0.0, 1.0, 0.0);
+  std::vector<int> inliers;
+  for (auto _ : state) {
+    int num_inliers =
+        lomsac.GetInliers(solver, kLine, 0.01 * 0.01, &inliers);
+    benchmark::DoNotOptimize(num_inliers);
+  }
+  state.SetItemsProcessed(state.iterations() * kN);
+}
+BENCHMARK(BM_GetInliers_Line)->Apply(DataArguments);
+
+// Evaluates and scores a pose with the scorer of the given policies.
+template <class Policies>
+static void BM_ScoreModel_Pose(benchmark::State& state) {
+  using calibrated_absolute_pose::CalibratedAbsolutePoseEstimator;
+  using calibrated_absolute_pose::CameraPose;
+  using calibrated_absolute_pose::CameraPoses;
+  const int kN = static_cast<int>(state.range(0));
+  const double kFocalLength = 320.0 / std::tan(60.0 * M_PI / 180.0);
+  calibrated_absolute_pose::Points2D points2D;
+  calibrated_absolute_pose::ViewingRays rays;
+  calibrated_absolute_pose::Points3D points3D;
+  GeneratePoseData(kN, kFocalLength, &points2D, &rays, &points3D);
+  CalibratedAbsolutePoseEstimator solver(kFocalLength, kFocalLength, 144.0,
+                                         points2D, rays, points3D);
+  BenchmarkLOMSAC<CameraPose, CameraPoses, CalibratedAbsolutePoseEstimator,
+                  Policies>
+      lomsac;
+  CameraPose pose;
+  pose.setIdentity();
+  pose.col(3).setZero();
+  for (auto _ : state) {
+    double score = 0.0;
+    lomsac.ScoreModel(solver, pose, 144.0, &score);
+    benchmark::DoNotOptimize(score);
+  }
+  state.SetItemsProcessed(state.iterations() * kN);
+}
+BENCHMARK_TEMPLATE(BM_ScoreModel_Pose, LOMSACPolicies)->Apply(DataArguments);
+BENCHMARK_TEMPLATE(BM_ScoreModel_Pose, VectorizedLOMSACPolicies)
+    ->Apply(DataArguments);
+BENCHMARK_TEMPLATE(BM_ScoreModel_Pose, MAGSACPlusPlusPolicies)
+    ->Apply(DataArguments);
+
+// Scores squared errors point by point via Scorer::Score, accumulating in a
+// single double, i.e., without the block kernels of scoring.h.
+template <class Scorer>
+struct PointwiseScorer {
+  static double ScoreErrors(const double* squared_errors, const int num_errors,
+                            const double squared_threshold) {
+    double score = 0.0;
+    for (int i = 0; i < num_errors; ++i) {
+      score += Scorer::Score(squared_errors[i], squared_threshold);
+    }
+    return score;
+  }
+};
+
+// The MAGSAC++ loss for 2 degrees of freedom evaluated from the incomplete
+// gamma functions for every data point, i.e., without the lookup tables used
+// by MAGSACPlusPlusScorer.
+struct DirectMAGSACPlusPlusScorer {
+  static double Score(const double squared_error,
+                      const double squared_threshold) {
+    static const double kSqK = scoring::ChiSquareQuantile(2, 0.99);
+    if (!(squared_error < squared_threshold)) return squared_threshold;
+    const double kXk = 0.5 * kSqK;
+    const double kX = kXk * squared_error / squared_threshold;
+    const double kLoss =
+        scoring::LowerIncompleteGamma(1.5, kX) +
+        kX * (scoring::UpperIncompleteGamma(0.5, kX) -
+              scoring::UpperIncompleteGamma(0.5, kXk));
+    return squared_threshold * kLoss / scoring::LowerIncompleteGamma(1.5, kXk);
+  }
+};
+
+// Scores N precomputed squared errors, 50% of which are below the threshold,
+// in blocks of kScoreBlockSize as done by LocallyOptimizedMSAC.
+template <class Scorer>
+static void BM_ScoreErrors(benchmark::State& state) {
+  const int kN = static_cast<int>(state.range(0));
+  std::mt19937 rng(kSeed);
+  std::uniform_real_distribution<double> distribution(0.0, 2.0);
+  std::vector<double> squared_errors(kN);
+  for (double& e : squared_errors) e = distribution(rng);
+  for (auto _ : state) {
+    double score = 0.0;
+    for (int i = 0; i < kN; i += kScoreBlockSize) {
+      score += Scorer::ScoreErrors(squared_errors.data() + i,
+                                   std::min(kScoreBlockSize, kN - i), 1.0);
+    }
+    benchmark::DoNotOptimize(score);
+  }
+  state.SetItemsProcessed(state.iterations() * kN);
+}
+BENCHMARK_TEMPLATE(BM_ScoreErrors, InlierCountScorer)->Apply(DataArguments);
+BENCHMARK_TEMPLATE(BM_ScoreErrors, PointwiseScorer<InlierCountScorer>)
+    ->Apply(DataArguments);
+BENCHMARK_TEMPLATE(BM_ScoreErrors, MSACScorer)->Apply(DataArguments);
+BENCHMARK_TEMPLATE(BM_ScoreErrors, PointwiseScorer<MSACScorer>)
+    ->Apply(DataArguments);
+BENCHMARK_TEMPLATE(BM_ScoreErrors, MLESACScorer)->Apply(DataArguments);
+BENCHMARK_TEMPLATE(BM_ScoreErrors, PointwiseScorer<MLESACScorer>)
+    ->Apply(DataArguments);
+BENCHMARK_TEMPLATE(BM_ScoreErrors, HuberScorer)->Apply(DataArguments);
+BENCHMARK_TEMPLATE(BM_ScoreErrors, PointwiseScorer<HuberScorer>)
+    ->Apply(DataArguments);
+BENCHMARK_TEMPLATE(BM_ScoreErrors, MAGSACPlusPlusScorer<2>)
+    ->Apply(DataArguments);
+BENCHMARK_TEMPLATE(BM_ScoreErrors, PointwiseScorer<MAGSACPlusPlusScorer<2>>)
+    ->Apply(DataArguments);
+BENCHMARK_TEMPLATE(BM_ScoreErrors,
+                   PointwiseScorer<DirectMAGSACPlusPlusScorer>)
+    ->Apply(DataArguments);
+
+////////////////////////////////////////////////////////////////////////////////
+// Engine configurations.
+////////////////////////////////////////////////////////////////////////////////
+
+// Plain MSAC with a fixed number of iterations, which never counts inliers
+// before the end.
+typedef RansacPolicies<MSACScorer, NoLocalOptimization, FixedNumIterations,
+                       CountOnlyStatistics>
+    FixedCountOnlyMSACPolicies;
+
+// Runs a complete estimation on a line instance. The number of processed
+// items is the number of RANSAC iterations, i.e., the reported rate shows
+// the cost of an iteration of the respective configuration.
+template <class Policies>
+static void BM_Engine_Line(benchmark::State& state) {
+  const int kN = static_cast<int>(state.range(0));
+  LineEstimator solver(GenerateLineData(kN));
+  LocallyOptimizedMSAC<Eigen::Vector3d, std::vector<Eigen::Vector3d>,
+                       LineEstimator, UniformSampling<LineEstimator>, Policies>
+      ransac;
+  LORansacOptions options;
+  options.min_num_iterations_ = 1000u;
+  options.max_num_iterations_ = 1000u;
+  options.squared_inlier_threshold_ = 0.01 * 0.01;
+  options.random_seed_ = kSeed;
+  int64_t num_iterations = 0;
+  for (auto _ : state) {
+    Eigen::Vector3d line;
+    RansacStatistics stats;
+    benchmark::DoNotOptimize(
+        ransac.EstimateModel(options, solver, &line, &stats));
+    num_iterations += stats.num_iterations;
+  }
+  state.SetItemsProcessed(num_iterations);
+}
+BENCHMARK_TEMPLATE(BM_Engine_Line, LOMSACPolicies)->Apply(DataArguments);
+BENCHMARK_TEMPLATE(BM_Engine_Line, VectorizedLOMSACPolicies)
+    ->Apply(DataArguments);
+BENCHMARK_TEMPLATE(BM_Engine_Line, MSACPolicies)->Apply(DataArguments);
+BENCHMARK_TEMPLATE(BM_Engine_Line, CountOnlyMSACPolicies)
+    ->Apply(DataArguments);
+BENCHMARK_TEMPLATE(BM_Engine_Line, FixedCountOnlyMSACPolicies)
+    ->Apply(DataArguments);
+BENCHMARK_TEMPLATE(BM_Engine_Line, InlierCountRansacPolicies)
+    ->Apply(DataArguments);
+
+////////////////////////////////////////////////////////////////////////////////
+// Solvers.
+////////////////////////////////////////////////////////////////////////////////
+
+static void BM_LineEstimator_MinimalSolver(benchmark::State& state) {
+  const int kN = static_cast<int>(state.range(0));
+  LineEstimator solver(GenerateLineData(kN));
+  SamplingProblem problem(kN, solver.min_sample_size());
+  UniformSampling<SamplingProblem> sampler(kSeed, problem);
+  std::vector<int> sample;
+  std::vector<Eigen::Vector3d> lines;
+  for (auto _ : state) {
+    sampler.Sample(&sample);
+    benchmark::DoNotOptimize(solver.MinimalSolver(sample, &lines));
+  }
+}
+BENCHMARK(BM_LineEstimator_MinimalSolver)->Apply(DataArguments);
+
+static void BM_LineEstimator_EvaluateModelOnPoint(benchmark::State& state) {
+  const int kN = static_cast<int>(state.range(0));
+  LineEstimator solver(GenerateLineData(kN));
+  const Eigen::Vector3d kLine(0.0, 1.0, 0.0);
+  for (auto _ : state) {
+    for (int i = 0; i < kN; ++i) {
+      benchmark::DoNotOptimize(solver.EvaluateModelOnPoint(kLine, i));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kN);
+}
+BENCHMARK(BM_LineEstimator_EvaluateModelOnPoint)->Apply(DataArguments);
+
+static void BM_LineEstimator_LeastSquares(benchmark::State& state) {
+  const int kN = static_cast<int>(state.range(0));
+  const int kSampleSize = static_cast<int>(state.range(1));
+  LineEstimator solver(GenerateLineData(kN));
+  // Only uses the inliers, i.e., the points with even indices.
+  std::vector<int> sample(kSampleSize);
+  for (int i = 0; i < kSampleSize; ++i) sample[i] = (2 * i) % kN;
+  for (auto _ : state) {
+    Eigen::Vector3d line(0.0, 1.0, 0.0);
+    solver.LeastSquares(sample, &line);
+    benchmark::DoNotOptimize(line.data());
+  }
+}
+BENCHMARK(BM_LineEstimator_LeastSquares)->Apply(LeastSquaresArguments);
+
+static void BM_PoseEstimator_MinimalSolver(benchmark::State& state) {
+  using calibrated_absolute_pose::CalibratedAbsolutePoseEstimator;
+  const int kN = static_cast<int>(state.range(0));
+  const double kFocalLength = 320.0 / std::tan(60.0 * M_PI / 180.0);
+  calibrated_absolute_pose::Points2D points2D;
+  calibrated_absolute_pose::ViewingRays rays;
+  calibrated_absolute_pose::Points3D points3D;
+  GeneratePoseData(kN, kFocalLength, &points2D, &rays, &points3D);
+  CalibratedAbsolutePoseEstimator solver(kFocalLength, kFocalLength, 144.0,
+                                         points2D, rays, points3D);
+  SamplingProblem problem(kN, solver.min_sample_size());
+  UniformSampling<SamplingProblem> sampler(kSeed, problem);
+  std::vector<int> sample;
+  calibrated_absolute_pose::CameraPoses poses;
+  for (auto _ : state) {
+    sampler.Sample(&sample);
+    benchmark::DoNotOptimize(solver.MinimalSolver(sample, &poses));
+  }
+}
+BENCHMARK(BM_PoseEstimator_MinimalSolver)->Apply(DataArguments);
+
+static void BM_PoseEstimator_EvaluateModelOnPoint(benchmark::State& state) {
+  using calibrated_absolute_pose::CalibratedAbsolutePoseEstimator;
+  const int kN = static_cast<int>(state.range(0));
+  const double kFocalLength = 320.0 / std::tan(60.0 * M_PI / 180.0);
+  calibrated_absolute_pose::Points2D points2D;
+  calibrated_absolute_pose::ViewingRays rays;
+  calibrated_absolute_pose::Points3D points3D;
+  GeneratePoseData(kN, kFocalLength, &points2D, &rays, &points3D);
+  CalibratedAbsolutePoseEstimator solver(kFocalLength, kFocalLength, 144.0,
+                                         points2D, rays, points3D);
+  calibrated_absolute_pose::CameraPose pose;
+  pose.setIdentity();
+  pose.col(3).setZero();
+  for (auto _ : state) {
+    for (int i = 0; i < kN; ++i) {
+      benchmark::DoNotOptimize(solver.EvaluateModelOnPoint(pose, i));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kN);
+}
+BENCHMARK(BM_PoseEstimator_EvaluateModelOnPoint)->Apply(DataArguments);
+
+static void BM_PoseEstimator_LeastSquares(benchmark::State& state) {
+  using calibrated_absolute_pose::CalibratedAbsolutePoseEstimator;
+  const int kN = static_cast<int>(state.range(0));
+  const int kSampleSize = static_cast<int>(state.range(1));
+  const double kFocalLength = 320.0 / std::tan(60.0 * M_PI / 180.0);
+  calibrated_absolute_pose::Points2D points2D;
+  calibrated_absolute_pose::ViewingRays rays;
+  calibrated_absolute_pose::Points3D points3D;
+  GeneratePoseData(kN, kFocalLength, &points2D, &rays, &points3D);
+  CalibratedAbsolutePoseEstimator solver(kFocalLength, kFocalLength, 144.0,
+                                         points2D, rays, points3D);
+  // Only uses the inliers, i.e., the matches with even indices.
+  std::vector<int> sample(kSampleSize);
+  for (int i = 0; i < kSampleSize; ++i) sample[i] = (2 * i) % kN;
+  for (auto _ : state) {
+    calibrated_absolute_pose::CameraPose pose;
+    pose.setIdentity();
+    pose.col(3).setZero();
+    solver.LeastSquares(sample, &pose);
+    benchmark::DoNotOptimize(pose.data());
+  }
+}
+BENCHMARK(BM_PoseEstimator_LeastSquares)->Apply(LeastSquaresArguments);
+
+}  // namespace ransac_lib
+
+BENCHMARK_MAIN();
@@ -0,0 +1,131 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// Converts 2D-3D matches from the text format used by the localization
+// examples (one match "x y X Y Z [score]" per line) into the binary match
+// format defined in match_file.h. If the first line contains a sixth value,
+// it is treated as a per-match score that is stored in the binary file.
+// Multiple files can be converted at once by passing a list of file name
+// prefixes together with the input and output postfixes.
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "calibrated_absolute_pose_estimator.h"
+#include "match_file.h"
+
+namespace {
+
+bool ConvertMatches(const std::string& input, const std::string& output,
+                    const bool use_double) {
+  using ransac_lib::calibrated_absolute_pose::Points2D;
+  using ransac_lib::calibrated_absolute_pose::Points3D;
+
+  std::ifstream ifs(input.c_str(), std::ios::in);
+  if (!ifs.is_open()) {
+    std::cerr << " ERROR: Cannot read the matches from " << input
+              << std::endl;
+    return false;
+  }
+
+  Points2D points2D;
+  Points3D points3D;
+  std::vector<double> scores;
+  bool has_scores = false;
+  bool first_line = true;
+  std::string line;
+  while (std::getline(ifs, line)) {
+    std::stringstream s_stream(line);
+    Eigen::Vector2d p2D;
+    Eigen::Vector3d p3D;
+    if (!(s_stream >> p2D[0] >> p2D[1] >> p3D[0] >> p3D[1] >> p3D[2])) {
+      continue;
+    }
+    double score = 0.0;
+    const bool kHasScore = static_cast<bool>(s_stream >> score);
+    if (first_line) {
+      has_scores = kHasScore;
+      first_line = false;
+    }
+    points2D.push_back(p2D);
+    points3D.push_back(p3D);
+    if (has_scores) scores.push_back(score);
+  }
+
+  return ransac_lib::match_file::WriteBinaryMatches(
+      output, points2D, points3D, has_scores ? &scores : nullptr, use_double);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::cout << " usage: " << argv[0] << " input.matches.txt output.bin "
+            << "[use_double (default 1)]" << std::endl;
+  std::cout << "    or: " << argv[0] << " --list list input_postfix "
+            << "output_postfix [use_double (default 1)]" << std::endl;
+  std::cout << "  where list contains one file name prefix (e.g., the query "
+            << "name) per line as first entry" << std::endl;
+  if (argc < 3) return -1;
+
+  if (std::string(argv[1]) == "--list") {
+    if (argc < 5) return -1;
+    const bool kUseDouble = argc >= 6 ? atoi(argv[5]) != 0 : true;
+    std::ifstream ifs(argv[2], std::ios::in);
+    if (!ifs.is_open()) {
+      std::cerr << " ERROR: Cannot read the list " << argv[2] << std::endl;
+      return -1;
+    }
+    int num_converted = 0, num_failed = 0;
+    std::string line;
+    while (std::getline(ifs, line)) {
+      std::stringstream s_stream(line);
+      std::string prefix;
+      if (!(s_stream >> prefix)) continue;
+      if (ConvertMatches(prefix + argv[3], prefix + argv[4], kUseDouble)) {
+        ++num_converted;
+      } else {
+        ++num_failed;
+      }
+    }
+    std::cout << " Converted " << num_converted << " files, " << num_failed
+              << " failed" << std::endl;
+    return num_failed == 0 ? 0 : -1;
+  }
+
+  const bool kUseDouble = argc >= 4 ? atoi(argv[3]) != 0 : true;
+  if (!ConvertMatches(argv[1], argv[2], kUseDouble)) return -1;
+  return 0;
+}
@@ -0,0 +1,205 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// Localizes a batch of queries under a latency budget on a single thread,
+// using the DeadlineScheduler to interleave the RANSAC runs of the queries.
+// Query i is released arrival_interval_ms * i milliseconds after the start
+// and has to be localized within budget_ms milliseconds after its release.
+// With the default interval of 0, all queries share a single global budget.
+// Queries that cannot be localized within their budget are stopped early
+// and reported, as are all missed deadlines. Only the time spent in RANSAC is
+// scheduled, i.e., all match files are loaded before the clock starts.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <RansacLib/deadline_scheduler.h>
+#include <RansacLib/ransac.h>
+#include "batch_localization.h"
+#include "calibrated_absolute_pose_estimator.h"
+#include "localization_io.h"
+#include "map_store.h"
+
+int main(int argc, char** argv) {
+  using ransac_lib::DeadlineScheduler;
+  using ransac_lib::DeadlineSchedulerOptions;
+  using ransac_lib::LORansacOptions;
+  using ransac_lib::RansacStatistics;
+  using ransac_lib::ScheduledJobReport;
+  using ransac_lib::batch_localization::FormatPose;
+  using ransac_lib::batch_localization::LocalizationSettings;
+  using ransac_lib::batch_localization::QueryMatches;
+  using ransac_lib::calibrated_absolute_pose::CalibratedAbsolutePoseEstimator;
+  using ransac_lib::calibrated_absolute_pose::CameraPose;
+  using ransac_lib::calibrated_absolute_pose::CameraPoses;
+  using ransac_lib::localization_io::LoadListIntrinsics;
+  using ransac_lib::localization_io::Queries;
+
+  std::cout << " usage: " << argv[0] << " images_with_intrinsics outfile "
+            << "inlier_threshold num_lo_steps invert_Y_Z points_centered "
+            << "[match-file postfix] [budget_ms (default 1000)] "
+            << "[arrival_interval_ms (default 0)] [random_seed]" << std::endl;
+  if (argc < 7) return -1;
+
+  LocalizationSettings settings;
+  settings.inlier_threshold = static_cast<double>(atof(argv[3]));
+  settings.num_lo_steps = atoi(argv[4]);
+  settings.invert_Y_Z = static_cast<bool>(atoi(argv[5]));
+  settings.points_centered = static_cast<bool>(atoi(argv[6]));
+  settings.matchfile_postfix = ".individual_datasets.matches.txt";
+  if (argc >= 8) {
+    settings.matchfile_postfix = std::string(argv[7]);
+  }
+  settings.min_num_matches = 4;
+  const double kBudgetSeconds = (argc >= 9 ? atof(argv[8]) : 1000.0) * 1e-3;
+  const double kIntervalSeconds = (argc >= 10 ? atof(argv[9]) : 0.0) * 1e-3;
+  if (argc >= 11) {
+    settings.random_seed =
+        static_cast<unsigned int>(std::strtoul(argv[10], nullptr, 10));
+  } else {
+    std::random_device rand_dev;
+    settings.random_seed = rand_dev();
+  }
+
+  // If RANSACLIB_MAP is set, the match files reference the 3D points of the
+  // map by their IDs.
+  ransac_lib::map_store::MapStore map;
+  if (!ransac_lib::batch_localization::UseMapFromEnvironment(&map,
+                                                             &settings)) {
+    return -1;
+  }
+
+  Queries query_data;
+  std::string list(argv[1]);
+  if (!LoadListIntrinsics(list, &query_data)) {
+    std::cerr << " ERROR: Could not read the data from " << list << std::endl;
+    return -1;
+  }
+  const int kNumQuery = static_cast<int>(query_data.size());
+  std::cout << " Found " << kNumQuery << " query images " << std::endl;
+
+  std::vector<QueryMatches> matches(kNumQuery);
+  std::vector<std::unique_ptr<CalibratedAbsolutePoseEstimator>> solvers(
+      kNumQuery);
+  std::vector<LORansacOptions> options(kNumQuery);
+  for (int i = 0; i < kNumQuery; ++i) {
+    if (!ransac_lib::batch_localization::LoadQueryMatches(
+            query_data[i], settings, &matches[i])) {
+      continue;
+    }
+    if (static_cast<int>(matches[i].points2D.size()) <
+        settings.min_num_matches) {
+      continue;
+    }
+    options[i] = ransac_lib::batch_localization::LocalizationOptions(settings);
+    options[i].random_seed_ =
+        ransac_lib::batch_localization::QuerySeed(settings.random_seed, i);
+    solvers[i].reset(new CalibratedAbsolutePoseEstimator(
+        query_data[i].focal_x, query_data[i].focal_y,
+        options[i].squared_inlier_threshold_, matches[i].points2D,
+        matches[i].rays, matches[i].points3D, matches[i].arrays));
+  }
+
+  DeadlineScheduler<CameraPose, CameraPoses, CalibratedAbsolutePoseEstimator>
+      scheduler((DeadlineSchedulerOptions()));
+  CameraPoses poses(kNumQuery, CameraPose::Identity());
+  std::vector<RansacStatistics> statistics(kNumQuery);
+  std::vector<int> job_ids(kNumQuery, -1);
+  for (int i = 0; i < kNumQuery; ++i) {
+    if (!solvers[i]) continue;
+    const double kRelease = kIntervalSeconds * static_cast<double>(i);
+    job_ids[i] = scheduler.AddJob(options[i], solvers[i].get(), kRelease,
+                                  kRelease + kBudgetSeconds, &poses[i],
+                                  &statistics[i]);
+  }
+
+  std::cout << " Scheduling " << std::count_if(job_ids.begin(), job_ids.end(),
+                                                [](int id) { return id >= 0; })
+            << " queries with a budget of " << kBudgetSeconds * 1e3
+            << " ms each, released every " << kIntervalSeconds * 1e3
+            << " ms, random seed " << settings.random_seed << std::endl;
+  const int kNumMissed = scheduler.Run();
+
+  std::ofstream ofs(argv[2], std::ios::out);
+  if (!ofs.is_open()) {
+    std::cerr << " ERROR: Cannot write to " << argv[2] << std::endl;
+    return -1;
+  }
+
+  int num_truncated = 0;
+  double makespan = 0.0;
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << " name matches inliers iterations slices predicted_ms run_ms "
+            << "release_ms deadline_ms finish_ms status" << std::endl;
+  for (int i = 0; i < kNumQuery; ++i) {
+    if (job_ids[i] < 0) {
+      std::cout << " " << query_data[i].name << " "
+                << matches[i].points2D.size() << " skipped" << std::endl;
+      continue;
+    }
+    const ScheduledJobReport& kReport = scheduler.reports()[job_ids[i]];
+    if (kReport.truncated) ++num_truncated;
+    makespan = std::max(makespan, kReport.finish_seconds);
+    std::cout << " " << query_data[i].name << " "
+              << matches[i].points2D.size() << " " << kReport.num_inliers
+              << " " << statistics[i].num_iterations << " "
+              << kReport.num_slices << " " << kReport.predicted_seconds * 1e3
+              << " " << kReport.run_seconds * 1e3 << " "
+              << kReport.release_seconds * 1e3 << " "
+              << kReport.deadline_seconds * 1e3 << " "
+              << kReport.finish_seconds * 1e3 << " "
+              << (kReport.missed_deadline
+                      ? "MISSED"
+                      : (kReport.truncated ? "truncated" : "ok"))
+              << std::endl;
+    ofs << FormatPose(query_data[i].name, poses[i]);
+  }
+  ofs.close();
+
+  std::cout << " Missed " << kNumMissed << " deadline(s), stopped "
+            << num_truncated << " quer(y/ies) early, all queries finished "
+            << "after " << makespan * 1e3 << " ms" << std::endl;
+  std::cout << std::scientific << " Cost model: "
+            << scheduler.seconds_per_evaluation()
+            << " s per model evaluation, " << std::fixed
+            << scheduler.iterations_prior() << " iterations expected per query"
+            << std::endl;
+  return kNumMissed == 0 ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// Checks that DeadlineScheduler stops jobs whose deadlines have already
+// passed once they ran min_iterations_ iterations, instead of running them
+// to completion in a single slice. Returns 0 on success.
+
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <RansacLib/deadline_scheduler.h>
+#include <RansacLib/ransac.h>
+#include "line_estimator.h"
+#include "synthetic_datasets.h"
+
+int main() {
+  using ransac_lib::DeadlineScheduler;
+  using ransac_lib::DeadlineSchedulerOptions;
+  using ransac_lib::LineEstimator;
+  using ransac_lib::LORansacOptions;
+  using ransac_lib::RansacStatistics;
+  using ransac_lib::ScheduledJobReport;
+
+  const int kNumJobs = 3;
+  std::mt19937 rng(0u);
+  std::vector<Eigen::Matrix2Xd> points(kNumJobs);
+  std::vector<LineEstimator> solvers;
+  for (int i = 0; i < kNumJobs; ++i) {
+    Eigen::Vector3d line;
+    std::vector<int> inliers;
+    // With 90% outliers, the jobs need far more iterations than
+    // min_iterations_ to reach the success probability.
+    ransac_lib::synthetic::GenerateLineInstance(100, 900, 0.01, &rng,
+                                                &points[i], &line, &inliers);
+    solvers.emplace_back(points[i]);
+  }
+
+  LORansacOptions options;
+  options.min_num_iterations_ = 1000u;
+  options.max_num_iterations_ = 100000u;
+  options.squared_inlier_threshold_ = 0.02 * 0.02;
+
+  DeadlineSchedulerOptions scheduler_options;
+  DeadlineScheduler<Eigen::Vector3d, std::vector<Eigen::Vector3d>,
+                    LineEstimator>
+      scheduler(scheduler_options);
+  std::vector<Eigen::Vector3d> models(kNumJobs);
+  std::vector<RansacStatistics> statistics(kNumJobs);
+  for (int i = 0; i < kNumJobs; ++i) {
+    options.random_seed_ = static_cast<unsigned int>(i);
+    // The deadlines are in the past when Run starts.
+    scheduler.AddJob(options, &solvers[i], 0.0, -0.001 * (i + 1), &models[i],
+                     &statistics[i]);
+  }
+  const int kNumMissed = scheduler.Run();
+
+  // A job runs at least min_iterations_ iterations, in slices of
+  // min_slice_iterations_ iterations.
+  const uint32_t kMaxIterations = scheduler_options.min_iterations_ +
+                                  scheduler_options.min_slice_iterations_;
+  bool passed = kNumMissed == kNumJobs;
+  for (int i = 0; i < kNumJobs; ++i) {
+    const ScheduledJobReport& report = scheduler.reports()[i];
+    const uint32_t kIterations = statistics[i].num_iterations;
+    std::cout << " job " << i << ": " << kIterations << " iterations in "
+              << report.num_slices << " slice(s), truncated "
+              << report.truncated << std::endl;
+    passed = passed && report.truncated &&
+             kIterations >= scheduler_options.min_iterations_ &&
+             kIterations <= kMaxIterations;
+  }
+  std::cout << (passed ? " PASSED" : " FAILED") << std::endl;
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,444 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// End-to-end benchmark of the estimators provided with the examples on
+// synthetic data. Sweeps over the number of data points, the outlier ratio,
+// and the noise level. Every configuration is repeated several times, where
+// each repetition uses a fixed seed derived from the configuration. The
+// results are thus reproducible and can be compared between runs, e.g., to
+// track performance regressions.
+// The aggregated results are written to <outfile_prefix>.csv and
+// <outfile_prefix>.json.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <RansacLib/hybrid_ransac.h>
+#include <RansacLib/ransac.h>
+#include "calibrated_absolute_pose_estimator.h"
+#include "hybrid_line_estimator.h"
+#include "line_estimator.h"
+#include "synthetic_datasets.h"
+
+namespace ransac_lib {
+
+namespace end_to_end {
+
+struct BenchmarkConfig {
+  std::string problem;
+  int num_data;
+  double outlier_ratio;
+  double noise;
+};
+
+// The result of a single RANSAC run.
+struct RunResult {
+  double seconds;
+  uint32_t num_iterations;
+  bool success;
+  double inlier_recall;
+};
+
+struct BenchmarkResult {
+  BenchmarkConfig config;
+  int num_repeats;
+  double mean_time_ms;
+  double median_time_ms;
+  double max_time_ms;
+  double mean_iterations;
+  double success_rate;
+  double mean_inlier_recall;
+};
+
+// Derives the seed of a run from its configuration via FNV-1a. In contrast to
+// std::hash, the result is the same for all platforms and standard libraries.
+unsigned int SeedForRun(const BenchmarkConfig& config, const int repeat) {
+  std::stringstream s_stream;
+  s_stream << config.problem << "/" << config.num_data << "/"
+           << config.outlier_ratio << "/" << config.noise << "/" << repeat;
+  const std::string kKey = s_stream.str();
+  uint32_t hash = 2166136261u;
+  for (const char c : kKey) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+void SplitInliersOutliers(const int num_data, const double outlier_ratio,
+                          int* num_inliers, int* num_outliers) {
+  *num_outliers =
+      static_cast<int>(static_cast<double>(num_data) * outlier_ratio);
+  *num_inliers = num_data - *num_outliers;
+}
+
+// A run is considered successful if the mean squared residual of the
+// estimated model over the ground truth inliers is below the squared inlier
+// threshold.
+void RunLine(const BenchmarkConfig& config, const unsigned int seed,
+             RunResult* result) {
+  const double kInlierThreshold = 0.01;
+  int num_inliers = 0, num_outliers = 0;
+  SplitInliersOutliers(config.num_data, config.outlier_ratio, &num_inliers,
+                       &num_outliers);
+
+  std::mt19937 rng(seed);
+  Eigen::Matrix2Xd data;
+  Eigen::Vector3d gt_line;
+  std::vector<int> gt_inliers;
+  synthetic::GenerateLineInstance(num_inliers, num_outliers, config.noise,
+                                  &rng, &data, &gt_line, &gt_inliers);
+
+  LORansacOptions options;
+  options.min_num_iterations_ = 100u;
+  options.max_num_iterations_ = 100000u;
+  options.squared_inlier_threshold_ = kInlierThreshold * kInlierThreshold;
+  options.random_seed_ = seed;
+
+  LineEstimator solver(data);
+  LocallyOptimizedMSAC<Eigen::Vector3d, std::vector<Eigen::Vector3d>,
+                       LineEstimator>
+      lomsac;
+  RansacStatistics ransac_stats;
+  Eigen::Vector3d best_model;
+
+  auto ransac_start = std::chrono::steady_clock::now();
+  lomsac.EstimateModel(options, solver, &best_model, &ransac_stats);
+  auto ransac_end = std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed_seconds = ransac_end - ransac_start;
+
+  double mean_sq_error = 0.0;
+  for (const int i : gt_inliers) {
+    mean_sq_error += solver.EvaluateModelOnPoint(best_model, i);
+  }
+  mean_sq_error /= static_cast<double>(std::max(num_inliers, 1));
+
+  result->seconds = elapsed_seconds.count();
+  result->num_iterations = ransac_stats.num_iterations;
+  result->success = ransac_stats.best_num_inliers > 0 &&
+                    mean_sq_error < options.squared_inlier_threshold_;
+  result->inlier_recall =
+      synthetic::InlierRecall(gt_inliers, ransac_stats.inlier_indices);
+}
+
+// Uses num_data points and num_data points with normals.
+void RunHybridLine(const BenchmarkConfig& config, const unsigned int seed,
+                   RunResult* result) {
+  const double kInlierThreshold = 0.01;
+  int num_inliers = 0, num_outliers = 0;
+  SplitInliersOutliers(config.num_data, config.outlier_ratio, &num_inliers,
+                       &num_outliers);
+
+  std::mt19937 rng(seed);
+  Eigen::Matrix2d R;
+  Eigen::Vector2d t;
+  synthetic::GenerateRandomTransform(&rng, &R, &t);
+
+  Eigen::Vector3d gt_line;
+  std::vector<std::vector<int>> gt_inliers(2);
+  Eigen::Matrix4Xd data;
+  synthetic::GenerateLineInstance(num_inliers, num_outliers, config.noise, R,
+                                  t, &rng, &data, &gt_line, &gt_inliers[0]);
+  Eigen::Matrix2Xd points = data.topRows<2>();
+  Eigen::Matrix4Xd points_with_normals;
+  synthetic::GenerateLineInstance(num_inliers, num_outliers, config.noise, R,
+                                  t, &rng, &points_with_normals, &gt_line,
+                                  &gt_inliers[1]);
+
+  HybridLORansacOptions options;
+  options.min_num_iterations_ = 100u;
+  options.max_num_iterations_ = 10000u;
+  options.max_num_iterations_per_solver_ = 1000u;
+  options.squared_inlier_thresholds_ = {kInlierThreshold * kInlierThreshold,
+                                        kInlierThreshold * kInlierThreshold};
+  options.data_type_weights_ = {2.0, 0.5};
+  options.random_seed_ = seed;
+
+  std::vector<double> prior_probabilities = {0.2, 0.8};
+  HybridLineEstimator solver(points, points_with_normals, prior_probabilities);
+  HybridLocallyOptimizedMSAC<Eigen::Vector3d, std::vector<Eigen::Vector3d>,
+                             HybridLineEstimator>
+      lomsac;
+  HybridRansacStatistics ransac_stats;
+  Eigen::Vector3d best_model;
+
+  auto ransac_start = std::chrono::steady_clock::now();
+  lomsac.EstimateModel(options, solver, &best_model, &ransac_stats);
+  auto ransac_end = std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed_seconds = ransac_end - ransac_start;
+
+  double mean_sq_error = 0.0;
+  double num_found = 0.0;
+  for (int type = 0; type < 2; ++type) {
+    for (const int i : gt_inliers[type]) {
+      mean_sq_error += solver.EvaluateModelOnPoint(best_model, type, i);
+    }
+    if (ransac_stats.inlier_indices.size() > static_cast<size_t>(type)) {
+      num_found += synthetic::InlierRecall(gt_inliers[type],
+                                           ransac_stats.inlier_indices[type]) *
+                   static_cast<double>(gt_inliers[type].size());
+    }
+  }
+  const double kNumGtInliers = static_cast<double>(2 * num_inliers);
+  mean_sq_error /= std::max(kNumGtInliers, 1.0);
+
+  result->seconds = elapsed_seconds.count();
+  result->num_iterations = ransac_stats.num_iterations_total;
+  result->success = ransac_stats.best_num_inliers > 0 &&
+                    mean_sq_error < options.squared_inlier_thresholds_[0];
+  result->inlier_recall =
+      kNumGtInliers > 0.0 ? num_found / kNumGtInliers : 1.0;
+}
+
+// The noise is given in pixels.
+void RunPose(const BenchmarkConfig& config, const unsigned int seed,
+             RunResult* result) {
+  using calibrated_absolute_pose::CalibratedAbsolutePoseEstimator;
+  using calibrated_absolute_pose::CameraPose;
+  using calibrated_absolute_pose::CameraPoses;
+
+  const double kWidth = 640.0;
+  const double kHeight = 320.0;
+  const double kFocalLength = (kWidth * 0.5) / std::tan(60.0 * M_PI / 180.0);
+  const double kInThreshPX = 12.0;
+  int num_inliers = 0, num_outliers = 0;
+  SplitInliersOutliers(config.num_data, config.outlier_ratio, &num_inliers,
+                       &num_outliers);
+
+  std::mt19937 rng(seed);
+  calibrated_absolute_pose::Points2D points2D;
+  calibrated_absolute_pose::ViewingRays rays;
+  calibrated_absolute_pose::Points3D points3D;
+  CameraPose gt_pose;
+  std::vector<int> gt_inliers;
+  synthetic::GeneratePoseInstance(kWidth, kHeight, kFocalLength, num_inliers,
+                                  num_outliers, config.noise, 2.0, 10.0, &rng,
+                                  &points2D, &rays, &points3D, &gt_pose,
+                                  &gt_inliers);
+
+  LORansacOptions options;
+  options.min_num_iterations_ = 100u;
+  options.max_num_iterations_ = 100000u;
+  options.squared_inlier_threshold_ = kInThreshPX * kInThreshPX;
+  options.min_sample_multiplicator_ = 7;
+  options.num_lsq_iterations_ = 4;
+  options.num_lo_steps_ = 10;
+  options.random_seed_ = seed;
+
+  CalibratedAbsolutePoseEstimator solver(kFocalLength, kFocalLength,
+                                         kInThreshPX * kInThreshPX, points2D,
+                                         rays, points3D);
+  LocallyOptimizedMSAC<CameraPose, CameraPoses,
+                       CalibratedAbsolutePoseEstimator>
+      lomsac;
+  RansacStatistics ransac_stats;
+  CameraPose best_model;
+
+  auto ransac_start = std::chrono::steady_clock::now();
+  lomsac.EstimateModel(options, solver, &best_model, &ransac_stats);
+  auto ransac_end = std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed_seconds = ransac_end - ransac_start;
+
+  double mean_sq_error = 0.0;
+  if (ransac_stats.best_num_inliers > 0) {
+    for (const int i : gt_inliers) {
+      mean_sq_error += solver.EvaluateModelOnPoint(best_model, i);
+    }
+    mean_sq_error /= static_cast<double>(std::max(num_inliers, 1));
+  }
+
+  result->seconds = elapsed_seconds.count();
+  result->num_iterations = ransac_stats.num_iterations;
+  result->success = ransac_stats.best_num_inliers > 0 &&
+                    mean_sq_error < options.squared_inlier_threshold_;
+  result->inlier_recall =
+      synthetic::InlierRecall(gt_inliers, ransac_stats.inlier_indices);
+}
+
+void RunConfig(const BenchmarkConfig& config, const int num_repeats,
+               BenchmarkResult* result) {
+  std::vector<double> times_ms;
+  double sum_iterations = 0.0;
+  int num_successes = 0;
+  double sum_recall = 0.0;
+  for (int r = 0; r < num_repeats; ++r) {
+    const unsigned int kSeed = SeedForRun(config, r);
+    RunResult run;
+    if (config.problem == "line") {
+      RunLine(config, kSeed, &run);
+    } else if (config.problem == "hybrid_line") {
+      RunHybridLine(config, kSeed, &run);
+    } else {
+      RunPose(config, kSeed, &run);
+    }
+    times_ms.push_back(run.seconds * 1000.0);
+    sum_iterations += static_cast<double>(run.num_iterations);
+    if (run.success) ++num_successes;
+    sum_recall += run.inlier_recall;
+  }
+
+  const double kNumRepeats = static_cast<double>(num_repeats);
+  result->config = config;
+  result->num_repeats = num_repeats;
+  double sum_times = 0.0;
+  for (const double t : times_ms) sum_times += t;
+  result->mean_time_ms = sum_times / kNumRepeats;
+  std::sort(times_ms.begin(), times_ms.end());
+  result->median_time_ms = times_ms[times_ms.size() / 2];
+  result->max_time_ms = times_ms.back();
+  result->mean_iterations = sum_iterations / kNumRepeats;
+  result->success_rate = static_cast<double>(num_successes) / kNumRepeats;
+  result->mean_inlier_recall = sum_recall / kNumRepeats;
+}
+
+bool WriteCSV(const std::string& filename,
+              const std::vector<BenchmarkResult>& results) {
+  std::ofstream ofs(filename.c_str(), std::ios::out);
+  if (!ofs.is_open()) {
+    std::cerr << " ERROR: Cannot write to " << filename << std::endl;
+    return false;
+  }
+  ofs << "problem,num_data,outlier_ratio,noise,num_repeats,mean_time_ms,"
+      << "median_time_ms,max_time_ms,mean_iterations,success_rate,"
+      << "mean_inlier_recall" << std::endl;
+  ofs << std::setprecision(9);
+  for (const BenchmarkResult& r : results) {
+    ofs << r.config.problem << "," << r.config.num_data << ","
+        << r.config.outlier_ratio << "," << r.config.noise << ","
+        << r.num_repeats << "," << r.mean_time_ms << "," << r.median_time_ms
+        << "," << r.max_time_ms << "," << r.mean_iterations << ","
+        << r.success_rate << "," << r.mean_inlier_recall << std::endl;
+  }
+  return true;
+}
+
+bool WriteJSON(const std::string& filename,
+               const std::vector<BenchmarkResult>& results) {
+  std::ofstream ofs(filename.c_str(), std::ios::out);
+  if (!ofs.is_open()) {
+    std::cerr << " ERROR: Cannot write to " << filename << std::endl;
+    return false;
+  }
+  ofs << std::setprecision(9);
+  ofs << "[" << std::endl;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchmarkResult& r = results[i];
+    ofs << "  {\"problem\": \"" << r.config.problem << "\", "
+        << "\"num_data\": " << r.config.num_data << ", "
+        << "\"outlier_ratio\": " << r.config.outlier_ratio << ", "
+        << "\"noise\": " << r.config.noise << ", "
+        << "\"num_repeats\": " << r.num_repeats << ", "
+        << "\"mean_time_ms\": " << r.mean_time_ms << ", "
+        << "\"median_time_ms\": " << r.median_time_ms << ", "
+        << "\"max_time_ms\": " << r.max_time_ms << ", "
+        << "\"mean_iterations\": " << r.mean_iterations << ", "
+        << "\"success_rate\": " << r.success_rate << ", "
+        << "\"mean_inlier_recall\": " << r.mean_inlier_recall << "}"
+        << (i + 1 < results.size() ? "," : "") << std::endl;
+  }
+  ofs << "]" << std::endl;
+  return true;
+}
+
+}  // namespace end_to_end
+
+}  // namespace ransac_lib
+
+int main(int argc, char** argv) {
+  using ransac_lib::end_to_end::BenchmarkConfig;
+  using ransac_lib::end_to_end::BenchmarkResult;
+
+  if (argc < 2) {
+    std::cout << " Usage: " << argv[0] << " outfile_prefix [num_repeats]"
+              << std::endl;
+    return -1;
+  }
+  const std::string kOutPrefix(argv[1]);
+  const int kNumRepeats = argc > 2 ? std::max(1, std::atoi(argv[2])) : 10;
+
+  // The outlier ratios for pose estimation stop at 80% as the number of
+  // required iterations of the P3P solver explodes afterwards.
+  std::vector<BenchmarkConfig> configs;
+  for (const int kN : {100, 1000, 10000}) {
+    for (const double kOutlierRatio : {0.1, 0.3, 0.5, 0.7, 0.9}) {
+      for (const double kNoise : {0.001, 0.0025, 0.005}) {
+        configs.push_back({"line", kN, kOutlierRatio, kNoise});
+      }
+    }
+  }
+  for (const int kN : {100, 1000}) {
+    for (const double kOutlierRatio : {0.1, 0.3, 0.5, 0.7, 0.9}) {
+      for (const double kNoise : {0.001, 0.0025, 0.005}) {
+        configs.push_back({"hybrid_line", kN, kOutlierRatio, kNoise});
+      }
+    }
+  }
+  for (const int kN : {100, 1000, 5000}) {
+    for (const double kOutlierRatio : {0.1, 0.3, 0.5, 0.7, 0.8}) {
+      for (const double kNoise : {0.5, 1.0, 2.0}) {
+        configs.push_back({"pose", kN, kOutlierRatio, kNoise});
+      }
+    }
+  }
+
+  std::vector<BenchmarkResult> results(configs.size());
+  for (size_t i = 0; i < configs.size(); ++i) {
+    ransac_lib::end_to_end::RunConfig(configs[i], kNumRepeats, &results[i]);
+    const BenchmarkResult& r = results[i];
+    std::cout << " " << r.config.problem << " N=" << r.config.num_data
+              << " outliers=" << r.config.outlier_ratio
+              << " noise=" << r.config.noise << " : " << r.median_time_ms
+              << " ms (median), " << r.mean_iterations << " iterations, "
+              << "success rate " << r.success_rate << ", inlier recall "
+              << r.mean_inlier_recall << std::endl;
+  }
+
+  if (!ransac_lib::end_to_end::WriteCSV(kOutPrefix + ".csv", results)) {
+    return -1;
+  }
+  if (!ransac_lib::end_to_end::WriteJSON(kOutPrefix + ".json", results)) {
+    return -1;
+  }
+  return 0;
+}
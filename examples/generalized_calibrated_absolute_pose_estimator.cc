@@ -48,8 +48,11 @@ GeneralizedCalibratedAbsolutePoseEstimator::
       squared_inlier_threshold_(squared_inlier_threshold),
       points2D_(points2D),
       points3D_(points3D),
+      rays_(rays),
       camera_indices_(camera_indices),
-      adapter_(rays, camera_indices, points3D, positions, rotations) {
+      positions_(positions),
+      rotations_(rotations),
+      adapter_(rays_, camera_indices_, points3D_, positions_, rotations_) {
   num_data_ = static_cast<int>(points2D_.size());
 
   rig_.global_pose.topLeftCorner<3, 3>() = Matrix3d::Identity();
@@ -118,33 +121,14 @@ void GeneralizedCalibratedAbsolutePoseEstimator::LeastSquares(
   // system instead.
   Eigen::Matrix3d R = pose->global_pose.topLeftCorner<3, 3>().transpose();
   Eigen::Vector3d c = pose->global_pose.col(3);
-  // At the moment, we need to copy data as we need to add the current pose
-  // estimate to the adapter, which would break the requirement that this
-  // function is constant.
-  const int kSampleSize = static_cast<int>(sample.size());
-  opengv::bearingVectors_t bearing_vectors(kSampleSize);
-  opengv::points_t points(kSampleSize);
-  std::vector<int> camera_indices(kSampleSize);
-  for (int i = 0; i < kSampleSize; ++i) {
-    const int kIdx = sample[i];
-    bearing_vectors[i] = adapter_.getBearingVector(kIdx);
-    points[i] = adapter_.getPoint(kIdx);
-    camera_indices[i] = camera_indices_[i];
-  }
-
-  opengv::translations_t camera_positions(num_cameras_);
-  opengv::rotations_t camera_rotations(num_cameras_);
-  for (int i = 0; i < num_cameras_; ++i) {
-    camera_positions[i] = rig_.cameras[i].pose.col(3);
-    camera_rotations[i] =
-        rig_.cameras[i].pose.topLeftCorner<3, 3>().transpose();
-  }
-
+  // The current pose estimate needs to be added to the adapter, which would
+  // break the requirement that this function is constant. We thus create a
+  // new adapter on the same data, which does not copy the data.
   opengv::absolute_pose::NoncentralAbsoluteAdapter lsq_adapter(
-      bearing_vectors, camera_indices, points, camera_positions,
-      camera_rotations, c, R);
+      rays_, camera_indices_, points3D_, positions_, rotations_, c, R);
 
-  CameraPose P = opengv::absolute_pose::optimize_nonlinear(lsq_adapter);
+  CameraPose P =
+      opengv::absolute_pose::optimize_nonlinear(lsq_adapter, sample);
   AssembleRig(P, pose);
 }
 
@@ -160,9 +160,14 @@ class GeneralizedCalibratedAbsolutePoseEstimator {
   Points2D points2D_;
   // Matrix holding the corresponding 3D point positions.
   Points3D points3D_;
+  // The viewing rays of the 2D points.
+  ViewingRays rays_;
   // For each match, stores the camera in the multi-camera rig where it was
   // detected.
   std::vector<int> camera_indices_;
+  // The poses of the cameras in the rig, as passed to the constructor.
+  CameraPositions positions_;
+  CameraRotations rotations_;
   // The adapter used by OpenGV's solvers.
   opengv::absolute_pose::NoncentralAbsoluteAdapter adapter_;
   int num_data_;
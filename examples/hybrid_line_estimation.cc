@@ -35,6 +35,7 @@
 #include <iostream>
 #include <limits>
 #include <random>
+#include <string>
 #include <vector>
 
 #include <Eigen/Core>
@@ -45,86 +46,7 @@
 #include <RansacLib/hybrid_ransac.h>
 #include <RansacLib/ransac.h>
 #include "hybrid_line_estimator.h"
-
-// Generates a random transformation.
-void GenerateRandomTransform(Eigen::Matrix2d* R, Eigen::Vector2d* t) {
-  std::random_device rand_dev;
-  std::mt19937 rng(rand_dev());
-  std::uniform_real_distribution<double> distr(-0.5, 0.5);
-
-  const double kAngle = distr(rng) * M_PI;
-  *R << std::cos(kAngle), -std::sin(kAngle), std::sin(kAngle), std::cos(kAngle);
-  *t = Eigen::Vector2d(distr(rng) * 10.0, distr(rng) * 10.0);
-}
-
-// Assumes that inlier threshold << 0.5.
-void GenerateRandomInstance(const int num_inliers, const int num_outliers,
-                            double inlier_threshold, const Eigen::Matrix2d& R,
-                            const Eigen::Vector2d& t,
-                            Eigen::Matrix4Xd* points_with_normals) {
-  const int kNumPoints = num_inliers + num_outliers;
-  points_with_normals->resize(4, kNumPoints);
-
-  std::vector<int> indices(kNumPoints);
-  std::iota(indices.begin(), indices.end(), 0);
-
-  std::random_device rand_dev;
-  std::mt19937 rng(rand_dev());
-
-  std::shuffle(indices.begin(), indices.end(), rng);
-
-  // Generates num_inliers points along the x-axis in the interval [0, 1] with
-  // a y-value in the range (-inlier_threshold, inlier_threshold) choosen
-  // at random. All normals of the inliers are set to [0, 1]
-  std::uniform_real_distribution<double> distr(-inlier_threshold,
-                                               inlier_threshold);
-
-  const double kXStep = 1.0 / static_cast<double>(num_inliers);
-  double x = 0.0;
-  for (int i = 0; i < num_inliers; ++i, x += kXStep) {
-    const int kIndex = indices[i];
-    points_with_normals->col(kIndex)[0] = x;
-    while (true) {
-      points_with_normals->col(kIndex)[1] = distr(rng);
-      if (points_with_normals->col(kIndex)[1] > -inlier_threshold) {
-        break;
-      }
-    }
-    points_with_normals->col(kIndex)[2] = 0.0;
-    points_with_normals->col(kIndex)[3] = 1.0;
-  }
-
-  // Randomly generates outliers in the range [0, 1] x [-0.5, 0.5].
-  std::uniform_real_distribution<double> distr_x(0.0, 1.0);
-  std::uniform_real_distribution<double> distr_y(-0.5, 0.5);
-  for (int i = num_inliers; i < kNumPoints; ++i) {
-    double x = distr_x(rng);
-    double y = distr_y(rng);
-    while (std::fabs(y) < 5.0 * inlier_threshold) {
-      y = distr_y(rng);
-    }
-
-    const int kIndex = indices[i];
-    points_with_normals->col(kIndex)[0] = x;
-    points_with_normals->col(kIndex)[1] = y;
-
-    points_with_normals->col(kIndex)[2] = 0.0;
-    points_with_normals->col(kIndex)[3] = 0.0;
-    while (points_with_normals->col(kIndex).tail<2>().norm() < 0.5) {
-      points_with_normals->col(kIndex)[2] = distr_y(rng);
-      points_with_normals->col(kIndex)[3] = distr_y(rng);
-      points_with_normals->col(kIndex).tail<2>().normalize();
-    }
-  }
-
-  // Rotates and translates the points.
-  for (int i = 0; i < kNumPoints; ++i) {
-    Eigen::Vector2d p = R * points_with_normals->col(i).head<2>() + t;
-    points_with_normals->col(i).head<2>() = p;
-    Eigen::Vector2d n = R * points_with_normals->col(i).tail<2>();
-    points_with_normals->col(i).tail<2>() = n;
-  }
-}
+#include "synthetic_datasets.h"
 
 int main(int argc, char** argv) {
   ransac_lib::HybridLORansacOptions options;
@@ -134,8 +56,12 @@ int main(int argc, char** argv) {
   options.squared_inlier_thresholds_ = {0.01 * 0.01, 0.01 * 0.01};
   options.data_type_weights_ = {2.0, 0.5};
 
-  std::random_device rand_dev;
-  options.random_seed_ = rand_dev();
+  // The seed can be passed as the first argument. The same seed is used to
+  // generate the instances and for RANSAC.
+  const unsigned int kSeed =
+      argc > 1 ? static_cast<unsigned int>(std::stoul(argv[1])) : 0u;
+  options.random_seed_ = kSeed;
+  std::mt19937 rng(kSeed);
 
   // Generates random instances for outlier ratios 10%, 20%, 30%, ..., 90%,
   // and then applies HybridRANSAC on it.
@@ -151,11 +77,14 @@ int main(int argc, char** argv) {
 
     Eigen::Matrix2d R;
     Eigen::Vector2d t;
-    GenerateRandomTransform(&R, &t);
+    ransac_lib::synthetic::GenerateRandomTransform(&rng, &R, &t);
 
     Eigen::Matrix4Xd data;
-    GenerateRandomInstance(num_inliers_points, num_outliers_points, 0.5 * 0.01,
-                           R, t, &data);
+    Eigen::Vector3d gt_line;
+    std::vector<int> gt_inliers;
+    ransac_lib::synthetic::GenerateLineInstance(
+        num_inliers_points, num_outliers_points, 0.5 * 0.01, R, t, &rng, &data,
+        &gt_line, &gt_inliers);
     Eigen::Matrix2Xd points(2, data.cols());
     points.row(0) = data.row(0);
     points.row(1) = data.row(1);
@@ -165,9 +94,9 @@ int main(int argc, char** argv) {
     int num_inliers_points_with_normals =
         kNumDataPointsWithNormals - num_outliers_points_with_normals;
 
-    GenerateRandomInstance(num_inliers_points_with_normals,
-                           num_outliers_points_with_normals, 0.5 * 0.01, R, t,
-                           &data);
+    ransac_lib::synthetic::GenerateLineInstance(
+        num_inliers_points_with_normals, num_outliers_points_with_normals,
+        0.5 * 0.01, R, t, &rng, &data, &gt_line, &gt_inliers);
     Eigen::Matrix4Xd points_with_normals = data;
     std::cout << "   ... instance generated" << std::endl;
 
@@ -47,14 +47,29 @@ namespace ransac_lib {
 
 HybridLineEstimator::HybridLineEstimator(
     const Eigen::Matrix2Xd& points, const Eigen::Matrix4Xd& points_with_normals,
-    const std::vector<double>& prior_probabilities) {
-  points_ = points;
+    const std::vector<double>& prior_probabilities)
+    : owned_points_(std::make_shared<const Eigen::Matrix2Xd>(points)),
+      owned_points_with_normals_(
+          std::make_shared<const Eigen::Matrix4Xd>(points_with_normals)),
+      points_(owned_points_->data(), 2, owned_points_->cols()),
+      points_with_normals_(owned_points_with_normals_->data(), 4,
+                           owned_points_with_normals_->cols()) {
   num_points_ = points_.cols();
-  points_with_normals_ = points_with_normals;
   num_points_with_normals_ = points_with_normals_.cols();
   prior_probabilities_ = prior_probabilities;
 }
 
+HybridLineEstimator::HybridLineEstimator(
+    const double* points, const int num_points,
+    const double* points_with_normals, const int num_points_with_normals,
+    const std::vector<double>& prior_probabilities)
+    : points_(points, 2, num_points),
+      points_with_normals_(points_with_normals, 4, num_points_with_normals) {
+  num_points_ = num_points;
+  num_points_with_normals_ = num_points_with_normals;
+  prior_probabilities_ = prior_probabilities;
+}
+
 void HybridLineEstimator::LeastSquares(
     const std::vector<std::vector<int>>& sample, Eigen::Vector3d* line) const {
   const int kNumSamplesPoints = static_cast<int>(sample[0].size());
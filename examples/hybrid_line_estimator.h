@@ -28,14 +28,15 @@
 //
 // author: Torsten Sattler, torsten.sattler.de@googlemail.com
 
-#ifndef RANSACLIB_EXAMPLE_LINE_ESTIMATOR_H_
-#define RANSACLIB_EXAMPLE_LINE_ESTIMATOR_H_
+#ifndef RANSACLIB_EXAMPLE_HYBRID_LINE_ESTIMATOR_H_
+#define RANSACLIB_EXAMPLE_HYBRID_LINE_ESTIMATOR_H_
 
 #include <algorithm>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <limits>
+#include <memory>
 #include <random>
 #include <vector>
 
@@ -54,6 +55,15 @@ class HybridLineEstimator {
                       const Eigen::Matrix4Xd& points_with_normals,
                       const std::vector<double>& prior_probabilities);
 
+  // Does not copy the data, which needs to outlive the estimator. The points
+  // are expected as the columns of a column-major 2xN matrix (or the rows of
+  // a row-major Nx2 array), the points with normals as the columns of a
+  // column-major 4xM matrix, where each column stores x, y, n_x, n_y.
+  HybridLineEstimator(const double* points, const int num_points,
+                      const double* points_with_normals,
+                      const int num_points_with_normals,
+                      const std::vector<double>& prior_probabilities);
+
   inline int num_minimal_solvers() const { return 2; }
 
   inline void min_sample_sizes(
@@ -99,13 +109,17 @@ class HybridLineEstimator {
   int PointNormalSolver(const std::vector<int>& sample,
                         std::vector<Eigen::Vector3d>* lines) const;
 
-  Eigen::Matrix2Xd points_;
+  // Hold the copies of the data if the estimator was constructed from
+  // matrices. Copies of the estimator share them.
+  std::shared_ptr<const Eigen::Matrix2Xd> owned_points_;
+  std::shared_ptr<const Eigen::Matrix4Xd> owned_points_with_normals_;
+  Eigen::Map<const Eigen::Matrix2Xd> points_;
   int num_points_;
-  Eigen::Matrix4Xd points_with_normals_;
+  Eigen::Map<const Eigen::Matrix4Xd> points_with_normals_;
   int num_points_with_normals_;
   std::vector<double> prior_probabilities_;
 };
 
 }  // namespace ransac_lib
 
-#endif  // RANSACLIB_EXAMPLE_LINE_ESTIMATOR_H_
+#endif  // RANSACLIB_EXAMPLE_HYBRID_LINE_ESTIMATOR_H_
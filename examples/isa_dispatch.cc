@@ -0,0 +1,113 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "isa_dispatch.h"
+
+namespace ransac_lib {
+
+namespace isa {
+
+namespace {
+
+// -1 as long as the level has not been determined.
+std::atomic<int> active_level(-1);
+
+}  // namespace
+
+IsaLevel SupportedIsaLevel() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  // __builtin_cpu_supports also checks that the operating system saves the
+  // corresponding registers on context switches.
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return IsaLevel::kAVX512;
+  if (__builtin_cpu_supports("avx2")) return IsaLevel::kAVX2;
+#endif
+  return IsaLevel::kBaseline;
+}
+
+IsaLevel ActiveIsaLevel() {
+  int level = active_level.load(std::memory_order_relaxed);
+  if (level >= 0) return static_cast<IsaLevel>(level);
+
+  IsaLevel selected = SupportedIsaLevel();
+  const char* requested = std::getenv("RANSACLIB_ISA");
+  if (requested != nullptr && requested[0] != '\0') {
+    IsaLevel requested_level;
+    if (ParseIsaLevel(requested, &requested_level)) {
+      selected = std::min(selected, requested_level);
+    } else {
+      std::cerr << " WARNING: Ignoring unknown RANSACLIB_ISA " << requested
+                << std::endl;
+    }
+  }
+  // Concurrent first calls determine the same level.
+  active_level.store(static_cast<int>(selected), std::memory_order_relaxed);
+  return selected;
+}
+
+IsaLevel SetActiveIsaLevel(const IsaLevel level) {
+  const IsaLevel kLevel = std::min(level, SupportedIsaLevel());
+  active_level.store(static_cast<int>(kLevel), std::memory_order_relaxed);
+  return kLevel;
+}
+
+const char* IsaName(const IsaLevel level) {
+  switch (level) {
+    case IsaLevel::kAVX2:
+      return "avx2";
+    case IsaLevel::kAVX512:
+      return "avx512";
+    case IsaLevel::kBaseline:
+    default:
+      return "baseline";
+  }
+}
+
+bool ParseIsaLevel(const std::string& name, IsaLevel* level) {
+  const IsaLevel kLevels[] = {IsaLevel::kBaseline, IsaLevel::kAVX2,
+                              IsaLevel::kAVX512};
+  for (const IsaLevel kLevel : kLevels) {
+    if (name == IsaName(kLevel)) {
+      *level = kLevel;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace isa
+
+}  // namespace ransac_lib
@@ -0,0 +1,71 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#ifndef RANSACLIB_EXAMPLE_ISA_DISPATCH_H_
+#define RANSACLIB_EXAMPLE_ISA_DISPATCH_H_
+
+#include <string>
+
+namespace ransac_lib {
+
+namespace isa {
+
+// The instruction set levels for which the vectorized kernels (see
+// reprojection_kernels.h) are compiled. All levels are built into every
+// binary, independently of the compiler flags, and the best level supported
+// by the CPU is picked at run-time. This allows to build the examples without
+// architecture-specific flags such as -march=native and to run the same
+// binary on machines with and without AVX2 or AVX-512.
+enum class IsaLevel : int { kBaseline = 0, kAVX2 = 1, kAVX512 = 2 };
+
+// The best level supported by the CPU and the operating system. Always
+// kBaseline on non-x86 architectures.
+IsaLevel SupportedIsaLevel();
+
+// The level used by the kernels. Defaults to SupportedIsaLevel(), limited by
+// the environment variable RANSACLIB_ISA ("baseline", "avx2", or "avx512")
+// if it is set.
+IsaLevel ActiveIsaLevel();
+
+// Selects the level used by the kernels, e.g., for benchmarking. Levels not
+// supported by the CPU are replaced by SupportedIsaLevel(). Returns the
+// level that is used.
+IsaLevel SetActiveIsaLevel(const IsaLevel level);
+
+const char* IsaName(const IsaLevel level);
+
+// Returns false if the name does not describe a level.
+bool ParseIsaLevel(const std::string& name, IsaLevel* level);
+
+}  // namespace isa
+
+}  // namespace ransac_lib
+
+#endif  // RANSACLIB_EXAMPLE_ISA_DISPATCH_H_
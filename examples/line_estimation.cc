@@ -35,6 +35,7 @@
 #include <iostream>
 #include <limits>
 #include <random>
+#include <string>
 #include <vector>
 
 #include <Eigen/Core>
@@ -44,66 +45,7 @@
 
 #include <RansacLib/ransac.h>
 #include "line_estimator.h"
-
-// Assumes that inlier threshold << 0.5.
-void GenerateRandomInstance(const int num_inliers, const int num_outliers,
-                            double inlier_threshold, Eigen::Matrix2Xd* points) {
-  const int kNumPoints = num_inliers + num_outliers;
-  points->resize(2, kNumPoints);
-
-  std::vector<int> indices(kNumPoints);
-  std::iota(indices.begin(), indices.end(), 0);
-
-  std::random_device rand_dev;
-  std::mt19937 rng(rand_dev());
-
-  std::shuffle(indices.begin(), indices.end(), rng);
-
-  // Generates num_inliers points along the x-axis in the interval [0, 1] with
-  // a y-value in the range (-inlier_threshold, inlier_threshold) choosen
-  // at random.
-  std::uniform_real_distribution<double> distr(-inlier_threshold,
-                                               inlier_threshold);
-
-  const double kXStep = 1.0 / static_cast<double>(num_inliers);
-  double x = 0.0;
-  for (int i = 0; i < num_inliers; ++i, x += kXStep) {
-    const int kIndex = indices[i];
-    points->col(kIndex)[0] = x;
-    while (true) {
-      points->col(kIndex)[1] = distr(rng);
-      if (points->col(kIndex)[1] > -inlier_threshold) {
-        break;
-      }
-    }
-  }
-
-  // Randomly generates outliers in the range [0, 1] x [-0.5, 0.5].
-  std::uniform_real_distribution<double> distr_x(0.0, 1.0);
-  std::uniform_real_distribution<double> distr_y(-0.5, 0.5);
-  for (int i = num_inliers; i < kNumPoints; ++i) {
-    double x = distr_x(rng);
-    double y = distr_y(rng);
-    while (std::fabs(y) < 5.0 * inlier_threshold) {
-      y = distr_y(rng);
-    }
-
-    const int kIndex = indices[i];
-    points->col(kIndex)[0] = x;
-    points->col(kIndex)[1] = y;
-  }
-
-  // Randomly rotates and translates the points.
-  const double kAngle = distr_y(rng) * M_PI;
-  Eigen::Matrix2d R;
-  R << std::cos(kAngle), -std::sin(kAngle), std::sin(kAngle), std::cos(kAngle);
-  Eigen::Vector2d t(distr_y(rng) * 10.0, distr_y(rng) * 10.0);
-
-  for (int i = 0; i < kNumPoints; ++i) {
-    Eigen::Vector2d p = R * points->col(i) + t;
-    points->col(i) = p;
-  }
-}
+#include "synthetic_datasets.h"
 
 int main(int argc, char** argv) {
   ransac_lib::LORansacOptions options;
@@ -111,8 +53,12 @@ int main(int argc, char** argv) {
   options.max_num_iterations_ = 100000u;
   options.squared_inlier_threshold_ = 0.01 * 0.01;
 
-  std::random_device rand_dev;
-  options.random_seed_ = rand_dev();
+  // The seed can be passed as the first argument. The same seed is used to
+  // generate the instances and for RANSAC.
+  const unsigned int kSeed =
+      argc > 1 ? static_cast<unsigned int>(std::stoul(argv[1])) : 0u;
+  options.random_seed_ = kSeed;
+  std::mt19937 rng(kSeed);
 
   // Generates random instances for outlier ratios 10%, 20%, 30%, ..., 90%,
   // and then applies RANSAC on it.
@@ -127,7 +73,11 @@ int main(int argc, char** argv) {
     int num_inliers = kNumDataPoints - num_outliers;
 
     Eigen::Matrix2Xd data;
-    GenerateRandomInstance(num_inliers, num_outliers, 0.5 * 0.01, &data);
+    Eigen::Vector3d gt_line;
+    std::vector<int> gt_inliers;
+    ransac_lib::synthetic::GenerateLineInstance(
+        num_inliers, num_outliers, 0.5 * 0.01, &rng, &data, &gt_line,
+        &gt_inliers);
     std::cout << "   ... instance generated" << std::endl;
 
     ransac_lib::LineEstimator solver(data);
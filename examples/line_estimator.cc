@@ -45,11 +45,17 @@
 
 namespace ransac_lib {
 
-LineEstimator::LineEstimator(const Eigen::Matrix2Xd& data) {
-  data_ = data;
+LineEstimator::LineEstimator(const Eigen::Matrix2Xd& data)
+    : owned_data_(std::make_shared<const Eigen::Matrix2Xd>(data)),
+      data_(owned_data_->data(), 2, owned_data_->cols()) {
   num_data_ = data_.cols();
 }
 
+LineEstimator::LineEstimator(const double* data, const int num_data)
+    : data_(data, 2, num_data) {
+  num_data_ = num_data;
+}
+
 int LineEstimator::MinimalSolver(const std::vector<int>& sample,
                                  std::vector<Eigen::Vector3d>* lines) const {
   lines->clear();
@@ -106,6 +112,35 @@ int LineEstimator::NonMinimalSolver(const std::vector<int>& sample,
   return 1;
 }
 
+void LineEstimator::WeightedLeastSquares(const std::vector<int>& sample,
+                                         const std::vector<double>& weights,
+                                         Eigen::Vector3d* line) const {
+  const int kNumSamples = static_cast<int>(sample.size());
+  if (kNumSamples < 2) return;
+
+  double sum_weights = 0.0;
+  Eigen::Vector2d mean(0.0, 0.0);
+  for (int i = 0; i < kNumSamples; ++i) {
+    mean += weights[i] * data_.col(sample[i]);
+    sum_weights += weights[i];
+  }
+  if (sum_weights <= 0.0) return;
+  mean /= sum_weights;
+
+  Eigen::Matrix2d C = Eigen::Matrix2d::Zero();
+  for (int i = 0; i < kNumSamples; ++i) {
+    Eigen::Vector2d d = data_.col(sample[i]) - mean;
+    C += weights[i] * d * d.transpose();
+  }
+
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix2d> eig_solver(C);
+  if (eig_solver.info() != Eigen::Success) return;
+
+  // The line normal is the direction of the smallest weighted variance.
+  line->head<2>() = eig_solver.eigenvectors().col(0);
+  (*line)[2] = -line->head<2>().dot(mean);
+}
+
 // Evaluates the line on the i-th data point.
 double LineEstimator::EvaluateModelOnPoint(const Eigen::Vector3d& line,
                                            int i) const {
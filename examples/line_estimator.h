@@ -36,6 +36,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <limits>
+#include <memory>
 #include <random>
 #include <vector>
 
@@ -47,8 +48,14 @@ namespace ransac_lib {
 // Implements a simple solver that estimates a line from two data points.
 class LineEstimator {
  public:
+  // Copies the data.
   LineEstimator(const Eigen::Matrix2Xd& data);
 
+  // Does not copy the data, which needs to outlive the estimator. The points
+  // are expected in the order x_1, y_1, x_2, y_2, ..., i.e., as the columns of
+  // a column-major 2xN matrix or as the rows of a row-major Nx2 array.
+  LineEstimator(const double* data, const int num_data);
+
   inline int min_sample_size() const { return 2; }
 
   inline int non_minimal_sample_size() const { return 6; }
@@ -72,9 +79,19 @@ class LineEstimator {
     NonMinimalSolver(sample, line);
   }
 
+  // Weighted linear least squares, where the squared distance of sample[i]
+  // to the line is weighted by weights[i]. Used by IRLSLocalOptimization (see
+  // policies.h). The line is not changed if the fit fails.
+  void WeightedLeastSquares(const std::vector<int>& sample,
+                            const std::vector<double>& weights,
+                            Eigen::Vector3d* line) const;
+
  protected:
+  // Holds the copy of the data if the estimator was constructed from a matrix.
+  // Copies of the estimator share it.
+  std::shared_ptr<const Eigen::Matrix2Xd> owned_data_;
   // Matrix holding the 2D points through which the line is fitted.
-  Eigen::Matrix2Xd data_;
+  Eigen::Map<const Eigen::Matrix2Xd> data_;
   int num_data_;
 };
 
@@ -33,6 +33,7 @@
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -50,258 +51,133 @@
 #include <opengv/types.hpp>
 
 #include <RansacLib/ransac.h>
+#include "batch_localization.h"
+#include "batch_metrics.h"
 #include "calibrated_absolute_pose_estimator.h"
-
-struct QueryData {
-  std::string name;
-  double c_x;
-  double c_y;
-
-  double focal_x;
-  double focal_y;
-
-  int width;
-  int height;
-
-  std::vector<double> radial;
-};
-
-// Loads the list of query images together with their intrinsics.
-bool LoadListAndFocals(const std::string& filename,
-                       std::vector<QueryData>* query_images) {
-  std::ifstream ifs(filename.c_str(), std::ios::in);
-  if (!ifs.is_open()) {
-    std::cerr << " ERROR: Cannot read the image list from " << filename
-              << std::endl;
-    return false;
-  }
-  std::string line;
-
-  query_images->clear();
-
-  while (std::getline(ifs, line)) {
-    std::stringstream s_stream(line);
-
-    std::string camera_type;
-
-    QueryData q;
-    s_stream >> q.name >> camera_type >> q.width >> q.height;
-    if (camera_type.compare("SIMPLE_RADIAL") == 0) {
-      q.radial.resize(1);
-      s_stream >> q.focal_x >> q.c_x >> q.c_y >> q.radial[0];
-      q.focal_y = q.focal_x;
-    } else if (camera_type.compare("PINHOLE") == 0) {
-      q.radial.clear();
-      s_stream >> q.focal_x >> q.focal_y >> q.c_x >> q.c_y;
-      q.focal_y = q.focal_x;
-    } else if (camera_type.compare("OPENCV") == 0) {
-      // The OPENCV camera model used in Colmap (see
-      // https://github.com/colmap/colmap/blob/master/src/base/camera_models.h
-      // for details).
-      q.radial.resize(4);
-      s_stream >> q.focal_x >> q.focal_y >> q.c_x >> q.c_y >> q.radial[0]
-               >> q.radial[1] >> q.radial[2] >> q.radial[3];
-    } else if (camera_type.compare("VSFM") == 0) {
-      q.radial.resize(1);
-      s_stream >> q.focal_x >> q.c_x >> q.c_y >> q.radial[0];
-      q.focal_y = q.focal_x;
-    } else if (camera_type.compare("BROWN_3_PARAMS") == 0) {
-      q.radial.resize(3);
-      s_stream >> q.focal_x >> q.focal_y >> q.c_x >> q.c_y >> q.radial[0]
-               >> q.radial[1] >> q.radial[2];
-    }
-    query_images->push_back(q);
-  }
-
-  ifs.close();
-
-  return true;
-}
-
-// Loads the 2D-3D matches found for that image from a text file.
-bool LoadMatches(const std::string& filename, bool invert_Y_Z,
-                 ransac_lib::calibrated_absolute_pose::Points2D* points2D,
-                 ransac_lib::calibrated_absolute_pose::Points3D* points3D) {
-  points2D->clear();
-  points3D->clear();
-
-  std::ifstream ifs(filename.c_str(), std::ios::in);
-  if (!ifs.is_open()) {
-    std::cerr << " ERROR: Cannot read the matches from " << filename
-              << std::endl;
-    return false;
-  }
-  std::string line;
-
-  while (std::getline(ifs, line)) {
-    std::stringstream s_stream(line);
-
-    Eigen::Vector2d p2D;
-    Eigen::Vector3d p3D;
-    s_stream >> p2D[0] >> p2D[1] >> p3D[0] >> p3D[1] >> p3D[2];
-
-    if (invert_Y_Z) {
-      // Inverting the y- and z-coordinate due to a choice of coordinate system.
-      p3D[1] *= -1.0;
-      p3D[2] *= -1.0;
-    }
-
-    points2D->push_back(p2D);
-    points3D->push_back(p3D);
-  }
-
-  return true;
-}
+#include "localization_io.h"
+#include "map_store.h"
+#include "ransac_replay.h"
 
 int main(int argc, char** argv) {
-  using ransac_lib::LocallyOptimizedMSAC;
-  using ransac_lib::calibrated_absolute_pose::CalibratedAbsolutePoseEstimator;
-  using ransac_lib::calibrated_absolute_pose::CameraPose;
-  using ransac_lib::calibrated_absolute_pose::CameraPoses;
-  using ransac_lib::calibrated_absolute_pose::Points2D;
-  using ransac_lib::calibrated_absolute_pose::Points3D;
+  using ransac_lib::batch_localization::FormatPose;
+  using ransac_lib::batch_localization::LocalizationSettings;
+  using ransac_lib::batch_localization::PipelineOptions;
+  using ransac_lib::batch_localization::ProcessedQuery;
+  using ransac_lib::batch_localization::QueryResult;
+  using ransac_lib::localization_io::LoadListIntrinsics;
+  using ransac_lib::localization_io::QueryData;
+  using ransac_lib::localization_io::Queries;
 
   std::cout << " usage: " << argv[0] << " images_with_intrinsics outfile "
             << "inlier_threshold num_lo_steps invert_Y_Z points_centered "
-            << "[match-file postfix]"
+            << "[match-file postfix] "
+            << ransac_lib::batch_localization::kPipelineArgumentsUsage
             << std::endl;
   if (argc < 7) return -1;
-  
-  bool invert_Y_Z = static_cast<bool>(atoi(argv[5]));
-  bool points_centered = static_cast<bool>(atoi(argv[6]));
 
-  std::vector<QueryData> query_data;
+  LocalizationSettings settings;
+  settings.inlier_threshold = static_cast<double>(atof(argv[3]));
+  settings.num_lo_steps = atoi(argv[4]);
+  settings.invert_Y_Z = static_cast<bool>(atoi(argv[5]));
+  settings.points_centered = static_cast<bool>(atoi(argv[6]));
+  settings.matchfile_postfix = ".individual_datasets.matches.txt";
+  if (argc >= 8) {
+    settings.matchfile_postfix = std::string(argv[7]);
+  }
+  settings.min_num_matches = 4;
+  // Runs with the same seed produce the same output files, independently of
+  // the number of threads.
+  PipelineOptions pipeline;
+  ransac_lib::batch_localization::ParsePipelineArguments(argc, argv, 8,
+                                                         &settings, &pipeline);
+
+  // If RANSACLIB_MAP is set, the match files reference the 3D points of the
+  // map by their IDs.
+  ransac_lib::map_store::MapStore map;
+  if (!ransac_lib::batch_localization::UseMapFromEnvironment(&map,
+                                                             &settings)) {
+    return -1;
+  }
+  if (settings.map != nullptr) {
+    std::cout << " Using a map with " << map.num_points() << " points"
+              << std::endl;
+  }
+  std::cout << " Using " << pipeline.num_workers << " RANSAC thread(s), "
+            << pipeline.num_loaders << " loader thread(s), queue depths "
+            << pipeline.load_queue_depth << " / "
+            << pipeline.result_queue_depth << ", and random seed "
+            << settings.random_seed << std::endl;
+
+  Queries query_data;
   std::string list(argv[1]);
 
-  if (!LoadListAndFocals(list, &query_data)) {
+  if (!LoadListIntrinsics(list, &query_data)) {
     std::cerr << " ERROR: Could not read the data from " << list << std::endl;
     return -1;
   }
   const int kNumQuery = static_cast<int>(query_data.size());
   std::cout << " Found " << kNumQuery << " query images " << std::endl;
 
-  std::ofstream ofs(argv[2], std::ios::out);
+  // Poses are written through a large buffer instead of being flushed one by
+  // one.
+  std::vector<char> ofs_buffer(1 << 20);
+  std::ofstream ofs;
+  ofs.rdbuf()->pubsetbuf(ofs_buffer.data(),
+                         static_cast<std::streamsize>(ofs_buffer.size()));
+  ofs.open(argv[2], std::ios::out);
   if (!ofs.is_open()) {
     std::cerr << " ERROR: Cannot write to " << argv[2] << std::endl;
     return -1;
   }
 
-  std::string matchfile_postfix = ".individual_datasets.matches.txt";
-  if (argc >= 8) {
-    matchfile_postfix = std::string(argv[7]);
-  }
-  for (int i = 0; i < kNumQuery; ++i) {
-    std::cout << std::endl << std::endl;
-
-    Points2D points2D;
-    Points3D points3D;
-    std::string matchfile(query_data[i].name);
-    matchfile.append(matchfile_postfix);
-    if (!LoadMatches(matchfile, invert_Y_Z, &points2D, &points3D)) {
-      std::cerr << "  ERROR: Could not load matches from " << matchfile
-                << std::endl;
-      continue;
+  // Runs are recorded into replay files if RANSACLIB_RECORD_DIR is set.
+  const ransac_lib::replay::RecordSettings kRecordSettings =
+      ransac_lib::replay::RecordSettingsFromEnvironment();
+
+  ransac_lib::metrics::BatchMetrics metrics;
+  metrics.Start();
+
+  // Called in the order of the queries, such that the output does not depend
+  // on the number of threads.
+  auto write_result = [&](const QueryData& query,
+                          const ProcessedQuery& processed) {
+    const QueryResult& result = processed.result;
+    std::cout << std::endl << std::endl << processed.log;
+    if (!result.ransac_run) {
+      metrics.AddSkippedQuery();
+      return;
     }
-    
-    const int kNumMatches = static_cast<int>(points2D.size());
-//    // Writes out the matches after subtracting the principal point.
-//    {
-//      for (int j = 0; j < kNumMatches; ++j) {
-//        points2D[j][0] -= query_data[i].c_x;
-//        points2D[j][1] -= query_data[i].c_y;
-//      }
-//
-//      std::ofstream ofs(matchfile.c_str(), std::ios::out);
-//      if (ofs.is_open()) {
-//        std::cout << " Updating match file" << std::endl;
-//
-//        for (int j = 0; j < kNumMatches; ++j) {
-//          ofs << std::setprecision(12) << points2D[j][0] << " "
-//              << points2D[j][1] << " " << points3D[j][0] << " "
-//              << points3D[j][1] << " " << points3D[j][2] << std::endl;
-//        }
-//
-//        ofs.close();
-//      }
-//    }
-    
-    std::cout << " image " << query_data[i].name << " has # " << kNumMatches
-              << " matches as input to RANSAC" << std::endl;
-    if (kNumMatches <= 3) {
-      std::cout << " Found only " << kNumMatches << " matches for query image "
-                << query_data[i].name << " -> skipping image" << std::endl;
-      continue;
-    }
-    std::cout << "  " << i << " " << query_data[i].name << " "
-              << query_data[i].focal_x << " " << query_data[i].focal_y
-              << std::endl;
-    opengv::bearingVectors_t rays;
-    if (!points_centered) {
-      for (int j = 0; j < kNumMatches; ++j) {
-        points2D[j][0] -= query_data[i].c_x;
-        points2D[j][1] -= query_data[i].c_y;
-      }
+    metrics.AddQuery(result.seconds, result.statistics.num_iterations,
+                     result.statistics.number_lo_iterations,
+                     result.num_inliers);
+    if (kRecordSettings.enabled &&
+        result.seconds >= kRecordSettings.min_seconds) {
+      ransac_lib::replay::PoseReplayRecord record;
+      record.name = query.name;
+      record.options = result.options;
+      record.focal_x = query.focal_x;
+      record.focal_y = query.focal_y;
+      record.solver_squared_inlier_threshold =
+          result.options.squared_inlier_threshold_;
+      record.points2D = processed.matches.points2D;
+      record.points3D = processed.matches.points3D;
+      record.num_ransac_inliers = result.num_inliers;
+      record.best_model = result.pose;
+      record.statistics = result.statistics;
+      ransac_lib::replay::WriteReplayFile(
+          ransac_lib::replay::ReplayFilename(kRecordSettings, query.name),
+          record);
     }
-    CalibratedAbsolutePoseEstimator::PixelsToViewingRays(
-        query_data[i].focal_x, query_data[i].focal_y, points2D, &rays);
-
-    ransac_lib::LORansacOptions options;
-    options.min_num_iterations_ = 100u;
-    options.max_num_iterations_ = 10000u;
-    options.min_sample_multiplicator_ = 7;
-    options.num_lsq_iterations_ = 4;
-    options.num_lo_steps_ = atoi(argv[4]);
-    options.lo_starting_iterations_ = 60;
-    options.final_least_squares_ = true;
-
-    std::random_device rand_dev;
-    options.random_seed_ = rand_dev();
-
-    const double kInThreshPX = static_cast<double>(atof(argv[3]));
-    options.squared_inlier_threshold_ = kInThreshPX * kInThreshPX;
-
-    CalibratedAbsolutePoseEstimator solver(
-        query_data[i].focal_x, query_data[i].focal_y, kInThreshPX * kInThreshPX,
-        points2D, rays, points3D);
-
-    LocallyOptimizedMSAC<CameraPose, CameraPoses,
-                         CalibratedAbsolutePoseEstimator>
-        lomsac;
-    ransac_lib::RansacStatistics ransac_stats;
-    CameraPose best_model;
-
-    std::cout << "   " << query_data[i].name << " : running LO-MSAC on "
-              << kNumMatches << " matches " << std::endl;
-    auto ransac_start = std::chrono::system_clock::now();
-
-    int num_ransac_inliers =
-        lomsac.EstimateModel(options, solver, &best_model, &ransac_stats);
-    auto ransac_end = std::chrono::system_clock::now();
-    std::chrono::duration<double> elapsed_seconds = ransac_end - ransac_start;
-    std::cout << "   ... LOMSAC found " << num_ransac_inliers << " inliers in "
-              << ransac_stats.num_iterations
-              << " iterations with an inlier ratio of "
-              << ransac_stats.inlier_ratio << std::endl;
-    std::cout << "   ... LOMSAC took " << elapsed_seconds.count() << " s"
-              << std::endl;
-    std::cout << "   ... LOMSAC executed " << ransac_stats.number_lo_iterations
-              << " local optimization stages" << std::endl;
-
-    std::cout << "  Image " << query_data[i].name << " : we found # "
-              << num_ransac_inliers << " inliers" << std::endl;
-
-    //    if (num_ransac_inliers < 12) continue;
-
-    Eigen::Matrix3d R = best_model.topLeftCorner<3, 3>();
-    Eigen::Vector3d t = -R * best_model.col(3);
-    Eigen::Quaterniond q(R);
-    q.normalize();
-
-    ofs << query_data[i].name << " " << q.w() << " " << q.x() << " " << q.y()
-        << " " << q.z() << " " << t[0] << " " << t[1] << " " << t[2]
-        << std::endl;
-  }
+    ofs << FormatPose(query.name, result.pose);
+  };
+  ransac_lib::batch_localization::RunPipeline(query_data, 0, settings,
+                                              pipeline, write_result);
 
   ofs.close();
+
+  metrics.Stop();
+  std::string metrics_file(argv[2]);
+  metrics.WritePrometheus(metrics_file + ".metrics.prom", "localization");
+  metrics.WriteJSON(metrics_file + ".metrics.json", "localization");
   return 0;
 }
@@ -0,0 +1,255 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "localization_checkpoint.h"
+
+namespace ransac_lib {
+
+namespace checkpoint {
+
+namespace {
+
+const char kMagic[] = "RLCKPT";
+const int kVersion = 1;
+
+bool ParseHeader(const std::string& line, CheckpointHeader* header) {
+  std::istringstream s_stream(line);
+  std::string magic;
+  int version = 0;
+  int invert_Y_Z = 0;
+  int points_centered = 0;
+  s_stream >> magic >> version >> header->random_seed >>
+      header->inlier_threshold >> header->num_lo_steps >> invert_Y_Z >>
+      points_centered >> header->num_queries;
+  if (s_stream.fail() || magic != kMagic || version != kVersion) return false;
+  header->invert_Y_Z = invert_Y_Z != 0;
+  header->points_centered = points_centered != 0;
+  // The postfix is the remainder of the line without the separating space.
+  std::getline(s_stream, header->matchfile_postfix);
+  if (!header->matchfile_postfix.empty()) {
+    header->matchfile_postfix.erase(0, 1);
+  }
+  return true;
+}
+
+bool ParseRecord(const std::string& line, QueryRecord* record) {
+  std::istringstream s_stream(line);
+  int ransac_run = 0;
+  s_stream >> record->index >> record->name >> ransac_run >>
+      record->num_matches >> record->num_inliers >> record->num_iterations >>
+      record->num_lo_iterations >> record->inlier_ratio >> record->seconds;
+  for (int r = 0; r < 3; ++r) {
+    for (int c = 0; c < 4; ++c) s_stream >> record->pose(r, c);
+  }
+  record->ransac_run = ransac_run != 0;
+  return !s_stream.fail();
+}
+
+}  // namespace
+
+CheckpointHeader HeaderFromSettings(
+    const batch_localization::LocalizationSettings& settings,
+    const int num_queries) {
+  CheckpointHeader header;
+  header.random_seed = settings.random_seed;
+  header.inlier_threshold = settings.inlier_threshold;
+  header.num_lo_steps = settings.num_lo_steps;
+  header.invert_Y_Z = settings.invert_Y_Z;
+  header.points_centered = settings.points_centered;
+  header.num_queries = num_queries;
+  header.matchfile_postfix = settings.matchfile_postfix;
+  return header;
+}
+
+bool SameSettings(const CheckpointHeader& a, const CheckpointHeader& b) {
+  return a.inlier_threshold == b.inlier_threshold &&
+         a.num_lo_steps == b.num_lo_steps && a.invert_Y_Z == b.invert_Y_Z &&
+         a.points_centered == b.points_centered &&
+         a.num_queries == b.num_queries &&
+         a.matchfile_postfix == b.matchfile_postfix;
+}
+
+QueryRecord RecordFromResult(const int index, const std::string& name,
+                             const batch_localization::QueryResult& result) {
+  QueryRecord record;
+  record.index = index;
+  record.name = name;
+  record.ransac_run = result.ransac_run;
+  record.num_matches = result.num_matches;
+  if (result.ransac_run) {
+    record.num_inliers = result.num_inliers;
+    record.num_iterations = result.statistics.num_iterations;
+    record.num_lo_iterations = result.statistics.number_lo_iterations;
+    record.inlier_ratio = result.statistics.inlier_ratio;
+    record.seconds = result.seconds;
+    record.pose = result.pose;
+  } else {
+    record.num_inliers = 0;
+    record.num_iterations = 0u;
+    record.num_lo_iterations = 0;
+    record.inlier_ratio = 0.0;
+    record.seconds = 0.0;
+    record.pose.setIdentity();
+  }
+  return record;
+}
+
+bool ReadCheckpoint(const std::string& filename, CheckpointHeader* header,
+                    QueryRecords* records, size_t* valid_size) {
+  records->clear();
+  *valid_size = 0u;
+  std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!ifs.is_open()) return false;
+  std::stringstream buffer;
+  buffer << ifs.rdbuf();
+  const std::string kData = buffer.str();
+
+  size_t line_begin = 0u;
+  bool has_header = false;
+  while (true) {
+    const size_t kLineEnd = kData.find('\n', line_begin);
+    // Lines without a line break were not completely written.
+    if (kLineEnd == std::string::npos) break;
+    const std::string kLine = kData.substr(line_begin, kLineEnd - line_begin);
+    if (!has_header) {
+      if (!ParseHeader(kLine, header)) return false;
+      has_header = true;
+    } else {
+      QueryRecord record;
+      if (!ParseRecord(kLine, &record) ||
+          record.index != static_cast<int>(records->size())) {
+        break;
+      }
+      records->push_back(record);
+    }
+    line_begin = kLineEnd + 1u;
+    *valid_size = line_begin;
+  }
+  return has_header;
+}
+
+CheckpointWriter::CheckpointWriter(const double sync_interval_seconds)
+    : fd_(-1), sync_interval_seconds_(sync_interval_seconds) {}
+
+CheckpointWriter::~CheckpointWriter() { Close(); }
+
+bool CheckpointWriter::Create(const std::string& filename,
+                              const CheckpointHeader& header) {
+  Close();
+  fd_ = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  if (fd_ < 0) return false;
+  last_sync_ = std::chrono::steady_clock::now();
+
+  std::ostringstream s_stream;
+  s_stream << std::setprecision(17) << kMagic << " " << kVersion << " "
+           << header.random_seed << " " << header.inlier_threshold << " "
+           << header.num_lo_steps << " " << (header.invert_Y_Z ? 1 : 0) << " "
+           << (header.points_centered ? 1 : 0) << " " << header.num_queries
+           << " " << header.matchfile_postfix << "\n";
+  if (!WriteAll(s_stream.str())) return false;
+  Sync();
+  return true;
+}
+
+bool CheckpointWriter::Resume(const std::string& filename,
+                              const size_t valid_size) {
+  Close();
+  fd_ = open(filename.c_str(), O_WRONLY | O_APPEND);
+  if (fd_ < 0) return false;
+  last_sync_ = std::chrono::steady_clock::now();
+  if (ftruncate(fd_, static_cast<off_t>(valid_size)) != 0) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool CheckpointWriter::Add(const QueryRecord& record) {
+  std::ostringstream s_stream;
+  s_stream << std::setprecision(17) << record.index << " " << record.name
+           << " " << (record.ransac_run ? 1 : 0) << " " << record.num_matches
+           << " " << record.num_inliers << " " << record.num_iterations << " "
+           << record.num_lo_iterations << " " << record.inlier_ratio << " "
+           << record.seconds;
+  for (int r = 0; r < 3; ++r) {
+    for (int c = 0; c < 4; ++c) s_stream << " " << record.pose(r, c);
+  }
+  s_stream << "\n";
+  // A single write per record, such that a terminated process leaves at most
+  // one incomplete record.
+  if (!WriteAll(s_stream.str())) return false;
+
+  std::chrono::duration<double> since_sync =
+      std::chrono::steady_clock::now() - last_sync_;
+  if (since_sync.count() >= sync_interval_seconds_) Sync();
+  return true;
+}
+
+void CheckpointWriter::Close() {
+  if (fd_ < 0) return;
+  Sync();
+  close(fd_);
+  fd_ = -1;
+}
+
+bool CheckpointWriter::WriteAll(const std::string& data) {
+  if (fd_ < 0) return false;
+  size_t num_written = 0u;
+  while (num_written < data.size()) {
+    const ssize_t kResult =
+        write(fd_, data.data() + num_written, data.size() - num_written);
+    if (kResult < 0 && errno == EINTR) continue;
+    if (kResult <= 0) return false;
+    num_written += static_cast<size_t>(kResult);
+  }
+  return true;
+}
+
+void CheckpointWriter::Sync() {
+  fdatasync(fd_);
+  last_sync_ = std::chrono::steady_clock::now();
+}
+
+}  // namespace checkpoint
+
+}  // namespace ransac_lib
@@ -0,0 +1,135 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#ifndef RANSACLIB_EXAMPLE_LOCALIZATION_CHECKPOINT_H_
+#define RANSACLIB_EXAMPLE_LOCALIZATION_CHECKPOINT_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+#include "batch_localization.h"
+#include "calibrated_absolute_pose_estimator.h"
+
+namespace ransac_lib {
+
+namespace checkpoint {
+
+// Identifies the run a checkpoint belongs to. A checkpoint can only be used
+// to resume a run with the same settings and query list.
+struct CheckpointHeader {
+  unsigned int random_seed;
+  double inlier_threshold;
+  int num_lo_steps;
+  bool invert_Y_Z;
+  bool points_centered;
+  int num_queries;
+  std::string matchfile_postfix;
+};
+
+CheckpointHeader HeaderFromSettings(
+    const batch_localization::LocalizationSettings& settings,
+    const int num_queries);
+
+// Returns true if both headers agree on everything but the random seed.
+bool SameSettings(const CheckpointHeader& a, const CheckpointHeader& b);
+
+// Everything that is needed to compute the outputs of a batch run for a
+// single query without running RANSAC again.
+struct QueryRecord {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  int index;
+  std::string name;
+  bool ransac_run;
+  int num_matches;
+  int num_inliers;
+  uint32_t num_iterations;
+  int num_lo_iterations;
+  double inlier_ratio;
+  double seconds;
+  calibrated_absolute_pose::CameraPose pose;
+};
+
+typedef std::vector<QueryRecord, Eigen::aligned_allocator<QueryRecord>>
+    QueryRecords;
+
+QueryRecord RecordFromResult(const int index, const std::string& name,
+                             const batch_localization::QueryResult& result);
+
+// Reads an existing checkpoint. Returns false if the file does not exist or
+// cannot be parsed. The records are stored in the order of the queries,
+// starting with query 0. An incomplete record at the end of the file, e.g.,
+// written while the process was terminated, is ignored. *valid_size is set to
+// the number of bytes occupied by the header and the complete records.
+bool ReadCheckpoint(const std::string& filename, CheckpointHeader* header,
+                    QueryRecords* records, size_t* valid_size);
+
+// Appends one line per query to a checkpoint file. Every record is passed to
+// the operating system as soon as it is added, i.e., it survives the process
+// being terminated. In addition, the file is synced to disk at most every
+// sync_interval_seconds seconds and when it is closed.
+class CheckpointWriter {
+ public:
+  explicit CheckpointWriter(const double sync_interval_seconds);
+  ~CheckpointWriter();
+  CheckpointWriter(const CheckpointWriter&) = delete;
+  CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+  // Starts a new checkpoint, replacing any existing file.
+  bool Create(const std::string& filename, const CheckpointHeader& header);
+
+  // Continues an existing checkpoint after discarding everything after the
+  // first valid_size bytes (see ReadCheckpoint).
+  bool Resume(const std::string& filename, const size_t valid_size);
+
+  bool Add(const QueryRecord& record);
+
+  // Syncs and closes the file.
+  void Close();
+
+ protected:
+  bool WriteAll(const std::string& data);
+  void Sync();
+
+  int fd_;
+  double sync_interval_seconds_;
+  std::chrono::steady_clock::time_point last_sync_;
+};
+
+}  // namespace checkpoint
+
+}  // namespace ransac_lib
+
+#endif  // RANSACLIB_EXAMPLE_LOCALIZATION_CHECKPOINT_H_
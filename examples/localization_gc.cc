@@ -50,88 +50,7 @@
 
 #include <RansacLib/ransac.h>
 #include "calibrated_absolute_pose_estimator.h"
-
-struct QueryData {
-  std::string name;
-  double c_x;
-  double c_y;
-
-  double focal_x;
-  double focal_y;
-
-  int width;
-  int height;
-
-  std::vector<double> radial;
-};
-
-// Loads the list of query images together with their intrinsics.
-bool LoadListAndFocals(const std::string& filename,
-                       std::vector<QueryData>* query_images) {
-  std::ifstream ifs(filename.c_str(), std::ios::in);
-  if (!ifs.is_open()) {
-    std::cerr << " ERROR: Cannot read the image list from " << filename
-              << std::endl;
-    return false;
-  }
-  std::string line;
-
-  query_images->clear();
-
-  while (std::getline(ifs, line)) {
-    std::stringstream s_stream(line);
-
-    std::string camera_type;
-
-    QueryData q;
-    s_stream >> q.name >> camera_type >> q.width >> q.height;
-    if (camera_type.compare("SIMPLE_RADIAL") == 0) {
-      q.radial.resize(1);
-      s_stream >> q.focal_x >> q.c_x >> q.c_y >> q.radial[0];
-      q.focal_y = q.focal_x;
-    } else if (camera_type.compare("PINHOLE") == 0) {
-      q.radial.clear();
-      s_stream >> q.focal_x >> q.focal_y >> q.c_x >> q.c_y;
-    }
-    query_images->push_back(q);
-  }
-
-  ifs.close();
-
-  return true;
-}
-
-// Loads the 2D-3D matches found for that image from a text file.
-bool LoadMatches(const std::string& filename,
-                 ransac_lib::calibrated_absolute_pose::Points2D* points2D,
-                 ransac_lib::calibrated_absolute_pose::Points3D* points3D) {
-  points2D->clear();
-  points3D->clear();
-
-  std::ifstream ifs(filename.c_str(), std::ios::in);
-  if (!ifs.is_open()) {
-    std::cerr << " ERROR: Cannot read the matches from " << filename
-              << std::endl;
-    return false;
-  }
-  std::string line;
-
-  while (std::getline(ifs, line)) {
-    std::stringstream s_stream(line);
-
-    Eigen::Vector2d p2D;
-    Eigen::Vector3d p3D;
-    s_stream >> p2D[0] >> p2D[1] >> p3D[0] >> p3D[1] >> p3D[2];
-
-    p3D[1] *= -1.0;
-    p3D[2] *= -1.0;
-
-    points2D->push_back(p2D);
-    points3D->push_back(p3D);
-  }
-
-  return true;
-}
+#include "localization_io.h"
 
 int main(int argc, char** argv) {
   using ransac_lib::LocallyOptimizedMSAC;
@@ -140,15 +59,18 @@ int main(int argc, char** argv) {
   using ransac_lib::calibrated_absolute_pose::CameraPoses;
   using ransac_lib::calibrated_absolute_pose::Points2D;
   using ransac_lib::calibrated_absolute_pose::Points3D;
+  using ransac_lib::localization_io::LoadListIntrinsics;
+  using ransac_lib::localization_io::LoadMatches;
+  using ransac_lib::localization_io::Queries;
 
   std::cout << " usage: " << argv[0] << " images_with_intrinsics outfile "
             << "[match-file postfix]" << std::endl;
   if (argc < 3) return -1;
 
-  std::vector<QueryData> query_data;
+  Queries query_data;
   std::string list(argv[1]);
 
-  if (!LoadListAndFocals(list, &query_data)) {
+  if (!LoadListIntrinsics(list, &query_data)) {
     std::cerr << " ERROR: Could not read the data from " << list << std::endl;
     return -1;
   }
@@ -172,7 +94,7 @@ int main(int argc, char** argv) {
     Points3D points3D;
     std::string matchfile(query_data[i].name);
     matchfile.append(matchfile_postfix);
-    if (!LoadMatches(matchfile, &points2D, &points3D)) {
+    if (!LoadMatches(matchfile, true, &points2D, &points3D)) {
       std::cerr << "  ERROR: Could not load matches from " << matchfile
                 << std::endl;
       continue;
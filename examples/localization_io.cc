@@ -0,0 +1,359 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "localization_io.h"
+#include "match_file.h"
+
+namespace ransac_lib {
+
+namespace localization_io {
+
+namespace {
+
+// The camera models supported in the query lists. All models store their
+// parameters in the order focal length(s), principal point, distortion
+// parameters.
+struct CameraModel {
+  const char* name;
+  // 1 if the model uses a single focal length for both axes, 2 otherwise.
+  int num_focals;
+  int num_radial;
+};
+
+const CameraModel kCameraModels[] = {{"SIMPLE_RADIAL", 1, 1},
+                                     {"VSFM", 1, 1},
+                                     {"PINHOLE", 2, 0},
+                                     // The OPENCV camera model used in Colmap
+                                     // (see https://github.com/colmap/colmap/
+                                     // blob/master/src/base/camera_models.h).
+                                     {"OPENCV", 2, 4},
+                                     {"BROWN_3_PARAMS", 2, 3}};
+
+const CameraModel* FindCameraModel(const std::string_view name) {
+  for (const CameraModel& model : kCameraModels) {
+    if (name == model.name) return &model;
+  }
+  return nullptr;
+}
+
+inline bool IsSpace(const char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Reads whitespace-separated entries from a single line of text. Numbers are
+// parsed with std::from_chars, which is locale-independent and, in contrast
+// to iostreams, does not allocate.
+class LineParser {
+ public:
+  LineParser(const char* begin, const char* end) : pos_(begin), end_(end) {}
+
+  inline bool AtEnd() {
+    SkipSpaces();
+    return pos_ == end_;
+  }
+
+  bool Token(std::string_view* token) {
+    SkipSpaces();
+    const char* begin = pos_;
+    while (pos_ != end_ && !IsSpace(*pos_)) ++pos_;
+    *token = std::string_view(begin, static_cast<size_t>(pos_ - begin));
+    return pos_ != begin;
+  }
+
+  // Returns false if the next entry is not a number of type T.
+  template <typename T>
+  bool Number(T* value) {
+    SkipSpaces();
+    // In contrast to iostreams, std::from_chars does not accept a leading '+'.
+    if (pos_ != end_ && *pos_ == '+') ++pos_;
+    const std::from_chars_result kResult = std::from_chars(pos_, end_, *value);
+    if (kResult.ec != std::errc()) return false;
+    pos_ = kResult.ptr;
+    return pos_ == end_ || IsSpace(*pos_);
+  }
+
+ protected:
+  inline void SkipSpaces() {
+    while (pos_ != end_ && IsSpace(*pos_)) ++pos_;
+  }
+
+  const char* pos_;
+  const char* end_;
+};
+
+// Calls parse_line(&parser, line_number) for every non-empty line in
+// [begin, end). Stops and returns false as soon as parse_line returns false.
+template <typename ParseLine>
+bool ForEachLine(const char* begin, const char* end, ParseLine parse_line) {
+  int line_number = 0;
+  const char* line_begin = begin;
+  while (line_begin < end) {
+    ++line_number;
+    const char* line_end = static_cast<const char*>(
+        std::memchr(line_begin, '\n', static_cast<size_t>(end - line_begin)));
+    if (line_end == nullptr) line_end = end;
+    LineParser parser(line_begin, line_end);
+    if (!parser.AtEnd() && !parse_line(&parser, line_number)) return false;
+    line_begin = line_end + 1;
+  }
+  return true;
+}
+
+bool ReportParseError(const std::string& source, const int line_number) {
+  std::cerr << " ERROR: Cannot parse line " << line_number << " of " << source
+            << std::endl;
+  return false;
+}
+
+bool LoadList(const std::string& filename, const bool with_extrinsics,
+              Queries* query_images) {
+  query_images->clear();
+  MappedFile file;
+  if (!file.Open(filename)) {
+    std::cerr << " ERROR: Cannot read the image list from " << filename
+              << std::endl;
+    return false;
+  }
+  return ParseList(file.data(), file.data() + file.size(), with_extrinsics,
+                   filename, query_images);
+}
+
+}  // namespace
+
+MappedFile::MappedFile() : data_(nullptr), size_(0u), is_open_(false) {}
+
+MappedFile::~MappedFile() { Close(); }
+
+bool MappedFile::Open(const std::string& filename) {
+  Close();
+
+  const int kFd = open(filename.c_str(), O_RDONLY);
+  if (kFd < 0) return false;
+  struct stat file_stat;
+  if (fstat(kFd, &file_stat) != 0) {
+    close(kFd);
+    return false;
+  }
+  const size_t kSize = static_cast<size_t>(file_stat.st_size);
+  if (kSize == 0u) {
+    // Empty files cannot be mapped.
+    close(kFd);
+    is_open_ = true;
+    return true;
+  }
+  void* mapped = mmap(nullptr, kSize, PROT_READ, MAP_PRIVATE, kFd, 0);
+  // The mapping stays valid after closing the file descriptor.
+  close(kFd);
+  if (mapped == MAP_FAILED) return false;
+  // Files are typically read once, front to back.
+  madvise(mapped, kSize, MADV_SEQUENTIAL);
+  madvise(mapped, kSize, MADV_WILLNEED);
+  data_ = static_cast<const char*>(mapped);
+  size_ = kSize;
+  is_open_ = true;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_ != nullptr) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0u;
+  is_open_ = false;
+}
+
+bool LoadListIntrinsics(const std::string& filename, Queries* query_images) {
+  return LoadList(filename, false, query_images);
+}
+
+bool LoadListIntrinsicsAndExtrinsics(const std::string& filename,
+                                     Queries* query_images) {
+  return LoadList(filename, true, query_images);
+}
+
+bool ParseList(const char* begin, const char* end, const bool with_extrinsics,
+               const std::string& source, Queries* query_images) {
+  query_images->clear();
+
+  return ForEachLine(begin, end, [&](LineParser* line, const int line_number) {
+    QueryData q;
+    std::string_view name;
+    std::string_view camera_type;
+    if (!line->Token(&name) || !line->Token(&camera_type) ||
+        !line->Number(&q.width) || !line->Number(&q.height)) {
+      return ReportParseError(source, line_number);
+    }
+    q.name = std::string(name);
+
+    const CameraModel* model = FindCameraModel(camera_type);
+    if (model == nullptr) {
+      std::cerr << " ERROR: Unknown camera model " << camera_type
+                << " in line " << line_number << " of " << source
+                << std::endl;
+      return false;
+    }
+    bool valid = line->Number(&q.focal_x);
+    if (model->num_focals == 2) {
+      valid = valid && line->Number(&q.focal_y);
+    } else {
+      q.focal_y = q.focal_x;
+    }
+    valid = valid && line->Number(&q.c_x) && line->Number(&q.c_y);
+    q.radial.resize(model->num_radial);
+    for (int i = 0; i < model->num_radial; ++i) {
+      valid = valid && line->Number(&q.radial[i]);
+    }
+
+    q.q.setIdentity();
+    q.c.setZero();
+    if (with_extrinsics) {
+      valid = valid && line->Number(&q.q.w()) && line->Number(&q.q.x()) &&
+              line->Number(&q.q.y()) && line->Number(&q.q.z()) &&
+              line->Number(&q.c[0]) && line->Number(&q.c[1]) &&
+              line->Number(&q.c[2]);
+    }
+    if (!valid) return ReportParseError(source, line_number);
+
+    query_images->push_back(q);
+    return true;
+  });
+}
+
+bool LoadMatches(const std::string& filename, const bool invert_Y_Z,
+                 calibrated_absolute_pose::Points2D* points2D,
+                 calibrated_absolute_pose::Points3D* points3D) {
+  if (match_file::IsBinaryMatchFile(filename)) {
+    return match_file::LoadBinaryMatches(filename, invert_Y_Z, points2D,
+                                         points3D);
+  }
+
+  points2D->clear();
+  points3D->clear();
+  MappedFile file;
+  if (!file.Open(filename)) {
+    std::cerr << " ERROR: Cannot read the matches from " << filename
+              << std::endl;
+    return false;
+  }
+  return ParseMatches(file.data(), file.data() + file.size(), invert_Y_Z,
+                      filename, points2D, points3D);
+}
+
+bool ParseMatches(const char* begin, const char* end, const bool invert_Y_Z,
+                  const std::string& source,
+                  calibrated_absolute_pose::Points2D* points2D,
+                  calibrated_absolute_pose::Points3D* points3D) {
+  points2D->clear();
+  points3D->clear();
+
+  // Each match is stored in its own line.
+  const size_t kMaxNumMatches =
+      static_cast<size_t>(std::count(begin, end, '\n')) + 1u;
+  points2D->reserve(kMaxNumMatches);
+  points3D->reserve(kMaxNumMatches);
+
+  const double kSign = invert_Y_Z ? -1.0 : 1.0;
+  return ForEachLine(begin, end, [&](LineParser* line, const int line_number) {
+    Eigen::Vector2d p2D;
+    Eigen::Vector3d p3D;
+    if (!line->Number(&p2D[0]) || !line->Number(&p2D[1]) ||
+        !line->Number(&p3D[0]) || !line->Number(&p3D[1]) ||
+        !line->Number(&p3D[2])) {
+      return ReportParseError(source, line_number);
+    }
+    // Inverting the y- and z-coordinate due to a choice of coordinate system.
+    p3D[1] *= kSign;
+    p3D[2] *= kSign;
+
+    points2D->push_back(p2D);
+    points3D->push_back(p3D);
+    return true;
+  });
+}
+
+bool LoadIdMatches(const std::string& filename,
+                   calibrated_absolute_pose::Points2D* points2D,
+                   std::vector<uint32_t>* point_ids) {
+  points2D->clear();
+  point_ids->clear();
+  MappedFile file;
+  if (!file.Open(filename)) {
+    std::cerr << " ERROR: Cannot read the matches from " << filename
+              << std::endl;
+    return false;
+  }
+  return ParseIdMatches(file.data(), file.data() + file.size(), filename,
+                        points2D, point_ids);
+}
+
+bool ParseIdMatches(const char* begin, const char* end,
+                    const std::string& source,
+                    calibrated_absolute_pose::Points2D* points2D,
+                    std::vector<uint32_t>* point_ids) {
+  points2D->clear();
+  point_ids->clear();
+
+  const size_t kMaxNumMatches =
+      static_cast<size_t>(std::count(begin, end, '\n')) + 1u;
+  points2D->reserve(kMaxNumMatches);
+  point_ids->reserve(kMaxNumMatches);
+
+  return ForEachLine(begin, end, [&](LineParser* line, const int line_number) {
+    Eigen::Vector2d p2D;
+    uint32_t id;
+    if (!line->Number(&p2D[0]) || !line->Number(&p2D[1]) ||
+        !line->Number(&id)) {
+      return ReportParseError(source, line_number);
+    }
+    points2D->push_back(p2D);
+    point_ids->push_back(id);
+    return true;
+  });
+}
+
+}  // namespace localization_io
+
+}  // namespace ransac_lib
@@ -0,0 +1,158 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#ifndef RANSACLIB_EXAMPLE_LOCALIZATION_IO_H_
+#define RANSACLIB_EXAMPLE_LOCALIZATION_IO_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+#include "calibrated_absolute_pose_estimator.h"
+
+namespace ransac_lib {
+
+namespace localization_io {
+
+// Read-only memory mapping of a whole file. Empty files can be opened, in
+// which case data() returns nullptr and size() returns 0.
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Returns false if the file cannot be opened or mapped.
+  bool Open(const std::string& filename);
+  void Close();
+
+  inline bool is_open() const { return is_open_; }
+  inline const char* data() const { return data_; }
+  inline size_t size() const { return size_; }
+
+ protected:
+  const char* data_;
+  size_t size_;
+  bool is_open_;
+};
+
+// A query image together with its intrinsic calibration and, if available,
+// its (ground truth) extrinsic calibration.
+struct QueryData {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  std::string name;
+  double c_x;
+  double c_y;
+
+  double focal_x;
+  double focal_y;
+
+  int width;
+  int height;
+
+  // The rotation from world to camera coordinates and the position of the
+  // camera center in world coordinates. Only set by
+  // LoadListIntrinsicsAndExtrinsics.
+  Eigen::Quaterniond q;
+  Eigen::Vector3d c;
+
+  std::vector<double> radial;
+};
+
+typedef std::vector<QueryData, Eigen::aligned_allocator<QueryData>> Queries;
+
+// Loads the list of query images together with their intrinsics. Each line
+// of the file has the format
+//   name camera_model width height params
+// where the parameters depend on the camera model:
+//   SIMPLE_RADIAL, VSFM   f cx cy k
+//   PINHOLE               fx fy cx cy
+//   OPENCV                fx fy cx cy k1 k2 p1 p2
+//   BROWN_3_PARAMS        fx fy cx cy k1 k2 k3
+// Additional entries at the end of a line are ignored. Returns false if the
+// file cannot be read, contains an unknown camera model, or a line cannot be
+// parsed.
+bool LoadListIntrinsics(const std::string& filename, Queries* query_images);
+
+// Same as LoadListIntrinsics, but each line additionally contains the pose of
+// the image as
+//   qw qx qy qz cx cy cz
+// after the camera parameters.
+bool LoadListIntrinsicsAndExtrinsics(const std::string& filename,
+                                     Queries* query_images);
+
+// Parses a query list stored in [begin, end). source is only used in error
+// messages.
+bool ParseList(const char* begin, const char* end, const bool with_extrinsics,
+               const std::string& source, Queries* query_images);
+
+// Loads the 2D-3D matches found for an image. If the filename ends with
+// ".bin", the matches are read from a binary match file (see match_file.h).
+// Otherwise, each line of the text file has the format
+//   x y X Y Z
+// with additional entries (e.g., a matching score) being ignored.
+// Optionally inverts the Y- and Z-coordinates of the 3D points.
+bool LoadMatches(const std::string& filename, const bool invert_Y_Z,
+                 calibrated_absolute_pose::Points2D* points2D,
+                 calibrated_absolute_pose::Points3D* points3D);
+
+// Parses 2D-3D matches in the text format stored in [begin, end). source is
+// only used in error messages.
+bool ParseMatches(const char* begin, const char* end, const bool invert_Y_Z,
+                  const std::string& source,
+                  calibrated_absolute_pose::Points2D* points2D,
+                  calibrated_absolute_pose::Points3D* points3D);
+
+// Loads 2D-3D matches that reference the 3D points of a map (see
+// map_store.h) by their IDs. Each line of the text file has the format
+//   x y point_id
+// with additional entries being ignored.
+bool LoadIdMatches(const std::string& filename,
+                   calibrated_absolute_pose::Points2D* points2D,
+                   std::vector<uint32_t>* point_ids);
+
+// Parses matches in the format read by LoadIdMatches stored in [begin, end).
+// source is only used in error messages.
+bool ParseIdMatches(const char* begin, const char* end,
+                    const std::string& source,
+                    calibrated_absolute_pose::Points2D* points2D,
+                    std::vector<uint32_t>* point_ids);
+
+}  // namespace localization_io
+
+}  // namespace ransac_lib
+
+#endif  // RANSACLIB_EXAMPLE_LOCALIZATION_IO_H_
@@ -0,0 +1,548 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// A long-running localization service that keeps its worker threads (each
+// with its own LocalizationWorker) alive between requests. Requests are read
+// either from stdin, with the responses written to stdout, or from clients
+// connecting to a Unix domain socket. Requests of all clients are processed
+// by the same worker pool.
+//
+// Every request is a single line of the form
+//   <id> FILE <match-file> <query>
+//   <id> INLINE <num_bytes> <query>
+// where id is an unsigned 32 bit integer chosen by the client and query is a
+// line in the format of the query lists used by localization, i.e.,
+//   name camera_model width height params
+// A match file given by its path is read as text or, if its name ends with
+// ".bin", as binary match file. For INLINE requests, the line is followed by
+// num_bytes bytes containing a binary match file (see match_file.h). If the
+// environment variable RANSACLIB_MAP names a map file (see map_store.h), match
+// files given by their paths reference the points of the map by their IDs.
+// Every request is answered by a single line, where responses can arrive in a
+// different order than the requests:
+//   <id> OK <num_matches> <num_inliers> <num_iterations> <num_lo_iterations>
+//      <inlier_ratio> <seconds> <name> <qw> <qx> <qy> <qz> <tx> <ty> <tz>
+//   <id> SKIPPED <num_matches>
+//   <id> ERROR <message>
+// The pose is given in the same format as in the pose files written by
+// localization. The random seed of a request is derived from its id, i.e.,
+// the same request sent with the same id to a server started with the same
+// seed produces the same pose.
+// INLINE requests larger than max_inline_bytes (1 GiB by default) are
+// answered with an ERROR and close the connection, since the position of the
+// next request is unknown.
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <RansacLib/executor.h>
+#include <RansacLib/ransac.h>
+#include "batch_localization.h"
+#include "calibrated_absolute_pose_estimator.h"
+#include "localization_io.h"
+#include "map_store.h"
+#include "match_file.h"
+
+namespace {
+
+using ransac_lib::batch_localization::BoundedQueue;
+using ransac_lib::batch_localization::LocalizationSettings;
+using ransac_lib::batch_localization::LocalizationWorker;
+using ransac_lib::batch_localization::QueryMatches;
+using ransac_lib::batch_localization::QueryResult;
+using ransac_lib::localization_io::QueryData;
+
+// Reads lines and blocks of bytes from a file descriptor.
+class FdReader {
+ public:
+  explicit FdReader(const int fd) : fd_(fd), begin_(0u) {}
+
+  bool ReadLine(std::string* line) {
+    while (true) {
+      const size_t kEnd = buffer_.find('\n', begin_);
+      if (kEnd != std::string::npos) {
+        line->assign(buffer_, begin_, kEnd - begin_);
+        begin_ = kEnd + 1u;
+        return true;
+      }
+      if (!Fill()) return false;
+    }
+  }
+
+  bool ReadBytes(const size_t num_bytes, std::string* data) {
+    while (buffer_.size() - begin_ < num_bytes) {
+      if (!Fill()) return false;
+    }
+    data->assign(buffer_, begin_, num_bytes);
+    begin_ += num_bytes;
+    return true;
+  }
+
+ protected:
+  // Appends the next chunk of data to the buffer. Returns false at the end of
+  // the input.
+  bool Fill() {
+    buffer_.erase(0u, begin_);
+    begin_ = 0u;
+    char chunk[1 << 16];
+    ssize_t num_read = 0;
+    do {
+      num_read = read(fd_, chunk, sizeof(chunk));
+    } while (num_read < 0 && errno == EINTR);
+    if (num_read <= 0) return false;
+    buffer_.append(chunk, static_cast<size_t>(num_read));
+    return true;
+  }
+
+  int fd_;
+  std::string buffer_;
+  size_t begin_;
+};
+
+// A client. Responses can be sent by any worker thread. The file descriptors
+// are closed once the connection is no longer referenced, i.e., after the
+// client closed its end and all of its requests have been answered.
+class Connection {
+ public:
+  Connection(const int in_fd, const int out_fd, const bool owns_fds)
+      : in_fd_(in_fd), out_fd_(out_fd), owns_fds_(owns_fds), failed_(false) {}
+
+  ~Connection() {
+    if (!owns_fds_) return;
+    close(in_fd_);
+    if (out_fd_ != in_fd_) close(out_fd_);
+  }
+
+  Connection(const Connection&) = delete;
+  Connection& operator=(const Connection&) = delete;
+
+  void Send(const std::string& response) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (failed_) return;
+    size_t num_written = 0u;
+    while (num_written < response.size()) {
+      const ssize_t kResult = write(out_fd_, response.data() + num_written,
+                                    response.size() - num_written);
+      if (kResult < 0 && errno == EINTR) continue;
+      if (kResult <= 0) {
+        // The client is gone. Its remaining requests are still processed.
+        failed_ = true;
+        return;
+      }
+      num_written += static_cast<size_t>(kResult);
+    }
+  }
+
+  inline int in_fd() const { return in_fd_; }
+
+  // Makes pending and future reads from the client return end of input.
+  void StopReading() { shutdown(in_fd_, SHUT_RD); }
+
+ protected:
+  std::mutex mutex_;
+  int in_fd_;
+  int out_fd_;
+  bool owns_fds_;
+  bool failed_;
+};
+
+struct Request {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  uint32_t id;
+  QueryData query;
+  // Either the path of a match file or, if has_inline_matches is true, the
+  // content of a binary match file.
+  std::string matchfile;
+  std::string inline_matches;
+  bool has_inline_matches;
+  std::shared_ptr<Connection> connection;
+};
+
+typedef BoundedQueue<std::unique_ptr<Request>> RequestQueue;
+
+// The size of the largest valid binary match file: INT32_MAX matches with 2D
+// and 3D points and scores in double precision, the header, and the padding
+// that aligns the three arrays to 64 bytes.
+const size_t kMaxMatchFileBytes =
+    sizeof(ransac_lib::match_file::MatchFileHeader) + 3u * 64u +
+    static_cast<size_t>(INT32_MAX) * 6u * sizeof(double);
+
+// Splits off the next space-separated token of line, starting at *pos.
+bool NextToken(const std::string& line, size_t* pos, std::string* token) {
+  const size_t kBegin = line.find_first_not_of(" \t\r", *pos);
+  if (kBegin == std::string::npos) return false;
+  size_t end = line.find_first_of(" \t\r", kBegin);
+  if (end == std::string::npos) end = line.size();
+  token->assign(line, kBegin, end - kBegin);
+  *pos = end;
+  return true;
+}
+
+template <typename T>
+bool ParseNumber(const std::string& token, T* value) {
+  const char* kEnd = token.data() + token.size();
+  const std::from_chars_result kResult =
+      std::from_chars(token.data(), kEnd, *value);
+  return kResult.ec == std::errc() && kResult.ptr == kEnd;
+}
+
+// Parses a request line and, for INLINE requests, reads the matches from
+// reader. Returns false if the request is invalid. *id_token is set as soon
+// as it is known, such that errors can be reported. *fatal is set if the
+// remaining input cannot be interpreted anymore.
+bool ReadRequest(const std::string& line, const size_t max_inline_bytes,
+                 FdReader* reader, Request* request, std::string* id_token,
+                 std::string* error, bool* fatal) {
+  *fatal = false;
+  size_t pos = 0u;
+  std::string kind;
+  std::string argument;
+  if (!NextToken(line, &pos, id_token)) {
+    *error = "empty request";
+    return false;
+  }
+  if (!ParseNumber(*id_token, &request->id)) {
+    *error = "invalid request id";
+    return false;
+  }
+  if (!NextToken(line, &pos, &kind) || !NextToken(line, &pos, &argument)) {
+    *error = "incomplete request";
+    return false;
+  }
+  if (kind == "INLINE") {
+    size_t num_bytes = 0u;
+    if (!ParseNumber(argument, &num_bytes)) {
+      // Without the size, the position of the next request is unknown.
+      *error = "invalid number of bytes";
+      *fatal = true;
+      return false;
+    }
+    if (num_bytes > max_inline_bytes) {
+      *error = "inline matches exceed " + std::to_string(max_inline_bytes) +
+               " bytes";
+      *fatal = true;
+      return false;
+    }
+    if (!reader->ReadBytes(num_bytes, &request->inline_matches)) {
+      *error = "incomplete inline matches";
+      *fatal = true;
+      return false;
+    }
+    request->has_inline_matches = true;
+  } else if (kind == "FILE") {
+    request->matchfile = argument;
+    request->has_inline_matches = false;
+  } else {
+    *error = "unknown request type " + kind;
+    return false;
+  }
+
+  ransac_lib::localization_io::Queries queries;
+  const std::string kSource = "request " + *id_token;
+  if (!ransac_lib::localization_io::ParseList(line.data() + pos,
+                                              line.data() + line.size(), false,
+                                              kSource, &queries) ||
+      queries.size() != 1u) {
+    *error = "invalid query";
+    return false;
+  }
+  request->query = queries[0];
+  return true;
+}
+
+// Reads the requests of a client and passes them to the workers.
+void ServeConnection(std::shared_ptr<Connection> connection,
+                     const size_t max_inline_bytes, RequestQueue* requests) {
+  FdReader reader(connection->in_fd());
+  std::string line;
+  while (reader.ReadLine(&line)) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+    std::unique_ptr<Request> request(new Request);
+    std::string id_token = "-";
+    std::string error;
+    bool fatal = false;
+    if (!ReadRequest(line, max_inline_bytes, &reader, request.get(),
+                     &id_token, &error, &fatal)) {
+      connection->Send(id_token + " ERROR " + error + "\n");
+      if (fatal) break;
+      continue;
+    }
+    request->connection = connection;
+    if (!requests->Push(std::move(request))) break;
+  }
+}
+
+// The threads reading from the clients of the socket. Threads of clients
+// that disconnected are joined when the next client connects. Stop makes
+// all remaining threads return, such that the request queue they push to
+// can be closed and destroyed.
+class ConnectionReaders {
+ public:
+  ConnectionReaders(const size_t max_inline_bytes, RequestQueue* requests)
+      : max_inline_bytes_(max_inline_bytes), requests_(requests) {}
+
+  ~ConnectionReaders() { Stop(); }
+
+  ConnectionReaders(const ConnectionReaders&) = delete;
+  ConnectionReaders& operator=(const ConnectionReaders&) = delete;
+
+  void Start(const std::shared_ptr<Connection>& connection) {
+    JoinFinished();
+    Reader reader;
+    reader.connection = connection;
+    reader.finished = std::make_shared<std::atomic<bool>>(false);
+    std::shared_ptr<std::atomic<bool>> finished = reader.finished;
+    const size_t kMaxInlineBytes = max_inline_bytes_;
+    RequestQueue* requests = requests_;
+    reader.thread = std::thread([connection, finished, kMaxInlineBytes,
+                                 requests]() {
+      ServeConnection(connection, kMaxInlineBytes, requests);
+      finished->store(true);
+    });
+    readers_.push_back(std::move(reader));
+  }
+
+  // Stops reading from all clients and joins the threads. Requests that
+  // were already read are still answered by the workers.
+  void Stop() {
+    for (Reader& reader : readers_) {
+      // The connection is only alive while the reader or a request holds it,
+      // i.e., its file descriptor cannot have been reused.
+      std::shared_ptr<Connection> connection = reader.connection.lock();
+      if (connection) connection->StopReading();
+    }
+    for (Reader& reader : readers_) reader.thread.join();
+    readers_.clear();
+  }
+
+ protected:
+  struct Reader {
+    std::thread thread;
+    std::weak_ptr<Connection> connection;
+    std::shared_ptr<std::atomic<bool>> finished;
+  };
+
+  void JoinFinished() {
+    std::vector<Reader> running;
+    for (Reader& reader : readers_) {
+      if (reader.finished->load()) {
+        reader.thread.join();
+      } else {
+        running.push_back(std::move(reader));
+      }
+    }
+    readers_.swap(running);
+  }
+
+  size_t max_inline_bytes_;
+  RequestQueue* requests_;
+  std::vector<Reader> readers_;
+};
+
+// Processes requests until the queue is closed.
+void ProcessRequests(const LocalizationSettings& settings,
+                     RequestQueue* requests) {
+  LocalizationWorker localizer;
+  QueryMatches matches;
+  QueryResult result;
+  std::ostringstream log;
+  std::unique_ptr<Request> request;
+  while (requests->Pop(&request)) {
+    std::ostringstream response;
+    response << request->id;
+
+    bool loaded = false;
+    if (request->has_inline_matches) {
+      loaded = ransac_lib::match_file::ParseBinaryMatches(
+          request->inline_matches.data(), request->inline_matches.size(),
+          settings.invert_Y_Z, "inline matches", &matches.points2D,
+          &matches.points3D);
+    } else {
+      loaded = ransac_lib::batch_localization::ReadMatches(
+          request->matchfile, settings, &matches);
+    }
+
+    if (!loaded) {
+      response << " ERROR cannot read matches\n";
+    } else {
+      ransac_lib::batch_localization::PrepareQueryMatches(request->query,
+                                                          settings, &matches);
+      log.str("");
+      localizer.Solve(request->query, matches, static_cast<int>(request->id),
+                      settings, &log, &result);
+      if (result.ransac_run) {
+        response << " OK " << result.num_matches << " " << result.num_inliers
+                 << " " << result.statistics.num_iterations << " "
+                 << result.statistics.number_lo_iterations << " "
+                 << result.statistics.inlier_ratio << " " << result.seconds
+                 << " "
+                 << ransac_lib::batch_localization::FormatPose(
+                        request->query.name, result.pose);
+      } else {
+        response << " SKIPPED " << result.num_matches << "\n";
+      }
+    }
+    request->connection->Send(response.str());
+    request.reset();
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  // Messages go to stderr since stdout is used for the responses.
+  std::cerr << " usage: " << argv[0] << " inlier_threshold num_lo_steps "
+            << "invert_Y_Z points_centered [num_threads] [socket_path] "
+            << "[random_seed] [max_inline_bytes]" << std::endl
+            << "   requests are read from stdin if no socket_path or \"-\" "
+            << "is given" << std::endl;
+  if (argc < 5) return -1;
+
+  LocalizationSettings settings;
+  settings.inlier_threshold = static_cast<double>(atof(argv[1]));
+  settings.num_lo_steps = atoi(argv[2]);
+  settings.invert_Y_Z = static_cast<bool>(atoi(argv[3]));
+  settings.points_centered = static_cast<bool>(atoi(argv[4]));
+  settings.min_num_matches = 4;
+  const int kNumThreads = argc >= 6 ? std::max(1, atoi(argv[5])) : 1;
+  const std::string kSocketPath = argc >= 7 ? std::string(argv[6]) : "-";
+  settings.random_seed =
+      argc >= 8 ? static_cast<unsigned int>(std::strtoul(argv[7], nullptr, 10))
+                : 0u;
+  const size_t kMaxInlineBytes =
+      argc >= 9 ? std::min<size_t>(std::strtoull(argv[8], nullptr, 10),
+                                   kMaxMatchFileBytes)
+                : std::min<size_t>(size_t{1} << 30, kMaxMatchFileBytes);
+
+  // If RANSACLIB_MAP is set, the match files given by their paths reference
+  // the 3D points of the map by their IDs. Inline matches always contain the
+  // coordinates of the points.
+  ransac_lib::map_store::MapStore map;
+  if (!ransac_lib::batch_localization::UseMapFromEnvironment(&map,
+                                                             &settings)) {
+    return -1;
+  }
+  if (settings.map != nullptr) {
+    std::cerr << " Using a map with " << map.num_points() << " points"
+              << std::endl;
+  }
+
+  // Writing to a client that disconnected should fail instead of terminating
+  // the server.
+  std::signal(SIGPIPE, SIG_IGN);
+
+  // Listens before starting the workers, such that all exits below happen
+  // after they finished.
+  int server_fd = -1;
+  if (kSocketPath != "-") {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (kSocketPath.size() >= sizeof(address.sun_path)) {
+      std::cerr << " ERROR: The socket path " << kSocketPath << " is too long"
+                << std::endl;
+      return -1;
+    }
+    std::strncpy(address.sun_path, kSocketPath.c_str(),
+                 sizeof(address.sun_path) - 1);
+
+    server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(kSocketPath.c_str());
+    if (server_fd < 0 ||
+        bind(server_fd, reinterpret_cast<const sockaddr*>(&address),
+             sizeof(address)) != 0 ||
+        listen(server_fd, 64) != 0) {
+      std::cerr << " ERROR: Cannot listen on " << kSocketPath << ": "
+                << std::strerror(errno) << std::endl;
+      return -1;
+    }
+    std::cerr << " Listening on " << kSocketPath << std::endl;
+  }
+
+  // Limits the number of requests waiting for a worker, such that clients
+  // sending faster than the server can process block.
+  RequestQueue requests(4 * kNumThreads);
+  // The RANSAC workers block on the request queue until it is closed. They
+  // thus run on a pool of their own instead of occupying the threads of
+  // DefaultExecutor(). Accepting connections and reading from the sockets
+  // blocks as well and uses dedicated threads.
+  ransac_lib::ThreadPoolExecutor executor(kNumThreads);
+  for (int t = 0; t < kNumThreads; ++t) {
+    executor.Submit([&]() { ProcessRequests(settings, &requests); });
+  }
+  std::cerr << " Started " << kNumThreads << " worker(s)" << std::endl;
+
+  if (server_fd < 0) {
+    ServeConnection(
+        std::make_shared<Connection>(STDIN_FILENO, STDOUT_FILENO, false),
+        kMaxInlineBytes, &requests);
+  } else {
+    ConnectionReaders readers(kMaxInlineBytes, &requests);
+    while (true) {
+      const int kClientFd = accept(server_fd, nullptr, nullptr);
+      if (kClientFd < 0) {
+        if (errno == EINTR) continue;
+        std::cerr << " ERROR: accept failed: " << std::strerror(errno)
+                  << std::endl;
+        break;
+      }
+      readers.Start(std::make_shared<Connection>(kClientFd, kClientFd, true));
+    }
+    readers.Stop();
+    close(server_fd);
+    unlink(kSocketPath.c_str());
+  }
+
+  // Answers all pending requests before exiting.
+  requests.Close();
+  executor.Wait();
+  return 0;
+}
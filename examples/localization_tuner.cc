@@ -0,0 +1,440 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// Searches LORansacOptions for configurations that offer a good trade-off
+// between run-time and pose accuracy on a localization dataset with ground
+// truth poses (in the format used by localization_with_gt). Every
+// configuration is run on all queries, where the queries are distributed over
+// multiple threads. For each configuration, the mean and 99th percentile of
+// the RANSAC run-times as well as the percentage of poses within the position
+// and orientation thresholds used by localization_with_gt are measured. The
+// configurations on the Pareto front of (mean time, p99 time, accuracy) are
+// written as recommended configurations.
+// The configurations are drawn at random (with a fixed seed) from a grid over
+// num_lo_steps_, num_lsq_iterations_, min_sample_multiplicator_,
+// lo_starting_iterations_, threshold_multiplier_, and the inlier threshold.
+// The first configuration is always the one used by localization_with_gt.
+// Every query uses the same random seed for all configurations such that the
+// configurations are evaluated on the same random samples as far as possible.
+// Note that measuring run-times while using multiple threads increases their
+// variance. Use a single thread for precise run-time measurements.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+#include <opengv/absolute_pose/CentralAbsoluteAdapter.hpp>
+#include <opengv/absolute_pose/methods.hpp>
+#include <opengv/types.hpp>
+
+#include <RansacLib/executor.h>
+#include <RansacLib/ransac.h>
+#include "calibrated_absolute_pose_estimator.h"
+#include "localization_io.h"
+
+// A query image together with its matches, with the 2D positions centered
+// around the principal point.
+struct QueryData : public ransac_lib::localization_io::QueryData {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  ransac_lib::calibrated_absolute_pose::Points2D points2D;
+  ransac_lib::calibrated_absolute_pose::ViewingRays rays;
+  ransac_lib::calibrated_absolute_pose::Points3D points3D;
+  ransac_lib::calibrated_absolute_pose::MatchArrays arrays;
+};
+
+typedef std::vector<QueryData, Eigen::aligned_allocator<QueryData>> Queries;
+
+struct TunerConfig {
+  double inlier_threshold;
+  int num_lo_steps;
+  int num_lsq_iterations;
+  int min_sample_multiplicator;
+  uint32_t lo_starting_iterations;
+  double threshold_multiplier;
+};
+
+struct TunerResult {
+  TunerConfig config;
+  double mean_time;
+  double p99_time;
+  // The percentage of all queries (including skipped ones) whose poses are
+  // within the k-th pair of thresholds.
+  std::vector<double> percent_within;
+  bool pareto_optimal;
+};
+
+const std::vector<double> kPositionThresholds = {0.05, 0.03, 0.02, 0.01};
+const std::vector<double> kOrientationThresholds = {5.0, 3.0, 2.0, 1.0};
+
+ransac_lib::LORansacOptions OptionsFromConfig(const TunerConfig& config) {
+  ransac_lib::LORansacOptions options;
+  options.min_num_iterations_ = 100u;
+  options.max_num_iterations_ = 10000u;
+  options.min_sample_multiplicator_ = config.min_sample_multiplicator;
+  options.num_lsq_iterations_ = config.num_lsq_iterations;
+  options.num_lo_steps_ = config.num_lo_steps;
+  options.lo_starting_iterations_ = config.lo_starting_iterations;
+  options.final_least_squares_ = true;
+  options.threshold_multiplier_ = config.threshold_multiplier;
+  options.squared_inlier_threshold_ =
+      config.inlier_threshold * config.inlier_threshold;
+  return options;
+}
+
+// Runs LO-MSAC on a single query and measures the run-time as well as the
+// position and orientation error of the estimated pose. The errors are set to
+// the maximal double value if no pose could be estimated.
+void RunQuery(const TunerConfig& config, const QueryData& query,
+              const unsigned int seed, double* seconds, double* c_error,
+              double* q_error) {
+  using ransac_lib::LocallyOptimizedMSAC;
+  using ransac_lib::calibrated_absolute_pose::CalibratedAbsolutePoseEstimator;
+  using ransac_lib::calibrated_absolute_pose::CameraPose;
+  using ransac_lib::calibrated_absolute_pose::CameraPoses;
+
+  ransac_lib::LORansacOptions options = OptionsFromConfig(config);
+  options.random_seed_ = seed;
+
+  CalibratedAbsolutePoseEstimator solver(
+      query.focal_x, query.focal_y, options.squared_inlier_threshold_,
+      query.points2D, query.rays, query.points3D, query.arrays);
+
+  LocallyOptimizedMSAC<CameraPose, CameraPoses,
+                       CalibratedAbsolutePoseEstimator>
+      lomsac;
+  ransac_lib::RansacStatistics ransac_stats;
+  CameraPose best_model;
+
+  auto ransac_start = std::chrono::steady_clock::now();
+  int num_ransac_inliers =
+      lomsac.EstimateModel(options, solver, &best_model, &ransac_stats);
+  auto ransac_end = std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed_seconds = ransac_end - ransac_start;
+  *seconds = elapsed_seconds.count();
+
+  *c_error = std::numeric_limits<double>::max();
+  *q_error = std::numeric_limits<double>::max();
+  if (num_ransac_inliers < 4) return;
+
+  Eigen::Matrix3d R = best_model.topLeftCorner<3, 3>();
+  *c_error = (best_model.col(3) - query.c).norm();
+  Eigen::Matrix3d R1 = R.transpose();
+  Eigen::Matrix3d R2(query.q);
+  Eigen::AngleAxisd aax(R1 * R2);
+  *q_error = aax.angle() * 180.0 / M_PI;
+}
+
+// Runs the given configuration on all queries, distributed over the threads
+// of the executor. num_total_queries also counts the skipped queries.
+void EvaluateConfig(const TunerConfig& config, const Queries& queries,
+                    const int num_total_queries,
+                    ransac_lib::Executor* executor, TunerResult* result) {
+  const int kNumQueries = static_cast<int>(queries.size());
+  std::vector<double> seconds(kNumQueries, 0.0);
+  std::vector<double> c_errors(kNumQueries);
+  std::vector<double> q_errors(kNumQueries);
+
+  executor->BulkFor(kNumQueries, [&](const int i) {
+    RunQuery(config, queries[i], static_cast<unsigned int>(i), &seconds[i],
+             &c_errors[i], &q_errors[i]);
+  });
+
+  result->config = config;
+  double sum_seconds = 0.0;
+  for (const double s : seconds) sum_seconds += s;
+  result->mean_time =
+      kNumQueries > 0 ? sum_seconds / static_cast<double>(kNumQueries) : 0.0;
+  std::sort(seconds.begin(), seconds.end());
+  result->p99_time =
+      kNumQueries > 0
+          ? seconds[std::min(kNumQueries - 1,
+                             static_cast<int>(std::ceil(0.99 * kNumQueries)) -
+                                 1)]
+          : 0.0;
+
+  const int kNumThresholds = static_cast<int>(kPositionThresholds.size());
+  result->percent_within.assign(kNumThresholds, 0.0);
+  for (int i = 0; i < kNumQueries; ++i) {
+    for (int k = 0; k < kNumThresholds; ++k) {
+      if (c_errors[i] <= kPositionThresholds[k] &&
+          q_errors[i] <= kOrientationThresholds[k]) {
+        result->percent_within[k] += 1.0;
+      }
+    }
+  }
+  for (double& p : result->percent_within) {
+    p *= 100.0 / static_cast<double>(std::max(num_total_queries, 1));
+  }
+  result->pareto_optimal = false;
+}
+
+// Returns true if a is at least as good as b in all objectives and better in
+// at least one.
+bool Dominates(const TunerResult& a, const TunerResult& b) {
+  bool better = false;
+  if (a.mean_time > b.mean_time || a.p99_time > b.p99_time) return false;
+  if (a.mean_time < b.mean_time || a.p99_time < b.p99_time) better = true;
+  for (size_t k = 0; k < a.percent_within.size(); ++k) {
+    if (a.percent_within[k] < b.percent_within[k]) return false;
+    if (a.percent_within[k] > b.percent_within[k]) better = true;
+  }
+  return better;
+}
+
+void ComputeParetoFront(std::vector<TunerResult>* results) {
+  for (TunerResult& r : *results) {
+    r.pareto_optimal = true;
+    for (const TunerResult& o : *results) {
+      if (Dominates(o, r)) {
+        r.pareto_optimal = false;
+        break;
+      }
+    }
+  }
+}
+
+// Draws num_configs distinct configurations from the search grid. The first
+// configuration is the one used by localization_with_gt.
+void SampleConfigs(const int num_configs, std::vector<TunerConfig>* configs) {
+  const std::vector<double> kInlierThresholds = {4.0, 8.0, 12.0, 16.0, 20.0};
+  const std::vector<int> kNumLOSteps = {0, 3, 5, 10};
+  const std::vector<int> kNumLSqIterations = {0, 2, 4, 8};
+  const std::vector<int> kMinSampleMultiplicators = {3, 5, 7, 10};
+  const std::vector<uint32_t> kLOStartingIterations = {0u, 30u, 60u, 200u};
+  const std::vector<double> kThresholdMultipliers = {1.0, std::sqrt(2.0), 2.0,
+                                                     3.0};
+  const size_t kGridSize =
+      kInlierThresholds.size() * kNumLOSteps.size() *
+      kNumLSqIterations.size() * kMinSampleMultiplicators.size() *
+      kLOStartingIterations.size() * kThresholdMultipliers.size();
+
+  configs->clear();
+  configs->push_back({12.0, 10, 4, 7, 60u, std::sqrt(2.0)});
+
+  std::vector<size_t> grid_indices(kGridSize);
+  for (size_t i = 0; i < kGridSize; ++i) grid_indices[i] = i;
+  std::mt19937 rng(0u);
+  std::shuffle(grid_indices.begin(), grid_indices.end(), rng);
+
+  for (size_t i = 0; i < kGridSize; ++i) {
+    if (static_cast<int>(configs->size()) >= num_configs) break;
+    size_t index = grid_indices[i];
+    TunerConfig c;
+    c.inlier_threshold = kInlierThresholds[index % kInlierThresholds.size()];
+    index /= kInlierThresholds.size();
+    c.num_lo_steps = kNumLOSteps[index % kNumLOSteps.size()];
+    index /= kNumLOSteps.size();
+    c.num_lsq_iterations = kNumLSqIterations[index % kNumLSqIterations.size()];
+    index /= kNumLSqIterations.size();
+    c.min_sample_multiplicator =
+        kMinSampleMultiplicators[index % kMinSampleMultiplicators.size()];
+    index /= kMinSampleMultiplicators.size();
+    c.lo_starting_iterations =
+        kLOStartingIterations[index % kLOStartingIterations.size()];
+    index /= kLOStartingIterations.size();
+    c.threshold_multiplier = kThresholdMultipliers[index];
+    // Configurations without LO steps still differ: LO then only runs its
+    // initial least squares fit, which depends on threshold_multiplier_ and
+    // lo_starting_iterations_ (and final_least_squares_ on the others).
+    configs->push_back(c);
+  }
+}
+
+void WriteConfigJSON(const TunerResult& r, std::ostream* os) {
+  *os << "{\"squared_inlier_threshold_\": "
+      << r.config.inlier_threshold * r.config.inlier_threshold
+      << ", \"inlier_threshold_px\": " << r.config.inlier_threshold
+      << ", \"num_lo_steps_\": " << r.config.num_lo_steps
+      << ", \"num_lsq_iterations_\": " << r.config.num_lsq_iterations
+      << ", \"min_sample_multiplicator_\": "
+      << r.config.min_sample_multiplicator
+      << ", \"lo_starting_iterations_\": " << r.config.lo_starting_iterations
+      << ", \"threshold_multiplier_\": " << r.config.threshold_multiplier
+      << ", \"mean_time_s\": " << r.mean_time
+      << ", \"p99_time_s\": " << r.p99_time << ", \"percent_within\": [";
+  for (size_t k = 0; k < r.percent_within.size(); ++k) {
+    *os << (k > 0 ? ", " : "") << r.percent_within[k];
+  }
+  *os << "]}";
+}
+
+int main(int argc, char** argv) {
+  using ransac_lib::calibrated_absolute_pose::CalibratedAbsolutePoseEstimator;
+
+  std::cout << " usage: " << argv[0] << " images_with_intrinsics outfile "
+            << "invert_Y_Z points_centered [num_configs] [num_threads] "
+            << "[match-file postfix]" << std::endl;
+  if (argc < 5) return -1;
+
+  bool invert_Y_Z = static_cast<bool>(atoi(argv[3]));
+  bool points_centered = static_cast<bool>(atoi(argv[4]));
+  const int kNumConfigs = argc >= 6 ? std::max(1, atoi(argv[5])) : 64;
+  // Without a number of threads, the queries run on the process-wide pool
+  // with one thread per logical CPU.
+  std::unique_ptr<ransac_lib::ThreadPoolExecutor> pool;
+  ransac_lib::Executor* executor = ransac_lib::DefaultExecutor();
+  if (argc >= 7) {
+    pool.reset(new ransac_lib::ThreadPoolExecutor(std::max(1, atoi(argv[6]))));
+    executor = pool.get();
+  }
+  std::string matchfile_postfix = ".individual_datasets.matches.txt";
+  if (argc >= 8) {
+    matchfile_postfix = std::string(argv[7]);
+  }
+
+  ransac_lib::localization_io::Queries query_data;
+  std::string list(argv[1]);
+  if (!ransac_lib::localization_io::LoadListIntrinsicsAndExtrinsics(
+          list, &query_data)) {
+    std::cerr << " ERROR: Could not read the data from " << list << std::endl;
+    return -1;
+  }
+  const int kNumQuery = static_cast<int>(query_data.size());
+  std::cout << " Found " << kNumQuery << " query images " << std::endl;
+
+  // Loads all matches once. Queries with too few matches are removed but
+  // still count towards the percentages of localized images.
+  Queries queries;
+  for (int i = 0; i < kNumQuery; ++i) {
+    QueryData q;
+    static_cast<ransac_lib::localization_io::QueryData&>(q) = query_data[i];
+    std::string matchfile(q.name);
+    matchfile.append(matchfile_postfix);
+    if (!ransac_lib::localization_io::LoadMatches(matchfile, invert_Y_Z, &q.points2D, &q.points3D)) {
+      std::cerr << "  ERROR: Could not load matches from " << matchfile
+                << std::endl;
+      continue;
+    }
+    const int kNumMatches = static_cast<int>(q.points2D.size());
+    if (kNumMatches <= 4) continue;
+
+    if (!points_centered) {
+      for (int j = 0; j < kNumMatches; ++j) {
+        q.points2D[j][0] -= q.c_x;
+        q.points2D[j][1] -= q.c_y;
+      }
+    }
+    CalibratedAbsolutePoseEstimator::PixelsToViewingRays(
+        q.focal_x, q.focal_y, q.points2D, &q.rays);
+    q.arrays.Assign(q.points2D, q.points3D);
+    queries.push_back(q);
+  }
+  std::cout << " Loaded matches for " << queries.size() << " queries"
+            << std::endl;
+
+  std::vector<TunerConfig> configs;
+  SampleConfigs(kNumConfigs, &configs);
+
+  std::vector<TunerResult> results(configs.size());
+  for (size_t i = 0; i < configs.size(); ++i) {
+    EvaluateConfig(configs[i], queries, kNumQuery, executor, &results[i]);
+    std::cout << " Configuration " << i << " : ";
+    WriteConfigJSON(results[i], &std::cout);
+    std::cout << std::endl;
+  }
+
+  ComputeParetoFront(&results);
+
+  std::ofstream ofs(argv[2], std::ios::out);
+  if (!ofs.is_open()) {
+    std::cerr << " ERROR: Cannot write to " << argv[2] << std::endl;
+    return -1;
+  }
+  ofs << std::setprecision(9);
+  ofs << "inlier_threshold num_lo_steps num_lsq_iterations "
+      << "min_sample_multiplicator lo_starting_iterations "
+      << "threshold_multiplier mean_time p99_time";
+  for (size_t k = 0; k < kPositionThresholds.size(); ++k) {
+    ofs << " percent_within_" << kPositionThresholds[k] * 100.0 << "cm_"
+        << kOrientationThresholds[k] << "deg";
+  }
+  ofs << " pareto_optimal" << std::endl;
+  for (const TunerResult& r : results) {
+    ofs << r.config.inlier_threshold << " " << r.config.num_lo_steps << " "
+        << r.config.num_lsq_iterations << " "
+        << r.config.min_sample_multiplicator << " "
+        << r.config.lo_starting_iterations << " "
+        << r.config.threshold_multiplier << " " << r.mean_time << " "
+        << r.p99_time;
+    for (const double p : r.percent_within) ofs << " " << p;
+    ofs << " " << (r.pareto_optimal ? 1 : 0) << std::endl;
+  }
+  ofs.close();
+
+  // The recommended configurations are the Pareto-optimal ones, sorted by
+  // their mean run-time.
+  std::vector<TunerResult> pareto_front;
+  for (const TunerResult& r : results) {
+    if (r.pareto_optimal) pareto_front.push_back(r);
+  }
+  std::sort(pareto_front.begin(), pareto_front.end(),
+            [](const TunerResult& a, const TunerResult& b) {
+              return a.mean_time < b.mean_time;
+            });
+
+  std::string recommended_file(argv[2]);
+  recommended_file.append(".recommended.json");
+  std::ofstream ofs_rec(recommended_file.c_str(), std::ios::out);
+  if (!ofs_rec.is_open()) {
+    std::cerr << " ERROR: Cannot write to " << recommended_file << std::endl;
+    return -1;
+  }
+  ofs_rec << std::setprecision(9);
+  ofs_rec << "[" << std::endl;
+  for (size_t i = 0; i < pareto_front.size(); ++i) {
+    ofs_rec << "  ";
+    WriteConfigJSON(pareto_front[i], &ofs_rec);
+    ofs_rec << (i + 1 < pareto_front.size() ? "," : "") << std::endl;
+  }
+  ofs_rec << "]" << std::endl;
+  ofs_rec.close();
+
+  std::cout << std::endl
+            << " Found " << pareto_front.size()
+            << " Pareto-optimal configurations out of " << results.size()
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,273 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// Compares LO-MSAC and MAGSAC++ (MAGSACPlusPlusPolicies, see policies.h) on
+// calibrated absolute pose estimation for a range of inlier thresholds. For
+// every threshold and method, reports the median rotation and position errors
+// w.r.t. the ground truth poses, the mean run-time, and the mean number of
+// inliers (w.r.t. the threshold). Since MAGSAC++ marginalizes over the noise
+// level up to the threshold, its accuracy should depend less on the choice of
+// the threshold than that of LO-MSAC.
+// Without arguments, synthetic instances are used. Otherwise, the queries of
+// a localization dataset with ground truth poses are used (see
+// localization_with_gt.cc for the format).
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+#include <RansacLib/policies.h>
+#include <RansacLib/ransac.h>
+#include "batch_localization.h"
+#include "calibrated_absolute_pose_estimator.h"
+#include "localization_io.h"
+#include "synthetic_datasets.h"
+
+namespace ransac_lib {
+
+namespace magsac_benchmark {
+
+using batch_localization::QueryMatches;
+using calibrated_absolute_pose::CalibratedAbsolutePoseEstimator;
+using calibrated_absolute_pose::CameraPose;
+using calibrated_absolute_pose::CameraPoses;
+
+// A query with its matches and ground truth pose [R | c].
+struct Instance {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  double focal_x;
+  double focal_y;
+  QueryMatches matches;
+  CameraPose gt_pose;
+};
+typedef std::vector<Instance, Eigen::aligned_allocator<Instance>> Instances;
+
+struct MethodStatistics {
+  std::vector<double> orientation_errors;
+  std::vector<double> position_errors;
+  double seconds = 0.0;
+  int64_t num_inliers = 0;
+};
+
+double Median(std::vector<double> values) {
+  if (values.empty()) return 0.0;
+  const size_t kMid = values.size() / 2u;
+  std::nth_element(values.begin(), values.begin() + kMid, values.end());
+  return values[kMid];
+}
+
+// The options of the localization examples (see
+// batch_localization::LocalizationOptions).
+LORansacOptions BenchmarkOptions(const double inlier_threshold) {
+  LORansacOptions options;
+  options.min_num_iterations_ = 100u;
+  options.max_num_iterations_ = 10000u;
+  options.min_sample_multiplicator_ = 7;
+  options.num_lsq_iterations_ = 4;
+  options.num_lo_steps_ = 10;
+  options.lo_starting_iterations_ = 60;
+  options.final_least_squares_ = true;
+  options.squared_inlier_threshold_ = inlier_threshold * inlier_threshold;
+  return options;
+}
+
+template <class Policies>
+void RunMethod(const Instances& instances, const double inlier_threshold,
+               MethodStatistics* stats) {
+  LocallyOptimizedMSAC<CameraPose, CameraPoses,
+                       CalibratedAbsolutePoseEstimator,
+                       UniformSampling<CalibratedAbsolutePoseEstimator>,
+                       Policies>
+      ransac;
+  LORansacOptions options = BenchmarkOptions(inlier_threshold);
+  const int kNumInstances = static_cast<int>(instances.size());
+  for (int i = 0; i < kNumInstances; ++i) {
+    const Instance& instance = instances[i];
+    options.random_seed_ = static_cast<unsigned int>(i);
+    CalibratedAbsolutePoseEstimator solver(
+        instance.focal_x, instance.focal_y, options.squared_inlier_threshold_,
+        instance.matches.points2D, instance.matches.rays,
+        instance.matches.points3D, instance.matches.arrays);
+
+    CameraPose pose;
+    pose.setIdentity();
+    RansacStatistics ransac_stats;
+    auto start = std::chrono::steady_clock::now();
+    const int kNumInliers =
+        ransac.EstimateModel(options, solver, &pose, &ransac_stats);
+    auto end = std::chrono::steady_clock::now();
+    stats->seconds += std::chrono::duration<double>(end - start).count();
+    stats->num_inliers += kNumInliers;
+
+    // The same error measures as in localization_with_gt.cc.
+    double orientation_error = std::numeric_limits<double>::max();
+    double position_error = std::numeric_limits<double>::max();
+    if (kNumInliers >= 4) {
+      const Eigen::Matrix3d kR = pose.topLeftCorner<3, 3>();
+      const Eigen::Matrix3d kRGt = instance.gt_pose.topLeftCorner<3, 3>();
+      orientation_error =
+          Eigen::AngleAxisd(kR.transpose() * kRGt).angle() * 180.0 / M_PI;
+      position_error = (pose.col(3) - instance.gt_pose.col(3)).norm();
+    }
+    stats->orientation_errors.push_back(orientation_error);
+    stats->position_errors.push_back(position_error);
+  }
+}
+
+void PrintStatistics(const std::string& method, const double inlier_threshold,
+                     const int num_instances, const MethodStatistics& stats) {
+  std::cout << std::setw(10) << method << std::setw(10) << inlier_threshold
+            << std::setw(14) << Median(stats.orientation_errors)
+            << std::setw(14) << Median(stats.position_errors) << std::setw(12)
+            << stats.seconds / num_instances * 1000.0 << std::setw(12)
+            << static_cast<double>(stats.num_inliers) / num_instances
+            << std::endl;
+}
+
+// 50 instances with 1000 matches each, 50% of which are outliers, and with
+// uniform noise of up to 2 pixels per coordinate on the inliers.
+void GenerateSyntheticInstances(Instances* instances) {
+  const double kWidth = 640.0;
+  const double kHeight = 320.0;
+  const double kFocalLength = (kWidth * 0.5) / std::tan(60.0 * M_PI / 180.0);
+  const int kNumInstances = 50;
+  std::mt19937 rng(0u);
+  instances->resize(kNumInstances);
+  for (Instance& instance : *instances) {
+    instance.focal_x = kFocalLength;
+    instance.focal_y = kFocalLength;
+    std::vector<int> gt_inliers;
+    synthetic::GeneratePoseInstance(
+        kWidth, kHeight, kFocalLength, 500, 500, 2.0, 2.0, 10.0, &rng,
+        &instance.matches.points2D, &instance.matches.rays,
+        &instance.matches.points3D, &instance.gt_pose, &gt_inliers);
+  }
+}
+
+bool LoadLocalizationInstances(int argc, char** argv, Instances* instances) {
+  batch_localization::LocalizationSettings settings;
+  settings.inlier_threshold = 0.0;
+  settings.num_lo_steps = 10;
+  settings.invert_Y_Z = static_cast<bool>(atoi(argv[2]));
+  settings.points_centered = static_cast<bool>(atoi(argv[3]));
+  settings.matchfile_postfix = ".individual_datasets.matches.txt";
+  if (argc >= 5) settings.matchfile_postfix = std::string(argv[4]);
+  settings.min_num_matches = 5;
+  settings.random_seed = 0u;
+  settings.map = nullptr;
+
+  localization_io::Queries queries;
+  if (!localization_io::LoadListIntrinsicsAndExtrinsics(argv[1], &queries)) {
+    std::cerr << " ERROR: Could not read the data from " << argv[1]
+              << std::endl;
+    return false;
+  }
+  instances->clear();
+  for (const localization_io::QueryData& query : queries) {
+    Instance instance;
+    if (!batch_localization::LoadQueryMatches(query, settings,
+                                              &instance.matches)) {
+      continue;
+    }
+    if (static_cast<int>(instance.matches.points2D.size()) <
+        settings.min_num_matches) {
+      continue;
+    }
+    instance.focal_x = query.focal_x;
+    instance.focal_y = query.focal_y;
+    instance.gt_pose.topLeftCorner<3, 3>() = query.q.toRotationMatrix();
+    instance.gt_pose.col(3) = query.c;
+    instances->push_back(instance);
+  }
+  std::cout << " Loaded " << instances->size() << " of " << queries.size()
+            << " queries" << std::endl;
+  return true;
+}
+
+}  // namespace magsac_benchmark
+
+}  // namespace ransac_lib
+
+int main(int argc, char** argv) {
+  using ransac_lib::magsac_benchmark::Instances;
+  using ransac_lib::magsac_benchmark::MethodStatistics;
+
+  std::cout << " usage: " << argv[0] << " [images_with_intrinsics invert_Y_Z "
+            << "points_centered [match-file postfix]]" << std::endl;
+
+  Instances instances;
+  if (argc >= 4) {
+    if (!ransac_lib::magsac_benchmark::LoadLocalizationInstances(
+            argc, argv, &instances)) {
+      return -1;
+    }
+  } else {
+    std::cout << " Using synthetic instances" << std::endl;
+    ransac_lib::magsac_benchmark::GenerateSyntheticInstances(&instances);
+  }
+  const int kNumInstances = static_cast<int>(instances.size());
+  if (kNumInstances == 0) return -1;
+
+  // Inlier thresholds in pixels.
+  const std::vector<double> kThresholds = {2.0, 4.0, 8.0, 16.0, 32.0};
+
+  std::cout << std::setw(10) << "method" << std::setw(10) << "thresh"
+            << std::setw(14) << "med. rot." << std::setw(14) << "med. pos."
+            << std::setw(12) << "ms/query" << std::setw(12) << "inliers"
+            << std::endl;
+  for (const double kThreshold : kThresholds) {
+    MethodStatistics lomsac_stats;
+    ransac_lib::magsac_benchmark::RunMethod<ransac_lib::LOMSACPolicies>(
+        instances, kThreshold, &lomsac_stats);
+    ransac_lib::magsac_benchmark::PrintStatistics("LO-MSAC", kThreshold,
+                                                  kNumInstances, lomsac_stats);
+
+    MethodStatistics magsac_stats;
+    ransac_lib::magsac_benchmark::RunMethod<
+        ransac_lib::MAGSACPlusPlusPolicies>(instances, kThreshold,
+                                            &magsac_stats);
+    ransac_lib::magsac_benchmark::PrintStatistics("MAGSAC++", kThreshold,
+                                                  kNumInstances, magsac_stats);
+  }
+  return 0;
+}
@@ -0,0 +1,215 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#include <sys/mman.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "map_store.h"
+
+namespace ransac_lib {
+
+namespace map_store {
+
+namespace {
+
+const char kMagic[8] = {'R', 'L', 'M', 'A', 'P', '\0', '\0', '\0'};
+const uint32_t kVersion = 1u;
+const uint32_t kByteOrderMark = 0x01020304u;
+const uint64_t kAlignment = 64u;
+
+uint64_t AlignOffset(const uint64_t offset) {
+  return (offset + kAlignment - 1u) / kAlignment * kAlignment;
+}
+
+}  // namespace
+
+bool WriteMapFile(const std::string& filename,
+                  const calibrated_absolute_pose::Points3D& points3D) {
+  const uint64_t kNumPoints = points3D.size();
+  const uint64_t kArraySize = AlignOffset(kNumPoints * sizeof(double));
+
+  MapFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byte_order_mark = kByteOrderMark;
+  header.num_points = kNumPoints;
+  header.X_offset = AlignOffset(sizeof(MapFileHeader));
+  header.Y_offset = header.X_offset + kArraySize;
+  header.Z_offset = header.Y_offset + kArraySize;
+
+  std::ofstream ofs(filename.c_str(), std::ios::out | std::ios::binary);
+  if (!ofs.is_open()) {
+    std::cerr << " ERROR: Cannot write to " << filename << std::endl;
+    return false;
+  }
+  ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  // Each coordinate is padded to the size of an aligned array.
+  std::vector<double> coordinate(kArraySize / sizeof(double), 0.0);
+  for (int d = 0; d < 3; ++d) {
+    for (uint64_t i = 0; i < kNumPoints; ++i) coordinate[i] = points3D[i][d];
+    ofs.write(reinterpret_cast<const char*>(coordinate.data()), kArraySize);
+  }
+
+  ofs.close();
+  if (!ofs) {
+    std::cerr << " ERROR: Failed to write " << filename << std::endl;
+    return false;
+  }
+  return true;
+}
+
+MapStore::MapStore()
+    : num_points_(0u),
+      X_(nullptr),
+      Y_(nullptr),
+      Z_(nullptr),
+      is_open_(false) {}
+
+bool MapStore::Open(const std::string& filename) {
+  Close();
+  if (!file_.Open(filename)) {
+    std::cerr << " ERROR: Cannot read the map from " << filename << std::endl;
+    return false;
+  }
+
+  const char* data = file_.data();
+  const size_t kSize = file_.size();
+  MapFileHeader header;
+  if (kSize < sizeof(header)) {
+    std::cerr << " ERROR: " << filename << " is not a map file" << std::endl;
+    file_.Close();
+    return false;
+  }
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion) {
+    std::cerr << " ERROR: " << filename << " is not a map file" << std::endl;
+    file_.Close();
+    return false;
+  }
+  if (header.byte_order_mark != kByteOrderMark) {
+    std::cerr << " ERROR: " << filename << " was written on a machine with "
+              << "a different byte order" << std::endl;
+    file_.Close();
+    return false;
+  }
+  // Bounds num_points before computing the size of the arrays, which could
+  // otherwise wrap around and pass the checks below.
+  const bool kNumPointsValid =
+      header.num_points <= (kSize - sizeof(header)) / sizeof(double);
+  const uint64_t kArrayBytes = header.num_points * sizeof(double);
+  const uint64_t kOffsets[3] = {header.X_offset, header.Y_offset,
+                                header.Z_offset};
+  for (const uint64_t kOffset : kOffsets) {
+    if (!kNumPointsValid || kOffset % kAlignment != 0u ||
+        kOffset < sizeof(header) || kOffset > kSize ||
+        kArrayBytes > kSize - kOffset) {
+      std::cerr << " ERROR: The map file " << filename << " is truncated or "
+                << "corrupted" << std::endl;
+      file_.Close();
+      return false;
+    }
+  }
+
+  // Points are accessed in random order. MappedFile assumes that the file is
+  // read front to back, which would let the kernel drop pages of the map
+  // right after they have been read.
+  if (kSize > 0u) {
+    madvise(const_cast<char*>(data), kSize, MADV_NORMAL);
+    madvise(const_cast<char*>(data), kSize, MADV_WILLNEED);
+  }
+
+  num_points_ = static_cast<size_t>(header.num_points);
+  X_ = reinterpret_cast<const double*>(data + header.X_offset);
+  Y_ = reinterpret_cast<const double*>(data + header.Y_offset);
+  Z_ = reinterpret_cast<const double*>(data + header.Z_offset);
+  is_open_ = true;
+  return true;
+}
+
+void MapStore::Build(const calibrated_absolute_pose::Points3D& points3D) {
+  Close();
+  num_points_ = points3D.size();
+  const size_t kStride =
+      static_cast<size_t>(AlignOffset(num_points_ * sizeof(double))) /
+      sizeof(double);
+  buffer_.assign(3u * kStride, 0.0);
+  for (int d = 0; d < 3; ++d) {
+    double* coordinate = buffer_.data() + d * kStride;
+    for (size_t i = 0; i < num_points_; ++i) coordinate[i] = points3D[i][d];
+  }
+  X_ = buffer_.data();
+  Y_ = X_ + kStride;
+  Z_ = Y_ + kStride;
+  is_open_ = true;
+}
+
+void MapStore::Close() {
+  file_.Close();
+  buffer_.clear();
+  buffer_.shrink_to_fit();
+  num_points_ = 0u;
+  X_ = nullptr;
+  Y_ = nullptr;
+  Z_ = nullptr;
+  is_open_ = false;
+}
+
+bool MapStore::Gather(const std::vector<uint32_t>& ids, const bool invert_Y_Z,
+                      const std::string& source,
+                      calibrated_absolute_pose::Points3D* points3D) const {
+  const size_t kNumIds = ids.size();
+  points3D->resize(kNumIds);
+  const double kSign = invert_Y_Z ? -1.0 : 1.0;
+  for (size_t i = 0; i < kNumIds; ++i) {
+    const uint32_t kId = ids[i];
+    if (kId >= num_points_) {
+      std::cerr << " ERROR: " << source << " references the point " << kId
+                << ", but the map only contains " << num_points_ << " points"
+                << std::endl;
+      return false;
+    }
+    // Inverting the y- and z-coordinate due to a choice of coordinate system.
+    (*points3D)[i] = Eigen::Vector3d(X_[kId], kSign * Y_[kId], kSign * Z_[kId]);
+  }
+  return true;
+}
+
+}  // namespace map_store
+
+}  // namespace ransac_lib
@@ -0,0 +1,125 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#ifndef RANSACLIB_EXAMPLE_MAP_STORE_H_
+#define RANSACLIB_EXAMPLE_MAP_STORE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "calibrated_absolute_pose_estimator.h"
+#include "localization_io.h"
+
+namespace ransac_lib {
+
+namespace map_store {
+
+// All queries of a localization batch are matched against the same 3D model.
+// Instead of repeating the coordinates of the 3D points in every match file,
+// the points can be stored once in a map file and referenced by their IDs
+// (see localization_io::LoadIdMatches). The map file consists of a 64 byte
+// header, followed by the coordinates stored as structure-of-arrays:
+//   X[N], Y[N], Z[N]
+// All arrays store doubles and start at 64 byte aligned offsets stored in the
+// header. The ID of a point is its index in the arrays. Values are stored in
+// the byte order of the writing machine, which is checked when reading.
+struct MapFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order_mark;
+  uint64_t num_points;
+  uint64_t X_offset;
+  uint64_t Y_offset;
+  uint64_t Z_offset;
+  uint64_t reserved[2];
+};
+static_assert(sizeof(MapFileHeader) == 64, "Unexpected header size");
+
+// Writes the points into a map file.
+bool WriteMapFile(const std::string& filename,
+                  const calibrated_absolute_pose::Points3D& points3D);
+
+// Read-only store of the 3D points of a map. A map file is memory mapped
+// rather than read, i.e., all threads of a process and all processes mapping
+// the same file share a single copy of the points in the page cache. The
+// store is never modified after it has been opened and can thus be used by
+// multiple threads without synchronization.
+class MapStore {
+ public:
+  MapStore();
+  MapStore(const MapStore&) = delete;
+  MapStore& operator=(const MapStore&) = delete;
+
+  // Maps a map file and validates its header. Returns false on failure.
+  bool Open(const std::string& filename);
+  // Builds the store from points that are already in memory. The points are
+  // copied into an aligned buffer with the same layout as a mapped file.
+  void Build(const calibrated_absolute_pose::Points3D& points3D);
+  void Close();
+
+  inline bool is_open() const { return is_open_; }
+  inline size_t num_points() const { return num_points_; }
+  inline const double* X() const { return X_; }
+  inline const double* Y() const { return Y_; }
+  inline const double* Z() const { return Z_; }
+
+  inline Eigen::Vector3d Point(const uint32_t id) const {
+    return Eigen::Vector3d(X_[id], Y_[id], Z_[id]);
+  }
+
+  // Gathers the points with the given IDs into the container used by the pose
+  // estimators, optionally inverting their Y- and Z-coordinates. Returns
+  // false if an ID is not part of the map. source is only used in error
+  // messages.
+  bool Gather(const std::vector<uint32_t>& ids, const bool invert_Y_Z,
+              const std::string& source,
+              calibrated_absolute_pose::Points3D* points3D) const;
+
+ protected:
+  // Only used if the store was opened from a file.
+  localization_io::MappedFile file_;
+  // Only used if the store was built from points in memory.
+  std::vector<double, Eigen::aligned_allocator<double>> buffer_;
+  size_t num_points_;
+  const double* X_;
+  const double* Y_;
+  const double* Z_;
+  bool is_open_;
+};
+
+}  // namespace map_store
+
+}  // namespace ransac_lib
+
+#endif  // RANSACLIB_EXAMPLE_MAP_STORE_H_
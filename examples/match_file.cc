@@ -0,0 +1,265 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "match_file.h"
+
+namespace ransac_lib {
+
+namespace match_file {
+
+namespace {
+
+const char kMagic[8] = {'R', 'L', 'M', 'A', 'T', 'C', 'H', '\0'};
+const uint32_t kVersion = 1u;
+const uint32_t kByteOrderMark = 0x01020304u;
+const uint64_t kAlignment = 64u;
+
+uint64_t AlignOffset(const uint64_t offset) {
+  return (offset + kAlignment - 1u) / kAlignment * kAlignment;
+}
+
+// Writes num_values values of type T, converted from double, followed by
+// zero padding up to the next aligned offset.
+template <typename T>
+void WriteArray(const std::vector<double>& values, std::ofstream* ofs) {
+  std::vector<T> converted(values.begin(), values.end());
+  ofs->write(reinterpret_cast<const char*>(converted.data()),
+             converted.size() * sizeof(T));
+  const uint64_t kSize = converted.size() * sizeof(T);
+  const std::vector<char> kPadding(AlignOffset(kSize) - kSize, 0);
+  ofs->write(kPadding.data(), kPadding.size());
+}
+
+}  // namespace
+
+bool IsBinaryMatchFile(const std::string& filename) {
+  const std::string kExtension = ".bin";
+  return filename.size() >= kExtension.size() &&
+         filename.compare(filename.size() - kExtension.size(),
+                          kExtension.size(), kExtension) == 0;
+}
+
+bool WriteBinaryMatches(const std::string& filename,
+                        const calibrated_absolute_pose::Points2D& points2D,
+                        const calibrated_absolute_pose::Points3D& points3D,
+                        const std::vector<double>* scores,
+                        const bool use_double) {
+  const uint64_t kNumMatches = points2D.size();
+  if (points3D.size() != kNumMatches ||
+      (scores != nullptr && scores->size() != kNumMatches)) {
+    std::cerr << " ERROR: Inconsistent number of matches for " << filename
+              << std::endl;
+    return false;
+  }
+  const uint64_t kScalarSize = use_double ? sizeof(double) : sizeof(float);
+
+  MatchFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byte_order_mark = kByteOrderMark;
+  header.flags = (use_double ? kMatchFileFlagDouble : 0u) |
+                 (scores != nullptr ? kMatchFileFlagScores : 0u);
+  header.header_size = sizeof(MatchFileHeader);
+  header.num_matches = kNumMatches;
+  header.points2D_offset = AlignOffset(sizeof(MatchFileHeader));
+  header.points3D_offset =
+      header.points2D_offset + AlignOffset(2u * kNumMatches * kScalarSize);
+  if (scores != nullptr) {
+    header.scores_offset =
+        header.points3D_offset + AlignOffset(3u * kNumMatches * kScalarSize);
+  }
+
+  std::ofstream ofs(filename.c_str(), std::ios::out | std::ios::binary);
+  if (!ofs.is_open()) {
+    std::cerr << " ERROR: Cannot write to " << filename << std::endl;
+    return false;
+  }
+  ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  // Gathers the coordinates into structure-of-arrays layout.
+  std::vector<double> soa_2D(2u * kNumMatches);
+  std::vector<double> soa_3D(3u * kNumMatches);
+  for (uint64_t i = 0; i < kNumMatches; ++i) {
+    for (int d = 0; d < 2; ++d) soa_2D[d * kNumMatches + i] = points2D[i][d];
+    for (int d = 0; d < 3; ++d) soa_3D[d * kNumMatches + i] = points3D[i][d];
+  }
+  if (use_double) {
+    WriteArray<double>(soa_2D, &ofs);
+    WriteArray<double>(soa_3D, &ofs);
+    if (scores != nullptr) WriteArray<double>(*scores, &ofs);
+  } else {
+    WriteArray<float>(soa_2D, &ofs);
+    WriteArray<float>(soa_3D, &ofs);
+    if (scores != nullptr) WriteArray<float>(*scores, &ofs);
+  }
+
+  ofs.close();
+  if (!ofs) {
+    std::cerr << " ERROR: Failed to write " << filename << std::endl;
+    return false;
+  }
+  return true;
+}
+
+MappedMatchFile::MappedMatchFile()
+    : data_(nullptr), size_(0u), num_matches_(0) {}
+
+MappedMatchFile::~MappedMatchFile() { Close(); }
+
+bool MappedMatchFile::Open(const std::string& filename) {
+  Close();
+
+  if (!file_.Open(filename)) {
+    std::cerr << " ERROR: Cannot read the matches from " << filename
+              << std::endl;
+    return false;
+  }
+  return Attach(file_.data(), file_.size(), filename);
+}
+
+bool MappedMatchFile::OpenBuffer(const char* data, const size_t size,
+                                 const std::string& source) {
+  Close();
+  return Attach(data, size, source);
+}
+
+bool MappedMatchFile::Attach(const char* data, const size_t size,
+                             const std::string& source) {
+  if (data == nullptr || size < sizeof(MatchFileHeader)) {
+    std::cerr << " ERROR: " << source << " is not a binary match file"
+              << std::endl;
+    Close();
+    return false;
+  }
+  data_ = data;
+  size_ = size;
+
+  // Validates the header and that all arrays are inside the data.
+  const MatchFileHeader& h = header();
+  bool valid = std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0 &&
+               h.version == kVersion && h.byte_order_mark == kByteOrderMark &&
+               h.header_size == sizeof(MatchFileHeader) &&
+               h.num_matches <= static_cast<uint64_t>(INT32_MAX);
+  if (valid) {
+    const uint64_t kScalarSize = (h.flags & kMatchFileFlagDouble) != 0u
+                                     ? sizeof(double)
+                                     : sizeof(float);
+    const uint64_t kN = h.num_matches;
+    // The arrays start after the header and end inside the data. The byte
+    // counts cannot overflow since num_matches <= INT32_MAX, the sums of
+    // offsets and byte counts could.
+    const uint64_t kSize = size_;
+    auto in_bounds = [kSize](const uint64_t offset, const uint64_t bytes) {
+      return offset % kAlignment == 0u &&
+             offset >= sizeof(MatchFileHeader) && offset <= kSize &&
+             bytes <= kSize - offset;
+    };
+    valid = in_bounds(h.points2D_offset, 2u * kN * kScalarSize) &&
+            in_bounds(h.points3D_offset, 3u * kN * kScalarSize);
+    if ((h.flags & kMatchFileFlagScores) != 0u) {
+      valid = valid && in_bounds(h.scores_offset, kN * kScalarSize);
+    }
+  }
+  if (!valid) {
+    std::cerr << " ERROR: " << source << " is not a valid binary match file"
+              << std::endl;
+    Close();
+    return false;
+  }
+  num_matches_ = static_cast<int>(h.num_matches);
+  return true;
+}
+
+void MappedMatchFile::Close() {
+  file_.Close();
+  data_ = nullptr;
+  size_ = 0u;
+  num_matches_ = 0;
+}
+
+void MappedMatchFile::CopyTo(const bool invert_Y_Z,
+                             calibrated_absolute_pose::Points2D* points2D,
+                             calibrated_absolute_pose::Points3D* points3D)
+    const {
+  points2D->resize(num_matches_);
+  points3D->resize(num_matches_);
+  const double kSign = invert_Y_Z ? -1.0 : 1.0;
+  if (uses_double()) {
+    const auto kP2D = this->points2D<double>();
+    const auto kP3D = this->points3D<double>();
+    for (int i = 0; i < num_matches_; ++i) {
+      (*points2D)[i] = kP2D.row(i).transpose();
+      (*points3D)[i] << kP3D(i, 0), kSign * kP3D(i, 1), kSign * kP3D(i, 2);
+    }
+  } else {
+    const auto kP2D = this->points2D<float>();
+    const auto kP3D = this->points3D<float>();
+    for (int i = 0; i < num_matches_; ++i) {
+      (*points2D)[i] = kP2D.row(i).transpose().cast<double>();
+      (*points3D)[i] << kP3D(i, 0), kSign * kP3D(i, 1), kSign * kP3D(i, 2);
+    }
+  }
+}
+
+bool LoadBinaryMatches(const std::string& filename, const bool invert_Y_Z,
+                       calibrated_absolute_pose::Points2D* points2D,
+                       calibrated_absolute_pose::Points3D* points3D) {
+  points2D->clear();
+  points3D->clear();
+  MappedMatchFile file;
+  if (!file.Open(filename)) return false;
+  file.CopyTo(invert_Y_Z, points2D, points3D);
+  return true;
+}
+
+bool ParseBinaryMatches(const char* data, const size_t size,
+                        const bool invert_Y_Z, const std::string& source,
+                        calibrated_absolute_pose::Points2D* points2D,
+                        calibrated_absolute_pose::Points3D* points3D) {
+  points2D->clear();
+  points3D->clear();
+  MappedMatchFile file;
+  if (!file.OpenBuffer(data, size, source)) return false;
+  file.CopyTo(invert_Y_Z, points2D, points3D);
+  return true;
+}
+
+}  // namespace match_file
+
+}  // namespace ransac_lib
@@ -0,0 +1,188 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#ifndef RANSACLIB_EXAMPLE_MATCH_FILE_H_
+#define RANSACLIB_EXAMPLE_MATCH_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "calibrated_absolute_pose_estimator.h"
+#include "localization_io.h"
+
+namespace ransac_lib {
+
+namespace match_file {
+
+// A binary format for 2D-3D matches. The file consists of a 64 byte header,
+// followed by the coordinates stored as structure-of-arrays:
+//   x[N], y[N]           2D positions
+//   X[N], Y[N], Z[N]     3D positions
+//   score[N]             optional per-match score (e.g., a matching score)
+// All arrays use the same scalar type (float or double) and start at 64 byte
+// aligned offsets stored in the header. As the arrays are laid out
+// contiguously, the 2D (3D) positions form a column-major N x 2 (N x 3)
+// matrix that can be mapped directly from the file. Values are stored in the
+// byte order of the writing machine, which is checked when reading.
+struct MatchFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order_mark;
+  uint32_t flags;
+  uint32_t header_size;
+  uint64_t num_matches;
+  uint64_t points2D_offset;
+  uint64_t points3D_offset;
+  // 0 if the file does not contain scores.
+  uint64_t scores_offset;
+  uint64_t reserved;
+};
+static_assert(sizeof(MatchFileHeader) == 64, "Unexpected header size");
+
+const uint32_t kMatchFileFlagDouble = 1u;
+const uint32_t kMatchFileFlagScores = 2u;
+
+// Returns true if the filename ends with ".bin", i.e., refers to a binary
+// match file.
+bool IsBinaryMatchFile(const std::string& filename);
+
+// Writes matches in the binary format, either with float or double precision.
+// scores can be nullptr, otherwise it needs to contain one entry per match.
+bool WriteBinaryMatches(const std::string& filename,
+                        const calibrated_absolute_pose::Points2D& points2D,
+                        const calibrated_absolute_pose::Points3D& points3D,
+                        const std::vector<double>* scores,
+                        const bool use_double);
+
+// Read-only memory mapping of a binary match file. The views returned by the
+// accessors point directly into the mapped file, i.e., no data is copied, and
+// are valid until the file is closed. Accessing the data with a scalar type
+// that does not match the precision of the file returns an empty view.
+class MappedMatchFile {
+ public:
+  MappedMatchFile();
+  ~MappedMatchFile();
+  MappedMatchFile(const MappedMatchFile&) = delete;
+  MappedMatchFile& operator=(const MappedMatchFile&) = delete;
+
+  // Maps the file and validates its header. Returns false on failure.
+  bool Open(const std::string& filename);
+  // Uses a match file that is already in memory, e.g., received over a
+  // socket. The data is not copied and needs to outlive this object. source
+  // is only used in error messages.
+  bool OpenBuffer(const char* data, const size_t size,
+                  const std::string& source);
+  void Close();
+
+  inline bool is_open() const { return data_ != nullptr; }
+  inline int num_matches() const { return num_matches_; }
+  inline bool uses_double() const {
+    return (header().flags & kMatchFileFlagDouble) != 0u;
+  }
+  inline bool has_scores() const {
+    return (header().flags & kMatchFileFlagScores) != 0u;
+  }
+
+  template <typename T>
+  Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, 2>> points2D() const {
+    return Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, 2>>(
+        Array<T>(header().points2D_offset), Rows<T>(), 2);
+  }
+
+  template <typename T>
+  Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, 3>> points3D() const {
+    return Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, 3>>(
+        Array<T>(header().points3D_offset), Rows<T>(), 3);
+  }
+
+  template <typename T>
+  Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, 1>> scores() const {
+    return Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, 1>>(
+        Array<T>(header().scores_offset), has_scores() ? Rows<T>() : 0, 1);
+  }
+
+  // Converts the matches into the containers used by the pose estimators,
+  // optionally inverting the Y- and Z-coordinates of the 3D points.
+  void CopyTo(const bool invert_Y_Z,
+              calibrated_absolute_pose::Points2D* points2D,
+              calibrated_absolute_pose::Points3D* points3D) const;
+
+ protected:
+  inline const MatchFileHeader& header() const {
+    return *reinterpret_cast<const MatchFileHeader*>(data_);
+  }
+
+  template <typename T>
+  inline bool MatchesPrecision() const {
+    return sizeof(T) == (uses_double() ? sizeof(double) : sizeof(float));
+  }
+
+  template <typename T>
+  inline int Rows() const {
+    return MatchesPrecision<T>() ? num_matches_ : 0;
+  }
+
+  template <typename T>
+  inline const T* Array(const uint64_t offset) const {
+    if (!MatchesPrecision<T>() || offset == 0u) return nullptr;
+    return reinterpret_cast<const T*>(data_ + offset);
+  }
+
+  // Validates the header and the array offsets of the given data.
+  bool Attach(const char* data, const size_t size, const std::string& source);
+
+  // Only used if the data is read from a file.
+  localization_io::MappedFile file_;
+  const char* data_;
+  size_t size_;
+  int num_matches_;
+};
+
+// Loads the matches from a binary match file into the containers used by the
+// pose estimators.
+bool LoadBinaryMatches(const std::string& filename, const bool invert_Y_Z,
+                       calibrated_absolute_pose::Points2D* points2D,
+                       calibrated_absolute_pose::Points3D* points3D);
+
+// Same as LoadBinaryMatches, but for a match file that is already in memory.
+bool ParseBinaryMatches(const char* data, const size_t size,
+                        const bool invert_Y_Z, const std::string& source,
+                        calibrated_absolute_pose::Points2D* points2D,
+                        calibrated_absolute_pose::Points3D* points3D);
+
+}  // namespace match_file
+
+}  // namespace ransac_lib
+
+#endif  // RANSACLIB_EXAMPLE_MATCH_FILE_H_
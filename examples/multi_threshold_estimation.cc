@@ -0,0 +1,140 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// Compares MultiThresholdLocallyOptimizedMSAC, which estimates models for
+// multiple inlier thresholds in a single run, to running LocallyOptimizedMSAC
+// once per threshold. Both are expected to produce identical results, while
+// the multi-threshold variant shares the random samples, minimal solver
+// calls, and residual computations between the thresholds.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <RansacLib/multi_threshold_ransac.h>
+#include <RansacLib/ransac.h>
+#include "line_estimator.h"
+#include "synthetic_datasets.h"
+
+int main(int argc, char** argv) {
+  ransac_lib::MultiThresholdLORansacOptions options;
+  options.min_num_iterations_ = 100u;
+  options.max_num_iterations_ = 100000u;
+  options.squared_inlier_thresholds_ = {0.005 * 0.005, 0.01 * 0.01,
+                                        0.02 * 0.02, 0.04 * 0.04};
+  const int kNumThresholds =
+      static_cast<int>(options.squared_inlier_thresholds_.size());
+
+  // The seed can be passed as the first argument.
+  const unsigned int kSeed =
+      argc > 1 ? static_cast<unsigned int>(std::stoul(argv[1])) : 0u;
+  options.random_seed_ = kSeed;
+  std::mt19937 rng(kSeed);
+
+  const int kNumDataPoints = 10000;
+  std::vector<double> outlier_ratios = {0.1, 0.3, 0.5, 0.7, 0.9, 0.95};
+  bool all_identical = true;
+  for (const double outlier_ratio : outlier_ratios) {
+    std::cout << " Inlier ratio: " << 1.0 - outlier_ratio << std::endl;
+    int num_outliers =
+        static_cast<int>(static_cast<double>(kNumDataPoints) * outlier_ratio);
+    int num_inliers = kNumDataPoints - num_outliers;
+
+    Eigen::Matrix2Xd data;
+    Eigen::Vector3d gt_line;
+    std::vector<int> gt_inliers;
+    ransac_lib::synthetic::GenerateLineInstance(
+        num_inliers, num_outliers, 0.5 * 0.01, &rng, &data, &gt_line,
+        &gt_inliers);
+
+    ransac_lib::LineEstimator solver(data);
+
+    // A single run for all thresholds.
+    ransac_lib::MultiThresholdLocallyOptimizedMSAC<
+        Eigen::Vector3d, std::vector<Eigen::Vector3d>,
+        ransac_lib::LineEstimator>
+        multi_lomsac;
+    std::vector<Eigen::Vector3d> multi_models;
+    std::vector<ransac_lib::RansacStatistics> multi_stats;
+    auto multi_start = std::chrono::steady_clock::now();
+    multi_lomsac.EstimateModels(options, solver, &multi_models, &multi_stats);
+    auto multi_end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> multi_seconds = multi_end - multi_start;
+
+    // One run per threshold.
+    ransac_lib::LocallyOptimizedMSAC<Eigen::Vector3d,
+                                     std::vector<Eigen::Vector3d>,
+                                     ransac_lib::LineEstimator>
+        lomsac;
+    double single_seconds = 0.0;
+    for (int t = 0; t < kNumThresholds; ++t) {
+      ransac_lib::LORansacOptions single_options = options;
+      single_options.squared_inlier_threshold_ =
+          options.squared_inlier_thresholds_[t];
+      ransac_lib::RansacStatistics stats;
+      Eigen::Vector3d model;
+      auto single_start = std::chrono::steady_clock::now();
+      lomsac.EstimateModel(single_options, solver, &model, &stats);
+      auto single_end = std::chrono::steady_clock::now();
+      std::chrono::duration<double> elapsed = single_end - single_start;
+      single_seconds += elapsed.count();
+
+      const bool kIdentical =
+          model == multi_models[t] &&
+          stats.num_iterations == multi_stats[t].num_iterations &&
+          stats.best_model_score == multi_stats[t].best_model_score &&
+          stats.inlier_indices == multi_stats[t].inlier_indices &&
+          stats.number_lo_iterations == multi_stats[t].number_lo_iterations;
+      all_identical &= kIdentical;
+      std::cout << "   ... threshold "
+                << std::sqrt(options.squared_inlier_thresholds_[t]) << ": "
+                << multi_stats[t].best_num_inliers << " inliers in "
+                << multi_stats[t].num_iterations << " iterations"
+                << (kIdentical ? "" : " (DIFFERS from single run)")
+                << std::endl;
+    }
+    std::cout << "   ... multi-threshold run took " << multi_seconds.count()
+              << " s, separate runs took " << single_seconds << " s"
+              << std::endl;
+  }
+
+  std::cout << (all_identical ? " All results identical"
+                              : " Results differ")
+            << std::endl;
+  return all_identical ? 0 : 1;
+}
@@ -0,0 +1,523 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// Python bindings for LocallyOptimizedMSAC with the line and the calibrated
+// absolute pose estimators and for HybridLocallyOptimizedMSAC with the hybrid
+// line estimator. Example usage:
+//   import numpy as np
+//   import pyransaclib
+//   options = pyransaclib.LORansacOptions()
+//   options.squared_inlier_threshold = 0.01 ** 2
+//   result = pyransaclib.estimate_line(points, options)
+//   inliers = points[result["inlier_mask"]]
+// Input arrays need to be C-contiguous float64 arrays and are never converted
+// implicitly, i.e., passing other arrays raises a TypeError instead of
+// silently creating a copy (use np.ascontiguousarray(a, dtype=np.float64)).
+// The line estimators work directly on the NumPy buffers. The camera pose
+// estimator copies the matches as OpenGV's adapter requires std::vectors.
+// The GIL is released while RANSAC runs. The batch functions estimate models
+// for a list of problems in parallel on RansacLib's thread pool and return a
+// list of results.
+// Every result is a dict holding the estimated model and the RANSAC
+// statistics. The inlier masks are boolean NumPy arrays that view buffers
+// owned by the bindings.
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <RansacLib/executor.h>
+#include <RansacLib/hybrid_ransac.h>
+#include <RansacLib/ransac.h>
+#include "calibrated_absolute_pose_estimator.h"
+#include "hybrid_line_estimator.h"
+#include "line_estimator.h"
+
+namespace py = pybind11;
+
+namespace ransac_lib {
+
+namespace python {
+
+using calibrated_absolute_pose::CalibratedAbsolutePoseEstimator;
+using calibrated_absolute_pose::CameraPose;
+using calibrated_absolute_pose::CameraPoses;
+using calibrated_absolute_pose::Points2D;
+using calibrated_absolute_pose::Points3D;
+using calibrated_absolute_pose::ViewingRays;
+
+typedef py::array_t<double, py::array::c_style> DoubleArray;
+
+// The outcome of a single RANSAC run. Filled without holding the GIL and
+// converted to a dict afterwards.
+template <class Model>
+struct Result {
+  Model model;
+  int num_ransac_inliers = 0;
+  RansacStatistics stats;
+  int num_data = 0;
+};
+
+struct HybridResult {
+  Eigen::Vector3d model;
+  int num_ransac_inliers = 0;
+  HybridRansacStatistics stats;
+  std::vector<int> num_data;
+};
+
+// Returns the number of rows of an array of shape (N, num_cols).
+int NumRows(const DoubleArray& array, const int num_cols, const char* name) {
+  if (array.ndim() != 2 || array.shape(1) != num_cols) {
+    throw std::invalid_argument(std::string(name) + " must have shape (N, " +
+                                std::to_string(num_cols) + ")");
+  }
+  return static_cast<int>(array.shape(0));
+}
+
+// Calls function(i) for i = 0, ..., num_tasks - 1. num_threads <= 0 uses the
+// process-wide thread pool (see DefaultExecutor), otherwise a pool with
+// num_threads threads is created for the call.
+void ParallelFor(const int num_tasks, const int num_threads,
+                 const std::function<void(int)>& function) {
+  if (num_threads <= 0) {
+    DefaultExecutor()->BulkFor(num_tasks, function);
+  } else {
+    ThreadPoolExecutor executor(num_threads);
+    executor.BulkFor(num_tasks, function);
+  }
+}
+
+// Returns a boolean array of size num_data that is true for the inliers. The
+// array views a buffer that is released together with the array.
+py::array_t<bool> InlierMask(const std::vector<int>& inliers,
+                             const int num_data) {
+  std::unique_ptr<bool[]> mask(new bool[std::max(num_data, 1)]());
+  for (const int i : inliers) mask[i] = true;
+  py::capsule owner(mask.get(),
+                    [](void* data) { delete[] static_cast<bool*>(data); });
+  bool* data = mask.release();
+  return py::array_t<bool>({static_cast<py::ssize_t>(num_data)},
+                           {static_cast<py::ssize_t>(sizeof(bool))}, data,
+                           owner);
+}
+
+py::dict StatisticsToDict(const RansacStatistics& stats,
+                          const int num_ransac_inliers, const int num_data) {
+  py::dict result;
+  result["num_inliers"] = num_ransac_inliers;
+  result["num_iterations"] = stats.num_iterations;
+  result["score"] = stats.best_model_score;
+  result["inlier_ratio"] = stats.inlier_ratio;
+  result["num_lo_iterations"] = stats.number_lo_iterations;
+  result["inlier_mask"] = InlierMask(stats.inlier_indices, num_data);
+  return result;
+}
+
+py::dict ToDict(const Result<Eigen::Vector3d>& line) {
+  py::dict result =
+      StatisticsToDict(line.stats, line.num_ransac_inliers, line.num_data);
+  py::array_t<double> model(3);
+  std::copy(line.model.data(), line.model.data() + 3, model.mutable_data());
+  result["model"] = model;
+  return result;
+}
+
+// The pose [R | c] is returned as a 3x4 array (see
+// CalibratedAbsolutePoseEstimator).
+py::dict ToDict(const Result<CameraPose>& pose) {
+  py::dict result =
+      StatisticsToDict(pose.stats, pose.num_ransac_inliers, pose.num_data);
+  py::array_t<double> model({3, 4});
+  auto m = model.mutable_unchecked<2>();
+  for (int r = 0; r < 3; ++r) {
+    for (int c = 0; c < 4; ++c) m(r, c) = pose.model(r, c);
+  }
+  result["model"] = model;
+  return result;
+}
+
+py::dict ToDict(const HybridResult& line) {
+  py::dict result;
+  result["num_inliers"] = line.num_ransac_inliers;
+  result["num_iterations"] = line.stats.num_iterations_total;
+  result["num_iterations_per_solver"] = line.stats.num_iterations_per_solver;
+  result["best_solver_type"] = line.stats.best_solver_type;
+  result["score"] = line.stats.best_model_score;
+  result["inlier_ratios"] = line.stats.inlier_ratios;
+  result["num_lo_iterations"] = line.stats.number_lo_iterations;
+  py::list masks;
+  for (int t = 0; t < static_cast<int>(line.num_data.size()); ++t) {
+    const std::vector<int> kNoInliers;
+    const std::vector<int>& inliers =
+        t < static_cast<int>(line.stats.inlier_indices.size())
+            ? line.stats.inlier_indices[t]
+            : kNoInliers;
+    masks.append(InlierMask(inliers, line.num_data[t]));
+  }
+  result["inlier_masks"] = masks;
+  py::array_t<double> model(3);
+  std::copy(line.model.data(), line.model.data() + 3, model.mutable_data());
+  result["model"] = model;
+  return result;
+}
+
+// The problem descriptions only hold pointers into the NumPy buffers, such
+// that they can be used without holding the GIL.
+struct LineProblem {
+  const double* points;
+  int num_points;
+};
+
+struct HybridLineProblem {
+  const double* points;
+  int num_points;
+  const double* points_with_normals;
+  int num_points_with_normals;
+};
+
+struct PoseProblem {
+  const double* points2D;
+  const double* points3D;
+  int num_points;
+  double focal_x;
+  double focal_y;
+};
+
+LineProblem MakeLineProblem(const DoubleArray& points) {
+  return {points.data(), NumRows(points, 2, "points")};
+}
+
+HybridLineProblem MakeHybridLineProblem(
+    const DoubleArray& points, const DoubleArray& points_with_normals) {
+  return {points.data(), NumRows(points, 2, "points"),
+          points_with_normals.data(),
+          NumRows(points_with_normals, 4, "points_with_normals")};
+}
+
+PoseProblem MakePoseProblem(const DoubleArray& points2D,
+                            const DoubleArray& points3D, const double focal_x,
+                            const double focal_y) {
+  const int kNumPoints = NumRows(points2D, 2, "points2D");
+  if (NumRows(points3D, 3, "points3D") != kNumPoints) {
+    throw std::invalid_argument(
+        "points2D and points3D must have the same number of rows");
+  }
+  return {points2D.data(), points3D.data(), kNumPoints, focal_x, focal_y};
+}
+
+void Estimate(const LORansacOptions& options, const LineProblem& problem,
+              Result<Eigen::Vector3d>* result) {
+  LineEstimator solver(problem.points, problem.num_points);
+  LocallyOptimizedMSAC<Eigen::Vector3d, std::vector<Eigen::Vector3d>,
+                       LineEstimator>
+      lomsac;
+  result->num_data = problem.num_points;
+  result->num_ransac_inliers =
+      lomsac.EstimateModel(options, solver, &result->model, &result->stats);
+}
+
+// The hybrid line estimator has two data types, points and points with
+// normals, and indexes the per-type options without checking their sizes.
+void CheckHybridLineOptions(const HybridLORansacOptions& options,
+                            const std::vector<double>& prior_probabilities) {
+  if (options.squared_inlier_thresholds_.size() != 2u ||
+      options.data_type_weights_.size() != 2u ||
+      prior_probabilities.size() != 2u) {
+    throw std::invalid_argument(
+        "squared_inlier_thresholds, data_type_weights, and "
+        "prior_probabilities must have length 2");
+  }
+}
+
+void Estimate(const HybridLORansacOptions& options,
+              const std::vector<double>& prior_probabilities,
+              const HybridLineProblem& problem, HybridResult* result) {
+  HybridLineEstimator solver(problem.points, problem.num_points,
+                             problem.points_with_normals,
+                             problem.num_points_with_normals,
+                             prior_probabilities);
+  HybridLocallyOptimizedMSAC<Eigen::Vector3d, std::vector<Eigen::Vector3d>,
+                             HybridLineEstimator>
+      lomsac;
+  result->num_data = {problem.num_points, problem.num_points_with_normals};
+  result->num_ransac_inliers =
+      lomsac.EstimateModel(options, solver, &result->model, &result->stats);
+}
+
+void Estimate(const LORansacOptions& options, const PoseProblem& problem,
+              Result<CameraPose>* result) {
+  Points2D points2D(problem.num_points);
+  Points3D points3D(problem.num_points);
+  for (int i = 0; i < problem.num_points; ++i) {
+    points2D[i] << problem.points2D[2 * i], problem.points2D[2 * i + 1];
+    points3D[i] << problem.points3D[3 * i], problem.points3D[3 * i + 1],
+        problem.points3D[3 * i + 2];
+  }
+  ViewingRays rays;
+  CalibratedAbsolutePoseEstimator::PixelsToViewingRays(
+      problem.focal_x, problem.focal_y, points2D, &rays);
+  CalibratedAbsolutePoseEstimator solver(
+      problem.focal_x, problem.focal_y, options.squared_inlier_threshold_,
+      points2D, rays, points3D);
+  LocallyOptimizedMSAC<CameraPose, CameraPoses,
+                       CalibratedAbsolutePoseEstimator>
+      lomsac;
+  result->num_data = problem.num_points;
+  result->num_ransac_inliers =
+      lomsac.EstimateModel(options, solver, &result->model, &result->stats);
+}
+
+// Runs Estimate on all problems in parallel without holding the GIL and
+// converts the results to dicts afterwards.
+template <class Options, class Problem, class ResultType>
+py::list EstimateBatch(const Options& options,
+                       const std::vector<Problem>& problems,
+                       const int num_threads) {
+  const int kNumProblems = static_cast<int>(problems.size());
+  std::vector<ResultType> results(kNumProblems);
+  {
+    py::gil_scoped_release release;
+    ParallelFor(kNumProblems, num_threads, [&](const int i) {
+      Estimate(options, problems[i], &results[i]);
+    });
+  }
+  py::list list;
+  for (const ResultType& result : results) list.append(ToDict(result));
+  return list;
+}
+
+py::dict EstimateLine(const DoubleArray& points,
+                      const LORansacOptions& options) {
+  const LineProblem kProblem = MakeLineProblem(points);
+  Result<Eigen::Vector3d> result;
+  {
+    py::gil_scoped_release release;
+    Estimate(options, kProblem, &result);
+  }
+  return ToDict(result);
+}
+
+py::list EstimateLines(const std::vector<DoubleArray>& points,
+                       const LORansacOptions& options, const int num_threads) {
+  std::vector<LineProblem> problems;
+  for (const DoubleArray& p : points) problems.push_back(MakeLineProblem(p));
+  return EstimateBatch<LORansacOptions, LineProblem, Result<Eigen::Vector3d>>(
+      options, problems, num_threads);
+}
+
+py::dict EstimateHybridLine(const DoubleArray& points,
+                            const DoubleArray& points_with_normals,
+                            const std::vector<double>& prior_probabilities,
+                            const HybridLORansacOptions& options) {
+  CheckHybridLineOptions(options, prior_probabilities);
+  const HybridLineProblem kProblem =
+      MakeHybridLineProblem(points, points_with_normals);
+  HybridResult result;
+  {
+    py::gil_scoped_release release;
+    Estimate(options, prior_probabilities, kProblem, &result);
+  }
+  return ToDict(result);
+}
+
+py::list EstimateHybridLines(
+    const std::vector<DoubleArray>& points,
+    const std::vector<DoubleArray>& points_with_normals,
+    const std::vector<double>& prior_probabilities,
+    const HybridLORansacOptions& options, const int num_threads) {
+  if (points.size() != points_with_normals.size()) {
+    throw std::invalid_argument(
+        "points and points_with_normals must have the same length");
+  }
+  CheckHybridLineOptions(options, prior_probabilities);
+  std::vector<HybridLineProblem> problems;
+  for (size_t i = 0; i < points.size(); ++i) {
+    problems.push_back(
+        MakeHybridLineProblem(points[i], points_with_normals[i]));
+  }
+  const int kNumProblems = static_cast<int>(problems.size());
+  std::vector<HybridResult> results(kNumProblems);
+  {
+    py::gil_scoped_release release;
+    ParallelFor(kNumProblems, num_threads, [&](const int i) {
+      Estimate(options, prior_probabilities, problems[i], &results[i]);
+    });
+  }
+  py::list list;
+  for (const HybridResult& result : results) list.append(ToDict(result));
+  return list;
+}
+
+py::dict EstimateAbsolutePose(const DoubleArray& points2D,
+                              const DoubleArray& points3D,
+                              const double focal_x, const double focal_y,
+                              const LORansacOptions& options) {
+  const PoseProblem kProblem =
+      MakePoseProblem(points2D, points3D, focal_x, focal_y);
+  Result<CameraPose> result;
+  {
+    py::gil_scoped_release release;
+    Estimate(options, kProblem, &result);
+  }
+  return ToDict(result);
+}
+
+py::list EstimateAbsolutePoses(const std::vector<DoubleArray>& points2D,
+                               const std::vector<DoubleArray>& points3D,
+                               const std::vector<double>& focal_x,
+                               const std::vector<double>& focal_y,
+                               const LORansacOptions& options,
+                               const int num_threads) {
+  const size_t kNumProblems = points2D.size();
+  if (points3D.size() != kNumProblems || focal_x.size() != kNumProblems ||
+      focal_y.size() != kNumProblems) {
+    throw std::invalid_argument(
+        "points2D, points3D, focal_x, and focal_y must have the same length");
+  }
+  std::vector<PoseProblem> problems;
+  for (size_t i = 0; i < kNumProblems; ++i) {
+    problems.push_back(
+        MakePoseProblem(points2D[i], points3D[i], focal_x[i], focal_y[i]));
+  }
+  return EstimateBatch<LORansacOptions, PoseProblem, Result<CameraPose>>(
+      options, problems, num_threads);
+}
+
+}  // namespace python
+
+}  // namespace ransac_lib
+
+PYBIND11_MODULE(pyransaclib, m) {
+  using ransac_lib::HybridLORansacOptions;
+  using ransac_lib::LORansacOptions;
+  namespace python = ransac_lib::python;
+
+  m.doc() = "Python bindings for RansacLib's LO-MSAC implementations.";
+
+  py::class_<LORansacOptions>(m, "LORansacOptions")
+      .def(py::init<>())
+      .def_readwrite("min_num_iterations",
+                     &LORansacOptions::min_num_iterations_)
+      .def_readwrite("max_num_iterations",
+                     &LORansacOptions::max_num_iterations_)
+      .def_readwrite("success_probability",
+                     &LORansacOptions::success_probability_)
+      .def_readwrite("squared_inlier_threshold",
+                     &LORansacOptions::squared_inlier_threshold_)
+      .def_readwrite("random_seed", &LORansacOptions::random_seed_)
+      .def_readwrite("num_lo_steps", &LORansacOptions::num_lo_steps_)
+      .def_readwrite("threshold_multiplier",
+                     &LORansacOptions::threshold_multiplier_)
+      .def_readwrite("num_lsq_iterations",
+                     &LORansacOptions::num_lsq_iterations_)
+      .def_readwrite("min_sample_multiplicator",
+                     &LORansacOptions::min_sample_multiplicator_)
+      .def_readwrite("non_min_sample_multiplier",
+                     &LORansacOptions::non_min_sample_multiplier_)
+      .def_readwrite("lo_starting_iterations",
+                     &LORansacOptions::lo_starting_iterations_)
+      .def_readwrite("final_least_squares",
+                     &LORansacOptions::final_least_squares_);
+
+  // The vector-valued members are converted to and from Python lists, i.e.,
+  // they need to be assigned as a whole.
+  py::class_<HybridLORansacOptions>(m, "HybridLORansacOptions")
+      .def(py::init<>())
+      .def_readwrite("min_num_iterations",
+                     &HybridLORansacOptions::min_num_iterations_)
+      .def_readwrite("max_num_iterations",
+                     &HybridLORansacOptions::max_num_iterations_)
+      .def_readwrite("max_num_iterations_per_solver",
+                     &HybridLORansacOptions::max_num_iterations_per_solver_)
+      .def_readwrite("success_probability",
+                     &HybridLORansacOptions::success_probability_)
+      .def_readwrite("squared_inlier_thresholds",
+                     &HybridLORansacOptions::squared_inlier_thresholds_)
+      .def_readwrite("data_type_weights",
+                     &HybridLORansacOptions::data_type_weights_)
+      .def_readwrite("random_seed", &HybridLORansacOptions::random_seed_)
+      .def_readwrite("num_lo_steps", &HybridLORansacOptions::num_lo_steps_)
+      .def_readwrite("threshold_multiplier",
+                     &HybridLORansacOptions::threshold_multiplier_)
+      .def_readwrite("num_lsq_iterations",
+                     &HybridLORansacOptions::num_lsq_iterations_)
+      .def_readwrite("min_sample_multiplicator",
+                     &HybridLORansacOptions::min_sample_multiplicator_)
+      .def_readwrite("lo_starting_iterations",
+                     &HybridLORansacOptions::lo_starting_iterations_)
+      .def_readwrite("final_least_squares",
+                     &HybridLORansacOptions::final_least_squares_);
+
+  m.def("estimate_line", &python::EstimateLine, py::arg("points").noconvert(),
+        py::arg("options"),
+        "Fits a line to an (N, 2) array of points. The model is the line "
+        "(a, b, c) with a*x + b*y + c = 0 and a^2 + b^2 = 1.");
+  m.def("estimate_lines", &python::EstimateLines,
+        py::arg("points").noconvert(), py::arg("options"),
+        py::arg("num_threads") = 0,
+        "Runs estimate_line on a list of point arrays in parallel. "
+        "num_threads <= 0 uses a shared pool with one thread per logical "
+        "CPU.");
+  m.def("estimate_hybrid_line", &python::EstimateHybridLine,
+        py::arg("points").noconvert(),
+        py::arg("points_with_normals").noconvert(),
+        py::arg("prior_probabilities"), py::arg("options"),
+        "Fits a line to an (N, 2) array of points and an (M, 4) array of "
+        "points with normals (x, y, n_x, n_y). prior_probabilities are the "
+        "probabilities of sampling the two-point and the point-normal "
+        "solver.");
+  m.def("estimate_hybrid_lines", &python::EstimateHybridLines,
+        py::arg("points").noconvert(),
+        py::arg("points_with_normals").noconvert(),
+        py::arg("prior_probabilities"), py::arg("options"),
+        py::arg("num_threads") = 0,
+        "Runs estimate_hybrid_line on lists of arrays in parallel.");
+  m.def("estimate_absolute_pose", &python::EstimateAbsolutePose,
+        py::arg("points2D").noconvert(), py::arg("points3D").noconvert(),
+        py::arg("focal_x"), py::arg("focal_y"), py::arg("options"),
+        "Estimates the pose [R | c] of a calibrated camera from (N, 2) "
+        "keypoints, centered around the principal point, and (N, 3) points. "
+        "R rotates from world to camera coordinates, c is the camera center.");
+  m.def("estimate_absolute_poses", &python::EstimateAbsolutePoses,
+        py::arg("points2D").noconvert(), py::arg("points3D").noconvert(),
+        py::arg("focal_x"), py::arg("focal_y"), py::arg("options"),
+        py::arg("num_threads") = 0,
+        "Runs estimate_absolute_pose on lists of matches in parallel.");
+}
@@ -0,0 +1,86 @@
+# Copyright (c) 2019, Torsten Sattler
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in the
+#       documentation and/or other materials provided with the distribution.
+#
+#     * Neither the name of Torsten Sattler nor the
+#       names of its contributors may be used to endorse or promote products
+#       derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+# SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+# author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+"""Smoke test for the pyransaclib bindings, run via ctest."""
+
+import unittest
+
+import numpy as np
+
+import pyransaclib
+
+
+def make_line_data(num_points, num_points_with_normals):
+  """Returns noisy points on the line y = 0.5 * x + 1 and their normals."""
+  rng = np.random.default_rng(0)
+  x = rng.uniform(-10.0, 10.0, num_points + num_points_with_normals)
+  points = np.stack([x, 0.5 * x + 1.0], axis=1)
+  points += rng.normal(0.0, 0.01, points.shape)
+  normal = np.array([-0.5, 1.0]) / np.linalg.norm([-0.5, 1.0])
+  normals = np.tile(normal, (num_points_with_normals, 1))
+  points_with_normals = np.hstack([points[num_points:], normals])
+  return points[:num_points].copy(), points_with_normals
+
+
+def make_hybrid_options():
+  options = pyransaclib.HybridLORansacOptions()
+  options.squared_inlier_thresholds = [0.01, 0.01]
+  options.data_type_weights = [1.0, 1.0]
+  options.random_seed = 0
+  return options
+
+
+class HybridLineTest(unittest.TestCase):
+
+  def test_estimate_hybrid_line(self):
+    points, points_with_normals = make_line_data(50, 50)
+    result = pyransaclib.estimate_hybrid_line(
+        points, points_with_normals, [0.5, 0.5], make_hybrid_options())
+    self.assertGreater(result["num_inliers"], 90)
+
+  def test_rejects_wrong_number_of_data_types(self):
+    points, points_with_normals = make_line_data(50, 50)
+    short_thresholds = make_hybrid_options()
+    short_thresholds.squared_inlier_thresholds = [0.01]
+    short_weights = make_hybrid_options()
+    short_weights.data_type_weights = []
+    for options, priors in [(short_thresholds, [0.5, 0.5]),
+                            (short_weights, [0.5, 0.5]),
+                            (make_hybrid_options(), [1.0])]:
+      with self.assertRaises(ValueError):
+        pyransaclib.estimate_hybrid_line(points, points_with_normals, priors,
+                                         options)
+      with self.assertRaises(ValueError):
+        pyransaclib.estimate_hybrid_lines([points], [points_with_normals],
+                                          priors, options)
+
+
+if __name__ == "__main__":
+  unittest.main()
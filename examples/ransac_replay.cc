@@ -0,0 +1,372 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "ransac_replay.h"
+
+namespace ransac_lib {
+
+namespace replay {
+
+namespace {
+
+// Layout of a replay file (version 1):
+//   char[4] magic "RLRP", uint32 version, uint32 byte order mark 0x01020304
+//   uint32 length + chars                 name
+//   uint32 min_num_iterations_, uint32 max_num_iterations_,
+//   double success_probability_, double squared_inlier_threshold_,
+//   uint32 random_seed_, int32 num_lo_steps_, double threshold_multiplier_,
+//   int32 num_lsq_iterations_, int32 min_sample_multiplicator_,
+//   int32 non_min_sample_multiplier_, uint32 lo_starting_iterations_,
+//   uint8 final_least_squares_
+//   double focal_x, double focal_y, double solver_squared_inlier_threshold
+//   uint32 N, N x double[2] points2D, N x double[3] points3D
+//   int32 num_ransac_inliers, double[12] best_model (column-major)
+//   uint32 num_iterations, int32 best_num_inliers, double best_model_score,
+//   double inlier_ratio, int32 number_lo_iterations,
+//   uint32 M, M x int32 inlier_indices
+const char kMagic[4] = {'R', 'L', 'R', 'P'};
+const uint32_t kVersion = 1u;
+const uint32_t kByteOrderMark = 0x01020304u;
+
+class Writer {
+ public:
+  explicit Writer(std::ofstream* ofs) : ofs_(ofs) {}
+
+  template <typename T>
+  void Write(const T& value) {
+    ofs_->write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  void WriteDoubles(const double* values, const size_t num_values) {
+    ofs_->write(reinterpret_cast<const char*>(values),
+                num_values * sizeof(double));
+  }
+
+  void WriteString(const std::string& s) {
+    Write(static_cast<uint32_t>(s.size()));
+    ofs_->write(s.data(), s.size());
+  }
+
+ private:
+  std::ofstream* ofs_;
+};
+
+class Reader {
+ public:
+  explicit Reader(std::ifstream* ifs) : ifs_(ifs) {}
+
+  template <typename T>
+  bool Read(T* value) {
+    ifs_->read(reinterpret_cast<char*>(value), sizeof(T));
+    return static_cast<bool>(*ifs_);
+  }
+
+  bool ReadDoubles(double* values, const size_t num_values) {
+    ifs_->read(reinterpret_cast<char*>(values), num_values * sizeof(double));
+    return static_cast<bool>(*ifs_);
+  }
+
+  bool ReadString(std::string* s) {
+    uint32_t length = 0u;
+    if (!Read(&length)) return false;
+    s->resize(length);
+    if (length == 0u) return true;
+    ifs_->read(&(*s)[0], length);
+    return static_cast<bool>(*ifs_);
+  }
+
+ private:
+  std::ifstream* ifs_;
+};
+
+bool SameDouble(const double a, const double b) {
+  return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+}  // namespace
+
+bool WriteReplayFile(const std::string& filename,
+                     const PoseReplayRecord& record) {
+  std::ofstream ofs(filename.c_str(), std::ios::out | std::ios::binary);
+  if (!ofs.is_open()) {
+    std::cerr << " ERROR: Cannot write the replay file " << filename
+              << std::endl;
+    return false;
+  }
+  Writer w(&ofs);
+  ofs.write(kMagic, 4);
+  w.Write(kVersion);
+  w.Write(kByteOrderMark);
+  w.WriteString(record.name);
+
+  const LORansacOptions& o = record.options;
+  w.Write(static_cast<uint32_t>(o.min_num_iterations_));
+  w.Write(static_cast<uint32_t>(o.max_num_iterations_));
+  w.Write(o.success_probability_);
+  w.Write(o.squared_inlier_threshold_);
+  w.Write(static_cast<uint32_t>(o.random_seed_));
+  w.Write(static_cast<int32_t>(o.num_lo_steps_));
+  w.Write(o.threshold_multiplier_);
+  w.Write(static_cast<int32_t>(o.num_lsq_iterations_));
+  w.Write(static_cast<int32_t>(o.min_sample_multiplicator_));
+  w.Write(static_cast<int32_t>(o.non_min_sample_multiplier_));
+  w.Write(static_cast<uint32_t>(o.lo_starting_iterations_));
+  w.Write(static_cast<uint8_t>(o.final_least_squares_ ? 1 : 0));
+
+  w.Write(record.focal_x);
+  w.Write(record.focal_y);
+  w.Write(record.solver_squared_inlier_threshold);
+  const uint32_t kNumData = static_cast<uint32_t>(record.points2D.size());
+  w.Write(kNumData);
+  for (uint32_t i = 0; i < kNumData; ++i) {
+    w.WriteDoubles(record.points2D[i].data(), 2);
+  }
+  for (uint32_t i = 0; i < kNumData; ++i) {
+    w.WriteDoubles(record.points3D[i].data(), 3);
+  }
+
+  w.Write(static_cast<int32_t>(record.num_ransac_inliers));
+  w.WriteDoubles(record.best_model.data(), 12);
+  const RansacStatistics& s = record.statistics;
+  w.Write(static_cast<uint32_t>(s.num_iterations));
+  w.Write(static_cast<int32_t>(s.best_num_inliers));
+  w.Write(s.best_model_score);
+  w.Write(s.inlier_ratio);
+  w.Write(static_cast<int32_t>(s.number_lo_iterations));
+  w.Write(static_cast<uint32_t>(s.inlier_indices.size()));
+  for (const int index : s.inlier_indices) {
+    w.Write(static_cast<int32_t>(index));
+  }
+
+  ofs.close();
+  if (!ofs) {
+    std::cerr << " ERROR: Failed to write the replay file " << filename
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool ReadReplayFile(const std::string& filename, PoseReplayRecord* record) {
+  std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!ifs.is_open()) {
+    std::cerr << " ERROR: Cannot read the replay file " << filename
+              << std::endl;
+    return false;
+  }
+  Reader r(&ifs);
+  char magic[4];
+  ifs.read(magic, 4);
+  uint32_t version = 0u, byte_order_mark = 0u;
+  if (!ifs || std::memcmp(magic, kMagic, 4) != 0 || !r.Read(&version) ||
+      !r.Read(&byte_order_mark)) {
+    std::cerr << " ERROR: " << filename << " is not a replay file"
+              << std::endl;
+    return false;
+  }
+  if (version != kVersion || byte_order_mark != kByteOrderMark) {
+    std::cerr << " ERROR: Unsupported version or byte order in " << filename
+              << std::endl;
+    return false;
+  }
+
+  bool ok = r.ReadString(&record->name);
+
+  LORansacOptions& o = record->options;
+  uint32_t u32 = 0u;
+  int32_t i32 = 0;
+  uint8_t u8 = 0u;
+  ok = ok && r.Read(&u32);
+  o.min_num_iterations_ = u32;
+  ok = ok && r.Read(&u32);
+  o.max_num_iterations_ = u32;
+  ok = ok && r.Read(&o.success_probability_);
+  ok = ok && r.Read(&o.squared_inlier_threshold_);
+  ok = ok && r.Read(&u32);
+  o.random_seed_ = u32;
+  ok = ok && r.Read(&i32);
+  o.num_lo_steps_ = i32;
+  ok = ok && r.Read(&o.threshold_multiplier_);
+  ok = ok && r.Read(&i32);
+  o.num_lsq_iterations_ = i32;
+  ok = ok && r.Read(&i32);
+  o.min_sample_multiplicator_ = i32;
+  ok = ok && r.Read(&i32);
+  o.non_min_sample_multiplier_ = i32;
+  ok = ok && r.Read(&u32);
+  o.lo_starting_iterations_ = u32;
+  ok = ok && r.Read(&u8);
+  o.final_least_squares_ = u8 != 0u;
+
+  ok = ok && r.Read(&record->focal_x);
+  ok = ok && r.Read(&record->focal_y);
+  ok = ok && r.Read(&record->solver_squared_inlier_threshold);
+  uint32_t num_data = 0u;
+  ok = ok && r.Read(&num_data);
+  if (!ok) {
+    std::cerr << " ERROR: Truncated replay file " << filename << std::endl;
+    return false;
+  }
+  record->points2D.resize(num_data);
+  record->points3D.resize(num_data);
+  for (uint32_t i = 0; ok && i < num_data; ++i) {
+    ok = r.ReadDoubles(record->points2D[i].data(), 2);
+  }
+  for (uint32_t i = 0; ok && i < num_data; ++i) {
+    ok = r.ReadDoubles(record->points3D[i].data(), 3);
+  }
+
+  ok = ok && r.Read(&i32);
+  record->num_ransac_inliers = i32;
+  ok = ok && r.ReadDoubles(record->best_model.data(), 12);
+  RansacStatistics& s = record->statistics;
+  ok = ok && r.Read(&u32);
+  s.num_iterations = u32;
+  ok = ok && r.Read(&i32);
+  s.best_num_inliers = i32;
+  ok = ok && r.Read(&s.best_model_score);
+  ok = ok && r.Read(&s.inlier_ratio);
+  ok = ok && r.Read(&i32);
+  s.number_lo_iterations = i32;
+  uint32_t num_inliers = 0u;
+  ok = ok && r.Read(&num_inliers);
+  if (ok) {
+    s.inlier_indices.resize(num_inliers);
+    for (uint32_t i = 0; ok && i < num_inliers; ++i) {
+      ok = r.Read(&i32);
+      s.inlier_indices[i] = i32;
+    }
+  }
+  if (!ok) {
+    std::cerr << " ERROR: Truncated replay file " << filename << std::endl;
+    return false;
+  }
+  return true;
+}
+
+double ReplayRun(const PoseReplayRecord& record, PoseReplayRecord* result) {
+  using calibrated_absolute_pose::CalibratedAbsolutePoseEstimator;
+  using calibrated_absolute_pose::CameraPose;
+  using calibrated_absolute_pose::CameraPoses;
+
+  *result = record;
+
+  calibrated_absolute_pose::ViewingRays rays;
+  CalibratedAbsolutePoseEstimator::PixelsToViewingRays(
+      record.focal_x, record.focal_y, record.points2D, &rays);
+  CalibratedAbsolutePoseEstimator solver(
+      record.focal_x, record.focal_y, record.solver_squared_inlier_threshold,
+      record.points2D, rays, record.points3D);
+
+  LocallyOptimizedMSAC<CameraPose, CameraPoses,
+                       CalibratedAbsolutePoseEstimator>
+      lomsac;
+  auto ransac_start = std::chrono::steady_clock::now();
+  result->num_ransac_inliers = lomsac.EstimateModel(
+      record.options, solver, &result->best_model, &result->statistics);
+  auto ransac_end = std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed_seconds = ransac_end - ransac_start;
+  return elapsed_seconds.count();
+}
+
+bool SameOutcome(const PoseReplayRecord& a, const PoseReplayRecord& b,
+                 std::string* difference) {
+  std::stringstream s_stream;
+  s_stream.precision(17);
+  const RansacStatistics& sa = a.statistics;
+  const RansacStatistics& sb = b.statistics;
+  if (a.num_ransac_inliers != b.num_ransac_inliers) {
+    s_stream << "number of inliers: " << a.num_ransac_inliers << " vs. "
+             << b.num_ransac_inliers;
+  } else if (sa.num_iterations != sb.num_iterations) {
+    s_stream << "number of iterations: " << sa.num_iterations << " vs. "
+             << sb.num_iterations;
+  } else if (sa.number_lo_iterations != sb.number_lo_iterations) {
+    s_stream << "number of LO iterations: " << sa.number_lo_iterations
+             << " vs. " << sb.number_lo_iterations;
+  } else if (sa.best_num_inliers != sb.best_num_inliers) {
+    s_stream << "best number of inliers: " << sa.best_num_inliers << " vs. "
+             << sb.best_num_inliers;
+  } else if (!SameDouble(sa.best_model_score, sb.best_model_score)) {
+    s_stream << "best model score: " << sa.best_model_score << " vs. "
+             << sb.best_model_score;
+  } else if (!SameDouble(sa.inlier_ratio, sb.inlier_ratio)) {
+    s_stream << "inlier ratio: " << sa.inlier_ratio << " vs. "
+             << sb.inlier_ratio;
+  } else if (sa.inlier_indices != sb.inlier_indices) {
+    s_stream << "inlier indices differ";
+  } else {
+    for (int i = 0; i < 12; ++i) {
+      if (!SameDouble(a.best_model.data()[i], b.best_model.data()[i])) {
+        s_stream << "best model entry " << i << ": " << a.best_model.data()[i]
+                 << " vs. " << b.best_model.data()[i];
+        break;
+      }
+    }
+  }
+  *difference = s_stream.str();
+  return difference->empty();
+}
+
+RecordSettings RecordSettingsFromEnvironment() {
+  RecordSettings settings;
+  const char* directory = std::getenv("RANSACLIB_RECORD_DIR");
+  settings.enabled = directory != nullptr && directory[0] != '\0';
+  settings.directory = settings.enabled ? std::string(directory) : "";
+  const char* min_seconds = std::getenv("RANSACLIB_RECORD_MIN_SECONDS");
+  settings.min_seconds =
+      min_seconds != nullptr ? std::atof(min_seconds) : 0.0;
+  return settings;
+}
+
+std::string ReplayFilename(const RecordSettings& settings,
+                           const std::string& query_name) {
+  std::string name(query_name);
+  for (char& c : name) {
+    if (c == '/' || c == '\\') c = '_';
+  }
+  return settings.directory + "/" + name + ".replay";
+}
+
+}  // namespace replay
+
+}  // namespace ransac_lib
@@ -0,0 +1,111 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#ifndef RANSACLIB_EXAMPLE_RANSAC_REPLAY_H_
+#define RANSACLIB_EXAMPLE_RANSAC_REPLAY_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <RansacLib/ransac.h>
+#include "calibrated_absolute_pose_estimator.h"
+
+namespace ransac_lib {
+
+namespace replay {
+
+// Everything needed to re-execute a single LO-MSAC run of the calibrated
+// absolute pose estimator, together with the outcome of the original run.
+// The random seed is part of the options, i.e., re-running LO-MSAC with the
+// recorded options and data reproduces the original run exactly.
+struct PoseReplayRecord {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  // Input.
+  std::string name;
+  LORansacOptions options;
+  double focal_x;
+  double focal_y;
+  // The squared inlier threshold passed to the solver.
+  double solver_squared_inlier_threshold;
+  // The 2D positions are stored as passed to the solver, i.e., centered
+  // around the principal point. The viewing rays are re-computed from them.
+  calibrated_absolute_pose::Points2D points2D;
+  calibrated_absolute_pose::Points3D points3D;
+
+  // Outcome.
+  int num_ransac_inliers;
+  calibrated_absolute_pose::CameraPose best_model;
+  RansacStatistics statistics;
+};
+
+// Writes the record into a binary replay file. All values are stored in the
+// byte order of the machine that writes the file; reading a file on a machine
+// with a different byte order fails.
+bool WriteReplayFile(const std::string& filename,
+                     const PoseReplayRecord& record);
+
+bool ReadReplayFile(const std::string& filename, PoseReplayRecord* record);
+
+// Runs LO-MSAC on the input stored in record and stores the outcome in
+// result (whose input fields are copied from record). Returns the run-time in
+// seconds.
+double ReplayRun(const PoseReplayRecord& record, PoseReplayRecord* result);
+
+// Compares the outcomes of two records bit by bit. Returns true if they are
+// identical. Otherwise, a description of the first difference is stored in
+// difference.
+bool SameOutcome(const PoseReplayRecord& a, const PoseReplayRecord& b,
+                 std::string* difference);
+
+// The recording settings of the localization drivers, read from environment
+// variables:
+//  - RANSACLIB_RECORD_DIR: The directory into which replay files are
+//    written. Recording is disabled if it is not set.
+//  - RANSACLIB_RECORD_MIN_SECONDS: Only runs taking at least this long are
+//    recorded (default: 0, i.e., all runs are recorded).
+struct RecordSettings {
+  bool enabled;
+  std::string directory;
+  double min_seconds;
+};
+
+RecordSettings RecordSettingsFromEnvironment();
+
+// Returns the name of the replay file for a query, placed in the record
+// directory. Path separators in the query name are replaced by underscores.
+std::string ReplayFilename(const RecordSettings& settings,
+                           const std::string& query_name);
+
+}  // namespace replay
+
+}  // namespace ransac_lib
+
+#endif  // RANSACLIB_EXAMPLE_RANSAC_REPLAY_H_
@@ -0,0 +1,96 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// Re-executes LO-MSAC runs recorded by the localization examples (see
+// ransac_replay.h) and verifies that the outcome is identical to the recorded
+// one. The run can be repeated several times, e.g., to collect enough samples
+// when running under a profiler such as perf. Returns 0 if all runs of all
+// files reproduced the recorded outcome and 1 otherwise.
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ransac_replay.h"
+
+int main(int argc, char** argv) {
+  using ransac_lib::replay::PoseReplayRecord;
+
+  std::cout << " usage: " << argv[0] << " replay_file [num_runs] "
+            << "[more replay files]" << std::endl;
+  if (argc < 2) return -1;
+
+  int num_runs = 1;
+  std::vector<std::string> files = {std::string(argv[1])};
+  if (argc >= 3) num_runs = std::max(1, atoi(argv[2]));
+  for (int i = 3; i < argc; ++i) files.push_back(std::string(argv[i]));
+
+  bool all_identical = true;
+  for (const std::string& file : files) {
+    PoseReplayRecord record;
+    if (!ransac_lib::replay::ReadReplayFile(file, &record)) {
+      all_identical = false;
+      continue;
+    }
+    std::cout << " " << file << " : " << record.name << ", "
+              << record.points2D.size() << " matches, seed "
+              << record.options.random_seed_ << std::endl;
+
+    double min_seconds = 0.0, sum_seconds = 0.0;
+    int num_completed_runs = 0;
+    for (int r = 0; r < num_runs; ++r) {
+      PoseReplayRecord result;
+      const double kSeconds = ransac_lib::replay::ReplayRun(record, &result);
+      sum_seconds += kSeconds;
+      min_seconds = r == 0 ? kSeconds : std::min(min_seconds, kSeconds);
+      ++num_completed_runs;
+
+      std::string difference;
+      if (!ransac_lib::replay::SameOutcome(record, result, &difference)) {
+        std::cout << "   ... run " << r << " differs from the recording: "
+                  << difference << std::endl;
+        all_identical = false;
+        break;
+      }
+    }
+    std::cout << "   ... " << record.statistics.num_iterations
+              << " iterations, " << record.num_ransac_inliers << " inliers, "
+              << "min. time " << min_seconds << " s, mean time "
+              << sum_seconds / static_cast<double>(num_completed_runs) << " s"
+              << std::endl;
+  }
+
+  std::cout << (all_identical ? " All runs identical to the recordings"
+                              : " MISMATCH between runs and recordings")
+            << std::endl;
+  return all_identical ? 0 : 1;
+}
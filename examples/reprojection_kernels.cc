@@ -0,0 +1,150 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// This file is compiled with -O3 -ffp-contract=off -fno-trapping-math (see
+// CMakeLists.txt): Disabling contractions ensures that no variant fuses
+// multiplications and additions, such that all of them produce the same
+// results. Without trapping math, the check for points behind the camera
+// can be vectorized as a select instead of a branch.
+
+#include <limits>
+
+#include "reprojection_kernels.h"
+
+namespace ransac_lib {
+
+namespace kernels {
+
+namespace {
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RANSACLIB_KERNEL_MULTIVERSIONING 1
+#define RANSACLIB_ALWAYS_INLINE inline __attribute__((always_inline))
+#define RANSACLIB_TARGET_AVX2 __attribute__((target("avx2")))
+#if defined(__clang__)
+#define RANSACLIB_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+// By default, GCC might only use 256 bit vectors for AVX-512.
+#define RANSACLIB_TARGET_AVX512 \
+  __attribute__((target("avx512f,prefer-vector-width=512")))
+#endif
+#else
+#define RANSACLIB_KERNEL_MULTIVERSIONING 0
+#define RANSACLIB_ALWAYS_INLINE inline
+#endif
+
+// The loop is written such that compilers vectorize it for the instruction
+// set of the function it is inlined into. The order of the operations is the
+// same as in CalibratedAbsolutePoseEstimator::EvaluateModelOnPoint.
+RANSACLIB_ALWAYS_INLINE void ErrorsImpl(const double* R, const double* c,
+                                        const double focal_x,
+                                        const double focal_y,
+                                        const ReprojectionData& data,
+                                        double* __restrict errors) {
+  const double kR00 = R[0], kR01 = R[1], kR02 = R[2];
+  const double kR10 = R[3], kR11 = R[4], kR12 = R[5];
+  const double kR20 = R[6], kR21 = R[7], kR22 = R[8];
+  const double kC0 = c[0], kC1 = c[1], kC2 = c[2];
+  const double* __restrict X = data.X;
+  const double* __restrict Y = data.Y;
+  const double* __restrict Z = data.Z;
+  const double* __restrict x = data.x;
+  const double* __restrict y = data.y;
+  const double kMax = std::numeric_limits<double>::max();
+  const int kNumPoints = data.num_points;
+  for (int i = 0; i < kNumPoints; ++i) {
+    const double kDX = X[i] - kC0;
+    const double kDY = Y[i] - kC1;
+    const double kDZ = Z[i] - kC2;
+    const double kPX = kR00 * kDX + kR01 * kDY + kR02 * kDZ;
+    const double kPY = kR10 * kDX + kR11 * kDY + kR12 * kDZ;
+    const double kPZ = kR20 * kDX + kR21 * kDY + kR22 * kDZ;
+    const double kEX = kPX / kPZ * focal_x - x[i];
+    const double kEY = kPY / kPZ * focal_y - y[i];
+    const double kError = kEX * kEX + kEY * kEY;
+    // Points behind the camera.
+    errors[i] = kPZ < 0.0 ? kMax : kError;
+  }
+}
+
+void ErrorsBaseline(const double* R, const double* c, const double focal_x,
+                    const double focal_y, const ReprojectionData& data,
+                    double* errors) {
+  ErrorsImpl(R, c, focal_x, focal_y, data, errors);
+}
+
+#if RANSACLIB_KERNEL_MULTIVERSIONING
+RANSACLIB_TARGET_AVX2 void ErrorsAVX2(const double* R, const double* c,
+                                      const double focal_x,
+                                      const double focal_y,
+                                      const ReprojectionData& data,
+                                      double* errors) {
+  ErrorsImpl(R, c, focal_x, focal_y, data, errors);
+}
+
+RANSACLIB_TARGET_AVX512 void ErrorsAVX512(const double* R, const double* c,
+                                          const double focal_x,
+                                          const double focal_y,
+                                          const ReprojectionData& data,
+                                          double* errors) {
+  ErrorsImpl(R, c, focal_x, focal_y, data, errors);
+}
+#endif
+
+}  // namespace
+
+void SquaredReprojectionErrors(const double* R, const double* c,
+                               const double focal_x, const double focal_y,
+                               const ReprojectionData& data, double* errors) {
+  SquaredReprojectionErrors(isa::ActiveIsaLevel(), R, c, focal_x, focal_y,
+                            data, errors);
+}
+
+void SquaredReprojectionErrors(const isa::IsaLevel level, const double* R,
+                               const double* c, const double focal_x,
+                               const double focal_y,
+                               const ReprojectionData& data, double* errors) {
+  switch (level) {
+#if RANSACLIB_KERNEL_MULTIVERSIONING
+    case isa::IsaLevel::kAVX512:
+      ErrorsAVX512(R, c, focal_x, focal_y, data, errors);
+      return;
+    case isa::IsaLevel::kAVX2:
+      ErrorsAVX2(R, c, focal_x, focal_y, data, errors);
+      return;
+#endif
+    default:
+      ErrorsBaseline(R, c, focal_x, focal_y, data, errors);
+  }
+}
+
+}  // namespace kernels
+
+}  // namespace ransac_lib
@@ -0,0 +1,73 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#ifndef RANSACLIB_EXAMPLE_REPROJECTION_KERNELS_H_
+#define RANSACLIB_EXAMPLE_REPROJECTION_KERNELS_H_
+
+#include "isa_dispatch.h"
+
+namespace ransac_lib {
+
+namespace kernels {
+
+// 2D-3D matches stored as structure-of-arrays. The 2D positions are centered
+// around the principal point.
+struct ReprojectionData {
+  const double* X;
+  const double* Y;
+  const double* Z;
+  const double* x;
+  const double* y;
+  int num_points;
+};
+
+// Computes the squared reprojection errors of all matches for the camera pose
+// [R | c], where R (given in row-major order) is the rotation from world to
+// camera coordinates and c is the position of the camera. Points behind the
+// camera have an error of std::numeric_limits<double>::max().
+// All instruction set levels compute bitwise identical errors (floating-point
+// contractions are disabled for the kernels), i.e., RANSAC produces the same
+// results independently of the CPU it runs on.
+void SquaredReprojectionErrors(const double* R, const double* c,
+                               const double focal_x, const double focal_y,
+                               const ReprojectionData& data, double* errors);
+
+// Same as above, but uses the given level instead of isa::ActiveIsaLevel().
+// The level needs to be supported by the CPU.
+void SquaredReprojectionErrors(const isa::IsaLevel level, const double* R,
+                               const double* c, const double focal_x,
+                               const double focal_y,
+                               const ReprojectionData& data, double* errors);
+
+}  // namespace kernels
+
+}  // namespace ransac_lib
+
+#endif  // RANSACLIB_EXAMPLE_REPROJECTION_KERNELS_H_
@@ -0,0 +1,205 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// Benchmarks the vectorized reprojection error kernels used by
+// CalibratedAbsolutePoseEstimator::EvaluateModelOnPoints for all instruction
+// sets supported by the CPU, and compares them to evaluating the data points
+// one by one via EvaluateModelOnPoint. The poses are random perturbations of
+// the ground truth pose of a synthetic instance, such that both inliers and
+// outliers as well as points behind the camera occur. Verifies that all
+// variants produce bitwise identical squared errors.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "calibrated_absolute_pose_estimator.h"
+#include "isa_dispatch.h"
+#include "synthetic_datasets.h"
+
+namespace ransac_lib {
+
+namespace kernel_benchmark {
+
+using calibrated_absolute_pose::CalibratedAbsolutePoseEstimator;
+using calibrated_absolute_pose::CameraPose;
+using calibrated_absolute_pose::CameraPoses;
+using calibrated_absolute_pose::Points2D;
+using calibrated_absolute_pose::Points3D;
+using calibrated_absolute_pose::ViewingRays;
+
+void PerturbPoses(const CameraPose& gt_pose, const int num_poses,
+                  std::mt19937* rng, CameraPoses* poses) {
+  std::normal_distribution<double> angle_dist(0.0, 0.2);
+  std::normal_distribution<double> position_dist(0.0, 0.5);
+  poses->clear();
+  for (int i = 0; i < num_poses; ++i) {
+    Eigen::Vector3d axis(angle_dist(*rng), angle_dist(*rng), angle_dist(*rng));
+    const double kAngle = axis.norm();
+    Eigen::Matrix3d R_delta = Eigen::Matrix3d::Identity();
+    if (kAngle > 0.0) {
+      R_delta = Eigen::AngleAxisd(kAngle, axis / kAngle).toRotationMatrix();
+    }
+    CameraPose pose;
+    pose.topLeftCorner<3, 3>() = R_delta * gt_pose.topLeftCorner<3, 3>();
+    pose.col(3) = gt_pose.col(3) + Eigen::Vector3d(position_dist(*rng),
+                                                   position_dist(*rng),
+                                                   position_dist(*rng));
+    poses->push_back(pose);
+  }
+}
+
+// Returns the time per evaluated data point in nanoseconds.
+template <typename Function>
+double TimePerPoint(const int num_points, const int num_poses,
+                    const int num_repeats, const Function& evaluate) {
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < num_repeats; ++r) {
+    for (int p = 0; p < num_poses; ++p) evaluate(p);
+  }
+  auto end = std::chrono::steady_clock::now();
+  const double kNanoSeconds = static_cast<double>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+          .count());
+  return kNanoSeconds / (static_cast<double>(num_points) *
+                         static_cast<double>(num_poses) *
+                         static_cast<double>(num_repeats));
+}
+
+bool RunBenchmark(const int num_points, const int num_poses,
+                  const int num_evaluations) {
+  const double kWidth = 640.0;
+  const double kHeight = 320.0;
+  const double kFocalLength = (kWidth * 0.5) / std::tan(60.0 * M_PI / 180.0);
+  const double kInThreshPX = 12.0;
+
+  std::mt19937 rng(static_cast<unsigned int>(num_points));
+  Points2D points2D;
+  ViewingRays rays;
+  Points3D points3D;
+  CameraPose gt_pose;
+  std::vector<int> gt_inliers;
+  const int kNumOutliers = num_points / 2;
+  synthetic::GeneratePoseInstance(kWidth, kHeight, kFocalLength,
+                                  num_points - kNumOutliers, kNumOutliers, 1.0,
+                                  2.0, 10.0, &rng, &points2D, &rays, &points3D,
+                                  &gt_pose, &gt_inliers);
+  CalibratedAbsolutePoseEstimator solver(kFocalLength, kFocalLength,
+                                         kInThreshPX * kInThreshPX, points2D,
+                                         rays, points3D);
+  CameraPoses poses;
+  PerturbPoses(gt_pose, num_poses, &rng, &poses);
+
+  const int kNumRepeats =
+      std::max(1, num_evaluations / (num_points * num_poses));
+  std::vector<double> errors(num_points);
+  std::vector<std::vector<double>> reference(num_poses,
+                                             std::vector<double>(num_points));
+
+  double sink = 0.0;
+  const double kPointNs =
+      TimePerPoint(num_points, num_poses, kNumRepeats, [&](const int p) {
+        for (int i = 0; i < num_points; ++i) {
+          reference[p][i] = solver.EvaluateModelOnPoint(poses[p], i);
+        }
+      });
+  std::cout << std::setw(8) << num_points << std::setw(12) << "per-point"
+            << std::setw(12) << std::fixed << std::setprecision(3) << kPointNs
+            << std::setw(10) << std::setprecision(2) << 1.0 << std::endl;
+
+  bool identical = true;
+  const int kSupported = static_cast<int>(isa::SupportedIsaLevel());
+  for (int l = 0; l <= kSupported; ++l) {
+    const isa::IsaLevel kLevel = isa::SetActiveIsaLevel(
+        static_cast<isa::IsaLevel>(l));
+    bool level_identical = true;
+    const double kNs =
+        TimePerPoint(num_points, num_poses, kNumRepeats, [&](const int p) {
+          solver.EvaluateModelOnPoints(poses[p], errors.data());
+          sink += errors[p % num_points];
+        });
+    for (int p = 0; p < num_poses; ++p) {
+      solver.EvaluateModelOnPoints(poses[p], errors.data());
+      if (std::memcmp(errors.data(), reference[p].data(),
+                      sizeof(double) * num_points) != 0) {
+        level_identical = false;
+      }
+    }
+    std::cout << std::setw(8) << num_points << std::setw(12)
+              << isa::IsaName(kLevel) << std::setw(12)
+              << std::setprecision(3) << kNs << std::setw(10)
+              << std::setprecision(2) << kPointNs / kNs
+              << (level_identical ? "" : "  MISMATCH") << std::endl;
+    identical = identical && level_identical;
+  }
+  if (sink == 0.123) std::cout << std::endl;
+  return identical;
+}
+
+}  // namespace kernel_benchmark
+
+}  // namespace ransac_lib
+
+int main(int argc, char** argv) {
+  using ransac_lib::kernel_benchmark::RunBenchmark;
+  namespace isa = ransac_lib::isa;
+
+  // The total number of point evaluations per configuration.
+  const int kNumEvaluations =
+      argc > 1 ? std::max(1, std::atoi(argv[1])) : 100000000;
+  const int kNumPoses = 64;
+
+  std::cout << " CPU supports: " << isa::IsaName(isa::SupportedIsaLevel())
+            << std::endl;
+  std::cout << std::setw(8) << "points" << std::setw(12) << "variant"
+            << std::setw(12) << "ns/point" << std::setw(10) << "speedup"
+            << std::endl;
+  bool identical = true;
+  for (const int kNumPoints : {100, 1000, 10000}) {
+    identical = RunBenchmark(kNumPoints, kNumPoses, kNumEvaluations) &&
+                identical;
+  }
+  if (!identical) {
+    std::cerr << " ERROR: The kernels do not produce identical results"
+              << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,449 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// Localizes a batch of queries with multiple worker processes on a single
+// host. Compared to running multiple threads in one process (see
+// localization), every worker has its own copy of the global state of Ceres
+// and OpenGV and its own heap, and a crashing worker does not take down the
+// whole batch.
+//
+// The query list, the settings, and, if RANSACLIB_MAP is set, the map (see
+// map_store.h) are loaded once by the parent process before the workers are
+// forked. The workers thus share them: the query list and the settings as
+// copy-on-write pages that are never written, the map as a read-only file
+// mapping. The queries are partitioned dynamically, i.e., every worker takes
+// the index of the next unprocessed query from a counter in shared memory,
+// which balances the load between the workers.
+//
+// Each worker sends its results to the parent through its own pipe. Every
+// message consists of a fixed-size ShardMessage followed by the progress
+// messages of the query. The parent writes the poses and the progress
+// messages in the order of the queries and collects the statistics of all
+// queries. As the seed of a query only depends on its index, the output is
+// the same as the one of localization for the same seed, independently of
+// the number of processes.
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <RansacLib/ransac.h>
+#include "batch_localization.h"
+#include "batch_metrics.h"
+#include "calibrated_absolute_pose_estimator.h"
+#include "localization_io.h"
+#include "map_store.h"
+#include "ransac_replay.h"
+
+namespace {
+
+using ransac_lib::batch_localization::LocalizationSettings;
+using ransac_lib::batch_localization::LocalizationWorker;
+using ransac_lib::batch_localization::QueryMatches;
+using ransac_lib::batch_localization::QueryResult;
+using ransac_lib::localization_io::QueryData;
+using ransac_lib::localization_io::Queries;
+
+enum ShardStatus : int32_t {
+  kLoadFailed = 0,
+  kSkipped = 1,
+  kLocalized = 2
+};
+
+// The result of a query as sent from a worker to the parent. The message is
+// followed by log_size bytes of progress messages.
+struct ShardMessage {
+  int32_t query_index;
+  int32_t status;
+  int32_t num_matches;
+  int32_t num_inliers;
+  uint32_t num_iterations;
+  int32_t num_lo_iterations;
+  double inlier_ratio;
+  double seconds;
+  // The camera pose in column-major order.
+  double pose[12];
+  uint64_t log_size;
+};
+
+bool WriteFully(const int fd, const char* data, size_t size) {
+  while (size > 0u) {
+    const ssize_t kWritten = write(fd, data, size);
+    if (kWritten < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += kWritten;
+    size -= static_cast<size_t>(kWritten);
+  }
+  return true;
+}
+
+// Processes queries until all of them have been taken. Runs in a forked
+// worker process.
+void RunShard(const Queries& queries, const LocalizationSettings& settings,
+              const ransac_lib::replay::RecordSettings& record_settings,
+              std::atomic<int>* next_query, const int fd) {
+  const int kNumQueries = static_cast<int>(queries.size());
+  LocalizationWorker localizer;
+  QueryMatches matches;
+  QueryResult result;
+  std::ostringstream log;
+  std::string message;
+  while (true) {
+    const int kIndex = next_query->fetch_add(1);
+    if (kIndex >= kNumQueries) break;
+    const QueryData& query = queries[kIndex];
+
+    ShardMessage header;
+    std::memset(&header, 0, sizeof(header));
+    header.query_index = kIndex;
+    log.str("");
+    if (!ransac_lib::batch_localization::LoadQueryMatches(query, settings,
+                                                          &matches)) {
+      header.status = kLoadFailed;
+      log << "  ERROR: Could not load matches from " << query.name
+          << settings.matchfile_postfix << std::endl;
+    } else {
+      localizer.Solve(query, matches, kIndex, settings, &log, &result);
+      header.num_matches = result.num_matches;
+      header.status = result.ransac_run ? kLocalized : kSkipped;
+    }
+    if (header.status == kLocalized) {
+      header.num_inliers = result.num_inliers;
+      header.num_iterations = result.statistics.num_iterations;
+      header.num_lo_iterations = result.statistics.number_lo_iterations;
+      header.inlier_ratio = result.statistics.inlier_ratio;
+      header.seconds = result.seconds;
+      std::memcpy(header.pose, result.pose.data(), sizeof(header.pose));
+
+      if (record_settings.enabled &&
+          result.seconds >= record_settings.min_seconds) {
+        ransac_lib::replay::PoseReplayRecord record;
+        record.name = query.name;
+        record.options = result.options;
+        record.focal_x = query.focal_x;
+        record.focal_y = query.focal_y;
+        record.solver_squared_inlier_threshold =
+            result.options.squared_inlier_threshold_;
+        record.points2D = matches.points2D;
+        record.points3D = matches.points3D;
+        record.num_ransac_inliers = result.num_inliers;
+        record.best_model = result.pose;
+        record.statistics = result.statistics;
+        ransac_lib::replay::WriteReplayFile(
+            ransac_lib::replay::ReplayFilename(record_settings, query.name),
+            record);
+      }
+    }
+
+    const std::string kLog = log.str();
+    header.log_size = kLog.size();
+    message.assign(reinterpret_cast<const char*>(&header), sizeof(header));
+    message.append(kLog);
+    // The parent is gone if the pipe is closed.
+    if (!WriteFully(fd, message.data(), message.size())) return;
+  }
+}
+
+// The state of a worker process as seen by the parent.
+struct Shard {
+  pid_t pid;
+  // The read end of the pipe of the worker, -1 once it has been closed.
+  int fd;
+  // Received bytes that do not form a complete message yet.
+  std::string buffer;
+  int num_queries;
+  double ransac_seconds;
+};
+
+// Extracts all complete messages from the buffer of a shard.
+void ExtractMessages(Shard* shard,
+                     std::map<int, std::pair<ShardMessage, std::string>>*
+                         pending) {
+  size_t pos = 0u;
+  while (shard->buffer.size() - pos >= sizeof(ShardMessage)) {
+    ShardMessage header;
+    std::memcpy(&header, shard->buffer.data() + pos, sizeof(header));
+    if (shard->buffer.size() - pos - sizeof(header) < header.log_size) break;
+    std::string log = shard->buffer.substr(pos + sizeof(header),
+                                           header.log_size);
+    pos += sizeof(header) + header.log_size;
+    ++shard->num_queries;
+    shard->ransac_seconds += header.seconds;
+    (*pending)[header.query_index] = std::make_pair(header, std::move(log));
+  }
+  shard->buffer.erase(0, pos);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  using ransac_lib::batch_localization::FormatPose;
+  using ransac_lib::localization_io::LoadListIntrinsics;
+
+  std::cout << " usage: " << argv[0] << " images_with_intrinsics outfile "
+            << "inlier_threshold num_lo_steps invert_Y_Z points_centered "
+            << "[match-file postfix] [num_processes] [random_seed]"
+            << std::endl;
+  if (argc < 7) return -1;
+
+  LocalizationSettings settings;
+  settings.inlier_threshold = static_cast<double>(atof(argv[3]));
+  settings.num_lo_steps = atoi(argv[4]);
+  settings.invert_Y_Z = static_cast<bool>(atoi(argv[5]));
+  settings.points_centered = static_cast<bool>(atoi(argv[6]));
+  settings.matchfile_postfix = ".individual_datasets.matches.txt";
+  if (argc >= 8) {
+    settings.matchfile_postfix = std::string(argv[7]);
+  }
+  settings.min_num_matches = 4;
+  const int kNumProcesses = argc >= 9 ? std::max(1, atoi(argv[8])) : 1;
+  if (argc >= 10) {
+    settings.random_seed =
+        static_cast<unsigned int>(std::strtoul(argv[9], nullptr, 10));
+  } else {
+    std::random_device rand_dev;
+    settings.random_seed = rand_dev();
+  }
+  std::cout << " Using " << kNumProcesses << " worker process(es) and random "
+            << "seed " << settings.random_seed << std::endl;
+
+  // If RANSACLIB_MAP is set, the match files reference the 3D points of the
+  // map by their IDs. The map is opened before forking, such that all
+  // workers share its pages.
+  ransac_lib::map_store::MapStore map;
+  if (!ransac_lib::batch_localization::UseMapFromEnvironment(&map,
+                                                             &settings)) {
+    return -1;
+  }
+  if (settings.map != nullptr) {
+    std::cout << " Using a map with " << map.num_points() << " points"
+              << std::endl;
+  }
+
+  Queries query_data;
+  std::string list(argv[1]);
+  if (!LoadListIntrinsics(list, &query_data)) {
+    std::cerr << " ERROR: Could not read the data from " << list << std::endl;
+    return -1;
+  }
+  const int kNumQuery = static_cast<int>(query_data.size());
+  std::cout << " Found " << kNumQuery << " query images " << std::endl;
+
+  std::vector<char> ofs_buffer(1 << 20);
+  std::ofstream ofs;
+  ofs.rdbuf()->pubsetbuf(ofs_buffer.data(),
+                         static_cast<std::streamsize>(ofs_buffer.size()));
+  ofs.open(argv[2], std::ios::out);
+  if (!ofs.is_open()) {
+    std::cerr << " ERROR: Cannot write to " << argv[2] << std::endl;
+    return -1;
+  }
+
+  const ransac_lib::replay::RecordSettings kRecordSettings =
+      ransac_lib::replay::RecordSettingsFromEnvironment();
+
+  // The index of the next query to process, shared by all workers. A
+  // lock-free atomic does not depend on the address it is mapped at and can
+  // thus be used across processes.
+  static_assert(std::atomic<int>::is_always_lock_free,
+                "The query counter needs to be lock-free");
+  void* shared = mmap(nullptr, sizeof(std::atomic<int>),
+                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1,
+                      0);
+  if (shared == MAP_FAILED) {
+    std::cerr << " ERROR: Cannot allocate shared memory" << std::endl;
+    return -1;
+  }
+  std::atomic<int>* next_query = new (shared) std::atomic<int>(0);
+
+  ransac_lib::metrics::BatchMetrics metrics;
+  metrics.Start();
+
+  // Buffered output would otherwise be written by every worker on exit.
+  std::cout.flush();
+  std::cerr.flush();
+
+  std::vector<Shard> shards;
+  for (int s = 0; s < kNumProcesses; ++s) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+      std::cerr << " ERROR: Cannot create a pipe: " << std::strerror(errno)
+                << std::endl;
+      break;
+    }
+    const pid_t kPid = fork();
+    if (kPid < 0) {
+      std::cerr << " ERROR: Cannot fork: " << std::strerror(errno)
+                << std::endl;
+      close(fds[0]);
+      close(fds[1]);
+      break;
+    }
+    if (kPid == 0) {
+      // The worker only needs the write end of its own pipe.
+      close(fds[0]);
+      for (const Shard& shard : shards) close(shard.fd);
+      RunShard(query_data, settings, kRecordSettings, next_query, fds[1]);
+      close(fds[1]);
+      // Skips the destructors and exit handlers of the parent's state.
+      _exit(0);
+    }
+    close(fds[1]);
+    Shard shard;
+    shard.pid = kPid;
+    shard.fd = fds[0];
+    shard.num_queries = 0;
+    shard.ransac_seconds = 0.0;
+    shards.push_back(std::move(shard));
+  }
+  if (shards.empty()) return -1;
+
+  // Results arrive in any order. They are written in the order of the
+  // queries, such that the output does not depend on the number of workers.
+  std::map<int, std::pair<ShardMessage, std::string>> pending;
+  int next_to_write = 0;
+  auto write_results = [&]() {
+    for (auto it = pending.begin();
+         it != pending.end() && it->first == next_to_write;
+         it = pending.erase(it), ++next_to_write) {
+      const ShardMessage& kMessage = it->second.first;
+      std::cout << std::endl << std::endl << it->second.second;
+      if (kMessage.status != kLocalized) {
+        metrics.AddSkippedQuery();
+        continue;
+      }
+      metrics.AddQuery(kMessage.seconds, kMessage.num_iterations,
+                       kMessage.num_lo_iterations, kMessage.num_inliers);
+      ransac_lib::calibrated_absolute_pose::CameraPose pose;
+      std::memcpy(pose.data(), kMessage.pose, sizeof(kMessage.pose));
+      ofs << FormatPose(query_data[it->first].name, pose);
+    }
+  };
+
+  std::vector<pollfd> poll_fds;
+  std::vector<char> read_buffer(1 << 16);
+  while (true) {
+    poll_fds.clear();
+    for (const Shard& shard : shards) {
+      if (shard.fd >= 0) poll_fds.push_back({shard.fd, POLLIN, 0});
+    }
+    if (poll_fds.empty()) break;
+    if (poll(poll_fds.data(), poll_fds.size(), -1) < 0) {
+      if (errno == EINTR) continue;
+      std::cerr << " ERROR: poll failed: " << std::strerror(errno)
+                << std::endl;
+      break;
+    }
+    for (const pollfd& kPollFd : poll_fds) {
+      if (kPollFd.revents == 0) continue;
+      Shard* shard = nullptr;
+      for (Shard& s : shards) {
+        if (s.fd == kPollFd.fd) shard = &s;
+      }
+      const ssize_t kRead = read(shard->fd, read_buffer.data(),
+                                 read_buffer.size());
+      if (kRead < 0 && errno == EINTR) continue;
+      if (kRead <= 0) {
+        // The worker finished or died.
+        close(shard->fd);
+        shard->fd = -1;
+        continue;
+      }
+      shard->buffer.append(read_buffer.data(), static_cast<size_t>(kRead));
+      ExtractMessages(shard, &pending);
+    }
+    write_results();
+  }
+
+  // Queries are only missing if a worker died while processing them. The
+  // results of all later queries are still written.
+  int num_lost = 0;
+  while (next_to_write < kNumQuery) {
+    const int kNextReceived =
+        pending.empty() ? kNumQuery : pending.begin()->first;
+    for (; next_to_write < kNextReceived; ++next_to_write, ++num_lost) {
+      std::cerr << " ERROR: The result of query " << next_to_write << " ("
+                << query_data[next_to_write].name << ") was lost"
+                << std::endl;
+    }
+    write_results();
+  }
+
+  bool failed = num_lost > 0;
+  for (int s = 0; s < static_cast<int>(shards.size()); ++s) {
+    int status = 0;
+    struct rusage usage;
+    std::memset(&usage, 0, sizeof(usage));
+    while (wait4(shards[s].pid, &status, 0, &usage) < 0 && errno == EINTR) {
+    }
+    const bool kSucceeded = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    failed = failed || !kSucceeded;
+    // Linux reports the maximum resident set size in kilobytes.
+    std::cout << " Worker " << s << " (pid " << shards[s].pid << ") "
+              << (kSucceeded ? "finished" : "FAILED") << " after "
+              << shards[s].num_queries << " queries and "
+              << shards[s].ransac_seconds << " s of RANSAC, peak RSS "
+              << usage.ru_maxrss / 1024 << " MB" << std::endl;
+  }
+  munmap(shared, sizeof(std::atomic<int>));
+
+  ofs.close();
+  metrics.Stop();
+
+
+  std::string metrics_file(argv[2]);
+  metrics.WritePrometheus(metrics_file + ".metrics.prom",
+                          "sharded_localization");
+  metrics.WriteJSON(metrics_file + ".metrics.json", "sharded_localization");
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,263 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "synthetic_datasets.h"
+
+namespace ransac_lib {
+
+namespace synthetic {
+
+void GenerateRandomTransform(std::mt19937* rng, Eigen::Matrix2d* R,
+                             Eigen::Vector2d* t) {
+  std::uniform_real_distribution<double> distr(-0.5, 0.5);
+
+  const double kAngle = distr(*rng) * M_PI;
+  *R << std::cos(kAngle), -std::sin(kAngle), std::sin(kAngle), std::cos(kAngle);
+  const double kTx = distr(*rng) * 10.0;
+  const double kTy = distr(*rng) * 10.0;
+  *t = Eigen::Vector2d(kTx, kTy);
+}
+
+void GenerateLineInstance(const int num_inliers, const int num_outliers,
+                          const double noise, const Eigen::Matrix2d& R,
+                          const Eigen::Vector2d& t, std::mt19937* rng,
+                          Eigen::Matrix4Xd* points_with_normals,
+                          Eigen::Vector3d* line,
+                          std::vector<int>* inlier_indices) {
+  const int kNumPoints = num_inliers + num_outliers;
+  points_with_normals->resize(4, kNumPoints);
+
+  std::vector<int> indices(kNumPoints);
+  std::iota(indices.begin(), indices.end(), 0);
+  std::shuffle(indices.begin(), indices.end(), *rng);
+
+  // Generates num_inliers points along the x-axis in the interval [0, 1] with
+  // a y-value in the range (-noise, noise) choosen at random. All normals of
+  // the inliers are set to [0, 1].
+  std::uniform_real_distribution<double> distr(-noise, noise);
+
+  const double kXStep = 1.0 / static_cast<double>(std::max(num_inliers, 1));
+  double x = 0.0;
+  for (int i = 0; i < num_inliers; ++i, x += kXStep) {
+    const int kIndex = indices[i];
+    points_with_normals->col(kIndex)[0] = x;
+    while (true) {
+      points_with_normals->col(kIndex)[1] = distr(*rng);
+      if (points_with_normals->col(kIndex)[1] > -noise) {
+        break;
+      }
+    }
+    points_with_normals->col(kIndex)[2] = 0.0;
+    points_with_normals->col(kIndex)[3] = 1.0;
+  }
+
+  // Randomly generates outliers in the range [0, 1] x [-0.5, 0.5].
+  std::uniform_real_distribution<double> distr_x(0.0, 1.0);
+  std::uniform_real_distribution<double> distr_y(-0.5, 0.5);
+  for (int i = num_inliers; i < kNumPoints; ++i) {
+    double x = distr_x(*rng);
+    double y = distr_y(*rng);
+    while (std::fabs(y) < 5.0 * noise) {
+      y = distr_y(*rng);
+    }
+
+    const int kIndex = indices[i];
+    points_with_normals->col(kIndex)[0] = x;
+    points_with_normals->col(kIndex)[1] = y;
+
+    points_with_normals->col(kIndex)[2] = 0.0;
+    points_with_normals->col(kIndex)[3] = 0.0;
+    while (points_with_normals->col(kIndex).tail<2>().norm() < 0.5) {
+      points_with_normals->col(kIndex)[2] = distr_y(*rng);
+      points_with_normals->col(kIndex)[3] = distr_y(*rng);
+    }
+    points_with_normals->col(kIndex).tail<2>().normalize();
+  }
+
+  // Rotates and translates the points.
+  for (int i = 0; i < kNumPoints; ++i) {
+    Eigen::Vector2d p = R * points_with_normals->col(i).head<2>() + t;
+    points_with_normals->col(i).head<2>() = p;
+    Eigen::Vector2d n = R * points_with_normals->col(i).tail<2>();
+    points_with_normals->col(i).tail<2>() = n;
+  }
+
+  // The line y = 0 is transformed into n^T p - n^T t = 0, where n = R [0, 1]^T.
+  const Eigen::Vector2d kNormal = R.col(1);
+  line->head<2>() = kNormal;
+  (*line)[2] = -kNormal.dot(t);
+
+  inlier_indices->assign(indices.begin(), indices.begin() + num_inliers);
+  std::sort(inlier_indices->begin(), inlier_indices->end());
+}
+
+void GenerateLineInstance(const int num_inliers, const int num_outliers,
+                          const double noise, std::mt19937* rng,
+                          Eigen::Matrix2Xd* points, Eigen::Vector3d* line,
+                          std::vector<int>* inlier_indices) {
+  Eigen::Matrix2d R;
+  Eigen::Vector2d t;
+  GenerateRandomTransform(rng, &R, &t);
+
+  Eigen::Matrix4Xd points_with_normals;
+  GenerateLineInstance(num_inliers, num_outliers, noise, R, t, rng,
+                       &points_with_normals, line, inlier_indices);
+  *points = points_with_normals.topRows<2>();
+}
+
+void GeneratePoseInstance(const double width, const double height,
+                          const double focal_length, const int num_inliers,
+                          const int num_outliers, const double noise,
+                          const double min_depth, const double max_depth,
+                          std::mt19937* rng,
+                          calibrated_absolute_pose::Points2D* points2D,
+                          calibrated_absolute_pose::ViewingRays* rays,
+                          calibrated_absolute_pose::Points3D* points3D,
+                          calibrated_absolute_pose::CameraPose* pose,
+                          std::vector<int>* inlier_indices) {
+  const int kNumPoints = num_inliers + num_outliers;
+  points2D->resize(kNumPoints);
+  points3D->resize(kNumPoints);
+
+  std::vector<int> indices(kNumPoints);
+  std::iota(indices.begin(), indices.end(), 0);
+  std::shuffle(indices.begin(), indices.end(), *rng);
+
+  const double kWidthHalf = width * 0.5;
+  const double kHeightHalf = height * 0.5;
+  std::uniform_real_distribution<double> distr_x(-kWidthHalf, kWidthHalf);
+  std::uniform_real_distribution<double> distr_y(-kHeightHalf, kHeightHalf);
+  std::uniform_real_distribution<double> distr_d(min_depth, max_depth);
+  std::uniform_real_distribution<double> distr(-1.0, 1.0);
+
+  // Generates the inliers.
+  for (int i = 0; i < num_inliers; ++i) {
+    const int kIndex = indices[i];
+    const double kX = distr_x(*rng);
+    const double kY = distr_y(*rng);
+    (*points2D)[kIndex] = Eigen::Vector2d(kX, kY);
+
+    Eigen::Vector3d dir = (*points2D)[kIndex].homogeneous();
+    dir.head<2>() /= focal_length;
+    dir.normalize();
+
+    // Obtains the 3D point.
+    (*points3D)[kIndex] = dir * distr_d(*rng);
+
+    // Adds some noise to the 2D position to make the case more realistic.
+    const double kNx = distr(*rng);
+    const double kNy = distr(*rng);
+    (*points2D)[kIndex] += Eigen::Vector2d(kNx, kNy) * noise;
+  }
+
+  // Generates the outliers.
+  for (int i = num_inliers; i < kNumPoints; ++i) {
+    const int kIndex = indices[i];
+    const double kX = distr_x(*rng);
+    const double kY = distr_y(*rng);
+    Eigen::Vector2d p(kX, kY);
+
+    Eigen::Vector3d dir = p.homogeneous();
+    dir.head<2>() /= focal_length;
+    dir.normalize();
+
+    // Obtains the 3D point.
+    (*points3D)[kIndex] = dir * distr_d(*rng);
+
+    // Estimates a new pixel position that is far enough from the original one.
+    do {
+      const double kOx = distr_x(*rng);
+      const double kOy = distr_y(*rng);
+      (*points2D)[kIndex] = Eigen::Vector2d(kOx, kOy);
+    } while (((*points2D)[kIndex] - p).norm() < 10.0 * (noise + 1.0));
+  }
+
+  // Randomly rotates and translates the 3D points. The rotation is drawn from
+  // rng rather than via Eigen::Quaterniond::UnitRandom(), which uses
+  // std::rand().
+  std::normal_distribution<double> distr_q(0.0, 1.0);
+  Eigen::Vector4d q_coeffs;
+  for (int i = 0; i < 4; ++i) q_coeffs[i] = distr_q(*rng);
+  Eigen::Quaterniond q(q_coeffs[0], q_coeffs[1], q_coeffs[2], q_coeffs[3]);
+  q.normalize();
+  Eigen::Matrix3d R(q);
+  std::uniform_real_distribution<double> distr_scale(1.0, 2.0);
+  Eigen::Vector3d t;
+  for (int i = 0; i < 3; ++i) t[i] = distr(*rng);
+  t *= distr_scale(*rng);
+
+  for (int i = 0; i < kNumPoints; ++i) {
+    Eigen::Vector3d p = R * (*points3D)[i] + t;
+    (*points3D)[i] = p;
+  }
+
+  // The camera was placed at the origin with identity rotation before the
+  // transformation, i.e., its rotation is now R^T and its position t.
+  pose->leftCols<3>() = R.transpose();
+  pose->col(3) = t;
+
+  // Same as CalibratedAbsolutePoseEstimator::PixelsToViewingRays, such that
+  // the library does not depend on the estimator implementation.
+  rays->resize(kNumPoints);
+  for (int i = 0; i < kNumPoints; ++i) {
+    (*rays)[i] = (*points2D)[i].homogeneous();
+    (*rays)[i].head<2>() /= focal_length;
+    (*rays)[i].normalize();
+  }
+
+  inlier_indices->assign(indices.begin(), indices.begin() + num_inliers);
+  std::sort(inlier_indices->begin(), inlier_indices->end());
+}
+
+double InlierRecall(const std::vector<int>& gt_inliers,
+                    const std::vector<int>& inliers) {
+  if (gt_inliers.empty()) return 1.0;
+
+  std::vector<int> found;
+  found.reserve(gt_inliers.size());
+  std::set_intersection(gt_inliers.begin(), gt_inliers.end(), inliers.begin(),
+                        inliers.end(), std::back_inserter(found));
+  return static_cast<double>(found.size()) /
+         static_cast<double>(gt_inliers.size());
+}
+
+}  // namespace synthetic
+
+}  // namespace ransac_lib
@@ -0,0 +1,106 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+#ifndef RANSACLIB_EXAMPLE_SYNTHETIC_DATASETS_H_
+#define RANSACLIB_EXAMPLE_SYNTHETIC_DATASETS_H_
+
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+#include "calibrated_absolute_pose_estimator.h"
+
+namespace ransac_lib {
+
+namespace synthetic {
+
+// Generators for the synthetic problem instances used by the examples and the
+// benchmarks. All randomness is drawn from the random number generator passed
+// to the functions, i.e., instances are reproducible for a fixed seed.
+// Besides the data, every generator returns the ground truth model and the
+// (sorted) indices of the inliers.
+
+// Generates a random 2D rotation and translation.
+void GenerateRandomTransform(std::mt19937* rng, Eigen::Matrix2d* R,
+                             Eigen::Vector2d* t);
+
+// Generates num_inliers points on a line and num_outliers points in a
+// [0, 1] x [-0.5, 0.5] region around it. The inliers are perturbed by uniform
+// noise in (-noise, noise) orthogonal to the line, outliers are at least
+// 5 * noise away from the line. Each point is stored together with a normal:
+// The inliers have the line normal, the outliers a random one. All points and
+// normals are transformed by [R | t]. The line is returned as (a, b, c) with
+// a * x + b * y + c = 0 and (a, b) having unit length.
+// Assumes that noise << 0.5.
+void GenerateLineInstance(const int num_inliers, const int num_outliers,
+                          const double noise, const Eigen::Matrix2d& R,
+                          const Eigen::Vector2d& t, std::mt19937* rng,
+                          Eigen::Matrix4Xd* points_with_normals,
+                          Eigen::Vector3d* line,
+                          std::vector<int>* inlier_indices);
+
+// As above, but without normals and using a random transformation.
+void GenerateLineInstance(const int num_inliers, const int num_outliers,
+                          const double noise, std::mt19937* rng,
+                          Eigen::Matrix2Xd* points, Eigen::Vector3d* line,
+                          std::vector<int>* inlier_indices);
+
+// Generates 2D-3D matches for a calibrated camera with a width x height image
+// and the given focal length. The 3D points have a depth in
+// [min_depth, max_depth] w.r.t. the camera. The 2D positions of the inliers
+// are perturbed by uniform noise in (-noise, noise) per coordinate, the
+// outliers are placed at least 10 * (noise + 1) pixels away from the
+// projections of their 3D points. The scene is transformed by a random
+// rotation and translation, which defines the ground truth pose [R | c] (see
+// CalibratedAbsolutePoseEstimator).
+void GeneratePoseInstance(const double width, const double height,
+                          const double focal_length, const int num_inliers,
+                          const int num_outliers, const double noise,
+                          const double min_depth, const double max_depth,
+                          std::mt19937* rng,
+                          calibrated_absolute_pose::Points2D* points2D,
+                          calibrated_absolute_pose::ViewingRays* rays,
+                          calibrated_absolute_pose::Points3D* points3D,
+                          calibrated_absolute_pose::CameraPose* pose,
+                          std::vector<int>* inlier_indices);
+
+// Returns the fraction of the ground truth inliers that are contained in
+// inliers. Both lists need to be sorted. Returns 1 if there are no ground
+// truth inliers.
+double InlierRecall(const std::vector<int>& gt_inliers,
+                    const std::vector<int>& inliers);
+
+}  // namespace synthetic
+
+}  // namespace ransac_lib
+
+#endif  // RANSACLIB_EXAMPLE_SYNTHETIC_DATASETS_H_
@@ -0,0 +1,518 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// Measures how the examples scale with the number of threads. All work is
+// distributed via one of RansacLib's executors (see executor.h), i.e., the
+// built-in thread pool, OpenMP, or TBB. Two forms of parallelism are
+// measured:
+//  - batch: A batch of independent problem instances is distributed over the
+//    threads, each running its own LO-MSAC.
+//  - scoring: The residuals of a single model on all data points are computed
+//    by splitting the data into one contiguous chunk per thread. This is the
+//    inner loop of LO-MSAC, and the measurement shows from which number of
+//    data points on it is worth parallelizing (see
+//    LORansacOptions::min_num_data_per_task_).
+// For each mode, problem, problem size and number of threads, the mean run
+// time and its standard deviation over several repetitions as well as the
+// speedup and efficiency w.r.t. a single thread are reported. In addition,
+// the crossover points, i.e., the smallest problem size for which a given
+// number of threads is faster than a single thread, are printed.
+// The results are written to <outfile_prefix>.csv and <outfile_prefix>.json.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <RansacLib/executor.h>
+#include <RansacLib/hybrid_ransac.h>
+#include <RansacLib/ransac.h>
+#include "calibrated_absolute_pose_estimator.h"
+#include "hybrid_line_estimator.h"
+#include "line_estimator.h"
+#include "synthetic_datasets.h"
+
+namespace ransac_lib {
+
+namespace thread_scaling {
+
+// Calls job(t, num_threads) for t = 0, ..., num_threads - 1 via the executor
+// and waits until all calls returned. The executors are created once such
+// that thread creation is not part of the measurements.
+void RunJob(Executor* executor, const std::function<void(int, int)>& job) {
+  const int kNumThreads = executor->num_threads();
+  executor->BulkFor(kNumThreads, [&](int t) { job(t, kNumThreads); });
+}
+
+// Creates an executor of the given type ("pool", "openmp", or "tbb") with
+// num_threads threads. Returns nullptr if the type is not available.
+std::unique_ptr<Executor> CreateExecutor(const std::string& type,
+                                         const int num_threads) {
+  if (type == "pool") {
+    return std::unique_ptr<Executor>(new ThreadPoolExecutor(num_threads));
+  }
+#ifdef _OPENMP
+  if (type == "openmp") {
+    return std::unique_ptr<Executor>(new OpenMPExecutor(num_threads));
+  }
+#endif
+#ifdef RANSACLIB_WITH_TBB
+  if (type == "tbb") {
+    return std::unique_ptr<Executor>(new TBBExecutor(num_threads));
+  }
+#endif
+  return nullptr;
+}
+
+// The synthetic instances used by the benchmark. Each problem holds a batch
+// of instances of the same size.
+struct LineProblem {
+  std::vector<Eigen::Matrix2Xd> points;
+};
+
+struct HybridLineProblem {
+  std::vector<Eigen::Matrix2Xd> points;
+  std::vector<Eigen::Matrix4Xd> points_with_normals;
+};
+
+struct PoseProblem {
+  std::vector<calibrated_absolute_pose::Points2D> points2D;
+  std::vector<calibrated_absolute_pose::ViewingRays> rays;
+  std::vector<calibrated_absolute_pose::Points3D> points3D;
+  std::vector<calibrated_absolute_pose::CameraPose,
+              Eigen::aligned_allocator<calibrated_absolute_pose::CameraPose>>
+      poses;
+};
+
+const double kLineThreshold = 0.01;
+const double kPoseWidth = 640.0;
+const double kPoseHeight = 320.0;
+const double kPoseThreshold = 12.0;
+
+double PoseFocalLength() {
+  return (kPoseWidth * 0.5) / std::tan(60.0 * M_PI / 180.0);
+}
+
+// All instances use 50% outliers.
+void GenerateLineProblem(const int num_data, const int batch_size,
+                         LineProblem* problem) {
+  std::mt19937 rng(static_cast<unsigned int>(num_data));
+  problem->points.resize(batch_size);
+  Eigen::Vector3d line;
+  std::vector<int> inliers;
+  for (int i = 0; i < batch_size; ++i) {
+    synthetic::GenerateLineInstance(num_data / 2, num_data - num_data / 2,
+                                    0.5 * kLineThreshold, &rng,
+                                    &problem->points[i], &line, &inliers);
+  }
+}
+
+void GenerateHybridLineProblem(const int num_data, const int batch_size,
+                               HybridLineProblem* problem) {
+  std::mt19937 rng(static_cast<unsigned int>(num_data));
+  problem->points.resize(batch_size);
+  problem->points_with_normals.resize(batch_size);
+  Eigen::Vector3d line;
+  std::vector<int> inliers;
+  for (int i = 0; i < batch_size; ++i) {
+    Eigen::Matrix2d R;
+    Eigen::Vector2d t;
+    synthetic::GenerateRandomTransform(&rng, &R, &t);
+    Eigen::Matrix4Xd data;
+    synthetic::GenerateLineInstance(num_data / 2, num_data - num_data / 2,
+                                    0.5 * kLineThreshold, R, t, &rng, &data,
+                                    &line, &inliers);
+    problem->points[i] = data.topRows<2>();
+    synthetic::GenerateLineInstance(
+        num_data / 2, num_data - num_data / 2, 0.5 * kLineThreshold, R, t,
+        &rng, &problem->points_with_normals[i], &line, &inliers);
+  }
+}
+
+void GeneratePoseProblem(const int num_data, const int batch_size,
+                         PoseProblem* problem) {
+  std::mt19937 rng(static_cast<unsigned int>(num_data));
+  problem->points2D.resize(batch_size);
+  problem->rays.resize(batch_size);
+  problem->points3D.resize(batch_size);
+  problem->poses.resize(batch_size);
+  std::vector<int> inliers;
+  for (int i = 0; i < batch_size; ++i) {
+    synthetic::GeneratePoseInstance(
+        kPoseWidth, kPoseHeight, PoseFocalLength(), num_data / 2,
+        num_data - num_data / 2, 2.0, 2.0, 10.0, &rng, &problem->points2D[i],
+        &problem->rays[i], &problem->points3D[i], &problem->poses[i],
+        &inliers);
+  }
+}
+
+void RunLine(const LineProblem& problem, const int i) {
+  LORansacOptions options;
+  options.min_num_iterations_ = 100u;
+  options.max_num_iterations_ = 100000u;
+  options.squared_inlier_threshold_ = kLineThreshold * kLineThreshold;
+  options.random_seed_ = static_cast<unsigned int>(i);
+
+  LineEstimator solver(problem.points[i]);
+  LocallyOptimizedMSAC<Eigen::Vector3d, std::vector<Eigen::Vector3d>,
+                       LineEstimator>
+      lomsac;
+  RansacStatistics ransac_stats;
+  Eigen::Vector3d best_model;
+  lomsac.EstimateModel(options, solver, &best_model, &ransac_stats);
+}
+
+void RunHybridLine(const HybridLineProblem& problem, const int i) {
+  HybridLORansacOptions options;
+  options.min_num_iterations_ = 100u;
+  options.max_num_iterations_ = 10000u;
+  options.max_num_iterations_per_solver_ = 1000u;
+  options.squared_inlier_thresholds_ = {kLineThreshold * kLineThreshold,
+                                        kLineThreshold * kLineThreshold};
+  options.data_type_weights_ = {2.0, 0.5};
+  options.random_seed_ = static_cast<unsigned int>(i);
+
+  std::vector<double> prior_probabilities = {0.2, 0.8};
+  HybridLineEstimator solver(problem.points[i], problem.points_with_normals[i],
+                             prior_probabilities);
+  HybridLocallyOptimizedMSAC<Eigen::Vector3d, std::vector<Eigen::Vector3d>,
+                             HybridLineEstimator>
+      lomsac;
+  HybridRansacStatistics ransac_stats;
+  Eigen::Vector3d best_model;
+  lomsac.EstimateModel(options, solver, &best_model, &ransac_stats);
+}
+
+void RunPose(const PoseProblem& problem, const int i) {
+  using calibrated_absolute_pose::CalibratedAbsolutePoseEstimator;
+  using calibrated_absolute_pose::CameraPose;
+  using calibrated_absolute_pose::CameraPoses;
+
+  LORansacOptions options;
+  options.min_num_iterations_ = 100u;
+  options.max_num_iterations_ = 100000u;
+  options.squared_inlier_threshold_ = kPoseThreshold * kPoseThreshold;
+  options.min_sample_multiplicator_ = 7;
+  options.num_lsq_iterations_ = 4;
+  options.num_lo_steps_ = 10;
+  options.random_seed_ = static_cast<unsigned int>(i);
+
+  CalibratedAbsolutePoseEstimator solver(
+      PoseFocalLength(), PoseFocalLength(), kPoseThreshold * kPoseThreshold,
+      problem.points2D[i], problem.rays[i], problem.points3D[i]);
+  LocallyOptimizedMSAC<CameraPose, CameraPoses,
+                       CalibratedAbsolutePoseEstimator>
+      lomsac;
+  RansacStatistics ransac_stats;
+  CameraPose best_model;
+  lomsac.EstimateModel(options, solver, &best_model, &ransac_stats);
+}
+
+// A job executed by the thread team. reset is called before every run.
+struct Job {
+  std::function<void(int, int)> run;
+  std::function<void()> reset;
+};
+
+std::atomic<int> g_next_instance(0);
+std::vector<double> g_scores;
+
+// Evaluates a model on the thread's contiguous chunk of the data. The scores
+// are written to per-thread slots (padded to avoid false sharing) such that
+// the compiler cannot remove the computation.
+template <class Evaluate>
+void ScoreChunk(const int num_data, const int thread_id, const int num_threads,
+                const Evaluate& evaluate) {
+  const int kBegin = static_cast<int>(
+      static_cast<int64_t>(num_data) * thread_id / num_threads);
+  const int kEnd = static_cast<int>(
+      static_cast<int64_t>(num_data) * (thread_id + 1) / num_threads);
+  double score = 0.0;
+  for (int i = kBegin; i < kEnd; ++i) score += evaluate(i);
+  g_scores[thread_id * 8] = score;
+}
+
+// Distributes the instances of a batch dynamically over the threads via an
+// atomic counter.
+template <class Problem, class RunInstance>
+Job BatchJob(const Problem& problem, const int batch_size,
+             const RunInstance& run_instance) {
+  Job job;
+  job.reset = [] { g_next_instance = 0; };
+  job.run = [&problem, batch_size, run_instance](int, int) {
+    while (true) {
+      const int kIndex = g_next_instance.fetch_add(1);
+      if (kIndex >= batch_size) break;
+      run_instance(problem, kIndex);
+    }
+  };
+  return job;
+}
+
+struct Measurement {
+  std::string mode;
+  std::string problem;
+  int num_data;
+  int num_threads;
+  int num_repeats;
+  double mean_ms;
+  double stddev_ms;
+  double speedup;
+  double efficiency;
+};
+
+void Measure(Executor* executor, const Job& job, const int num_repeats,
+             double* mean_ms, double* stddev_ms) {
+  std::vector<double> times_ms(num_repeats);
+  // Warm-up run.
+  job.reset();
+  RunJob(executor, job.run);
+  for (int r = 0; r < num_repeats; ++r) {
+    job.reset();
+    auto start = std::chrono::steady_clock::now();
+    RunJob(executor, job.run);
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+    times_ms[r] = elapsed.count();
+  }
+  double sum = 0.0;
+  for (const double t : times_ms) sum += t;
+  *mean_ms = sum / static_cast<double>(num_repeats);
+  double sum_sq = 0.0;
+  for (const double t : times_ms) sum_sq += (t - *mean_ms) * (t - *mean_ms);
+  *stddev_ms = num_repeats > 1
+                   ? std::sqrt(sum_sq / static_cast<double>(num_repeats - 1))
+                   : 0.0;
+}
+
+bool WriteResults(const std::string& prefix,
+                  const std::vector<Measurement>& results) {
+  std::ofstream ofs_csv((prefix + ".csv").c_str(), std::ios::out);
+  std::ofstream ofs_json((prefix + ".json").c_str(), std::ios::out);
+  if (!ofs_csv.is_open() || !ofs_json.is_open()) {
+    std::cerr << " ERROR: Cannot write to " << prefix << ".{csv,json}"
+              << std::endl;
+    return false;
+  }
+  ofs_csv << std::setprecision(9);
+  ofs_json << std::setprecision(9);
+  ofs_csv << "mode,problem,num_data,num_threads,num_repeats,mean_ms,"
+          << "stddev_ms,speedup,efficiency" << std::endl;
+  ofs_json << "[" << std::endl;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Measurement& m = results[i];
+    ofs_csv << m.mode << "," << m.problem << "," << m.num_data << ","
+            << m.num_threads << "," << m.num_repeats << "," << m.mean_ms
+            << "," << m.stddev_ms << "," << m.speedup << "," << m.efficiency
+            << std::endl;
+    ofs_json << "  {\"mode\": \"" << m.mode << "\", \"problem\": \""
+             << m.problem << "\", \"num_data\": " << m.num_data
+             << ", \"num_threads\": " << m.num_threads
+             << ", \"num_repeats\": " << m.num_repeats
+             << ", \"mean_ms\": " << m.mean_ms
+             << ", \"stddev_ms\": " << m.stddev_ms
+             << ", \"speedup\": " << m.speedup
+             << ", \"efficiency\": " << m.efficiency << "}"
+             << (i + 1 < results.size() ? "," : "") << std::endl;
+  }
+  ofs_json << "]" << std::endl;
+  return true;
+}
+
+// Prints, for every mode, problem and number of threads, the smallest
+// problem size from which on the threads provide a speedup of at least
+// min_speedup for all larger measured sizes. Assumes that results are sorted by mode, problem, size, and
+// number of threads.
+void PrintCrossoverPoints(const std::vector<Measurement>& results,
+                          const double min_speedup) {
+  std::cout << std::endl
+            << " Crossover points (smallest N with a speedup >= "
+            << min_speedup << "):" << std::endl;
+  std::vector<bool> printed(results.size(), false);
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Measurement& m = results[i];
+    if (m.num_threads == 1 || printed[i]) continue;
+    int crossover = -1;
+    for (size_t j = i; j < results.size(); ++j) {
+      const Measurement& o = results[j];
+      if (o.mode != m.mode || o.problem != m.problem) break;
+      if (o.num_threads != m.num_threads) continue;
+      printed[j] = true;
+      if (o.speedup < min_speedup) {
+        crossover = -1;
+      } else if (crossover < 0) {
+        crossover = o.num_data;
+      }
+    }
+    std::cout << "   " << m.mode << " " << m.problem << " " << m.num_threads
+              << " threads: ";
+    if (crossover < 0) {
+      std::cout << "none" << std::endl;
+    } else {
+      std::cout << "N = " << crossover << std::endl;
+    }
+  }
+}
+
+}  // namespace thread_scaling
+
+}  // namespace ransac_lib
+
+int main(int argc, char** argv) {
+  using namespace ransac_lib::thread_scaling;
+
+  if (argc < 2) {
+    std::cout << " Usage: " << argv[0]
+              << " outfile_prefix [max_num_threads] [num_repeats] "
+              << "[batch_size] [executor: pool|openmp|tbb]" << std::endl;
+    return -1;
+  }
+  const std::string kOutPrefix(argv[1]);
+  const int kHardwareThreads =
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  const int kMaxNumThreads =
+      argc > 2 ? std::max(1, std::atoi(argv[2])) : kHardwareThreads;
+  const int kNumRepeats = argc > 3 ? std::max(1, std::atoi(argv[3])) : 5;
+  const int kBatchSize = argc > 4 ? std::max(1, std::atoi(argv[4])) : 64;
+  const std::string kExecutorType(argc > 5 ? argv[5] : "pool");
+
+  // Uses 1, 2, 4, ... threads and kMaxNumThreads.
+  std::vector<int> thread_counts;
+  for (int t = 1; t < kMaxNumThreads; t *= 2) thread_counts.push_back(t);
+  thread_counts.push_back(kMaxNumThreads);
+
+  const std::vector<int> kBatchSizes = {100, 1000, 10000};
+  const std::vector<int> kScoringSizes = {100,   300,    1000,  3000,
+                                          10000, 30000, 100000, 300000};
+
+  // The executors are created once and re-used for all measurements.
+  std::vector<std::unique_ptr<ransac_lib::Executor>> executors;
+  for (const int t : thread_counts) {
+    executors.push_back(CreateExecutor(kExecutorType, t));
+    if (!executors.back()) {
+      std::cerr << " ERROR: Executor " << kExecutorType << " is not available"
+                << std::endl;
+      return -1;
+    }
+  }
+  g_scores.assign(8 * kMaxNumThreads, 0.0);
+
+  std::vector<Measurement> results;
+  auto measure_all = [&](const std::string& mode, const std::string& problem,
+                         const int num_data, const Job& job) {
+    double time_single = 0.0;
+    for (size_t t = 0; t < thread_counts.size(); ++t) {
+      Measurement m;
+      m.mode = mode;
+      m.problem = problem;
+      m.num_data = num_data;
+      m.num_threads = thread_counts[t];
+      m.num_repeats = kNumRepeats;
+      Measure(executors[t].get(), job, kNumRepeats, &m.mean_ms, &m.stddev_ms);
+      if (t == 0) time_single = m.mean_ms;
+      m.speedup = time_single / std::max(m.mean_ms, 1e-9);
+      m.efficiency = m.speedup / static_cast<double>(m.num_threads);
+      std::cout << " " << mode << " " << problem << " N=" << num_data << " "
+                << m.num_threads << " threads: " << m.mean_ms << " ms (+- "
+                << m.stddev_ms << "), speedup " << m.speedup
+                << ", efficiency " << m.efficiency << std::endl;
+      results.push_back(m);
+    }
+  };
+
+  for (const int kN : kBatchSizes) {
+    LineProblem problem;
+    GenerateLineProblem(kN, kBatchSize, &problem);
+    measure_all("batch", "line", kN, BatchJob(problem, kBatchSize, RunLine));
+  }
+  for (const int kN : kBatchSizes) {
+    HybridLineProblem problem;
+    GenerateHybridLineProblem(kN, kBatchSize, &problem);
+    measure_all("batch", "hybrid_line", kN,
+                BatchJob(problem, kBatchSize, RunHybridLine));
+  }
+  for (const int kN : kBatchSizes) {
+    PoseProblem problem;
+    GeneratePoseProblem(kN, kBatchSize, &problem);
+    measure_all("batch", "pose", kN, BatchJob(problem, kBatchSize, RunPose));
+  }
+
+  for (const int kN : kScoringSizes) {
+    LineProblem problem;
+    GenerateLineProblem(kN, 1, &problem);
+    ransac_lib::LineEstimator solver(problem.points[0]);
+    const Eigen::Vector3d kLine(0.0, 1.0, 0.0);
+    Job job;
+    job.reset = [] {};
+    job.run = [&](int thread_id, int num_threads) {
+      ScoreChunk(kN, thread_id, num_threads, [&](int i) {
+        return solver.EvaluateModelOnPoint(kLine, i);
+      });
+    };
+    measure_all("scoring", "line", kN, job);
+  }
+  for (const int kN : kScoringSizes) {
+    PoseProblem problem;
+    GeneratePoseProblem(kN, 1, &problem);
+    ransac_lib::calibrated_absolute_pose::CalibratedAbsolutePoseEstimator
+        solver(PoseFocalLength(), PoseFocalLength(),
+               kPoseThreshold * kPoseThreshold, problem.points2D[0],
+               problem.rays[0], problem.points3D[0]);
+    const ransac_lib::calibrated_absolute_pose::CameraPose kPose =
+        problem.poses[0];
+    Job job;
+    job.reset = [] {};
+    job.run = [&](int thread_id, int num_threads) {
+      ScoreChunk(kN, thread_id, num_threads, [&](int i) {
+        return std::min(solver.EvaluateModelOnPoint(kPose, i), 1e6);
+      });
+    };
+    measure_all("scoring", "pose", kN, job);
+  }
+
+  PrintCrossoverPoints(results, 1.0);
+  PrintCrossoverPoints(results, 1.5);
+
+  if (!WriteResults(kOutPrefix, results)) return -1;
+  return 0;
+}
@@ -0,0 +1,242 @@
+// Copyright (c) 2019, Torsten Sattler
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Torsten Sattler nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// author: Torsten Sattler, torsten.sattler.de@googlemail.com
+
+// Measures the effect of the topology-aware placement of the built-in thread
+// pool (see ThreadPoolOptions in executor.h). A batch of line fitting
+// problems is processed by three pools with the same number of threads:
+//  - unpinned: The operating system is free to move the workers.
+//  - pinned: Every worker is pinned to its own CPU, spread over the NUMA
+//    nodes.
+//  - partitioned: The workers are pinned and the batch is partitioned by
+//    NUMA node, such that every problem is only processed on the node on
+//    which its data was allocated.
+// For each pool, the data of every problem is generated (and thus first
+// touched) inside a BulkFor call of the pool. The benchmark then measures
+//  - scoring: Evaluating a set of hypotheses on all points of every problem,
+//    with the squared errors written to the worker's workspace. This is
+//    memory-bound and shows the cost of remote memory accesses.
+//  - lomsac: Running LO-MSAC on every problem.
+// On machines with a single NUMA node, only the effect of pinning itself is
+// measured.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <RansacLib/executor.h>
+#include <RansacLib/ransac.h>
+#include <RansacLib/topology.h>
+#include "line_estimator.h"
+#include "synthetic_datasets.h"
+
+namespace ransac_lib {
+
+namespace topology_benchmark {
+
+const double kThreshold = 0.01;
+const int kNumHypotheses = 16;
+
+void PrintTopology(const topology::CpuTopology& cpu_topology) {
+  std::cout << " Topology: " << cpu_topology.cpus.size() << " CPUs, "
+            << cpu_topology.num_cores << " cores, "
+            << cpu_topology.num_packages << " packages, "
+            << cpu_topology.num_nodes << " NUMA nodes" << std::endl;
+  for (const topology::LogicalCpu& cpu : cpu_topology.cpus) {
+    std::cout << "   cpu " << cpu.cpu << ": core " << cpu.core << ", smt "
+              << cpu.smt_index << ", package " << cpu.package << ", node "
+              << cpu.node << std::endl;
+  }
+}
+
+void PrintPlacement(const ThreadPoolExecutor& pool) {
+  std::cout << "   placement (worker:cpu/node):";
+  for (int i = 0; i < pool.num_threads(); ++i) {
+    std::cout << " " << i << ":" << pool.worker_cpu(i) << "/"
+              << pool.worker_node(i);
+  }
+  std::cout << std::endl;
+}
+
+// Generates the data of all problems inside the pool. The data of problem i
+// is allocated by the worker that processes item i.
+void GenerateProblems(const int num_data, const int batch_size,
+                      ThreadPoolExecutor* pool,
+                      std::vector<Eigen::Matrix2Xd>* points) {
+  points->clear();
+  points->resize(batch_size);
+  pool->BulkFor(batch_size, [&](int i) {
+    std::mt19937 rng(static_cast<unsigned int>(i));
+    Eigen::Vector3d line;
+    std::vector<int> inliers;
+    synthetic::GenerateLineInstance(num_data / 2, num_data - num_data / 2,
+                                    0.5 * kThreshold, &rng, &(*points)[i],
+                                    &line, &inliers);
+  });
+}
+
+// Evaluates kNumHypotheses lines, each defined by two random points, on all
+// points of problem i and returns the sum of their MSAC scores. The calling
+// thread of BulkFor, which also processes items unless the batch is
+// partitioned, is not a worker and uses its own buffer.
+double ScoreProblem(const ThreadPoolExecutor& pool,
+                    const Eigen::Matrix2Xd& points, const int i) {
+  const int kNumData = static_cast<int>(points.cols());
+  const int kWorker = pool.current_worker();
+  thread_local std::vector<double> caller_errors;
+  double* errors = nullptr;
+  if (kWorker >= 0) {
+    errors = reinterpret_cast<double*>(pool.workspace(kWorker));
+  } else {
+    caller_errors.resize(kNumData);
+    errors = caller_errors.data();
+  }
+
+  LineEstimator solver(points);
+  std::mt19937 rng(static_cast<unsigned int>(i));
+  std::uniform_int_distribution<int> distribution(0, kNumData - 1);
+  const double kSquaredThreshold = kThreshold * kThreshold;
+  double score = 0.0;
+  for (int h = 0; h < kNumHypotheses; ++h) {
+    std::vector<int> sample = {distribution(rng), distribution(rng)};
+    std::vector<Eigen::Vector3d> lines;
+    if (solver.MinimalSolver(sample, &lines) == 0) continue;
+    for (int j = 0; j < kNumData; ++j) {
+      errors[j] = solver.EvaluateModelOnPoint(lines[0], j);
+    }
+    for (int j = 0; j < kNumData; ++j) {
+      score += std::min(errors[j], kSquaredThreshold);
+    }
+  }
+  return score;
+}
+
+void RunLOMSAC(const Eigen::Matrix2Xd& points, const int i) {
+  LORansacOptions options;
+  options.min_num_iterations_ = 100u;
+  options.max_num_iterations_ = 100000u;
+  options.squared_inlier_threshold_ = kThreshold * kThreshold;
+  options.random_seed_ = static_cast<unsigned int>(i);
+
+  LineEstimator solver(points);
+  LocallyOptimizedMSAC<Eigen::Vector3d, std::vector<Eigen::Vector3d>,
+                       LineEstimator>
+      lomsac;
+  RansacStatistics ransac_stats;
+  Eigen::Vector3d best_model;
+  lomsac.EstimateModel(options, solver, &best_model, &ransac_stats);
+}
+
+// Returns the mean run-time of function in milliseconds over num_repeats
+// runs, after one warm-up run.
+double Measure(const int num_repeats, const std::function<void()>& function) {
+  function();
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < num_repeats; ++r) function();
+  auto end = std::chrono::steady_clock::now();
+  std::chrono::duration<double, std::milli> elapsed = end - start;
+  return elapsed.count() / static_cast<double>(num_repeats);
+}
+
+}  // namespace topology_benchmark
+
+}  // namespace ransac_lib
+
+int main(int argc, char** argv) {
+  using namespace ransac_lib::topology_benchmark;
+  using ransac_lib::ThreadPoolExecutor;
+  using ransac_lib::ThreadPoolOptions;
+
+  if (argc > 1 && std::string(argv[1]) == "--help") {
+    std::cout << " Usage: " << argv[0]
+              << " [num_threads] [num_data] [batch_size] [num_repeats] "
+              << "[use_smt: 0|1]" << std::endl;
+    return 0;
+  }
+  const int kNumThreads = argc > 1 ? std::atoi(argv[1]) : 0;
+  const int kNumData = argc > 2 ? std::max(2, std::atoi(argv[2])) : 100000;
+  const int kBatchSize = argc > 3 ? std::max(1, std::atoi(argv[3])) : 256;
+  const int kNumRepeats = argc > 4 ? std::max(1, std::atoi(argv[4])) : 5;
+  const bool kUseSMT = argc > 5 ? std::atoi(argv[5]) != 0 : true;
+
+  const ransac_lib::topology::CpuTopology kTopology =
+      ransac_lib::topology::DiscoverTopology();
+  PrintTopology(kTopology);
+
+  const std::vector<std::string> kConfigurations = {"unpinned", "pinned",
+                                                    "partitioned"};
+  double scoring_unpinned = 0.0;
+  double lomsac_unpinned = 0.0;
+  for (const std::string& configuration : kConfigurations) {
+    ThreadPoolOptions options;
+    options.num_threads_ = kNumThreads;
+    options.use_smt_ = kUseSMT;
+    options.pin_threads_ = configuration != "unpinned";
+    options.partition_by_node_ = configuration == "partitioned";
+    options.workspace_bytes_ = sizeof(double) * static_cast<size_t>(kNumData);
+    ThreadPoolExecutor pool(options, kTopology);
+
+    std::cout << std::endl
+              << " " << configuration << ": " << pool.num_threads()
+              << " threads on " << pool.num_nodes() << " node(s)"
+              << std::endl;
+    PrintPlacement(pool);
+
+    std::vector<Eigen::Matrix2Xd> points;
+    GenerateProblems(kNumData, kBatchSize, &pool, &points);
+
+    std::vector<double> scores(kBatchSize, 0.0);
+    const double kScoringMs = Measure(kNumRepeats, [&]() {
+      pool.BulkFor(kBatchSize, [&](int i) {
+        scores[i] = ScoreProblem(pool, points[i], i);
+      });
+    });
+    const double kLOMSACMs = Measure(kNumRepeats, [&]() {
+      pool.BulkFor(kBatchSize, [&](int i) { RunLOMSAC(points[i], i); });
+    });
+    if (configuration == "unpinned") {
+      scoring_unpinned = kScoringMs;
+      lomsac_unpinned = kLOMSACMs;
+    }
+    std::cout << "   scoring: " << kScoringMs << " ms (speedup "
+              << scoring_unpinned / kScoringMs << ")" << std::endl;
+    std::cout << "   lomsac:  " << kLOMSACMs << " ms (speedup "
+              << lomsac_unpinned / kLOMSACMs << ")" << std::endl;
+  }
+  return 0;
+}